@@ -0,0 +1,215 @@
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace buffer_pool {
+namespace {
+
+/// Mask for the part of a free list head that identifies the block.
+constexpr uint64_t kIdMask = 0xFFFFFFFF;
+/// Amount to add to a free list head to bump its version.
+constexpr uint64_t kVersionIncrement = kIdMask + 1;
+/// Never keep fewer blocks than this in any class.
+constexpr uint32_t kMinBlocksPerClass = 4;
+/// Never keep more blocks than this in any class.
+constexpr uint32_t kMaxBlocksPerClass = 4096;
+
+}  // namespace
+
+/**
+ * @brief A chunk of memory that can be shared between several buffers.
+ */
+struct Buffer::Block {
+  /// The pool that this block belongs to.
+  BufferPool* pool;
+  /// Index of the size class that this block belongs to. If the block isn't
+  /// pooled, this is `kNumSizeClasses`.
+  size_t class_index;
+  /// ID of this block within its size class.
+  uint32_t id;
+  /// One more than the ID of the next block on the free list, or zero if this
+  /// is the last one. Only meaningful while the block is on the free list.
+  std::atomic<uint32_t> next_free;
+  /// Number of buffers that are using this block.
+  std::atomic<uint32_t> references;
+  /// The memory itself.
+  std::unique_ptr<uint8_t[]> data;
+};
+
+Buffer::Buffer(Block* block, size_t size)
+    : block_(block), data_(block->data.get()), size_(size) {}
+
+Buffer::~Buffer() { Release(); }
+
+Buffer::Buffer(const Buffer& other)
+    : block_(other.block_), data_(other.data_), size_(other.size_) {
+  if (block_ != nullptr) {
+    block_->references.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+Buffer& Buffer::operator=(const Buffer& other) {
+  if (this != &other) {
+    // Take the new reference first, in case both share a block.
+    if (other.block_ != nullptr) {
+      other.block_->references.fetch_add(1, std::memory_order_relaxed);
+    }
+    Release();
+    block_ = other.block_;
+    data_ = other.data_;
+    size_ = other.size_;
+  }
+
+  return *this;
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+    : block_(std::exchange(other.block_, nullptr)),
+      data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+  if (this != &other) {
+    Release();
+    block_ = std::exchange(other.block_, nullptr);
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+
+  return *this;
+}
+
+void Buffer::TrimFront(size_t num_bytes) {
+  num_bytes = std::min(num_bytes, size_);
+  data_ += num_bytes;
+  size_ -= num_bytes;
+}
+
+void Buffer::Release() {
+  if (block_ == nullptr) {
+    return;
+  }
+
+  if (block_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // We were the last user.
+    block_->pool->Recycle(block_);
+  }
+  block_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+BufferPool::BufferPool() {
+  size_t buffer_size = kMinBufferSize;
+  for (auto& size_class : size_classes_) {
+    size_class.buffer_size = buffer_size;
+    size_class.max_blocks = static_cast<uint32_t>(
+        std::clamp(kMaxRetainedBytes / buffer_size,
+                   static_cast<size_t>(kMinBlocksPerClass),
+                   static_cast<size_t>(kMaxBlocksPerClass)));
+    size_class.blocks = std::make_unique<std::atomic<Buffer::Block*>[]>(
+        size_class.max_blocks);
+    buffer_size *= 2;
+  }
+}
+
+BufferPool::~BufferPool() {
+  for (auto& size_class : size_classes_) {
+    const uint32_t kNumBlocks = size_class.num_blocks.load();
+    for (uint32_t i = 0; i < kNumBlocks; ++i) {
+      delete size_class.blocks[i].load();
+    }
+  }
+}
+
+Buffer BufferPool::Acquire(size_t size) {
+  if (size == 0) {
+    return {};
+  }
+
+  // Find the smallest class that fits.
+  size_t class_index = 0;
+  while (class_index < kNumSizeClasses &&
+         size_classes_[class_index].buffer_size < size) {
+    ++class_index;
+  }
+  if (class_index == kNumSizeClasses) {
+    // Too big to be worth keeping around.
+    return {NewBlock(kNumSizeClasses, 0, size), size};
+  }
+  auto& size_class = size_classes_[class_index];
+
+  // Try to take one off the free list.
+  uint64_t head = size_class.free_head.load(std::memory_order_acquire);
+  while ((head & kIdMask) != 0) {
+    auto* block =
+        size_class.blocks[(head & kIdMask) - 1].load(std::memory_order_acquire);
+    // Blocks are never freed while the pool exists, so it's safe to look at
+    // this even if somebody else takes it first. The CAS will fail if they do.
+    const uint64_t kNewHead =
+        ((head & ~kIdMask) + kVersionIncrement) |
+        block->next_free.load(std::memory_order_relaxed);
+    if (size_class.free_head.compare_exchange_weak(
+            head, kNewHead, std::memory_order_acquire,
+            std::memory_order_acquire)) {
+      block->references.store(1, std::memory_order_relaxed);
+      return {block, size};
+    }
+  }
+
+  // The free list is empty, so make a new one if this class has room.
+  uint32_t id = size_class.num_blocks.load(std::memory_order_relaxed);
+  while (id < size_class.max_blocks &&
+         !size_class.num_blocks.compare_exchange_weak(
+             id, id + 1, std::memory_order_relaxed)) {
+  }
+  if (id >= size_class.max_blocks) {
+    // Plenty of these are out already. This one just gets freed at the end.
+    return {NewBlock(kNumSizeClasses, 0, size_class.buffer_size), size};
+  }
+
+  auto* block = NewBlock(class_index, id, size_class.buffer_size);
+  size_class.blocks[id].store(block, std::memory_order_release);
+  return {block, size};
+}
+
+uint64_t BufferPool::GetNumAllocations() const {
+  return num_allocations_.load(std::memory_order_relaxed);
+}
+
+BufferPool& BufferPool::Default() {
+  static auto* pool = new BufferPool();
+  return *pool;
+}
+
+void BufferPool::Recycle(Buffer::Block* block) {
+  if (block->class_index == kNumSizeClasses) {
+    // Not pooled.
+    delete block;
+    return;
+  }
+
+  auto& size_class = size_classes_[block->class_index];
+  uint64_t head = size_class.free_head.load(std::memory_order_relaxed);
+  uint64_t new_head;
+  do {
+    block->next_free.store(static_cast<uint32_t>(head & kIdMask),
+                           std::memory_order_relaxed);
+    new_head = ((head & ~kIdMask) + kVersionIncrement) | (block->id + 1);
+  } while (!size_class.free_head.compare_exchange_weak(
+      head, new_head, std::memory_order_release, std::memory_order_relaxed));
+}
+
+Buffer::Block* BufferPool::NewBlock(size_t class_index, uint32_t id,
+                                    size_t capacity) {
+  num_allocations_.fetch_add(1, std::memory_order_relaxed);
+  return new Buffer::Block{this,
+                           class_index,
+                           id,
+                           {0},
+                           {1},
+                           std::make_unique<uint8_t[]>(capacity)};
+}
+
+}  // namespace buffer_pool
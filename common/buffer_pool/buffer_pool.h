@@ -0,0 +1,175 @@
+#ifndef CSCI6780_BUFFER_POOL_BUFFER_POOL_H
+#define CSCI6780_BUFFER_POOL_BUFFER_POOL_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace buffer_pool {
+
+class BufferPool;
+
+/**
+ * @brief Reference-counted handle to a buffer that came from a `BufferPool`.
+ * @details Copying a handle only bumps the reference count. The memory goes
+ *    back to the pool once the last handle to it is destroyed. Each handle
+ *    has its own view of the memory, so trimming one copy doesn't affect the
+ *    others.
+ */
+class Buffer {
+ public:
+  /**
+   * @brief Creates an empty buffer, which doesn't hold any memory.
+   */
+  Buffer() = default;
+  ~Buffer();
+
+  Buffer(const Buffer& other);
+  Buffer& operator=(const Buffer& other);
+  Buffer(Buffer&& other) noexcept;
+  Buffer& operator=(Buffer&& other) noexcept;
+
+  /**
+   * @return The start of the buffer.
+   */
+  [[nodiscard]] uint8_t* data() { return data_; }
+  [[nodiscard]] const uint8_t* data() const { return data_; }
+
+  /**
+   * @return The number of bytes in the buffer.
+   */
+  [[nodiscard]] size_t size() const { return size_; }
+
+  /**
+   * @return True if the buffer has no data.
+   */
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  /**
+   * @brief Removes bytes from the front of the buffer, without copying
+   *    anything.
+   * @param num_bytes The number of bytes to remove. If it is more than the
+   *    size of the buffer, the buffer becomes empty.
+   */
+  void TrimFront(size_t num_bytes);
+
+ private:
+  friend class BufferPool;
+
+  struct Block;
+
+  /**
+   * @param block The block to take ownership of a reference to.
+   * @param size The number of bytes of the block to use.
+   */
+  Buffer(Block* block, size_t size);
+
+  /**
+   * @brief Gives up this handle's reference, returning the block to its pool
+   *    if nobody else is using it.
+   */
+  void Release();
+
+  /// The block that the memory belongs to.
+  Block* block_ = nullptr;
+  /// The start of this handle's view of the block.
+  uint8_t* data_ = nullptr;
+  /// The size of this handle's view of the block.
+  size_t size_ = 0;
+};
+
+/**
+ * @brief Hands out buffers that are recycled instead of freed, so that code
+ *    which constantly needs short-lived buffers doesn't have to go to the
+ *    allocator every time.
+ * @details Buffers are grouped into power-of-two size classes, each with its
+ *    own lock-free free list. A class only keeps a limited number of buffers
+ *    around, so that a burst of traffic doesn't pin memory forever. Requests
+ *    larger than the largest class, or made when a class is at its limit,
+ *    fall back to the allocator.
+ * @note The pool must outlive every buffer that it hands out.
+ */
+class BufferPool {
+ public:
+  /// Size of the smallest size class.
+  static constexpr size_t kMinBufferSize = 256;
+  /// Number of size classes. The largest one is 1 MiB.
+  static constexpr size_t kNumSizeClasses = 13;
+  /// Approximately how much memory each size class is allowed to keep.
+  static constexpr size_t kMaxRetainedBytes = 4 * 1024 * 1024;
+
+  BufferPool();
+  ~BufferPool();
+
+  BufferPool(const BufferPool& other) = delete;
+  BufferPool& operator=(const BufferPool& other) = delete;
+
+  /**
+   * @brief Gets a buffer from the pool. Its contents are undefined.
+   * @param size The size of the buffer.
+   * @return The buffer.
+   */
+  Buffer Acquire(size_t size);
+
+  /**
+   * @return The number of times that this pool has had to allocate memory.
+   *    Once the pool is warmed up, this should stop changing.
+   */
+  [[nodiscard]] uint64_t GetNumAllocations() const;
+
+  /**
+   * @return The pool that is shared by the whole process. It is never
+   *    destroyed, so that it safely outlives buffers held by other static
+   *    objects.
+   */
+  static BufferPool& Default();
+
+ private:
+  friend class Buffer;
+
+  /**
+   * @brief Buffers of one particular size.
+   */
+  struct SizeClass {
+    /// Size of every buffer in this class.
+    size_t buffer_size = 0;
+    /// Maximum number of buffers that this class will keep.
+    uint32_t max_blocks = 0;
+    /// Every block that this class has created, indexed by block ID.
+    std::unique_ptr<std::atomic<Buffer::Block*>[]> blocks{};
+    /// Number of entries in `blocks` that are in use.
+    std::atomic<uint32_t> num_blocks = 0;
+    /// Top of the free list. The low half is one more than the ID of the
+    /// first free block, or zero if the list is empty. The high half is
+    /// bumped on every change, so that a stale compare-and-swap can't
+    /// succeed just because the same block ended up on top again.
+    std::atomic<uint64_t> free_head = 0;
+  };
+
+  /**
+   * @brief Puts a block back on its free list.
+   * @param block The block, which nobody is using anymore.
+   */
+  void Recycle(Buffer::Block* block);
+
+  /**
+   * @brief Allocates a new block.
+   * @param class_index The index of the class it belongs to, or
+   *    `kNumSizeClasses` if it shouldn't be pooled.
+   * @param id The ID of the block within its class.
+   * @param capacity The size of the block.
+   * @return The block.
+   */
+  Buffer::Block* NewBlock(size_t class_index, uint32_t id, size_t capacity);
+
+  /// All the size classes, from smallest to largest.
+  std::array<SizeClass, kNumSizeClasses> size_classes_{};
+  /// Total number of blocks that have been allocated.
+  std::atomic<uint64_t> num_allocations_ = 0;
+};
+
+}  // namespace buffer_pool
+
+#endif  // CSCI6780_BUFFER_POOL_BUFFER_POOL_H
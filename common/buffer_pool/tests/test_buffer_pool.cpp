@@ -0,0 +1,126 @@
+/**
+ * @file Tests for `BufferPool`.
+ */
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../buffer_pool.h"
+#include "gtest/gtest.h"
+
+namespace buffer_pool::tests {
+
+/**
+ * @test Tests that a buffer that was released gets handed out again instead
+ * of allocating a new one.
+ */
+TEST(BufferPool, ReusesBuffers) {
+  // Arrange.
+  BufferPool pool;
+
+  // Act.
+  const uint8_t* first_data;
+  {
+    auto buffer = pool.Acquire(100);
+    first_data = buffer.data();
+  }
+  auto buffer = pool.Acquire(200);
+
+  // Assert.
+  // Both sizes are in the same class, so it should be the same memory.
+  EXPECT_EQ(first_data, buffer.data());
+  EXPECT_EQ(200U, buffer.size());
+  EXPECT_EQ(1U, pool.GetNumAllocations());
+}
+
+/**
+ * @test Tests that copies of a buffer share the same memory, but have their
+ * own views of it, and that the memory isn't recycled until they're all gone.
+ */
+TEST(BufferPool, SharedHandles) {
+  // Arrange.
+  BufferPool pool;
+  auto buffer = pool.Acquire(4);
+  std::memcpy(buffer.data(), "abcd", 4);
+
+  // Act.
+  auto copy = buffer;
+  copy.TrimFront(1);
+  buffer = Buffer();
+  // This can't reuse the memory, because `copy` still has it.
+  auto other = pool.Acquire(4);
+
+  // Assert.
+  ASSERT_EQ(3U, copy.size());
+  EXPECT_EQ(0, std::memcmp(copy.data(), "bcd", 3));
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_NE(copy.data() - 1, other.data());
+  EXPECT_EQ(2U, pool.GetNumAllocations());
+}
+
+/**
+ * @test Tests that buffers that are too big for any size class still work.
+ */
+TEST(BufferPool, Oversized) {
+  // Arrange.
+  BufferPool pool;
+  constexpr size_t kSize = 16 * 1024 * 1024;
+
+  // Act.
+  auto buffer = pool.Acquire(kSize);
+  buffer.data()[kSize - 1] = 42;
+
+  // Assert.
+  EXPECT_EQ(kSize, buffer.size());
+  EXPECT_EQ(42, buffer.data()[kSize - 1]);
+}
+
+/**
+ * @test Tests that many threads can share the pool without ever being handed
+ * the same buffer at once, and that it stops allocating once it is warm.
+ */
+TEST(BufferPool, ManyThreads) {
+  // Arrange.
+  BufferPool pool;
+  constexpr int kNumThreads = 8;
+  constexpr int kNumIterations = 20000;
+  constexpr size_t kSize = 1000;
+
+  // Act.
+  std::vector<std::thread> threads;
+  std::array<bool, kNumThreads> corrupted{};
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&pool, &corrupted, i]() {
+      for (int j = 0; j < kNumIterations; ++j) {
+        // Hold a couple at a time, so the free list gets some depth.
+        auto first = pool.Acquire(kSize);
+        auto second = pool.Acquire(kSize);
+        std::memset(first.data(), i, kSize);
+        std::memset(second.data(), i + kNumThreads, kSize);
+        std::this_thread::yield();
+
+        if (first.data()[kSize - 1] != i ||
+            second.data()[0] != i + kNumThreads) {
+          // Somebody else was writing to the same memory.
+          corrupted[i] = true;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Assert.
+  for (int i = 0; i < kNumThreads; ++i) {
+    EXPECT_FALSE(corrupted[i]);
+  }
+  // Nobody ever held more than two at once.
+  EXPECT_LE(pool.GetNumAllocations(), 2U * kNumThreads);
+}
+
+}  // namespace buffer_pool::tests
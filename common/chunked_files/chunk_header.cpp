@@ -0,0 +1,41 @@
+#include "chunk_header.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+
+namespace chunked_files {
+namespace {
+
+/// Set in the header of the final chunk.
+constexpr uint32_t kLastFlag = 1U << 31;
+/// Set in the header of the final chunk if the file was aborted.
+constexpr uint32_t kAbortedFlag = 1U << 30;
+
+}  // namespace
+
+void WriteChunkHeader(const ChunkHeader& header, uint8_t* data) {
+  uint32_t word = header.length & kMaxChunkLength;
+  if (header.is_last) {
+    word |= kLastFlag;
+  }
+  if (header.aborted) {
+    word |= kAbortedFlag;
+  }
+
+  const uint32_t kWordNetwork = htonl(word);
+  std::copy(reinterpret_cast<const uint8_t*>(&kWordNetwork),
+            reinterpret_cast<const uint8_t*>(&kWordNetwork + 1), data);
+}
+
+ChunkHeader ReadChunkHeader(const uint8_t* data) {
+  uint32_t word_network;
+  std::copy(data, data + kChunkHeaderSize,
+            reinterpret_cast<uint8_t*>(&word_network));
+  const uint32_t kWord = ntohl(word_network);
+
+  return {kWord & kMaxChunkLength, (kWord & kLastFlag) != 0,
+          (kWord & kAbortedFlag) != 0};
+}
+
+}  // namespace chunked_files
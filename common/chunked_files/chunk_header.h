@@ -0,0 +1,49 @@
+#ifndef PROJECT1_CHUNK_HEADER_H
+#define PROJECT1_CHUNK_HEADER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace chunked_files {
+
+/// Number of bytes that a chunk header takes up on the wire.
+constexpr size_t kChunkHeaderSize = sizeof(uint32_t);
+/// Largest chunk that a header can describe.
+constexpr uint32_t kMaxChunkLength = (1U << 30) - 1;
+
+/**
+ * @brief Header that goes in front of each chunk of a file that is streamed
+ *  raw, instead of in `FileContents` messages.
+ * @details On the wire, this is a single big-endian word. The low 30 bits
+ *  are the length of the chunk, and the top two bits are the flags. The
+ *  chunk data follows the header directly.
+ */
+struct ChunkHeader {
+  /// The number of bytes of file data that follow the header.
+  uint32_t length = 0;
+  /// Whether this is the final chunk of the file.
+  bool is_last = false;
+  /// Whether the sender gave up on the file. This is only set on a final,
+  /// empty chunk, and means that the receiver should throw away what it got.
+  bool aborted = false;
+};
+
+/**
+ * @brief Writes a chunk header in the wire format.
+ * @param header The header to write. The length must be no more than
+ *  `kMaxChunkLength`.
+ * @param[out] data Where to write it. Must have room for `kChunkHeaderSize`
+ *  bytes.
+ */
+void WriteChunkHeader(const ChunkHeader& header, uint8_t* data);
+
+/**
+ * @brief Reads a chunk header that was written with `WriteChunkHeader()`.
+ * @param data The header data. Must contain `kChunkHeaderSize` bytes.
+ * @return The header.
+ */
+ChunkHeader ReadChunkHeader(const uint8_t* data);
+
+}  // namespace chunked_files
+
+#endif  // PROJECT1_CHUNK_HEADER_H
@@ -10,7 +10,7 @@ namespace chunked_files {
 namespace {
 
 /// Size to receive message chunks in.
-constexpr uint32_t kClientBufferSize = 4096;
+constexpr uint32_t kClientBufferSize = 64 * 1024;
 
 }  // namespace
 
@@ -22,7 +22,7 @@ int ChunkedFileReceiver::ReceiveNextChunk() {
   while (!parser_.HasCompleteMessage()) {
     incoming_message_buffer_.resize(kClientBufferSize);
 
-    // Read 1000 bytes from the socket
+    // Read some more data from the socket.
     const auto bytes_read =
         recv(socket_, incoming_message_buffer_.data(), kClientBufferSize, 0);
 
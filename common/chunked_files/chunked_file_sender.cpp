@@ -14,8 +14,9 @@ using wire_protocol::Serialize;
 namespace chunked_files {
 namespace {
 
-/// Number of bytes of the file to send in each chunk.
-constexpr size_t kChunkSize = 1000;
+/// Number of bytes of the file to send in each chunk. Each one is a separate
+/// message, so small chunks mean a lot of framing and syscall overhead.
+constexpr size_t kChunkSize = 64 * 1024;
 
 }  // namespace
 
@@ -0,0 +1,168 @@
+#include "file_stream_receiver.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <loguru.hpp>
+#include <utility>
+
+namespace chunked_files {
+namespace {
+
+/// Maximum amount of file data to read from the socket at once.
+constexpr size_t kReceiveBufferSize = 64 * 1024;
+
+/**
+ * @brief Writes a complete buffer to a file descriptor.
+ * @param fd The file descriptor.
+ * @param data The data to write.
+ * @param length The number of bytes to write.
+ * @param offset Where in the file to write it.
+ * @return True if it wrote everything.
+ */
+bool WriteAll(int fd, const uint8_t* data, size_t length, off_t offset) {
+  while (length > 0) {
+    const ssize_t kWriteResult = pwrite(fd, data, length, offset);
+    if (kWriteResult < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    data += kWriteResult;
+    length -= kWriteResult;
+    offset += kWriteResult;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+FileStreamReceiver::FileStreamReceiver(int socket, int out_fd,
+                                       std::vector<uint8_t> initial_data,
+                                       off_t out_offset, uint64_t max_length)
+    : initial_data_(std::move(initial_data)),
+      incoming_buffer_(kReceiveBufferSize),
+      socket_(socket),
+      out_fd_(out_fd),
+      out_offset_(out_offset),
+      max_length_(max_length) {}
+
+int FileStreamReceiver::ReceiveNextChunk() {
+  if (complete_file_) {
+    return 0;
+  }
+
+  if (chunk_bytes_remaining_ == 0) {
+    // We are between chunks, so read the next header. It is small, so reading
+    // it separately doesn't cost much, and it keeps us from ever consuming
+    // data past the end of the file.
+    const ssize_t kBytesRead = Read(header_buffer_ + header_bytes_read_,
+                                    kChunkHeaderSize - header_bytes_read_);
+    if (kBytesRead <= 0) {
+      if (kBytesRead == 0) {
+        LOG_F(INFO, "Server with FD %i has disconnected.", socket_);
+      }
+      return kBytesRead;
+    }
+
+    header_bytes_read_ += kBytesRead;
+    if (header_bytes_read_ == kChunkHeaderSize) {
+      current_header_ = ReadChunkHeader(header_buffer_);
+      chunk_bytes_remaining_ = current_header_.length;
+      header_bytes_read_ = 0;
+
+      if (current_header_.is_last && chunk_bytes_remaining_ == 0) {
+        complete_file_ = true;
+      }
+    }
+
+    return kBytesRead;
+  }
+
+  // Read chunk data.
+  const size_t kToRead =
+      std::min<size_t>(chunk_bytes_remaining_, incoming_buffer_.size());
+  const ssize_t kBytesRead = Read(incoming_buffer_.data(), kToRead);
+  if (kBytesRead <= 0) {
+    if (kBytesRead == 0) {
+      LOG_F(INFO, "Server with FD %i has disconnected.", socket_);
+    }
+    return kBytesRead;
+  }
+
+  chunk_bytes_remaining_ -= kBytesRead;
+  if (chunk_bytes_remaining_ == 0 && current_header_.is_last) {
+    complete_file_ = true;
+  }
+
+  num_file_bytes_ += kBytesRead;
+  if (out_fd_ >= 0 && num_file_bytes_ > max_length_) {
+    // Don't let the sender write outside of where it is supposed to.
+    LOG_S(ERROR) << "Got more than the expected " << max_length_
+                 << " bytes of file data, discarding the rest.";
+    out_fd_ = -1;
+  }
+
+  if (out_fd_ >= 0 &&
+      !WriteAll(out_fd_, incoming_buffer_.data(), kBytesRead, out_offset_)) {
+    LOG_S(ERROR) << "Failed to write file data: " << std::strerror(errno);
+    // CleanUp() can still drain the rest of the file from the socket.
+    return -1;
+  }
+  out_offset_ += kBytesRead;
+
+  return kBytesRead;
+}
+
+ssize_t FileStreamReceiver::Read(uint8_t* buffer, size_t length) {
+  if (initial_data_offset_ < initial_data_.size()) {
+    const size_t kToCopy =
+        std::min(length, initial_data_.size() - initial_data_offset_);
+    std::copy(initial_data_.begin() + initial_data_offset_,
+              initial_data_.begin() + initial_data_offset_ + kToCopy, buffer);
+    initial_data_offset_ += kToCopy;
+    return kToCopy;
+  }
+
+  return recv(socket_, buffer, length, 0);
+}
+
+bool FileStreamReceiver::HasCompleteFile() const { return complete_file_; }
+
+bool FileStreamReceiver::WasAborted() const {
+  return complete_file_ && current_header_.aborted;
+}
+
+bool FileStreamReceiver::HasBufferedData() const {
+  return initial_data_offset_ < initial_data_.size();
+}
+
+uint64_t FileStreamReceiver::GetNumFileBytes() const {
+  return num_file_bytes_;
+}
+
+bool FileStreamReceiver::CleanUp() {
+  out_fd_ = -1;
+
+  while (!complete_file_) {
+    const int kBytesRead = ReceiveNextChunk();
+    if (kBytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                           errno == EINTR)) {
+      // Just a timeout.
+      continue;
+    }
+    if (kBytesRead <= 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace chunked_files
@@ -0,0 +1,125 @@
+#ifndef PROJECT1_FILE_STREAM_RECEIVER_H
+#define PROJECT1_FILE_STREAM_RECEIVER_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "chunk_header.h"
+
+namespace chunked_files {
+
+/**
+ * @brief Helper class for receiving a file that was sent with
+ *    `FileStreamSender`. The data is written to a file descriptor as it
+ *    arrives, so the whole file never has to fit in memory.
+ */
+class FileStreamReceiver {
+ public:
+  /**
+   * @param socket The socket to receive data on.
+   * @param out_fd Where to write the file data. This does not take ownership
+   *    of it.
+   * @param initial_data Data that was already read from the socket, such as
+   *    the overflow from parsing the preceding message. It is consumed
+   *    before reading anything else.
+   * @param out_offset Where in the output file to write the data. This is
+   *    useful for fetching a file in several ranges.
+   * @param max_length The most file data to write. Anything past that is
+   *    still read, so the socket is left in a valid state, but discarded.
+   */
+  FileStreamReceiver(int socket, int out_fd,
+                     std::vector<uint8_t> initial_data = {},
+                     off_t out_offset = 0,
+                     uint64_t max_length =
+                         std::numeric_limits<uint64_t>::max());
+
+  /**
+   * @brief Does a single read from the socket, and writes out any file data
+   *    that it got.
+   * @return Total number of bytes read from the socket, 0 if the sender
+   *    disconnected, -1 for an error reading the socket or writing the file.
+   *    In either case, `errno` is left set.
+   */
+  int ReceiveNextChunk();
+
+  /**
+   * @return True if it read the last chunk of the file. This is also true if
+   *    the sender aborted.
+   */
+  [[nodiscard]] bool HasCompleteFile() const;
+
+  /**
+   * @return True if the sender aborted the file, in which case whatever was
+   *    written so far should be thrown away.
+   */
+  [[nodiscard]] bool WasAborted() const;
+
+  /**
+   * @return True if some of the initial data hasn't been consumed yet. In
+   *    that case, `ReceiveNextChunk()` will not touch the socket, so it can be
+   *    called even if the socket has nothing to read.
+   */
+  [[nodiscard]] bool HasBufferedData() const;
+
+  /**
+   * @return How many bytes of file data have been received so far, including
+   *    any that were discarded.
+   */
+  [[nodiscard]] uint64_t GetNumFileBytes() const;
+
+  /**
+   * @brief Reads any remaining data from the socket until the end of the
+   *    file, discarding it. This is mostly so we don't leave the socket in an
+   *    indeterminate state.
+   * @return False if it encountered a socket error.
+   */
+  bool CleanUp();
+
+ private:
+  /**
+   * @brief Reads data, taking it from the initial data first, and then from
+   *    the socket.
+   * @param buffer Where to put the data.
+   * @param length The maximum number of bytes to read.
+   * @return The same as `recv()`.
+   */
+  ssize_t Read(uint8_t *buffer, size_t length);
+
+  /// Data that was read before we were created, and hasn't been consumed.
+  std::vector<uint8_t> initial_data_;
+  /// Number of bytes of the initial data we have already consumed.
+  size_t initial_data_offset_ = 0;
+
+  /// Buffer used for storing raw data from the socket.
+  std::vector<uint8_t> incoming_buffer_;
+
+  /// Raw bytes of the chunk header we are in the middle of reading.
+  uint8_t header_buffer_[kChunkHeaderSize]{};
+  /// Number of bytes of the current header that we have read.
+  size_t header_bytes_read_ = 0;
+  /// The header of the chunk we are currently reading.
+  ChunkHeader current_header_{};
+  /// Number of bytes of the current chunk that we still have to read.
+  uint32_t chunk_bytes_remaining_ = 0;
+
+  /// Whether we got the last chunk.
+  bool complete_file_ = false;
+
+  /// Socket to receive data on.
+  int socket_;
+  /// Where to write the file data. Set to -1 to discard it instead.
+  int out_fd_;
+  /// Offset in the output file to write the next byte of data at.
+  off_t out_offset_;
+  /// The most file data to write.
+  uint64_t max_length_;
+  /// How much file data we have received.
+  uint64_t num_file_bytes_ = 0;
+};
+
+}  // namespace chunked_files
+
+#endif  // PROJECT1_FILE_STREAM_RECEIVER_H
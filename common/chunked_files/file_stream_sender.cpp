@@ -0,0 +1,193 @@
+#include "file_stream_sender.h"
+
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <loguru.hpp>
+#include <utility>
+
+#include "chunk_header.h"
+
+namespace chunked_files {
+namespace {
+
+/// How long we would like each chunk to take to send. This bounds how long
+/// it takes to notice a termination, since we check between chunks.
+constexpr double kTargetChunkSeconds = 0.02;
+/// Weight of the newest measurement in the smoothed throughput.
+constexpr double kThroughputSmoothing = 0.5;
+
+/**
+ * @brief Clamps a chunk size to the allowed range.
+ * @param size The chunk size.
+ * @param max_size The largest allowed chunk size.
+ * @return The clamped size.
+ */
+uint32_t ClampChunkSize(uint64_t size, uint32_t max_size) {
+  return std::clamp<uint64_t>(size, kMinChunkSize, max_size);
+}
+
+}  // namespace
+
+FileStreamSender::FileStreamSender(int socket, int file_fd,
+                                   uint32_t max_chunk_size)
+    : socket_(socket),
+      file_fd_(file_fd),
+      max_chunk_size_(max_chunk_size == 0
+                          ? kMaxChunkSize
+                          : ClampChunkSize(max_chunk_size, kMaxChunkSize)),
+      chunk_size_(max_chunk_size_) {
+  // Until we have measured anything, a socket buffer's worth is a good guess
+  // at how much we can send quickly.
+  int send_buffer_size = 0;
+  socklen_t option_size = sizeof(send_buffer_size);
+  if (getsockopt(socket_, SOL_SOCKET, SO_SNDBUF, &send_buffer_size,
+                 &option_size) == 0) {
+    chunk_size_ = ClampChunkSize(send_buffer_size, max_chunk_size_);
+  }
+
+  struct stat file_stat {};
+  if (file_fd_ < 0) {
+    // Nothing to send, which is only useful for aborting.
+  } else if (fstat(file_fd_, &file_stat) < 0) {
+    LOG_S(ERROR) << "Failed to stat file: " << std::strerror(errno);
+  } else {
+    file_size_ = file_stat.st_size;
+    end_ = file_size_;
+  }
+}
+
+FileStreamSender::FileStreamSender(
+    int socket, std::shared_ptr<const std::vector<uint8_t>> contents,
+    uint32_t max_chunk_size)
+    : FileStreamSender(socket, -1, max_chunk_size) {
+  contents_ = std::move(contents);
+  file_size_ = contents_->size();
+  end_ = file_size_;
+}
+
+FileStreamSender::~FileStreamSender() {
+  if (file_fd_ >= 0) {
+    close(file_fd_);
+  }
+}
+
+int FileStreamSender::SendNextChunk() {
+  const off_t kChunkLength = std::min<off_t>(chunk_size_, end_ - offset_);
+  const bool kIsLast = offset_ + kChunkLength >= end_;
+  const auto kStartTime = std::chrono::steady_clock::now();
+
+  // MSG_MORE keeps the header from going out in a packet of its own.
+  if (!SendHeader(kChunkLength, kIsLast, false)) {
+    return -1;
+  }
+
+  // Send the file data.
+  if (!SendData(offset_ + kChunkLength)) {
+    return -1;
+  }
+
+  sent_last_ = kIsLast;
+  if (!kIsLast) {
+    // The last chunk is usually short, so it doesn't tell us much.
+    const auto kElapsed = std::chrono::steady_clock::now() - kStartTime;
+    AdaptChunkSize(
+        kChunkLength,
+        std::chrono::duration_cast<std::chrono::microseconds>(kElapsed)
+            .count());
+  }
+  return kChunkHeaderSize + kChunkLength;
+}
+
+bool FileStreamSender::SendData(off_t chunk_end) {
+  while (offset_ < chunk_end) {
+    ssize_t send_result;
+    if (contents_) {
+      send_result = send(socket_, contents_->data() + offset_,
+                         chunk_end - offset_, 0);
+      if (send_result > 0) {
+        offset_ += send_result;
+      }
+    } else {
+      send_result = sendfile(socket_, file_fd_, &offset_, chunk_end - offset_);
+    }
+
+    if (send_result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_S(ERROR) << "Failed to send file data: " << std::strerror(errno);
+      return false;
+    } else if (send_result == 0) {
+      // We already promised the receiver more data than this, so the stream
+      // is unusable now.
+      LOG_F(ERROR, "File was truncated while sending it on FD %i.", socket_);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool FileStreamSender::SentCompleteFile() const { return sent_last_; }
+
+void FileStreamSender::SetRange(off_t offset, off_t length) {
+  offset_ = std::clamp<off_t>(offset, 0, file_size_);
+  end_ = length > 0 ? std::min(offset_ + length, file_size_) : file_size_;
+}
+
+uint32_t FileStreamSender::GetChunkSize() const { return chunk_size_; }
+
+void FileStreamSender::AdaptChunkSize(uint32_t chunk_length,
+                                      int64_t elapsed_us) {
+  // Anything faster than a microsecond just means it fit in the socket
+  // buffer.
+  const int64_t kElapsedUs = std::max<int64_t>(elapsed_us, 1);
+  const double kMeasured = chunk_length * 1e6 / kElapsedUs;
+  throughput_ = throughput_ == 0.0
+                    ? kMeasured
+                    : kThroughputSmoothing * kMeasured +
+                          (1.0 - kThroughputSmoothing) * throughput_;
+
+  chunk_size_ = ClampChunkSize(
+      static_cast<uint64_t>(throughput_ * kTargetChunkSeconds),
+      max_chunk_size_);
+}
+
+bool FileStreamSender::Abort() {
+  sent_last_ = true;
+  return SendHeader(0, true, true);
+}
+
+bool FileStreamSender::SendHeader(uint32_t length, bool is_last,
+                                  bool aborted) {
+  uint8_t header[kChunkHeaderSize];
+  WriteChunkHeader({length, is_last, aborted}, header);
+
+  const int kFlags = length > 0 ? MSG_MORE : 0;
+  size_t header_bytes_sent = 0;
+  while (header_bytes_sent < kChunkHeaderSize) {
+    const ssize_t kSendResult =
+        send(socket_, header + header_bytes_sent,
+             kChunkHeaderSize - header_bytes_sent, kFlags);
+
+    if (kSendResult < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_S(ERROR) << "Failed to send on socket: " << std::strerror(errno);
+      return false;
+    }
+    header_bytes_sent += kSendResult;
+  }
+
+  return true;
+}
+
+}  // namespace chunked_files
@@ -0,0 +1,150 @@
+#ifndef PROJECT1_FILE_STREAM_SENDER_H
+#define PROJECT1_FILE_STREAM_SENDER_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace chunked_files {
+
+/// Smallest chunk size that the sender will pick on its own.
+constexpr uint32_t kMinChunkSize = 64 * 1024;
+/// Largest chunk size that the sender will ever use.
+constexpr uint32_t kMaxChunkSize = 4 * 1024 * 1024;
+
+/**
+ * @brief Helper class for sending a file straight from its file descriptor,
+ *    without copying it through user space.
+ * @details Each chunk is a `ChunkHeader` followed by the raw file data, which
+ *    is sent with `sendfile()`. The last chunk has the `is_last` flag set. An
+ *    empty file is sent as a single empty last chunk.
+ *
+ *    It can also send a file that is already in memory, in which case the
+ *    data is copied from there instead.
+ *
+ *    The caller gets control back between chunks, which is where it checks
+ *    for termination. To keep that responsive without paying per-chunk
+ *    overhead on fast links, the chunk size adapts to the measured
+ *    throughput, so that each chunk takes roughly the same amount of time.
+ */
+class FileStreamSender {
+ public:
+  /**
+   * @param socket The socket to send data on.
+   * @param file_fd The file to send. This takes ownership of it, and closes
+   *    it when destroyed. If it is -1, the only sensible thing to do is
+   *    `Abort()`.
+   * @param max_chunk_size The largest chunk that the receiver asked for. It
+   *    is clamped to between `kMinChunkSize` and `kMaxChunkSize`, and 0 means
+   *    that the receiver has no preference.
+   */
+  FileStreamSender(int socket, int file_fd,
+                   uint32_t max_chunk_size = kMaxChunkSize);
+  /**
+   * @param socket The socket to send data on.
+   * @param contents The contents of the file to send. They must not change
+   *    while they are being sent.
+   * @param max_chunk_size The largest chunk that the receiver asked for.
+   */
+  FileStreamSender(int socket,
+                   std::shared_ptr<const std::vector<uint8_t>> contents,
+                   uint32_t max_chunk_size = kMaxChunkSize);
+  ~FileStreamSender();
+
+  FileStreamSender(const FileStreamSender &other) = delete;
+  FileStreamSender &operator=(const FileStreamSender &other) = delete;
+
+  /**
+   * @brief Sends the next chunk of the file. Call this repeatedly until
+   *    `SentCompleteFile()` returns true.
+   * @return Total number of bytes sent on the socket, or -1 for an error,
+   *    including if the receiver disconnected or the file shrank while we
+   *    were sending it.
+   */
+  int SendNextChunk();
+
+  /**
+   * @return True if it sent the complete file.
+   */
+  [[nodiscard]] bool SentCompleteFile() const;
+
+  /**
+   * @brief Limits the transfer to part of the file. Call this before sending
+   *    anything. The last chunk of the range is still marked as the last
+   *    chunk.
+   * @param offset Where in the file to start. This is clamped to the end of
+   *    the file.
+   * @param length The number of bytes to send, or 0 for the rest of the
+   *    file. This is clamped to the end of the file.
+   */
+  void SetRange(off_t offset, off_t length);
+
+  /**
+   * @return The size of the next chunk that will be sent, unless the end of
+   *    the file comes first.
+   */
+  [[nodiscard]] uint32_t GetChunkSize() const;
+
+  /**
+   * @brief Tells the receiver to throw away what it got so far, by sending
+   *    an empty last chunk with the `aborted` flag set. Nothing else should
+   *    be sent after this.
+   * @return True if it sent the terminator, false on a socket error.
+   */
+  bool Abort();
+
+ private:
+  /**
+   * @brief Sends a chunk header.
+   * @param length The length of the chunk.
+   * @param is_last Whether this is the last chunk.
+   * @param aborted Whether the file is being aborted.
+   * @return True if it sent the header, false on a socket error.
+   */
+  bool SendHeader(uint32_t length, bool is_last, bool aborted);
+
+  /**
+   * @brief Sends file data up to a particular offset, from wherever the file
+   *    is.
+   * @param chunk_end The offset to stop at.
+   * @return True if it sent the data, false on an error.
+   */
+  bool SendData(off_t chunk_end);
+
+  /**
+   * @brief Updates the chunk size based on how long the last chunk took.
+   * @param chunk_length The length of the chunk that we sent.
+   * @param elapsed_us How long it took to send, in microseconds.
+   */
+  void AdaptChunkSize(uint32_t chunk_length, int64_t elapsed_us);
+
+  /// Socket to send data on.
+  int socket_;
+  /// File we are sending, or -1 if it is in memory.
+  int file_fd_;
+  /// Contents of the file we are sending, if it is in memory.
+  std::shared_ptr<const std::vector<uint8_t>> contents_{};
+
+  /// Size of the file, as of when we started sending it.
+  off_t file_size_ = 0;
+  /// Offset in the file just past the last byte to send.
+  off_t end_ = 0;
+  /// Offset in the file of the next byte to send.
+  off_t offset_ = 0;
+  /// Whether the last chunk went out.
+  bool sent_last_ = false;
+
+  /// Largest chunk size we are allowed to use.
+  uint32_t max_chunk_size_;
+  /// Size of the next chunk to send.
+  uint32_t chunk_size_;
+  /// Smoothed throughput, in bytes per second, or 0 if we haven't measured
+  /// it yet.
+  double throughput_ = 0.0;
+};
+
+}  // namespace chunked_files
+
+#endif  // PROJECT1_FILE_STREAM_SENDER_H
@@ -0,0 +1,381 @@
+/**
+ * @file Tests for `FileStreamSender` and `FileStreamReceiver`.
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../chunk_header.h"
+#include "../file_stream_receiver.h"
+#include "../file_stream_sender.h"
+#include "gtest/gtest.h"
+
+namespace chunked_files::tests {
+namespace {
+
+/**
+ * @brief Creates a temporary file with particular contents.
+ * @param contents The contents of the file.
+ * @return The FD of the file, positioned at the start.
+ */
+int MakeFile(const std::vector<uint8_t>& contents) {
+  FILE* file = std::tmpfile();
+  EXPECT_NE(file, nullptr);
+  const int kFd = dup(fileno(file));
+  std::fclose(file);
+
+  EXPECT_EQ(write(kFd, contents.data(), contents.size()),
+            static_cast<ssize_t>(contents.size()));
+  lseek(kFd, 0, SEEK_SET);
+  return kFd;
+}
+
+/**
+ * @brief Reads the complete contents of a file.
+ * @param fd The file to read.
+ * @return The contents.
+ */
+std::vector<uint8_t> ReadFile(int fd) {
+  std::vector<uint8_t> contents;
+  uint8_t buffer[4096];
+  lseek(fd, 0, SEEK_SET);
+  ssize_t bytes_read;
+  while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
+    contents.insert(contents.end(), buffer, buffer + bytes_read);
+  }
+  return contents;
+}
+
+/**
+ * @brief Receives until the complete file arrives.
+ * @param receiver The receiver to use.
+ * @return True if it got the complete file.
+ */
+bool ReceiveAll(FileStreamReceiver* receiver) {
+  while (!receiver->HasCompleteFile()) {
+    if (receiver->ReceiveNextChunk() <= 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Fixture that sets up a connected pair of sockets.
+ */
+class FileStreamTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets_), 0);
+  }
+
+  void TearDown() override {
+    close(sockets_[0]);
+    close(sockets_[1]);
+  }
+
+  /// The sending and receiving sockets.
+  int sockets_[2]{};
+};
+
+/**
+ * @test Tests that a chunk header survives a round-trip through the wire
+ *    format.
+ */
+TEST(ChunkHeader, RoundTrip) {
+  // Arrange.
+  const ChunkHeader kHeader{123456, true, false};
+  uint8_t data[kChunkHeaderSize];
+
+  // Act.
+  WriteChunkHeader(kHeader, data);
+  const auto kGotHeader = ReadChunkHeader(data);
+
+  // Assert.
+  EXPECT_EQ(kGotHeader.length, kHeader.length);
+  EXPECT_TRUE(kGotHeader.is_last);
+  EXPECT_FALSE(kGotHeader.aborted);
+}
+
+/**
+ * @test Tests that a file spanning multiple chunks arrives intact.
+ */
+TEST_F(FileStreamTest, LargeFile) {
+  // Arrange.
+  std::vector<uint8_t> contents(5 * 1024 * 1024 / 2);
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = i * 31 + (i >> 12);
+  }
+  const int kInFd = MakeFile(contents);
+  const int kOutFd = MakeFile({});
+
+  FileStreamReceiver receiver(sockets_[1], kOutFd);
+
+  // Act.
+  std::thread sender_thread([&]() {
+    FileStreamSender sender(sockets_[0], kInFd);
+    while (!sender.SentCompleteFile()) {
+      ASSERT_GT(sender.SendNextChunk(), 0);
+    }
+  });
+  const bool kReceived = ReceiveAll(&receiver);
+  sender_thread.join();
+
+  // Assert.
+  EXPECT_TRUE(kReceived);
+  EXPECT_FALSE(receiver.WasAborted());
+  EXPECT_EQ(ReadFile(kOutFd), contents);
+
+  close(kOutFd);
+}
+
+/**
+ * @test Tests that the sender never uses chunks larger than the receiver
+ *    asked for, and that a tiny request is raised to the minimum.
+ */
+TEST_F(FileStreamTest, MaxChunkSize) {
+  // Arrange.
+  const std::vector<uint8_t> kContents(1024 * 1024, 3);
+  const int kInFd = MakeFile(kContents);
+  const int kOutFd = MakeFile({});
+
+  FileStreamReceiver receiver(sockets_[1], kOutFd);
+
+  // Act.
+  std::vector<int> chunk_sizes;
+  uint32_t tiny_chunk_size = 0;
+  std::thread sender_thread([&]() {
+    FileStreamSender sender(sockets_[0], kInFd, kMinChunkSize);
+    while (!sender.SentCompleteFile()) {
+      const int kBytesSent = sender.SendNextChunk();
+      ASSERT_GT(kBytesSent, 0);
+      chunk_sizes.push_back(kBytesSent);
+    }
+
+    tiny_chunk_size = FileStreamSender(sockets_[0], -1, 1).GetChunkSize();
+  });
+  const bool kReceived = ReceiveAll(&receiver);
+  sender_thread.join();
+
+  // Assert.
+  EXPECT_TRUE(kReceived);
+  EXPECT_EQ(ReadFile(kOutFd), kContents);
+  EXPECT_EQ(chunk_sizes.size(), kContents.size() / kMinChunkSize);
+  for (const int kChunkSize : chunk_sizes) {
+    EXPECT_LE(kChunkSize, static_cast<int>(kMinChunkSize + kChunkHeaderSize));
+  }
+  EXPECT_EQ(tiny_chunk_size, kMinChunkSize);
+
+  close(kOutFd);
+}
+
+/**
+ * @test Tests that the receiver consumes data that was already read from the
+ *    socket before reading any more.
+ */
+TEST_F(FileStreamTest, InitialData) {
+  // Arrange.
+  const std::vector<uint8_t> kContents(100000, 9);
+  const int kInFd = MakeFile(kContents);
+  const int kOutFd = MakeFile({});
+
+  std::thread sender_thread([&]() {
+    FileStreamSender sender(sockets_[0], kInFd);
+    while (!sender.SentCompleteFile()) {
+      ASSERT_GT(sender.SendNextChunk(), 0);
+    }
+  });
+
+  // Pretend that something else read the start of the stream, splitting the
+  // chunk header.
+  std::vector<uint8_t> initial_data(kChunkHeaderSize - 1);
+  ASSERT_EQ(recv(sockets_[1], initial_data.data(), initial_data.size(),
+                 MSG_WAITALL),
+            static_cast<ssize_t>(initial_data.size()));
+
+  FileStreamReceiver receiver(sockets_[1], kOutFd, initial_data);
+
+  // Act.
+  const bool kReceived = ReceiveAll(&receiver);
+  sender_thread.join();
+
+  // Assert.
+  EXPECT_TRUE(kReceived);
+  EXPECT_EQ(ReadFile(kOutFd), kContents);
+
+  close(kOutFd);
+}
+
+/**
+ * @test Tests that a file that is already in memory arrives intact, including
+ *    when only a range of it is sent.
+ */
+TEST_F(FileStreamTest, InMemory) {
+  // Arrange.
+  auto contents = std::make_shared<std::vector<uint8_t>>(1024 * 1024);
+  for (size_t i = 0; i < contents->size(); ++i) {
+    (*contents)[i] = i * 13;
+  }
+  const off_t kOffset = 1000;
+  const off_t kLength = 500000;
+  const int kOutFd = MakeFile({});
+
+  FileStreamReceiver receiver(sockets_[1], kOutFd, {}, kOffset);
+
+  // Act.
+  std::thread sender_thread([&]() {
+    FileStreamSender sender(sockets_[0], contents);
+    sender.SetRange(kOffset, kLength);
+    while (!sender.SentCompleteFile()) {
+      ASSERT_GT(sender.SendNextChunk(), 0);
+    }
+  });
+  const bool kReceived = ReceiveAll(&receiver);
+  sender_thread.join();
+
+  // Assert.
+  EXPECT_TRUE(kReceived);
+  EXPECT_FALSE(receiver.WasAborted());
+  const auto kGotContents = ReadFile(kOutFd);
+  ASSERT_EQ(kGotContents.size(), static_cast<size_t>(kOffset + kLength));
+  EXPECT_TRUE(std::equal(kGotContents.begin() + kOffset, kGotContents.end(),
+                         contents->begin() + kOffset));
+
+  close(kOutFd);
+}
+
+/**
+ * @test Tests that a range of a file can be sent and written at the same
+ *    offset on the other side.
+ */
+TEST_F(FileStreamTest, Range) {
+  // Arrange.
+  std::vector<uint8_t> contents(1024 * 1024);
+  for (size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = i * 7;
+  }
+  const off_t kOffset = 100000;
+  const off_t kLength = 300000;
+  const int kInFd = MakeFile(contents);
+  const int kOutFd = MakeFile({});
+
+  FileStreamReceiver receiver(sockets_[1], kOutFd, {}, kOffset);
+
+  // Act.
+  std::thread sender_thread([&]() {
+    FileStreamSender sender(sockets_[0], kInFd);
+    sender.SetRange(kOffset, kLength);
+    while (!sender.SentCompleteFile()) {
+      ASSERT_GT(sender.SendNextChunk(), 0);
+    }
+  });
+  const bool kReceived = ReceiveAll(&receiver);
+  sender_thread.join();
+
+  // Assert.
+  EXPECT_TRUE(kReceived);
+  const auto kGotContents = ReadFile(kOutFd);
+  ASSERT_EQ(kGotContents.size(), static_cast<size_t>(kOffset + kLength));
+  EXPECT_TRUE(std::equal(kGotContents.begin() + kOffset, kGotContents.end(),
+                         contents.begin() + kOffset));
+
+  close(kOutFd);
+}
+
+/**
+ * @test Tests that the receiver doesn't write past the length it was given,
+ *    even if the sender sends more.
+ */
+TEST_F(FileStreamTest, MaxLength) {
+  // Arrange.
+  const std::vector<uint8_t> kContents(300000, 42);
+  const uint64_t kMaxLength = 100000;
+  const int kInFd = MakeFile(kContents);
+  const int kOutFd = MakeFile({});
+
+  FileStreamReceiver receiver(sockets_[1], kOutFd, {}, 0, kMaxLength);
+
+  // Act.
+  std::thread sender_thread([&]() {
+    FileStreamSender sender(sockets_[0], kInFd);
+    while (!sender.SentCompleteFile()) {
+      ASSERT_GT(sender.SendNextChunk(), 0);
+    }
+  });
+  const bool kReceived = ReceiveAll(&receiver);
+  sender_thread.join();
+
+  // Assert.
+  // The whole file is still read off the socket.
+  EXPECT_TRUE(kReceived);
+  EXPECT_EQ(receiver.GetNumFileBytes(), kContents.size());
+  EXPECT_LE(ReadFile(kOutFd).size(), kMaxLength);
+
+  close(kOutFd);
+}
+
+/**
+ * @test Tests that an empty file is sent as a single empty chunk.
+ */
+TEST_F(FileStreamTest, EmptyFile) {
+  // Arrange.
+  const int kInFd = MakeFile({});
+  const int kOutFd = MakeFile({});
+
+  FileStreamSender sender(sockets_[0], kInFd);
+  FileStreamReceiver receiver(sockets_[1], kOutFd);
+
+  // Act.
+  const int kBytesSent = sender.SendNextChunk();
+  const bool kReceived = ReceiveAll(&receiver);
+
+  // Assert.
+  EXPECT_EQ(kBytesSent, static_cast<int>(kChunkHeaderSize));
+  EXPECT_TRUE(sender.SentCompleteFile());
+  EXPECT_TRUE(kReceived);
+  EXPECT_TRUE(ReadFile(kOutFd).empty());
+
+  close(kOutFd);
+}
+
+/**
+ * @test Tests that the receiver notices when the sender aborts partway
+ *    through, and that cleaning up leaves the socket at a message boundary.
+ */
+TEST_F(FileStreamTest, Abort) {
+  // Arrange.
+  const std::vector<uint8_t> kContents(3 * 1024 * 1024 / 2, 42);
+  const int kInFd = MakeFile(kContents);
+  const uint8_t kTrailer = 7;
+
+  FileStreamReceiver receiver(sockets_[1], -1);
+
+  // Act.
+  std::thread sender_thread([&]() {
+    FileStreamSender sender(sockets_[0], kInFd);
+    ASSERT_GT(sender.SendNextChunk(), 0);
+    ASSERT_TRUE(sender.Abort());
+    ASSERT_EQ(send(sockets_[0], &kTrailer, 1, 0), 1);
+  });
+  const bool kCleanedUp = receiver.CleanUp();
+  sender_thread.join();
+
+  uint8_t trailer = 0;
+  const ssize_t kTrailerRead = recv(sockets_[1], &trailer, 1, 0);
+
+  // Assert.
+  EXPECT_TRUE(kCleanedUp);
+  EXPECT_TRUE(receiver.WasAborted());
+  EXPECT_EQ(kTrailerRead, 1);
+  EXPECT_EQ(trailer, kTrailer);
+}
+
+}  // namespace
+}  // namespace chunked_files::tests
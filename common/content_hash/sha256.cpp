@@ -0,0 +1,188 @@
+#include "sha256.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace content_hash {
+namespace {
+
+/// Round constants, from FIPS 180-4.
+constexpr std::array<uint32_t, 64> kRoundConstants = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/// Initial hash value, from FIPS 180-4.
+constexpr std::array<uint32_t, 8> kInitialState = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+/// Size of the reads when hashing a file.
+constexpr size_t kReadSize = 1024 * 1024;
+
+uint32_t RotateRight(uint32_t value, int bits) {
+  return (value >> bits) | (value << (32 - bits));
+}
+
+}  // namespace
+
+Sha256::Sha256() : state_(kInitialState) {}
+
+void Sha256::Update(const uint8_t* data, size_t size) {
+  total_size_ += size;
+
+  // Top up a partial block first.
+  if (buffer_size_ > 0) {
+    const size_t kToCopy = std::min(size, kBlockSize - buffer_size_);
+    std::memcpy(buffer_.data() + buffer_size_, data, kToCopy);
+    buffer_size_ += kToCopy;
+    data += kToCopy;
+    size -= kToCopy;
+    if (buffer_size_ < kBlockSize) {
+      return;
+    }
+    ProcessBlock(buffer_.data());
+    buffer_size_ = 0;
+  }
+
+  // Whole blocks can be processed in place.
+  for (; size >= kBlockSize; data += kBlockSize, size -= kBlockSize) {
+    ProcessBlock(data);
+  }
+
+  std::memcpy(buffer_.data(), data, size);
+  buffer_size_ = size;
+}
+
+Sha256::Digest Sha256::Finish() {
+  const uint64_t kTotalBits = total_size_ * 8;
+
+  // Pad with a 1 bit, then zeros, leaving room for the length at the end of
+  // the last block.
+  buffer_[buffer_size_++] = 0x80;
+  if (buffer_size_ > kBlockSize - 8) {
+    std::fill(buffer_.begin() + buffer_size_, buffer_.end(), 0);
+    ProcessBlock(buffer_.data());
+    buffer_size_ = 0;
+  }
+  std::fill(buffer_.begin() + buffer_size_, buffer_.end() - 8, 0);
+  for (int i = 0; i < 8; ++i) {
+    buffer_[kBlockSize - 1 - i] = static_cast<uint8_t>(kTotalBits >> (8 * i));
+  }
+  ProcessBlock(buffer_.data());
+
+  Digest digest;
+  for (size_t i = 0; i < state_.size(); ++i) {
+    digest[4 * i] = static_cast<uint8_t>(state_[i] >> 24);
+    digest[4 * i + 1] = static_cast<uint8_t>(state_[i] >> 16);
+    digest[4 * i + 2] = static_cast<uint8_t>(state_[i] >> 8);
+    digest[4 * i + 3] = static_cast<uint8_t>(state_[i]);
+  }
+  return digest;
+}
+
+void Sha256::ProcessBlock(const uint8_t* block) {
+  // Expand the block into the message schedule.
+  std::array<uint32_t, 64> schedule;
+  for (size_t i = 0; i < 16; ++i) {
+    schedule[i] = (static_cast<uint32_t>(block[4 * i]) << 24) |
+                  (static_cast<uint32_t>(block[4 * i + 1]) << 16) |
+                  (static_cast<uint32_t>(block[4 * i + 2]) << 8) |
+                  static_cast<uint32_t>(block[4 * i + 3]);
+  }
+  for (size_t i = 16; i < schedule.size(); ++i) {
+    const uint32_t kSigma0 = RotateRight(schedule[i - 15], 7) ^
+                             RotateRight(schedule[i - 15], 18) ^
+                             (schedule[i - 15] >> 3);
+    const uint32_t kSigma1 = RotateRight(schedule[i - 2], 17) ^
+                             RotateRight(schedule[i - 2], 19) ^
+                             (schedule[i - 2] >> 10);
+    schedule[i] = schedule[i - 16] + kSigma0 + schedule[i - 7] + kSigma1;
+  }
+
+  uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+  uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+  for (size_t i = 0; i < schedule.size(); ++i) {
+    const uint32_t kSum1 =
+        RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+    const uint32_t kChoice = (e & f) ^ (~e & g);
+    const uint32_t kTemp1 = h + kSum1 + kChoice + kRoundConstants[i] +
+                            schedule[i];
+    const uint32_t kSum0 =
+        RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+    const uint32_t kMajority = (a & b) ^ (a & c) ^ (b & c);
+    const uint32_t kTemp2 = kSum0 + kMajority;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + kTemp1;
+    d = c;
+    c = b;
+    b = a;
+    a = kTemp1 + kTemp2;
+  }
+
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+  state_[4] += e;
+  state_[5] += f;
+  state_[6] += g;
+  state_[7] += h;
+}
+
+std::string ToHex(const Sha256::Digest& digest) {
+  static constexpr char kHexDigits[] = "0123456789abcdef";
+
+  std::string hex;
+  hex.reserve(digest.size() * 2);
+  for (const uint8_t kByte : digest) {
+    hex.push_back(kHexDigits[kByte >> 4]);
+    hex.push_back(kHexDigits[kByte & 0xF]);
+  }
+  return hex;
+}
+
+std::string HashData(const uint8_t* data, size_t size) {
+  Sha256 hasher;
+  hasher.Update(data, size);
+  return ToHex(hasher.Finish());
+}
+
+std::string HashFile(int file_fd) {
+  Sha256 hasher;
+  std::vector<uint8_t> buffer(kReadSize);
+
+  off_t offset = 0;
+  while (true) {
+    const ssize_t kBytesRead =
+        pread(file_fd, buffer.data(), buffer.size(), offset);
+    if (kBytesRead < 0 && errno == EINTR) {
+      continue;
+    } else if (kBytesRead < 0) {
+      return "";
+    } else if (kBytesRead == 0) {
+      break;
+    }
+    hasher.Update(buffer.data(), kBytesRead);
+    offset += kBytesRead;
+  }
+
+  return ToHex(hasher.Finish());
+}
+
+}  // namespace content_hash
@@ -0,0 +1,84 @@
+#ifndef CSCI6780_CONTENT_HASH_SHA256_H
+#define CSCI6780_CONTENT_HASH_SHA256_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace content_hash {
+
+/**
+ * @brief Computes SHA-256 digests, which identify file contents well enough
+ *    to tell whether two files are the same without comparing them.
+ */
+class Sha256 {
+ public:
+  /// Size of a digest, in bytes.
+  static constexpr size_t kDigestSize = 32;
+
+  /// A raw digest.
+  using Digest = std::array<uint8_t, kDigestSize>;
+
+  Sha256();
+
+  /**
+   * @brief Adds more data to the digest.
+   * @param data The data.
+   * @param size The number of bytes of data.
+   */
+  void Update(const uint8_t* data, size_t size);
+
+  /**
+   * @brief Finishes the digest. Nothing else can be added afterwards.
+   * @return The digest.
+   */
+  Digest Finish();
+
+ private:
+  /// Size of the blocks that data is processed in.
+  static constexpr size_t kBlockSize = 64;
+
+  /**
+   * @brief Mixes one block into the state.
+   * @param block The block.
+   */
+  void ProcessBlock(const uint8_t* block);
+
+  /// The running hash.
+  std::array<uint32_t, 8> state_;
+  /// Data that doesn't make up a whole block yet.
+  std::array<uint8_t, kBlockSize> buffer_{};
+  /// Number of bytes in `buffer_`.
+  size_t buffer_size_ = 0;
+  /// Total number of bytes added so far.
+  uint64_t total_size_ = 0;
+};
+
+/**
+ * @brief Formats a digest the usual way, as lowercase hex.
+ * @param digest The digest.
+ * @return The hex string.
+ */
+std::string ToHex(const Sha256::Digest& digest);
+
+/**
+ * @brief Hashes a block of memory.
+ * @param data The data.
+ * @param size The number of bytes of data.
+ * @return The digest, as hex.
+ */
+std::string HashData(const uint8_t* data, size_t size);
+
+/**
+ * @brief Hashes the whole of an open file. It uses `pread()`, so the file
+ *    position is left alone.
+ * @param file_fd The file.
+ * @return The digest, as hex, or an empty string if the file couldn't be
+ *    read.
+ */
+std::string HashFile(int file_fd);
+
+}  // namespace content_hash
+
+#endif  // CSCI6780_CONTENT_HASH_SHA256_H
@@ -0,0 +1,97 @@
+/**
+ * @file Tests for SHA-256 hashing.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../sha256.h"
+#include "gtest/gtest.h"
+
+namespace content_hash::tests {
+namespace {
+
+/**
+ * @brief Hashes a string.
+ * @param data The string.
+ * @return The digest, as hex.
+ */
+std::string HashString(const std::string& data) {
+  return HashData(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+}
+
+}  // namespace
+
+/**
+ * @test Tests the digests against the FIPS 180-4 examples.
+ */
+TEST(Sha256, KnownDigests) {
+  // Act and assert.
+  EXPECT_EQ(HashString(""),
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(HashString("abc"),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  // This one needs an extra block for the padding.
+  EXPECT_EQ(HashString("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+/**
+ * @test Tests that adding data in pieces gives the same digest as adding it
+ *    all at once.
+ */
+TEST(Sha256, Incremental) {
+  // Arrange.
+  std::vector<uint8_t> data(1000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 7);
+  }
+
+  // Act.
+  Sha256 hasher;
+  // Use pieces that don't line up with blocks.
+  for (size_t offset = 0; offset < data.size(); offset += 37) {
+    hasher.Update(data.data() + offset,
+                  std::min<size_t>(37, data.size() - offset));
+  }
+  const auto kIncremental = ToHex(hasher.Finish());
+
+  // Assert.
+  EXPECT_EQ(kIncremental, HashData(data.data(), data.size()));
+}
+
+/**
+ * @test Tests that hashing a file gives the same digest as hashing its
+ *    contents.
+ */
+TEST(Sha256, HashFile) {
+  // Arrange.
+  // Bigger than one read, so it takes several.
+  std::vector<uint8_t> data(3 * 1024 * 1024 + 5);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 13);
+  }
+
+  char path[] = "/tmp/test_sha256_XXXXXX";
+  const int kFileFd = mkstemp(path);
+  ASSERT_GE(kFileFd, 0);
+  ASSERT_EQ(write(kFileFd, data.data(), data.size()),
+            static_cast<ssize_t>(data.size()));
+
+  // Act.
+  const auto kFileDigest = HashFile(kFileFd);
+
+  // Assert.
+  EXPECT_EQ(kFileDigest, HashData(data.data(), data.size()));
+
+  close(kFileFd);
+  unlink(path);
+}
+
+}  // namespace content_hash::tests
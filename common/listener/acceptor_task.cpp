@@ -0,0 +1,124 @@
+#include "acceptor_task.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <loguru.hpp>
+#include <utility>
+
+namespace listener {
+namespace {
+
+/// How long to wait for a connection before checking again, in milliseconds.
+/// Cancellation and shutdown both wake us up early.
+constexpr int kPollTimeoutMs = 250;
+
+/// Maximum number of connections to accept in one iteration, so that a flood
+/// of clients can't keep the task from noticing that it was cancelled.
+constexpr uint32_t kMaxAcceptsPerIteration = 64;
+
+/// How long to wait before accepting again when we are out of FDs or memory.
+/// The pending connection keeps the socket readable, so without this we would
+/// spin.
+constexpr std::chrono::milliseconds kResourceBackoff(100);
+
+}  // namespace
+
+AcceptorTask::AcceptorTask(int listener_fd, AcceptCallback callback,
+                           int accept_flags)
+    : listener_fd_(listener_fd),
+      callback_(std::move(callback)),
+      accept_flags_(accept_flags) {}
+
+thread_pool::Task::Status AcceptorTask::RunAtomic() {
+  struct pollfd poll_fds[2] = {{listener_fd_, POLLIN, 0},
+                               {cancelled_.GetFd(), POLLIN, 0}};
+
+  // Wait for a connection with a timeout.
+  const int kNumReady = poll(poll_fds, 2, kPollTimeoutMs);
+  if (shut_down_) {
+    return Status::DONE;
+  }
+  if (poll_fds[1].revents != 0) {
+    // The pool will notice that we were cancelled.
+    return Status::RUNNING;
+  }
+  if (kNumReady < 0) {
+    if (errno == EINTR) {
+      return Status::RUNNING;
+    }
+    LOG_S(ERROR) << "poll() failed: " << std::strerror(errno);
+    return Status::FAILED;
+  } else if (kNumReady == 0) {
+    // Timed out. We'll try again later.
+    return Status::RUNNING;
+  }
+
+  // Drain the backlog, since there may be more than one pending connection.
+  for (uint32_t i = 0; i < kMaxAcceptsPerIteration; ++i) {
+    struct sockaddr_storage client_address {};
+    socklen_t address_size = sizeof(client_address);
+    const int kClientFd = accept4(
+        listener_fd_, reinterpret_cast<struct sockaddr*>(&client_address),
+        &address_size, accept_flags_);
+    if (kClientFd >= 0) {
+      callback_(kClientFd, client_address);
+      continue;
+    }
+
+    switch (errno) {
+      case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+      case EWOULDBLOCK:
+#endif
+        // Backlog is empty.
+        return Status::RUNNING;
+      case EINTR:
+      case ECONNABORTED:
+      case EPROTO:
+        // The client went away before we got to it.
+        continue;
+      case EMFILE:
+      case ENFILE:
+      case ENOBUFS:
+      case ENOMEM:
+        // Resource exhaustion is hopefully temporary, so don't stop
+        // listening because of it. Give it a chance to clear up first, but
+        // still wake up right away if we are cancelled.
+        LOG_S(WARNING) << "accept4() failed: " << std::strerror(errno);
+        cancelled_.Wait(kResourceBackoff);
+        return Status::RUNNING;
+      default:
+        LOG_S(ERROR) << "accept4() failed: " << std::strerror(errno);
+        return Status::FAILED;
+    }
+  }
+
+  return Status::RUNNING;
+}
+
+void AcceptorTask::CleanUp() {
+  std::lock_guard<std::mutex> lock(close_mutex_);
+  close(listener_fd_);
+  listener_fd_ = -1;
+}
+
+void AcceptorTask::OnCancel() { cancelled_.Signal(); }
+
+void AcceptorTask::Shutdown() {
+  shut_down_ = true;
+
+  std::lock_guard<std::mutex> lock(close_mutex_);
+  if (listener_fd_ >= 0) {
+    // This takes the socket out of the listening state right away, which
+    // also wakes up poll(). We can't close it yet because it might still be
+    // in use.
+    shutdown(listener_fd_, SHUT_RD);
+  }
+}
+
+}  // namespace listener
@@ -0,0 +1,67 @@
+#ifndef CSCI6780_LISTENER_ACCEPTOR_TASK_H
+#define CSCI6780_LISTENER_ACCEPTOR_TASK_H
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+#include "thread_pool/task.h"
+#include "thread_pool/wakeup_event.h"
+
+namespace listener {
+
+/**
+ * @brief Callback that gets run whenever a new client connects. It is called
+ *    with the FD of the new connection, which it takes ownership of, and the
+ *    address of the client.
+ * @note This is run on the acceptor thread, so it should hand the connection
+ *    off quickly rather than servicing it inline.
+ */
+using AcceptCallback =
+    std::function<void(int, const struct sockaddr_storage&)>;
+
+/**
+ * @brief Task that accepts connections on a single non-blocking listener
+ *    socket.
+ */
+class AcceptorTask : public thread_pool::Task {
+ public:
+  /**
+   * @param listener_fd The listening socket. It must be non-blocking. This
+   *    task takes ownership of it, and closes it when it exits.
+   * @param callback The callback to run for each accepted connection.
+   * @param accept_flags Flags to pass to `accept4()` for the new connections.
+   */
+  AcceptorTask(int listener_fd, AcceptCallback callback, int accept_flags);
+  ~AcceptorTask() override = default;
+
+  Status RunAtomic() final;
+  void CleanUp() final;
+  void OnCancel() final;
+
+  /**
+   * @brief Stops the socket from accepting any more connections, and wakes up
+   *    the task so that it exits. This is safe to call from any thread.
+   */
+  void Shutdown();
+
+ private:
+  /// The socket we are accepting on. Set to -1 once it is closed.
+  int listener_fd_;
+  /// Keeps `Shutdown()` from touching the socket after it is closed.
+  std::mutex close_mutex_{};
+  /// Callback to run when a client connects.
+  AcceptCallback callback_;
+  /// Flags to use for accepted connections.
+  int accept_flags_;
+  /// Set once `Shutdown()` has been called.
+  std::atomic<bool> shut_down_ = false;
+  /// Signalled when the task is cancelled, to wake up `poll()`.
+  thread_pool::WakeupEvent cancelled_{};
+};
+
+}  // namespace listener
+
+#endif  // CSCI6780_LISTENER_ACCEPTOR_TASK_H
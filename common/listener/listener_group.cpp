@@ -0,0 +1,170 @@
+#include "listener_group.h"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <loguru.hpp>
+#include <utility>
+
+namespace listener {
+
+int SetUpReusePortSocket(uint16_t port, int backlog) {
+  // Open a TCP socket.
+  const int kServerFd =
+      socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (kServerFd < 0) {
+    LOG_S(ERROR) << "Failed to create server socket: " << std::strerror(errno);
+    return -1;
+  }
+
+  // Allow the server to re-bind to this port if it was restarted quickly.
+  const int kOption = 1;
+  if (setsockopt(kServerFd, SOL_SOCKET, SO_REUSEADDR, &kOption,
+                 sizeof(kOption))) {
+    LOG_S(WARNING) << "Failed to set SO_REUSEADDR: " << std::strerror(errno);
+    // This is not a fatal error.
+  }
+  // Allow other sockets in the group to bind to the same port. Without this,
+  // only the first one would succeed.
+  if (setsockopt(kServerFd, SOL_SOCKET, SO_REUSEPORT, &kOption,
+                 sizeof(kOption))) {
+    LOG_S(ERROR) << "Failed to set SO_REUSEPORT: " << std::strerror(errno);
+    close(kServerFd);
+    return -1;
+  }
+
+  struct sockaddr_in address {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons(port);
+  if (bind(kServerFd, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) < 0) {
+    LOG_S(ERROR) << "bind() failed on server socket: " << std::strerror(errno);
+    close(kServerFd);
+    return -1;
+  }
+  if (listen(kServerFd, backlog) < 0) {
+    LOG_S(ERROR) << "listen() failed on server socket: "
+                 << std::strerror(errno);
+    close(kServerFd);
+    return -1;
+  }
+
+  return kServerFd;
+}
+
+ListenerGroup::ListenerGroup(thread_pool::IThreadPool& thread_pool,
+                             AcceptCallback callback, int accept_flags)
+    : thread_pool_(thread_pool),
+      callback_(std::move(callback)),
+      accept_flags_(accept_flags) {}
+
+ListenerGroup::~ListenerGroup() { Stop(); }
+
+bool ListenerGroup::ListenTcp(uint16_t port, uint32_t num_acceptors,
+                              int backlog) {
+  for (uint32_t i = 0; i < num_acceptors; ++i) {
+    const int kServerFd = SetUpReusePortSocket(port, backlog);
+    if (kServerFd < 0) {
+      return false;
+    }
+
+    if (port == 0) {
+      // Bind the rest of the sockets to whichever port the kernel picked.
+      struct sockaddr_in address {};
+      socklen_t address_size = sizeof(address);
+      if (getsockname(kServerFd, reinterpret_cast<struct sockaddr*>(&address),
+                      &address_size) < 0) {
+        LOG_S(ERROR) << "getsockname() failed: " << std::strerror(errno);
+        close(kServerFd);
+        return false;
+      }
+      port = ntohs(address.sin_port);
+    }
+
+    if (!AddListener(kServerFd)) {
+      return false;
+    }
+  }
+
+  port_ = port;
+  LOG_S(INFO) << "Listening on port " << port_ << " with " << num_acceptors
+              << " acceptors.";
+  return true;
+}
+
+bool ListenerGroup::AddListener(int listener_fd) {
+  // The acceptor drains the whole backlog each time it wakes up, which only
+  // works if accept() doesn't block.
+  const int kFlags = fcntl(listener_fd, F_GETFL);
+  if (kFlags < 0 || fcntl(listener_fd, F_SETFL, kFlags | O_NONBLOCK) < 0) {
+    LOG_S(ERROR) << "Failed to make listener non-blocking: "
+                 << std::strerror(errno);
+    close(listener_fd);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopped_) {
+    close(listener_fd);
+    return false;
+  }
+
+  auto acceptor =
+      std::make_shared<AcceptorTask>(listener_fd, callback_, accept_flags_);
+  thread_pool_.AddTask(acceptor);
+  acceptors_.push_back(std::move(acceptor));
+
+  return true;
+}
+
+bool ListenerGroup::IsRunning() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& kAcceptor : acceptors_) {
+    if (thread_pool_.GetTaskStatus(kAcceptor) ==
+        thread_pool::Task::Status::RUNNING) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ListenerGroup::Wait() {
+  std::vector<std::shared_ptr<AcceptorTask>> acceptors;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    acceptors = acceptors_;
+  }
+
+  for (const auto& kAcceptor : acceptors) {
+    thread_pool_.WaitForCompletion(kAcceptor);
+  }
+}
+
+void ListenerGroup::Stop() {
+  std::vector<std::shared_ptr<AcceptorTask>> acceptors;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    acceptors.swap(acceptors_);
+  }
+
+  // Shut everything down first, so the acceptors all exit in parallel.
+  for (const auto& kAcceptor : acceptors) {
+    thread_pool_.CancelTask(kAcceptor);
+    kAcceptor->Shutdown();
+  }
+  for (const auto& kAcceptor : acceptors) {
+    thread_pool_.WaitForCompletion(kAcceptor);
+  }
+
+  port_ = 0;
+}
+
+uint16_t ListenerGroup::GetPort() const { return port_; }
+
+}  // namespace listener
@@ -0,0 +1,122 @@
+#ifndef CSCI6780_LISTENER_LISTENER_GROUP_H
+#define CSCI6780_LISTENER_LISTENER_GROUP_H
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "acceptor_task.h"
+#include "thread_pool/thread_pool_interface.h"
+
+namespace listener {
+
+/// Number of acceptors that a TCP listener group uses by default.
+constexpr uint32_t kDefaultNumAcceptors = 4;
+
+/**
+ * @brief Sets up a non-blocking TCP socket for listening. `SO_REUSEPORT` is
+ *    set, so that several of these can be bound to the same port and the
+ *    kernel will balance incoming connections between them. The kernel only
+ *    lets sockets owned by the same user join the group.
+ * @param port The port to listen on.
+ * @param backlog The length of the accept queue.
+ * @return The server socket it created, or -1 if it failed.
+ */
+int SetUpReusePortSocket(uint16_t port, int backlog = SOMAXCONN);
+
+/**
+ * @brief Accepts connections on a set of listener sockets, using one
+ *    `AcceptorTask` per socket.
+ * @details For TCP, each acceptor gets its own `SO_REUSEPORT` socket with its
+ *    own accept queue, so a new connection only wakes up one of them.
+ * @note The callback may be run from several acceptor threads at once.
+ */
+class ListenerGroup {
+ public:
+  /**
+   * @param thread_pool The thread pool to run the acceptor tasks in. It must
+   *    outlive this object.
+   * @param callback The callback to run for each accepted connection.
+   * @param accept_flags Flags to pass to `accept4()` for new connections. By
+   *    default, they are blocking.
+   */
+  ListenerGroup(thread_pool::IThreadPool& thread_pool, AcceptCallback callback,
+                int accept_flags = SOCK_CLOEXEC);
+  /**
+   * @brief Stops all the acceptors and closes their sockets.
+   */
+  ~ListenerGroup();
+
+  ListenerGroup(const ListenerGroup& other) = delete;
+  ListenerGroup& operator=(const ListenerGroup& other) = delete;
+
+  /**
+   * @brief Starts accepting TCP connections on a port.
+   * @param port The port to listen on. If it is 0, a free port will be
+   *    chosen, which can be retrieved with `GetPort()`.
+   * @param num_acceptors Number of sockets to bind to the port, each of which
+   *    gets its own acceptor thread.
+   * @param backlog The length of the accept queue for each socket.
+   * @return True if all the sockets were set up, false otherwise.
+   */
+  bool ListenTcp(uint16_t port, uint32_t num_acceptors = kDefaultNumAcceptors,
+                 int backlog = SOMAXCONN);
+
+  /**
+   * @brief Starts accepting connections on a socket that is already
+   *    listening. This is useful for sockets that aren't TCP.
+   * @param listener_fd The socket. The group takes ownership of it, and makes
+   *    it non-blocking.
+   * @return True if it succeeded, false otherwise, or if the group has been
+   *    stopped.
+   */
+  bool AddListener(int listener_fd);
+
+  /**
+   * @return True if at least one of the acceptors is still running.
+   */
+  bool IsRunning();
+
+  /**
+   * @brief Blocks until all the acceptors have exited.
+   */
+  void Wait();
+
+  /**
+   * @brief Stops all the acceptors, and waits for them to exit. The sockets
+   *    stop accepting connections before this returns. Once a group is
+   *    stopped, no more listeners can be added to it.
+   */
+  void Stop();
+
+  /**
+   * @return The TCP port that this group is listening on, or 0 if it is not
+   *    listening on one.
+   */
+  [[nodiscard]] uint16_t GetPort() const;
+
+ private:
+  /// The thread pool to run acceptors in.
+  thread_pool::IThreadPool& thread_pool_;
+  /// Callback to run when a client connects.
+  AcceptCallback callback_;
+  /// Flags to use for accepted connections.
+  int accept_flags_;
+
+  /// All the acceptors we have started.
+  std::vector<std::shared_ptr<AcceptorTask>> acceptors_{};
+  /// Whether `Stop()` has been called.
+  bool stopped_ = false;
+  /// Protects access to `acceptors_` and `stopped_`.
+  std::mutex mutex_{};
+  /// The TCP port we are listening on.
+  std::atomic<uint16_t> port_ = 0;
+};
+
+}  // namespace listener
+
+#endif  // CSCI6780_LISTENER_LISTENER_GROUP_H
@@ -0,0 +1,120 @@
+/**
+ * @file Tests for `ListenerGroup`.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../listener_group.h"
+#include "gtest/gtest.h"
+#include "thread_pool/thread_pool.h"
+
+namespace listener::tests {
+namespace {
+
+/// How long to wait for the acceptors to catch up, in seconds.
+constexpr uint32_t kAcceptTimeout = 5;
+
+/**
+ * @brief Connects to the local machine.
+ * @param port The port to connect to.
+ * @return The client socket, or -1 on failure.
+ */
+int ConnectToPort(uint16_t port) {
+  const int kSock = socket(AF_INET, SOCK_STREAM, 0);
+  if (kSock < 0) {
+    return -1;
+  }
+
+  struct sockaddr_in address {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+  if (connect(kSock, reinterpret_cast<struct sockaddr*>(&address),
+              sizeof(address)) < 0) {
+    close(kSock);
+    return -1;
+  }
+
+  return kSock;
+}
+
+}  // namespace
+
+/**
+ * @test Tests that a burst of concurrent clients all get accepted.
+ */
+TEST(ListenerGroup, AcceptsBurst) {
+  // Arrange.
+  constexpr int kNumClients = 200;
+  thread_pool::ThreadPool pool;
+  std::atomic<int> num_accepted = 0;
+  ListenerGroup listeners(
+      pool, [&num_accepted](int client_fd, const struct sockaddr_storage&) {
+        close(client_fd);
+        ++num_accepted;
+      });
+  ASSERT_TRUE(listeners.ListenTcp(0));
+  const uint16_t kPort = listeners.GetPort();
+  ASSERT_NE(kPort, 0);
+
+  // Act.
+  std::atomic<int> num_connected = 0;
+  std::vector<std::thread> clients;
+  for (int i = 0; i < 4; ++i) {
+    clients.emplace_back([kPort, &num_connected]() {
+      for (int j = 0; j < kNumClients / 4; ++j) {
+        const int kSock = ConnectToPort(kPort);
+        if (kSock >= 0) {
+          ++num_connected;
+          close(kSock);
+        }
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+
+  // Assert.
+  EXPECT_EQ(num_connected, kNumClients);
+  const auto kStartTime = std::chrono::steady_clock::now();
+  while (num_accepted < kNumClients &&
+         std::chrono::steady_clock::now() - kStartTime <
+             std::chrono::seconds(kAcceptTimeout)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(num_accepted, kNumClients);
+  EXPECT_TRUE(listeners.IsRunning());
+}
+
+/**
+ * @test Tests that stopping the group closes the port.
+ */
+TEST(ListenerGroup, StopClosesPort) {
+  // Arrange.
+  thread_pool::ThreadPool pool;
+  ListenerGroup listeners(
+      pool, [](int client_fd, const struct sockaddr_storage&) {
+        close(client_fd);
+      });
+  ASSERT_TRUE(listeners.ListenTcp(0, 2));
+  const uint16_t kPort = listeners.GetPort();
+
+  // Act.
+  listeners.Stop();
+
+  // Assert.
+  EXPECT_FALSE(listeners.IsRunning());
+  EXPECT_EQ(ConnectToPort(kPort), -1);
+}
+
+}  // namespace listener::tests
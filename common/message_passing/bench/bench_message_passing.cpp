@@ -0,0 +1,257 @@
+/**
+ * @file Measures round-trip latency and throughput of `message_passing`,
+ *  both over TCP and over the in-process loopback transport. The difference
+ *  between the two is roughly what the kernel costs us, and the loopback
+ *  numbers are what the framework itself costs.
+ *
+ *  Usage: bench_message_passing [num_messages] [trace_file]
+ *
+ *  If a trace file is given, a sample of the messages is traced, and the
+ *  trace is written there in the Chrome trace event format.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <loguru.hpp>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../client.h"
+#include "../server.h"
+#include "../trace/tracer.h"
+#include "test_messages.pb.h"
+#include "thread_pool/thread_pool.h"
+
+namespace message_passing::bench {
+namespace {
+
+using test_messages::TestMessage;
+using thread_pool::ThreadPool;
+using Clock = std::chrono::steady_clock;
+
+/// Port to use for the TCP server.
+constexpr uint16_t kBenchPort = 4321;
+/// Number of round trips to measure by default.
+constexpr uint32_t kDefaultNumMessages = 10000;
+/// Number of round trips to run before measuring anything.
+constexpr uint32_t kNumWarmupMessages = 100;
+/// How many times to try connecting before we give up.
+constexpr uint32_t kConnectionRetries = 50;
+/// Size of the payload in each message.
+constexpr size_t kPayloadSize = 64;
+/// Trace one in this many messages when tracing.
+constexpr uint32_t kTraceSampleInterval = 100;
+
+/**
+ * @brief Results from benchmarking one transport.
+ */
+struct Results {
+  /// Latency of each sequential round trip, in microseconds, sorted.
+  std::vector<double> latencies_us;
+  /// Sequential round trips per second.
+  double round_trips_per_sec;
+  /// Messages per second when many round trips are in flight at once.
+  double pipelined_per_sec;
+};
+
+/**
+ * @brief Echoes every message back to whoever sent it.
+ * @param server The server to echo on.
+ * @param stop Set when we should exit.
+ */
+void EchoLoop(Server* server, const std::atomic<bool>* stop) {
+  while (!*stop) {
+    TestMessage message;
+    Endpoint source;
+    if (server->Receive(std::chrono::milliseconds(100), &message, &source)) {
+      server->SendAsync(message, source);
+    }
+  }
+}
+
+/**
+ * @brief Sends one message and waits for the echo.
+ * @param client The client to use.
+ * @param message The message to send.
+ * @return True if the echo came back.
+ */
+bool RoundTrip(Client* client, const TestMessage& message) {
+  TestMessage echo;
+  return client->SendAsync(message) &&
+         client->Receive(std::chrono::seconds(5), &echo);
+}
+
+/**
+ * @brief Gets a percentile from a sorted list of samples.
+ * @param sorted The samples, in ascending order.
+ * @param percentile The percentile, between 0 and 1.
+ * @return The sample at that percentile.
+ */
+double Percentile(const std::vector<double>& sorted, double percentile) {
+  const auto kIndex = std::min(
+      sorted.size() - 1, static_cast<size_t>(percentile * sorted.size()));
+  return sorted[kIndex];
+}
+
+/**
+ * @brief Benchmarks one endpoint.
+ * @param server_endpoint The endpoint for the server to listen on.
+ * @param client_endpoint The endpoint for the client to connect to.
+ * @param num_messages The number of round trips to measure.
+ * @param results[out] Set to the results.
+ * @return True if it succeeded.
+ */
+bool RunBenchmark(const Endpoint& server_endpoint,
+                  const Endpoint& client_endpoint, uint32_t num_messages,
+                  Results* results) {
+  auto thread_pool = std::make_shared<ThreadPool>();
+  Server server(thread_pool, server_endpoint);
+  Client client(thread_pool, client_endpoint);
+
+  std::atomic<bool> stop = false;
+  std::thread echo_thread(EchoLoop, &server, &stop);
+
+  TestMessage message;
+  message.set_parameter(std::string(kPayloadSize, 'x'));
+
+  // The server might not be listening yet.
+  bool connected = false;
+  for (uint32_t i = 0; i < kConnectionRetries && !connected; ++i) {
+    connected = client.Send(message) > 0;
+    if (!connected) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+  TestMessage echo;
+  bool succeeded =
+      connected && client.Receive(std::chrono::seconds(5), &echo);
+
+  for (uint32_t i = 0; i < kNumWarmupMessages && succeeded; ++i) {
+    succeeded = RoundTrip(&client, message);
+  }
+
+  // Sequential round trips, for latency.
+  results->latencies_us.clear();
+  const auto kSequentialStart = Clock::now();
+  for (uint32_t i = 0; i < num_messages && succeeded; ++i) {
+    const auto kStart = Clock::now();
+    succeeded = RoundTrip(&client, message);
+    results->latencies_us.push_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - kStart)
+            .count());
+  }
+  const std::chrono::duration<double> kSequentialTime =
+      Clock::now() - kSequentialStart;
+
+  // As much in flight as the queues allow, for throughput. The echoes have
+  // to be read concurrently, or everything backs up once the queues fill.
+  const auto kPipelinedStart = Clock::now();
+  std::atomic<bool> received_all = succeeded;
+  std::thread receive_thread([&]() {
+    TestMessage pipelined_echo;
+    for (uint32_t i = 0; i < num_messages && received_all; ++i) {
+      received_all =
+          client.Receive(std::chrono::seconds(5), &pipelined_echo);
+    }
+  });
+  for (uint32_t i = 0; i < num_messages && succeeded; ++i) {
+    succeeded = client.SendAsync(message);
+  }
+  receive_thread.join();
+  succeeded = succeeded && received_all;
+  const std::chrono::duration<double> kPipelinedTime =
+      Clock::now() - kPipelinedStart;
+
+  stop = true;
+  echo_thread.join();
+  if (!succeeded) {
+    return false;
+  }
+
+  std::sort(results->latencies_us.begin(), results->latencies_us.end());
+  results->round_trips_per_sec = num_messages / kSequentialTime.count();
+  results->pipelined_per_sec = num_messages / kPipelinedTime.count();
+  return true;
+}
+
+/**
+ * @brief Prints the results for one transport.
+ * @param name The name of the transport.
+ * @param results The results.
+ */
+void PrintResults(const char* name, const Results& results) {
+  std::printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f %14.0f %14.0f\n", name,
+              Percentile(results.latencies_us, 0.5),
+              Percentile(results.latencies_us, 0.9),
+              Percentile(results.latencies_us, 0.99),
+              Percentile(results.latencies_us, 0.999),
+              results.latencies_us.back(), results.round_trips_per_sec,
+              results.pipelined_per_sec);
+}
+
+}  // namespace
+}  // namespace message_passing::bench
+
+int main(int argc, char** argv) {
+  using message_passing::bench::kBenchPort;
+  using message_passing::bench::kDefaultNumMessages;
+  using message_passing::bench::kTraceSampleInterval;
+  using message_passing::bench::PrintResults;
+  using message_passing::bench::Results;
+  using message_passing::bench::RunBenchmark;
+
+  loguru::g_stderr_verbosity = loguru::Verbosity_ERROR;
+
+  uint32_t num_messages = kDefaultNumMessages;
+  if (argc > 1) {
+    num_messages = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (num_messages == 0) {
+    std::fprintf(stderr, "Usage: %s [num_messages] [trace_file]\n", argv[0]);
+    return 1;
+  }
+  auto& tracer = message_passing::Tracer::Default();
+  if (argc > 2) {
+    tracer.Start(kTraceSampleInterval);
+  }
+
+  std::printf("%u round trips with a %zu byte payload.\n", num_messages,
+              message_passing::bench::kPayloadSize);
+  std::printf("%-10s %10s %10s %10s %10s %10s %14s %14s\n", "transport",
+              "p50 (us)", "p90 (us)", "p99 (us)", "p99.9 (us)", "max (us)",
+              "round trips/s", "pipelined/s");
+
+  Results results;
+  const auto kLoopbackEndpoint =
+      message_passing::MakeLoopbackEndpoint("bench_message_passing");
+  if (!RunBenchmark(kLoopbackEndpoint, kLoopbackEndpoint, num_messages,
+                    &results)) {
+    std::fprintf(stderr, "Loopback benchmark failed.\n");
+    return 1;
+  }
+  PrintResults("loopback", results);
+
+  if (!RunBenchmark({"", kBenchPort}, {"127.0.0.1", kBenchPort}, num_messages,
+                    &results)) {
+    std::fprintf(stderr, "TCP benchmark failed.\n");
+    return 1;
+  }
+  PrintResults("tcp", results);
+
+  if (argc > 2) {
+    tracer.Stop();
+    if (!tracer.WriteChromeTrace(argv[2])) {
+      return 1;
+    }
+    std::printf("Wrote %zu spans to %s.\n", tracer.GetSpans().size(),
+                argv[2]);
+  }
+
+  return 0;
+}
@@ -3,11 +3,15 @@
 #include <unistd.h>
 
 #include <functional>
+#include <future>
 #include <loguru.hpp>
 #include <utility>
 
-#include "wire_protocol/wire_protocol.h"
+#include "transport/loopback_connection.h"
+#include "transport/shm_connection.h"
+#include "transport/socket_connection.h"
 #include "utils.h"
+#include "wire_protocol/wire_protocol.h"
 
 namespace message_passing {
 
@@ -17,8 +21,8 @@ Client::Client(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
                Endpoint destination)
     : Node(std::move(thread_pool)),
       endpoint_(std::move(destination)),
-      send_queue_(
-          std::make_shared<queue::Queue<SenderTask::SendQueueMessage>>()) {}
+      send_queue_(std::make_shared<queue::Queue<SenderTask::SendQueueMessage>>(
+          SenderTask::kSendQueueLength)) {}
 
 Client::~Client() {
   // Cancel the tasks we added to the thread pool.
@@ -29,88 +33,181 @@ Client::~Client() {
 
   // Close the socket.
   close(client_fd_);
+
+  // Nobody is going to answer outstanding requests now.
+  pending_requests_->FailAll();
 }
 
 int Client::Send(const google::protobuf::Message& message) {
-  MessageId message_id;
-  if (!DispatchSend(message, false, &message_id)) {
+  std::future<int> completion;
+  if (!DispatchSend(message, &completion, kSendQueueTimeout)) {
     // Failed to dispatch the send.
     return -1;
   }
 
   // Wait for the send to finish.
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (send_results_.find(message_id) == send_results_.end()) {
-      // Wait for the send to finish.
-      send_results_updated_.wait(lock, [this, message_id]() {
-        return send_results_.find(message_id) != send_results_.end();
-      });
-    }
-
-    const int kResult = send_results_[message_id];
-    // Erase this result so it doesn't get read twice.
-    send_results_.erase(message_id);
-
-    return kResult;
+  try {
+    return completion.get();
+  } catch (const std::future_error& error) {
+    // The send was dropped without finishing, e.g. because the connection
+    // was closed while it was still queued.
+    LOG_S(WARNING) << "Send was abandoned: " << error.what();
+    return -1;
   }
 }
 
-bool Client::SendAsync(const google::protobuf::Message& message) {
-  return DispatchSend(message, true, nullptr);
+bool Client::SendAsync(const google::protobuf::Message& message,
+                       std::chrono::milliseconds timeout) {
+  return DispatchSend(message, nullptr, timeout);
+}
+
+bool Client::SendAsync(const google::protobuf::Message& message,
+                       StreamId stream, std::chrono::milliseconds timeout) {
+  wire_protocol::FrameHeader header;
+  header.stream_id = stream;
+  return DispatchSend(message, nullptr, timeout, header);
 }
 
-bool Client::DispatchSend(const google::protobuf::Message& message, bool async,
-                          MessageId* id) {
+bool Client::DispatchSend(const google::protobuf::Message& message,
+                          std::future<int>* completion,
+                          std::chrono::milliseconds timeout,
+                          const wire_protocol::FrameHeader& header) {
+  wire_protocol::FrameHeader traced_header = header;
+  traced_header.trace_id = StartSendTrace(false);
+  const int64_t kEnqueueStart =
+      traced_header.trace_id != 0 ? Tracer::Now() : 0;
+
   // Make sure we are connected.
   if (!EnsureConnected()) {
     return false;
   }
 
-  // Prepare a message to send on the queue.
-  SenderTask::SendQueueMessage queue_message{++message_id_, {}, async};
-  // Serialize the message.
-  if (!Serialize(message, &queue_message.message)) {
+  // Serialize the message. Only requests and traced messages need a header.
+  auto serialized = std::make_shared<std::vector<uint8_t>>();
+  const bool kSerializeResult =
+      traced_header.IsEmpty()
+          ? Serialize(message, serialized.get())
+          : Serialize(message, traced_header, serialized.get());
+  if (!kSerializeResult) {
     // Failed to serialize the message.
     LOG_S(ERROR) << "Message serialization failed.";
     return false;
   }
 
-  if (id != nullptr) {
-    *id = queue_message.message_id;
+  // Prepare a message to send on the queue.
+  SenderTask::SendQueueMessage queue_message{++message_id_,
+                                             std::move(serialized), nullptr};
+  if (completion != nullptr) {
+    queue_message.completion = std::make_shared<std::promise<int>>();
+    *completion = queue_message.completion->get_future();
+  }
+  queue_message.stream_id = traced_header.stream_id;
+  if (traced_header.trace_id != 0) {
+    queue_message.trace_id = traced_header.trace_id;
+    queue_message.stage_start_us = Tracer::Now();
+    Tracer::Default().Record(queue_message.trace_id, TraceStage::ENQUEUE,
+                             kEnqueueStart, queue_message.stage_start_us);
   }
 
-  // Send the queue message.
-  send_queue_->Push(queue_message);
+  // Send the queue message, unless the sender is too far behind.
+  if (!send_queue_->PushTimed(timeout, queue_message)) {
+    LOG_S(WARNING) << "Send queue is full, dropping message "
+                   << queue_message.message_id << ".";
+    return false;
+  }
 
   return true;
 }
 
+std::future<bool> Client::DispatchRequest(
+    const google::protobuf::Message& request,
+    RequestTable::ResponseParser parser) {
+  const RequestId kRequestId = ++request_id_;
+  auto result = pending_requests_->Add(kRequestId, std::move(parser));
+
+  if (!DispatchSend(request, nullptr, kSendQueueTimeout, {kRequestId})) {
+    // This request is never going to get a response.
+    pending_requests_->Fail(kRequestId);
+  }
+
+  return result;
+}
+
+bool Client::IsHealthy() {
+  std::lock_guard<std::mutex> lock(connect_mutex_);
+
+  if (client_fd_ < 0) {
+    // Either we never connected, or we tried and failed.
+    return !connect_attempted_;
+  }
+
+  return thread_pool()->GetTaskStatus(sender_task_) ==
+             thread_pool::Task::Status::RUNNING &&
+         ReceiversRunning();
+}
+
 bool Client::EnsureConnected() {
+  std::lock_guard<std::mutex> lock(connect_mutex_);
+
   if (client_fd_ < 0) {
     // Connect to the server.
-    LOG_S(INFO) << "Connecting to " << endpoint_.hostname << ":"
-                << endpoint_.port << "...";
-    const auto kAddress = MakeAddress(endpoint_.port);
-    client_fd_ = SetUpSocket(kAddress, endpoint_.hostname);
+    if (endpoint_.transport != Transport::TCP) {
+      LOG_S(INFO) << "Connecting to " << endpoint_.socket_path << "...";
+    } else {
+      LOG_S(INFO) << "Connecting to " << endpoint_.hostname << ":"
+                  << endpoint_.port << "...";
+    }
+    connect_attempted_ = true;
+    std::shared_ptr<IConnection> connection;
+    if (endpoint_.transport == Transport::LOOPBACK) {
+      // There's no socket, so the connection comes first.
+      connection = LoopbackConnection::Connect(endpoint_.socket_path);
+      if (connection == nullptr) {
+        return false;
+      }
+      client_fd_ = connection->GetFd();
+    } else {
+      client_fd_ = ConnectTo(endpoint_);
+      if (client_fd_ < 0) {
+        // No point in starting tasks for a socket that doesn't exist.
+        return false;
+      }
+
+      if (endpoint_.transport == Transport::SHARED_MEMORY) {
+        connection = ShmConnection::Connect(client_fd_);
+        if (connection == nullptr) {
+          close(client_fd_);
+          client_fd_ = -1;
+          return false;
+        }
+      } else {
+        connection = std::make_shared<SocketConnection>(client_fd_);
+      }
+    }
 
     // Create the task for sending messages.
-    sender_task_ = std::make_shared<SenderTask>(
-        client_fd_, send_queue_, [this](MessageId id, int status) {
-          {
-            std::lock_guard<std::mutex> lock(mutex_);
-            send_results_[id] = status;
-          }
-          // Notify everyone waiting on this.
-          send_results_updated_.notify_all();
-        });
+    sender_task_ = std::make_shared<SenderTask>(connection, send_queue_);
     thread_pool()->AddTask(sender_task_);
 
-    // Create the task for receiving messages.
-    StartReceiverTask(client_fd_, endpoint_);
+    // Create the task for receiving messages. Responses to requests go
+    // straight to whoever is waiting for them, instead of the receive queue.
+    StartReceiverTask(
+        connection, endpoint_,
+        [pending_requests = pending_requests_](
+            const ReceiverTask::ReceiveQueueMessage& message) {
+          if (message.status <= 0) {
+            // The connection is gone, so no more responses will arrive.
+            pending_requests->FailAll();
+            return false;
+          }
+
+          return message.header.request_id != 0 &&
+                 pending_requests->Complete(message.header.request_id,
+                                            message.message);
+        });
   }
 
-  return client_fd_ >= 0;
+  return true;
 }
 
-}  // namespace message_passing
\ No newline at end of file
+}  // namespace message_passing
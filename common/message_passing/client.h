@@ -5,16 +5,16 @@
 #include <sys/socket.h>
 
 #include <atomic>
-#include <condition_variable>
+#include <chrono>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <string>
-#include <unordered_map>
-#include <vector>
 
 #include "node.h"
 #include "queue/queue.h"
+#include "request_table.h"
 #include "tasks/receiver_task.h"
 #include "tasks/sender_task.h"
 #include "thread_pool/thread_pool.h"
@@ -47,12 +47,42 @@ class Client : public Node {
 
   /**
    * @brief Sends a message to another node asynchronously. Will return
-   *    immediately, before the message is sent. Errors will not be reported.
+   *    before the message is sent. Errors will not be reported.
+   * @details The send queue is bounded, so if the server is not keeping up,
+   *    this will wait for space on the queue.
    * @param message The message to send.
+   * @param timeout How long to wait for space on the send queue. If it is
+   *    zero, this never blocks, and fails right away if the queue is full.
+   * @return True if it succeeded in dispatching the send request, false
+   *    otherwise, including if the queue stayed full for the whole timeout.
+   */
+  bool SendAsync(const google::protobuf::Message& message,
+                 std::chrono::milliseconds timeout = kSendQueueTimeout);
+
+  /**
+   * @brief Same as the other `SendAsync()`, but sends the message on a
+   *    particular stream.
+   * @details Large messages on streams other than 0 are sent in fragments,
+   *    taking turns with the other streams, so putting bulk data on its own
+   *    stream keeps it from holding up everything else.
+   * @param message The message to send.
+   * @param stream The stream to send it on. Messages on the same stream
+   *    arrive in order, but ones on different streams might not.
+   * @param timeout How long to wait for space on the send queue.
    * @return True if it succeeded in dispatching the send request, false
    *    otherwise.
    */
-  bool SendAsync(const google::protobuf::Message& message);
+  bool SendAsync(const google::protobuf::Message& message, StreamId stream,
+                 std::chrono::milliseconds timeout = kSendQueueTimeout);
+
+  /**
+   * @brief Checks whether this client can still be used to talk to the
+   *    server.
+   * @return True if the client is connected and its sender and receiver
+   *    tasks are still running, or if it has not tried to connect yet. False
+   *    if connecting failed or the connection has since been lost.
+   */
+  bool IsHealthy();
 
   /**
    * @brief Sends a request, then waits for a response from the receiver.
@@ -74,6 +104,29 @@ class Client : public Node {
     return Receive(response, nullptr);
   }
 
+  /**
+   * @brief Sends a request without waiting for the response. Any number of
+   *    requests can be outstanding on the same connection at once, and the
+   *    responses can come back in any order.
+   * @note The server has to reply using `Server::SendResponse()` so that the
+   *    response carries the ID of this request.
+   * @tparam ResponseType The type of response message we expect.
+   * @param request The request to be sent.
+   * @param response[out] The response that we received. Must stay valid until
+   *    the returned future is ready.
+   * @return A future that will be set to true once the response has been
+   *    received and parsed, or false if the request failed.
+   */
+  template <class ResponseType>
+  std::future<bool> SendRequestAsync(const google::protobuf::Message& request,
+                                     ResponseType* response) {
+    return DispatchRequest(request, [response](
+                                        const buffer_pool::Buffer& data) {
+      return response->ParseFromArray(data.data(),
+                                      static_cast<int>(data.size()));
+    });
+  }
+
  protected:
   /**
    * @brief Ensures that we are connected to the server.
@@ -85,12 +138,27 @@ class Client : public Node {
   /**
    * @brief Dispatches a new message send operation.
    * @param message The message to send.
-   * @param async Whether to send the message asynchronously.
-   * @param id[out] Filled with the chosen message ID, if not null.
+   * @param completion[out] If not null, this will be set to a future that
+   *    becomes ready with the result of `send()` once the message is sent.
+   *    Otherwise, the message is sent asynchronously.
+   * @param timeout How long to wait for space on the send queue.
+   * @param header Header to send with the message. If none of its fields are
+   *    set, no header will be sent.
    * @return True if the dispatch succeeded, false otherwise.
    */
-  bool DispatchSend(const google::protobuf::Message& message, bool async,
-                    MessageId* id);
+  bool DispatchSend(const google::protobuf::Message& message,
+                    std::future<int>* completion,
+                    std::chrono::milliseconds timeout,
+                    const wire_protocol::FrameHeader& header = {});
+
+  /**
+   * @brief Sends a new request and registers it to wait for a response.
+   * @param request The request to send.
+   * @param parser Will be used to parse the response.
+   * @return A future that will be set to the result of parsing the response.
+   */
+  std::future<bool> DispatchRequest(const google::protobuf::Message& request,
+                                    RequestTable::ResponseParser parser);
 
   /// The endpoint we are sending messages to.
   Endpoint endpoint_;
@@ -103,16 +171,19 @@ class Client : public Node {
 
   /// Current message id.
   std::atomic<MessageId> message_id_ = 0;
-
-  /// Associates send return values with message IDs.
-  std::unordered_map<MessageId, int> send_results_{};
-  /// Protects access to send_results_;
-  std::mutex mutex_{};
-  /// Used to wait for changes to `send_results_`.
-  std::condition_variable send_results_updated_;
+  /// Current request id.
+  std::atomic<RequestId> request_id_ = 0;
+  /// Requests that are waiting for a response. This is shared with the
+  /// receiver task, so it can outlive the client.
+  std::shared_ptr<RequestTable> pending_requests_ =
+      std::make_shared<RequestTable>();
 
   /// The file descriptor for the client socket.
   int client_fd_ = -1;
+  /// Whether we have ever attempted to connect.
+  bool connect_attempted_ = false;
+  /// Protects the connection state when multiple threads share this client.
+  std::mutex connect_mutex_{};
 };
 
 }  // namespace message_passing
@@ -0,0 +1,83 @@
+#include "connection_cache.h"
+
+#include <loguru.hpp>
+#include <utility>
+
+namespace message_passing {
+
+ConnectionCache::ConnectionCache(
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+    Clock::duration idle_timeout)
+    : thread_pool_(std::move(thread_pool)), idle_timeout_(idle_timeout) {}
+
+std::shared_ptr<Client> ConnectionCache::Get(const Endpoint& endpoint) {
+  // Clients we are dropping. These are destroyed after the lock is released,
+  // since tearing down a connection can take a while.
+  std::vector<std::shared_ptr<Client>> evicted;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  TakeIdle(&evicted);
+
+  auto endpoint_and_entry = entries_.find(endpoint);
+  if (endpoint_and_entry != entries_.end()) {
+    auto& entry = endpoint_and_entry->second;
+    if (entry.client->IsHealthy()) {
+      // We can reuse the existing connection.
+      entry.last_used = Clock::now();
+      return entry.client;
+    }
+
+    // The connection went bad, so replace it.
+    LOG_S(INFO) << "Connection to " << endpoint.hostname << ":"
+                << endpoint.port << " is no longer healthy, reconnecting.";
+    evicted.push_back(std::move(entry.client));
+    entries_.erase(endpoint_and_entry);
+  }
+
+  auto client = std::make_shared<Client>(thread_pool_, endpoint);
+  entries_[endpoint] = {client, Clock::now()};
+  return client;
+}
+
+void ConnectionCache::Evict(const Endpoint& endpoint) {
+  std::shared_ptr<Client> evicted;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto endpoint_and_entry = entries_.find(endpoint);
+  if (endpoint_and_entry != entries_.end()) {
+    evicted = std::move(endpoint_and_entry->second.client);
+    entries_.erase(endpoint_and_entry);
+  }
+}
+
+void ConnectionCache::EvictIdle() {
+  std::vector<std::shared_ptr<Client>> evicted;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  TakeIdle(&evicted);
+}
+
+size_t ConnectionCache::Size() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+void ConnectionCache::TakeIdle(std::vector<std::shared_ptr<Client>>* evicted) {
+  const auto kNow = Clock::now();
+
+  for (auto iter = entries_.begin(); iter != entries_.end();) {
+    const auto& kEntry = iter->second;
+    // If anyone else holds a reference, the connection is still in use.
+    if (kNow - kEntry.last_used > idle_timeout_ &&
+        kEntry.client.use_count() == 1) {
+      LOG_S(1) << "Closing idle connection to " << iter->first.hostname << ":"
+               << iter->first.port << ".";
+      evicted->push_back(kEntry.client);
+      iter = entries_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
+
+}  // namespace message_passing
@@ -0,0 +1,100 @@
+#ifndef CSCI6780_MESSAGE_PASSING_CONNECTION_CACHE_H
+#define CSCI6780_MESSAGE_PASSING_CONNECTION_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "client.h"
+#include "thread_pool/thread_pool.h"
+#include "types.h"
+
+namespace message_passing {
+
+/**
+ * @brief Thread-safe cache of long-lived `Client`s, keyed by the endpoint that
+ *    they are connected to.
+ * @details Clients that have not been used for longer than the idle timeout
+ *    are closed, and clients whose connection has failed are transparently
+ *    replaced with a fresh one the next time they are requested.
+ */
+class ConnectionCache {
+ public:
+  /// Clock used for tracking idle connections.
+  using Clock = std::chrono::steady_clock;
+
+  /// Default amount of time a connection can sit unused before it is closed.
+  static constexpr auto kDefaultIdleTimeout = std::chrono::seconds(60);
+
+  /**
+   * @param thread_pool Thread pool to use for the clients that this cache
+   *    creates.
+   * @param idle_timeout How long a connection can go without being used
+   *    before it gets evicted.
+   */
+  explicit ConnectionCache(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+                           Clock::duration idle_timeout = kDefaultIdleTimeout);
+
+  /**
+   * @brief Gets a client connected to a particular endpoint, creating it if
+   *    necessary.
+   * @param endpoint The endpoint to connect to.
+   * @return The client. It will never be null, but it might not be able to
+   *    connect if the endpoint is unreachable.
+   */
+  std::shared_ptr<Client> Get(const Endpoint& endpoint);
+
+  /**
+   * @brief Removes any cached connection to a particular endpoint.
+   * @param endpoint The endpoint.
+   */
+  void Evict(const Endpoint& endpoint);
+
+  /**
+   * @brief Removes all connections that have been idle for longer than the
+   *    idle timeout. Connections that are currently checked out by a caller
+   *    are never evicted.
+   */
+  void EvictIdle();
+
+  /**
+   * @return The number of connections currently in the cache.
+   */
+  size_t Size();
+
+ private:
+  /**
+   * @brief Represents a single cached connection.
+   */
+  struct Entry {
+    /// The client for this connection.
+    std::shared_ptr<Client> client;
+    /// The last time that this connection was handed out.
+    Clock::time_point last_used;
+  };
+
+  /**
+   * @brief Moves all idle entries out of the cache. Must be called with
+   *    `mutex_` held.
+   * @param evicted[out] Evicted clients will be appended here, so that they
+   *    can be destroyed after the lock is released.
+   */
+  void TakeIdle(std::vector<std::shared_ptr<Client>>* evicted);
+
+  /// Thread pool to use for created clients.
+  std::shared_ptr<thread_pool::ThreadPool> thread_pool_;
+  /// How long connections can sit idle before being evicted.
+  Clock::duration idle_timeout_;
+
+  /// Maps endpoints to the connection for that endpoint.
+  std::unordered_map<Endpoint, Entry, EndpointHash> entries_{};
+  /// Protects access to `entries_`.
+  std::mutex mutex_{};
+};
+
+}  // namespace message_passing
+
+#endif  // CSCI6780_MESSAGE_PASSING_CONNECTION_CACHE_H
@@ -7,8 +7,8 @@ namespace message_passing {
 Node::Node(std::shared_ptr<thread_pool::ThreadPool> thread_pool)
     : thread_pool_(std::move(thread_pool)),
       receive_queue_(
-          std::make_shared<queue::Queue<ReceiverTask::ReceiveQueueMessage>>()) {
-}
+          std::make_shared<queue::Queue<ReceiverTask::ReceiveQueueMessage>>(
+              ReceiverTask::kReceiveQueueLength)) {}
 
 Node::~Node() {
   // Cancel all the tasks we created.
@@ -17,16 +17,41 @@ Node::~Node() {
   }
 }
 
-void Node::StartReceiverTask(int socket_fd, const Endpoint& endpoint) {
+void Node::StartReceiverTask(std::shared_ptr<IConnection> connection,
+                             const Endpoint& endpoint,
+                             ReceiverTask::MessageFilter filter) {
   LOG_S(1) << "Starting receiver task for " << endpoint.hostname << ":"
-           << endpoint.port << " on socket " << socket_fd << ".";
+           << endpoint.port << " on socket " << connection->GetFd() << ".";
 
   auto receiver_task =
-      std::make_shared<ReceiverTask>(socket_fd, receive_queue_, endpoint);
+      std::make_shared<ReceiverTask>(std::move(connection), receive_queue_,
+                                     endpoint, std::move(filter));
   receiver_tasks_.push_back(receiver_task);
   thread_pool_->AddTask(receiver_task);
 }
 
+bool Node::ReceiversRunning() {
+  for (const auto& kTask : receiver_tasks_) {
+    if (thread_pool_->GetTaskStatus(kTask) !=
+        thread_pool::Task::Status::RUNNING) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Node::InterruptReceive() { receive_queue_->Interrupt(); }
+
+uint64_t Node::StartSendTrace(bool is_reply) {
+  auto& tracer = Tracer::Default();
+  const uint64_t kHandlerTraceId = tracer.LeaveHandler();
+  if (is_reply && kHandlerTraceId != 0) {
+    return kHandlerTraceId;
+  }
+  return tracer.StartTrace();
+}
+
 std::shared_ptr<thread_pool::ThreadPool> Node::thread_pool() {
   return thread_pool_;
 }
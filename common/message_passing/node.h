@@ -6,14 +6,13 @@
 #include <functional>
 #include <loguru.hpp>
 #include <memory>
-#include <queue>
 #include <vector>
 
 #include "queue/queue.h"
 #include "tasks/receiver_task.h"
+#include "trace/tracer.h"
 #include "thread_pool/thread_pool.h"
 #include "types.h"
-#include "wire_protocol/wire_protocol.h"
 
 namespace message_passing {
 
@@ -22,6 +21,9 @@ namespace message_passing {
  */
 class Node {
  public:
+  /// How long sends wait for space on a full send queue by default.
+  static constexpr std::chrono::milliseconds kSendQueueTimeout{5000};
+
   /**
    * @param thread_pool Thread pool to use internally for managing associated
    *    tasks.
@@ -35,17 +37,21 @@ class Node {
    * @param message[out] Set to the received message.
    * @param source[out] Set to the source of the message, if provided. If
    *    it is nullptr, it will be ignored.
+   * @param request_id[out] Set to the request ID that the message was sent
+   *    with, or 0 if it wasn't sent as a request. If it is nullptr, it will be
+   *    ignored.
    * @return True if it successfully received and parsed the message,
    *    false otherwise.
    */
   template <class MessageType>
-  bool Receive(MessageType* message, Endpoint* source = nullptr) {
+  bool Receive(MessageType* message, Endpoint* source = nullptr,
+               RequestId* request_id = nullptr) {
     return DoReceive(
         [this](ReceiverTask::ReceiveQueueMessage* message) {
           *message = receive_queue_->Pop();
           return true;
         },
-        message, source);
+        message, source, request_id);
   }
 
   /**
@@ -57,26 +63,48 @@ class Node {
    * @param message[out] Set to the received message.
    * @param source[out] Set to the source of the message, if provided. If it
    *    is nullptr, it will be ignored.
+   * @param request_id[out] Set to the request ID that the message was sent
+   *    with, or 0 if it wasn't sent as a request. If it is nullptr, it will be
+   *    ignored.
    * @return True if it successfully received and parsed the message, false
    *    otherwise or if it timed out.
    */
   template <class MessageType, class Rep, class Period>
   bool Receive(const std::chrono::duration<Rep, Period>& timeout,
-               MessageType* message, Endpoint* source = nullptr) {
+               MessageType* message, Endpoint* source = nullptr,
+               RequestId* request_id = nullptr) {
     return DoReceive(
         [this, &timeout](ReceiverTask::ReceiveQueueMessage* message) {
           return receive_queue_->PopTimed(timeout, message);
         },
-        message, source);
+        message, source, request_id);
   }
 
+  /**
+   * @brief Makes a thread that is blocked in `Receive()` with a timeout give
+   *    up right away. If nobody is waiting, the next such `Receive()` that
+   *    would have to wait gives up instead. This is useful for stopping a
+   *    task that is receiving in a loop.
+   */
+  void InterruptReceive();
+
  protected:
   /**
-   * @brief Starts a new task for receiving messages on a socket.
-   * @param socket_fd The socket to receive messages on.
-   * @param endpoint The endpoint that this socket is connected to.
+   * @brief Starts a new task for receiving messages on a connection.
+   * @param connection The connection to receive messages on.
+   * @param endpoint The endpoint that this connection goes to.
+   * @param filter Optional filter to run on received messages before they
+   *    are put on the receive queue.
    */
-  void StartReceiverTask(int socket_fd, const Endpoint& endpoint);
+  void StartReceiverTask(std::shared_ptr<IConnection> connection,
+                         const Endpoint& endpoint,
+                         ReceiverTask::MessageFilter filter = nullptr);
+
+  /**
+   * @return True if all the receiver tasks started by this node are still
+   *    running.
+   */
+  bool ReceiversRunning();
 
   /**
    * @return The thread pool to use for this class.
@@ -88,6 +116,18 @@ class Node {
   std::shared_ptr<queue::Queue<ReceiverTask::ReceiveQueueMessage>>
   receive_queue();
 
+  /**
+   * @brief Decides whether to trace a message that is about to be sent. If
+   *    the calling thread is handling a traced message, that ends the handler
+   *    stage.
+   * @param is_reply Whether the message is the reply to the one that the
+   *    thread is handling, in which case it continues the same trace. Only
+   *    servers reply, or a client would carry a single trace on through
+   *    every request it makes.
+   * @return The trace ID for the message, or 0 if it shouldn't be traced.
+   */
+  static uint64_t StartSendTrace(bool is_reply);
+
   /**
    * @brief Ensures that any sockets are initialized and we are properly
    *    connected.
@@ -103,67 +143,55 @@ class Node {
    * @param message[out] Set to the received message.
    * @param source[out] Set to the source of the message, if provided. If
    *    it is nullptr, it will be ignored.
+   * @param request_id[out] Set to the request ID of the message, if
+   *    provided. If it is nullptr, it will be ignored.
    * @return True if it successfully received and parsed the message,
    *    false otherwise.
    */
   template <class MessageType>
   bool DoReceive(
       const std::function<bool(ReceiverTask::ReceiveQueueMessage*)>& pop_queue,
-      MessageType* message, Endpoint* source) {
+      MessageType* message, Endpoint* source, RequestId* request_id) {
+    // If this thread was handling a message, it's done with it now.
+    auto& tracer = Tracer::Default();
+    tracer.LeaveHandler();
+
     // Make sure we're connected.
     if (!EnsureConnected()) {
       return false;
     }
 
-    // Create the parser for the response.
-    wire_protocol::MessageParser<MessageType> parser;
-
-    // Messages that were read off the queue but not yet processed.
-    auto un_processed_messages = un_processed_messages_;
-    un_processed_messages_ = {};
-
-    // Receive the response.
-    Endpoint reading_endpoint;
-    bool set_reading_endpoint = false;
-    while (!parser.HasCompleteMessage()) {
-      // Get the next message.
-      ReceiverTask::ReceiveQueueMessage response;
-      if (!un_processed_messages.empty()) {
-        response = un_processed_messages.front();
-        un_processed_messages.pop();
-      } else if (!pop_queue(&response)) {
-        // Receive timed out.
-        return false;
-      }
-
-      // Make sure we're only processing messages from the same endpoint.
-      if (!set_reading_endpoint) {
-        reading_endpoint = response.endpoint;
-        set_reading_endpoint = true;
-      } else if (response.endpoint != reading_endpoint) {
-        // Save this message, but ignore it.
-        un_processed_messages_.push(response);
-        continue;
-      }
-
-      if (response.status <= 0) {
-        // The receive failed or the endpoint disconnected.
-        return false;
-      }
-
-      parser.AddNewData(response.message);
+    // Receiver tasks only ever queue complete messages, so whatever is at
+    // the front of the queue is ready to be parsed.
+    ReceiverTask::ReceiveQueueMessage received;
+    if (!pop_queue(&received)) {
+      // Receive timed out.
+      return false;
+    }
+    const uint64_t kTraceId = received.header.trace_id;
+    const int64_t kPoppedAt = kTraceId != 0 ? Tracer::Now() : 0;
+
+    if (received.status <= 0) {
+      // The receive failed or the endpoint disconnected.
+      return false;
     }
 
     if (source != nullptr) {
-      *source = reading_endpoint;
+      *source = received.endpoint;
     }
-    // Save any overflow data to use for the next message.
-    if (parser.HasOverflow()) {
-      const auto& overflow = parser.GetOverflow();
-      un_processed_messages_.push(
-          {overflow, reading_endpoint, static_cast<int>(overflow.size())});
+    if (request_id != nullptr) {
+      *request_id = received.header.request_id;
     }
-    return parser.GetMessage(message);
+    const bool kParsed = message->ParseFromArray(received.message.data(),
+                                                 received.message.size());
+
+    if (kTraceId != 0) {
+      tracer.Record(kTraceId, TraceStage::RECEIVE_QUEUE, received.queued_at_us,
+                    kPoppedAt);
+      tracer.Record(kTraceId, TraceStage::PARSE, kPoppedAt, Tracer::Now());
+      tracer.EnterHandler(kTraceId);
+    }
+    return kParsed;
   }
 
   /// Internal thread pool to use for managing tasks.
@@ -174,9 +202,6 @@ class Node {
       receive_queue_;
   /// Keeps track of all the ReceiverTasks that it created.
   std::vector<std::shared_ptr<ReceiverTask>> receiver_tasks_{};
-
-  /// A buffer of all messages that have been received but not yet processed.
-  std::queue<ReceiverTask::ReceiveQueueMessage> un_processed_messages_;
 };
 
 }  // namespace message_passing
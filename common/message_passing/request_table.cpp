@@ -0,0 +1,61 @@
+#include "request_table.h"
+
+#include <utility>
+
+namespace message_passing {
+
+std::future<bool> RequestTable::Add(RequestId id, ResponseParser parser) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (closed_) {
+    // The receiver already gave up on the connection.
+    std::promise<bool> result;
+    result.set_value(false);
+    return result.get_future();
+  }
+
+  auto& request = pending_[id];
+  request.parser = std::move(parser);
+  return request.result.get_future();
+}
+
+bool RequestTable::Complete(RequestId id,
+                            const buffer_pool::Buffer& response) {
+  PendingRequest request;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto id_and_request = pending_.find(id);
+    if (id_and_request == pending_.end()) {
+      return false;
+    }
+    request = std::move(id_and_request->second);
+    pending_.erase(id_and_request);
+  }
+
+  // Parse outside the lock so other responses aren't held up.
+  request.result.set_value(request.parser(response));
+  return true;
+}
+
+void RequestTable::Fail(RequestId id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto id_and_request = pending_.find(id);
+  if (id_and_request != pending_.end()) {
+    id_and_request->second.result.set_value(false);
+    pending_.erase(id_and_request);
+  }
+}
+
+void RequestTable::FailAll() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (auto& id_and_request : pending_) {
+    id_and_request.second.result.set_value(false);
+  }
+  pending_.clear();
+  closed_ = true;
+}
+
+}  // namespace message_passing
@@ -0,0 +1,77 @@
+#ifndef CSCI6780_MESSAGE_PASSING_REQUEST_TABLE_H
+#define CSCI6780_MESSAGE_PASSING_REQUEST_TABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+
+#include "buffer_pool/buffer_pool.h"
+#include "types.h"
+
+namespace message_passing {
+
+/**
+ * @brief Keeps track of requests that are waiting for a response, so that
+ *    responses can be matched up with them as they arrive, in any order.
+ */
+class RequestTable {
+ public:
+  /// Function that parses the serialized response to a request.
+  using ResponseParser = std::function<bool(const buffer_pool::Buffer&)>;
+
+  /**
+   * @brief Starts tracking a new request.
+   * @param id The ID of the request.
+   * @param parser Will be run on the response when it arrives.
+   * @return A future that will be set to the result of parsing the response,
+   *    or to false if the request fails. If `FailAll()` was already called,
+   *    it is set to false right away.
+   */
+  std::future<bool> Add(RequestId id, ResponseParser parser);
+
+  /**
+   * @brief Completes a request with a response.
+   * @param id The ID of the request that this is a response to.
+   * @param response The serialized response.
+   * @return True if the response belonged to a pending request, false if
+   *    there was no such request.
+   */
+  bool Complete(RequestId id, const buffer_pool::Buffer& response);
+
+  /**
+   * @brief Fails a single request.
+   * @param id The ID of the request.
+   */
+  void Fail(RequestId id);
+
+  /**
+   * @brief Fails every pending request. Used when the connection is lost.
+   *    Requests added after this fail immediately, since nothing is left to
+   *    answer them.
+   */
+  void FailAll();
+
+ private:
+  /**
+   * @brief A request that is waiting for a response.
+   */
+  struct PendingRequest {
+    /// Parses the response.
+    ResponseParser parser;
+    /// Set once the response arrives.
+    std::promise<bool> result;
+  };
+
+  /// Maps request IDs to the corresponding pending requests.
+  std::unordered_map<RequestId, PendingRequest> pending_{};
+  /// Set once `FailAll()` is called.
+  bool closed_ = false;
+  /// Protects access to `pending_` and `closed_`.
+  std::mutex mutex_{};
+};
+
+}  // namespace message_passing
+
+#endif  // CSCI6780_MESSAGE_PASSING_REQUEST_TABLE_H
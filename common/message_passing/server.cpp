@@ -1,34 +1,55 @@
 #include "server.h"
 
+#include <future>
 #include <loguru.hpp>
 #include <utility>
+#include <vector>
 
 #include "wire_protocol/wire_protocol.h"
 
 namespace message_passing {
+namespace {
 
 using wire_protocol::Serialize;
 
+/**
+ * @brief Serializes a message into a buffer that can be put on send queues.
+ * @param message The message to serialize.
+ * @param header Header to send with the message. If none of its fields are
+ *    set, no header will be sent.
+ * @return The serialized message, or nullptr if serialization failed.
+ */
+SenderTask::Buffer MakeBuffer(const google::protobuf::Message& message,
+                              const wire_protocol::FrameHeader& header) {
+  auto serialized = std::make_shared<std::vector<uint8_t>>();
+  const bool kSerializeResult =
+      header.IsEmpty() ? Serialize(message, serialized.get())
+                       : Serialize(message, header, serialized.get());
+  if (!kSerializeResult) {
+    LOG_S(ERROR) << "Message serialization failed.";
+    return nullptr;
+  }
+
+  return serialized;
+}
+
+}  // namespace
+
 Server::Server(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
                uint16_t listen_port)
+    : Server(std::move(thread_pool), Endpoint{"", listen_port}) {}
+
+Server::Server(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+               const Endpoint& listen_endpoint)
     : Node(std::move(thread_pool)),
       server_task_(std::make_shared<ServerTask>(
-          listen_port, Server::thread_pool(), receive_queue(),
+          listen_endpoint, Server::thread_pool(), receive_queue(),
           [this](const Endpoint& endpoint,
                  std::shared_ptr<queue::Queue<SenderTask::SendQueueMessage>>
                      send_queue) {
             // Save the send queue for the new client.
             std::lock_guard<std::mutex> lock(send_queue_mutex_);
             send_queues_[endpoint] = std::move(send_queue);
-          },
-
-          [this](MessageId id, int status) {
-            {
-              std::lock_guard<std::mutex> lock(send_results_mutex_);
-              send_results_[id] = status;
-            }
-            // Notify everyone waiting on this.
-            send_results_updated_.notify_all();
           })) {
   // Start the server task.
   Server::thread_pool()->AddTask(server_task_);
@@ -36,6 +57,9 @@ Server::Server(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
 
 Server::~Server() {
   LOG_S(INFO) << "Server is exiting, cancelling the server task.";
+  // The server task only closes its sockets after it notices the
+  // cancellation, so make sure nobody else can connect in the meantime.
+  server_task_->StopListening();
   thread_pool()->CancelTask(server_task_);
 
   // Actually wait for the task to cancel, so we don't leave open ports before
@@ -45,53 +69,80 @@ Server::~Server() {
 
 int Server::Send(const google::protobuf::Message& message,
                  const Endpoint& destination) {
-  MessageId message_id;
-  if (!DispatchSend(message, destination, false, &message_id)) {
+  std::future<int> completion;
+  if (!DispatchSend(message, destination, &completion, kSendQueueTimeout)) {
     // Failed to dispatch the send.
     return -1;
   }
 
   // Wait for the send to finish.
-  {
-    std::unique_lock<std::mutex> lock(send_results_mutex_);
-    if (send_results_.find(message_id) == send_results_.end()) {
-      // Wait for the send to finish.
-      send_results_updated_.wait(lock, [this, message_id]() {
-        return send_results_.find(message_id) != send_results_.end();
-      });
-    }
-
-    const int kResult = send_results_[message_id];
-    // Erase this result so it doesn't get read twice.
-    send_results_.erase(message_id);
-
-    return kResult;
+  try {
+    return completion.get();
+  } catch (const std::future_error& error) {
+    // The send was dropped without finishing, e.g. because the connection
+    // was closed while it was still queued.
+    LOG_S(WARNING) << "Send was abandoned: " << error.what();
+    return -1;
   }
 }
 
 bool Server::SendAsync(const google::protobuf::Message& message,
-                       const Endpoint& destination) {
-  return DispatchSend(message, destination, true, nullptr);
+                       const Endpoint& destination,
+                       std::chrono::milliseconds timeout) {
+  return DispatchSend(message, destination, nullptr, timeout);
+}
+
+bool Server::SendAsync(const google::protobuf::Message& message,
+                       const Endpoint& destination, StreamId stream,
+                       std::chrono::milliseconds timeout) {
+  wire_protocol::FrameHeader header;
+  header.stream_id = stream;
+  return DispatchSend(message, destination, nullptr, timeout, header);
+}
+
+bool Server::SendResponse(const google::protobuf::Message& response,
+                          const Endpoint& destination, RequestId request_id) {
+  return DispatchSend(response, destination, nullptr, kSendQueueTimeout,
+                      {request_id});
 }
 
 bool Server::DispatchSend(const google::protobuf::Message& message,
-                          const Endpoint& endpoint, bool async, MessageId* id) {
+                          const Endpoint& endpoint,
+                          std::future<int>* completion,
+                          std::chrono::milliseconds timeout,
+                          const wire_protocol::FrameHeader& header) {
+  wire_protocol::FrameHeader traced_header = header;
+  traced_header.trace_id = StartSendTrace(true);
+  const int64_t kEnqueueStart =
+      traced_header.trace_id != 0 ? Tracer::Now() : 0;
+
   if (!EnsureConnected()) {
     return false;
   }
 
-  // Prepare the message to send on the queue.
-  SenderTask::SendQueueMessage queue_message{++message_id_, {}, async};
   // Serialize the message.
-  if (!Serialize(message, &queue_message.message)) {
-    LOG_S(ERROR) << "Message serialization failed.";
+  auto serialized = MakeBuffer(message, traced_header);
+  if (serialized == nullptr) {
     return false;
   }
 
-  if (id != nullptr) {
-    *id = queue_message.message_id;
+  // Prepare the message to send on the queue.
+  SenderTask::SendQueueMessage queue_message{++message_id_,
+                                             std::move(serialized), nullptr};
+
+  if (completion != nullptr) {
+    queue_message.completion = std::make_shared<std::promise<int>>();
+    *completion = queue_message.completion->get_future();
+  }
+  queue_message.stream_id = traced_header.stream_id;
+  if (traced_header.trace_id != 0) {
+    queue_message.trace_id = traced_header.trace_id;
+    queue_message.stage_start_us = Tracer::Now();
+    Tracer::Default().Record(queue_message.trace_id, TraceStage::ENQUEUE,
+                             kEnqueueStart, queue_message.stage_start_us);
   }
 
+  std::shared_ptr<queue::Queue<SenderTask::SendQueueMessage>> send_queue;
   {
     std::lock_guard<std::mutex> lock(send_queue_mutex_);
 
@@ -102,14 +153,54 @@ bool Server::DispatchSend(const google::protobuf::Message& message,
                    << endpoint.port << " because it is not connected.";
       return false;
     }
+    send_queue = endpoint_and_queue->second;
+  }
 
-    // Send the message.
-    endpoint_and_queue->second->Push(queue_message);
+  // Send the message. This might have to wait for the client to catch up, so
+  // we don't hold the lock, which would block sends to everyone else.
+  if (!send_queue->PushTimed(timeout, queue_message)) {
+    LOG_S(WARNING) << "Send queue for " << endpoint.hostname << ":"
+                   << endpoint.port << " is full, dropping message "
+                   << queue_message.message_id << ".";
+    return false;
   }
 
   return true;
 }
 
+int Server::Broadcast(const google::protobuf::Message& message,
+                      const BroadcastFilter& filter) {
+  if (!EnsureConnected()) {
+    return -1;
+  }
+
+  // Every client gets a reference to the same buffer.
+  const auto kSerialized = MakeBuffer(message, {});
+  if (kSerialized == nullptr) {
+    return -1;
+  }
+
+  std::lock_guard<std::mutex> lock(send_queue_mutex_);
+
+  int num_dispatched = 0;
+  for (const auto& kEndpointAndQueue : send_queues_) {
+    if (filter && !filter(kEndpointAndQueue.first)) {
+      continue;
+    }
+
+    if (!kEndpointAndQueue.second->TryPush(
+            {++message_id_, kSerialized, nullptr})) {
+      LOG_S(WARNING) << "Send queue for " << kEndpointAndQueue.first.hostname
+                     << ":" << kEndpointAndQueue.first.port
+                     << " is full, skipping broadcast.";
+      continue;
+    }
+    ++num_dispatched;
+  }
+
+  return num_dispatched;
+}
+
 std::unordered_set<Endpoint, EndpointHash> Server::GetConnected() {
   std::lock_guard<std::mutex> lock(send_queue_mutex_);
 
@@ -5,8 +5,9 @@
 
 #include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -19,6 +20,7 @@
 #include "tasks/server_task.h"
 #include "thread_pool/thread_pool.h"
 #include "types.h"
+#include "wire_protocol/wire_protocol.h"
 
 namespace message_passing {
 
@@ -27,6 +29,9 @@ namespace message_passing {
  */
 class Server : public Node {
  public:
+  /// Decides whether a particular client should get a broadcast message.
+  using BroadcastFilter = std::function<bool(const Endpoint&)>;
+
   /**
    * @param listen_port The port for the server to listen on.
    * @param thread_pool Thread pool to use internally for managing associated
@@ -34,6 +39,14 @@ class Server : public Node {
    */
   Server(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
          uint16_t listen_port);
+  /**
+   * @param thread_pool Thread pool to use internally for managing associated
+   *    tasks.
+   * @param listen_endpoint The endpoint for the server to listen on. This
+   *    allows listening on a Unix domain socket, for clients on the same host.
+   */
+  Server(std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+         const Endpoint& listen_endpoint);
   ~Server() override;
 
   /**
@@ -49,14 +62,68 @@ class Server : public Node {
 
   /**
    * @brief Sends a message to a connected client asynchronously. Will return
-   *    immediately, before the message is sent. Errors will not be reported.
+   *    before the message is sent. Errors will not be reported.
+   * @details Each client has a bounded send queue, so if that client is not
+   *    keeping up, this will wait for space on its queue.
    * @param message The message to send.
    * @param destination The connected node to send the message to.
+   * @param timeout How long to wait for space on the send queue. If it is
+   *    zero, this never blocks, and fails right away if the queue is full.
+   * @return True if it succeeded in dispatching the send request, false
+   *    otherwise, including if the queue stayed full for the whole timeout.
+   */
+  bool SendAsync(const google::protobuf::Message& message,
+                 const Endpoint& destination,
+                 std::chrono::milliseconds timeout = kSendQueueTimeout);
+
+  /**
+   * @brief Same as the other `SendAsync()`, but sends the message on a
+   *    particular stream.
+   * @details Large messages on streams other than 0 are sent in fragments,
+   *    taking turns with the other streams, so putting bulk data on its own
+   *    stream keeps it from holding up everything else.
+   * @param message The message to send.
+   * @param destination The connected node to send the message to.
+   * @param stream The stream to send it on. Messages on the same stream
+   *    arrive in order, but ones on different streams might not.
+   * @param timeout How long to wait for space on the send queue.
    * @return True if it succeeded in dispatching the send request, false
    *    otherwise.
    */
   bool SendAsync(const google::protobuf::Message& message,
-                 const Endpoint& destination);
+                 const Endpoint& destination, StreamId stream,
+                 std::chrono::milliseconds timeout = kSendQueueTimeout);
+
+  /**
+   * @brief Responds to a request that was sent with
+   *    `Client::SendRequestAsync()`. Will return immediately, before the
+   *    message is sent.
+   * @param response The response to send.
+   * @param destination The client that sent the request.
+   * @param request_id The ID of the request, as returned by `Receive()`.
+   * @return True if it succeeded in dispatching the send request, false
+   *    otherwise.
+   */
+  bool SendResponse(const google::protobuf::Message& response,
+                    const Endpoint& destination, RequestId request_id);
+
+  /**
+   * @brief Sends the same message to many connected clients asynchronously.
+   *    The message is only serialized once, and all the clients share the
+   *    resulting buffer.
+   * @param message The message to send.
+   * @note Clients whose send queues are full are skipped rather than waited
+   *    on, so that one slow client can't hold up everybody else.
+   * @note Broadcasts are never traced, because every client gets the same
+   *    header.
+   * @param filter If provided, the message is only sent to clients for which
+   *    this returns true. It is called with the send queues locked, so it
+   *    must not call back into the server.
+   * @return The number of clients that the message was dispatched to, or -1
+   *    if it could not be dispatched at all.
+   */
+  int Broadcast(const google::protobuf::Message& message,
+                const BroadcastFilter& filter = nullptr);
 
   /**
    * @return The set of all clients that are currently connected.
@@ -70,12 +137,19 @@ class Server : public Node {
   /**
    * @brief Dispatches a new message send operation.
    * @param message The message to send.
-   * @param async Whether to send the message asynchronously.
-   * @param id[out] Filled with the chosen message ID, if not null.
+   * @param endpoint The connected node to send the message to.
+   * @param completion[out] If not null, this will be set to a future that
+   *    becomes ready with the result of `send()` once the message is sent.
+   *    Otherwise, the message is sent asynchronously.
+   * @param timeout How long to wait for space on the send queue.
+   * @param header Header to send with the message. If none of its fields are
+   *    set, no header will be sent.
    * @return True if the dispatch succeeded, false otherwise.
    */
   bool DispatchSend(const google::protobuf::Message& message,
-                    const Endpoint& endpoint, bool async, MessageId* id);
+                    const Endpoint& endpoint, std::future<int>* completion,
+                    std::chrono::milliseconds timeout,
+                    const wire_protocol::FrameHeader& header = {});
 
   /// Maps endpoints to send queues for that particular endpoint.
   std::unordered_map<Endpoint,
@@ -88,13 +162,6 @@ class Server : public Node {
   /// The task that actually implements the server.
   std::shared_ptr<ServerTask> server_task_;
 
-  /// Associates send return values with message IDs.
-  std::unordered_map<MessageId, int> send_results_{};
-  /// Protects access to send_results_;
-  std::mutex send_results_mutex_{};
-  /// Used to wait for changes to `send_results_`.
-  std::condition_variable send_results_updated_;
-
   /// Current message id.
   std::atomic<MessageId> message_id_ = 0;
 };
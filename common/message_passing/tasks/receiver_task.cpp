@@ -1,57 +1,119 @@
 #include "receiver_task.h"
 
-#include <sys/socket.h>
-
 #include <cerrno>
 #include <cstring>
 #include <loguru.hpp>
 #include <utility>
 
+#include "../trace/tracer.h"
+
 namespace message_passing {
 
 using thread_pool::Task;
 
 ReceiverTask::ReceiverTask(
-    int receive_fd,
+    std::shared_ptr<IConnection> connection,
     std::shared_ptr<queue::Queue<ReceiveQueueMessage>> receive_queue,
-    Endpoint endpoint)
-    : receive_fd_(receive_fd),
+    Endpoint endpoint, MessageFilter filter)
+    : connection_(std::move(connection)),
       endpoint_(std::move(endpoint)),
-      receive_queue_(std::move(receive_queue)) {}
+      receive_queue_(std::move(receive_queue)),
+      filter_(std::move(filter)) {}
 
 Task::Status message_passing::ReceiverTask::RunAtomic() {
+  if (!FlushUndelivered()) {
+    // The reader is behind, so leave new data in the connection for now.
+    return Task::Status::RUNNING;
+  }
+  if (disconnected_) {
+    return Task::Status::FAILED;
+  }
+
   ReceiveQueueMessage message = {{}, endpoint_, -1};
 
   // Receive the next message.
-  received_message_buffer_.resize(kReceiveChunkSize);
-  const ssize_t kReceiveResult =
-      recv(receive_fd_, received_message_buffer_.data(), kReceiveChunkSize, 0);
+  const ssize_t kReceiveResult = connection_->Receive(
+      received_message_buffer_.data(), kReceiveChunkSize);
   if (kReceiveResult < 0) {
     if (errno == EAGAIN || errno == EWOULDBLOCK) {
       // This is merely a timeout. We can try again later.
       return Task::Status::RUNNING;
     }
+    if (errno == EINTR) {
+      // We're being cancelled, which isn't the remote end's fault.
+      return Task::Status::RUNNING;
+    }
 
     // General failure to receive.
     LOG_S(ERROR) << "Socket error: " << std::strerror(errno);
   } else if (kReceiveResult == 0) {
     LOG_S(WARNING) << "Remote end disconnected, exiting receive task.";
   } else {
-    // Resize the buffer to the actual amount of content received so we can
-    // tell where the actual data ends.
-    received_message_buffer_.resize(kReceiveResult);
-    message.message = received_message_buffer_;
+    // Queue every message that this data completes.
+    auto& tracer = Tracer::Default();
+    const int64_t kReceivedAt = tracer.IsEnabled() ? Tracer::Now() : 0;
+    parser_.AddNewData(received_message_buffer_.data(), kReceiveResult);
+    while (parser_.GetFrame(&message.message, &message.header)) {
+      message.status = static_cast<int>(kReceiveResult);
+      if (message.header.trace_id != 0 && kReceivedAt != 0) {
+        message.queued_at_us = Tracer::Now();
+        if (message.header.sent_at_us != 0) {
+          tracer.Record(message.header.trace_id, TraceStage::NETWORK,
+                        message.header.sent_at_us, kReceivedAt);
+        }
+        tracer.Record(message.header.trace_id, TraceStage::RECEIVE,
+                      kReceivedAt, message.queued_at_us);
+      }
+      Dispatch(message);
+    }
+
+    if (!parser_.HasFailed()) {
+      return Task::Status::RUNNING;
+    }
+    // We can't tell where the next message starts anymore.
+    LOG_S(ERROR) << "Protocol error from " << endpoint_.hostname << ":"
+                 << endpoint_.port << ", dropping the connection.";
   }
 
-  // Add the message to the queue.
-  message.status = static_cast<int>(kReceiveResult);
-  receive_queue_->Push(message);
+  // Let the reader know that this endpoint failed.
+  message.status =
+      parser_.HasFailed() ? -1 : static_cast<int>(kReceiveResult);
+  Dispatch(message);
+  disconnected_ = true;
 
   // If the receive fails, we fail the task, because otherwise we'll probably
-  // just get stuck in an infinite loop.
-  return kReceiveResult > 0 ? Task::Status::RUNNING : Task::Status::FAILED;
+  // just get stuck in an infinite loop. We have to hang around until
+  // everything is queued, though.
+  return undelivered_.empty() ? Task::Status::FAILED : Task::Status::RUNNING;
 }
 
-int ReceiverTask::GetFd() const { return receive_fd_; }
+void ReceiverTask::OnCancel() { connection_->Interrupt(); }
+
+int ReceiverTask::GetFd() const { return connection_->GetFd(); }
+
+void ReceiverTask::Dispatch(const ReceiveQueueMessage& message) {
+  if (filter_ && filter_(message)) {
+    // Somebody else took care of it.
+    return;
+  }
+
+  // Anything we're already holding has to go first.
+  if (!undelivered_.empty() || !receive_queue_->TryPush(message)) {
+    undelivered_.push_back(message);
+  }
+}
+
+bool ReceiverTask::FlushUndelivered() {
+  while (!undelivered_.empty()) {
+    // Don't wait for space, since that would tie up a pool thread that
+    // other connections need.
+    if (!receive_queue_->TryPush(undelivered_.front())) {
+      return false;
+    }
+    undelivered_.pop_front();
+  }
+
+  return true;
+}
 
 }  // namespace message_passing
@@ -1,60 +1,114 @@
 #ifndef CSCI6780_RECEIVER_TASK_H
 #define CSCI6780_RECEIVER_TASK_H
 
+#include <array>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <unordered_map>
 
+#include "../transport/connection_interface.h"
 #include "../types.h"
+#include "buffer_pool/buffer_pool.h"
 #include "queue/queue.h"
 #include "socket_task_interface.h"
+#include "wire_protocol/wire_protocol.h"
 
 namespace message_passing {
 
 /**
  * @brief Task that is responsible for reading messages from a socket.
+ * @details Each task splits the data from its own socket into complete
+ *    messages before putting them on the queue, so that data from different
+ *    endpoints never has to be untangled by the reader.
+ *
+ *    The receive queue is bounded. When it is full, the task stops reading
+ *    from the connection until the reader catches up, so the data backs up
+ *    into the connection and the peer's receive window closes. The peer's
+ *    sender then stalls, and its send queue fills up, which pushes back on
+ *    whoever is calling `SendAsync()` over there.
  */
 class ReceiverTask : public ISocketTask {
  public:
-  /// Queue message containing messages to be sent.
+  /// Maximum number of messages to hold on a receive queue.
+  static constexpr uint32_t kReceiveQueueLength = 4096;
+
+  /// Queue message containing messages that were received.
   struct ReceiveQueueMessage {
-    /// The serialized message.
-    std::vector<uint8_t> message;
+    /// The serialized message, without the length prefix. Always contains
+    /// exactly one complete message.
+    buffer_pool::Buffer message;
 
     /// The endpoint that this message was received from.
     Endpoint endpoint;
     /// recv() call status associated with this message.
     int status;
+    /// The header that was sent along with the message, if any.
+    wire_protocol::FrameHeader header{};
+    /// For traced messages, when the message was put on the queue.
+    int64_t queued_at_us = 0;
   };
 
   /**
-   * @param receive_fd The file descriptor to receive on.
+   * @brief Function that gets a look at each message before it is queued.
+   *    It should return true if it handled the message, in which case the
+   *    message will not be queued.
+   */
+  using MessageFilter = std::function<bool(const ReceiveQueueMessage&)>;
+
+  /**
+   * @param connection The connection to receive on.
    * @param receive_queue The queue that messages we receive will be sent on.
    * @param endpoint The endpoint that this task is receiving messages from.
    *    This will be set in all queue messages from this task.
+   * @param filter Optional filter to run on messages before they are queued.
    */
-  ReceiverTask(int receive_fd,
+  ReceiverTask(std::shared_ptr<IConnection> connection,
                std::shared_ptr<queue::Queue<ReceiveQueueMessage>> receive_queue,
-               Endpoint endpoint);
+               Endpoint endpoint, MessageFilter filter = nullptr);
   ~ReceiverTask() override = default;
 
   Status RunAtomic() final;
+  void OnCancel() final;
   [[nodiscard]] int GetFd() const final;
 
  private:
+  /**
+   * @brief Queues a message, unless the filter handles it. If the queue is
+   *    full, the message is held until `FlushUndelivered()` can queue it.
+   * @param message The message.
+   */
+  void Dispatch(const ReceiveQueueMessage& message);
+
+  /**
+   * @brief Tries to queue any messages that didn't fit on the queue earlier,
+   *    without blocking.
+   * @return True if there is nothing left waiting to be queued.
+   */
+  bool FlushUndelivered();
+
   /// Size of chunks to receive messages in.
   static constexpr uint32_t kReceiveChunkSize = 1024;
 
-  /// File descriptor to receive messages on.
-  int receive_fd_;
+  /// Connection to receive messages on.
+  std::shared_ptr<IConnection> connection_;
   /// Endpoint we are receiving from.
   Endpoint endpoint_;
-  /// Buffer to use for partial received messages.
-  std::vector<uint8_t> received_message_buffer_{};
+  /// Buffer that data is received into before it is split into messages.
+  std::array<uint8_t, kReceiveChunkSize> received_message_buffer_{};
+  /// Splits received data into complete messages.
+  wire_protocol::FrameParser parser_{};
 
   /// Queue to receive messages on.
   std::shared_ptr<queue::Queue<ReceiveQueueMessage>> receive_queue_;
+  /// Filter to run on messages before they are queued.
+  MessageFilter filter_;
+  /// Messages that were received while the queue was full, in order.
+  std::deque<ReceiveQueueMessage> undelivered_{};
+  /// Whether the connection has failed. The task only exits once the failure
+  /// has been queued for the reader.
+  bool disconnected_ = false;
 };
 
 }  // namespace message_passing
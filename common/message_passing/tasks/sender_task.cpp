@@ -1,13 +1,18 @@
 #include "sender_task.h"
 
-#include <sys/socket.h>
+#include <sys/uio.h>
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
 #include <chrono>
 #include <cstring>
 #include <loguru.hpp>
 #include <utility>
 
+#include "../trace/tracer.h"
+#include "wire_protocol/wire_protocol.h"
+
 namespace message_passing {
 namespace {
 
@@ -19,44 +24,240 @@ const auto kQueueTimeout = std::chrono::seconds(1);
 using thread_pool::Task;
 
 SenderTask::SenderTask(
-    int send_fd, std::shared_ptr<queue::Queue<SendQueueMessage>> send_queue,
-    SendCallback send_callback)
-    : send_fd_(send_fd),
-      send_queue_(std::move(send_queue)),
-      send_callback_(std::move(send_callback)) {}
+    std::shared_ptr<IConnection> connection,
+    std::shared_ptr<queue::Queue<SendQueueMessage>> send_queue)
+    : connection_(std::move(connection)), send_queue_(std::move(send_queue)) {}
 
 Task::Status message_passing::SenderTask::RunAtomic() {
-  // Read the next message from the queue.
-  SendQueueMessage message;
-  if (!send_queue_->PopTimed(kQueueTimeout, &message)) {
+  if (!FillPending()) {
     // Nothing new on the queue.
     return Task::Status::RUNNING;
   }
 
+  // Gather everything we can into one call.
+  const size_t kNumBuffers = GatherBatch();
+
   // Attempt to send.
-  const ssize_t kSendResult =
-      send(send_fd_, message.message.data(), message.message.size(), 0);
+  const ssize_t kSendResult = connection_->Send(buffers_.data(), kNumBuffers);
   if (kSendResult < 0) {
+    if (errno == EINTR) {
+      // We're being cancelled, so there's no point in retrying.
+      return Task::Status::RUNNING;
+    }
     if (errno == EAGAIN || errno == EWOULDBLOCK) {
-      // This is merely a timeout. We can try again later. Add the message
-      // back to the queue.
-      LOG_S(INFO) << "Send timed out for message " << message.message_id
-                  << ". Will retry.";
-      send_queue_->Push(message);
+      // This is merely a timeout. The messages stay pending, so we'll try
+      // again on the next run.
+      LOG_S(INFO) << "Send timed out with " << num_pending_
+                  << " messages pending. Will retry.";
       return Task::Status::RUNNING;
     }
 
-    // General failure to send.
+    // General failure to send. None of the pending messages are going to make
+    // it, because we can't skip over any of them without corrupting the
+    // stream.
     LOG_S(ERROR) << "Socket error: " << std::strerror(errno);
+    FailPending(static_cast<int>(kSendResult));
+    return Task::Status::RUNNING;
   }
 
-  if (!message.send_async) {
-    // Run the callback to indicate the send result.
-    send_callback_(message.message_id, static_cast<int>(kSendResult));
-  }
+  CompleteSent(kSendResult, kNumBuffers);
   return Task::Status::RUNNING;
 }
 
-int SenderTask::GetFd() const { return send_fd_; }
+void SenderTask::OnCancel() {
+  // We could be waiting on either the queue or the connection.
+  send_queue_->Interrupt();
+  connection_->Interrupt();
+}
+
+int SenderTask::GetFd() const { return connection_->GetFd(); }
+
+bool SenderTask::FillPending() {
+  if (num_pending_ == 0) {
+    // Wait for something to send.
+    SendQueueMessage message;
+    if (!send_queue_->PopTimed(kQueueTimeout, &message)) {
+      return false;
+    }
+    AddPending(std::move(message));
+  }
+
+  // Grab anything else that's ready, without waiting. The further ahead we
+  // look, the less likely it is that a small message on one stream is stuck
+  // in the queue behind a lot of bulk data on another.
+  SendQueueMessage message;
+  while (num_pending_ < kMaxPendingMessages &&
+         send_queue_->TryPop(&message)) {
+    AddPending(std::move(message));
+  }
+
+  return true;
+}
+
+void SenderTask::AddPending(SendQueueMessage message) {
+  if (message.trace_id != 0) {
+    const int64_t kNow = Tracer::Now();
+    Tracer::Default().Record(message.trace_id, TraceStage::SEND_QUEUE,
+                             message.stage_start_us, kNow);
+    message.stage_start_us = kNow;
+
+    // The buffer might be shared, so stamp a copy of it.
+    auto stamped = std::make_shared<std::vector<uint8_t>>(*message.message);
+    wire_protocol::SetSendTime(kNow, stamped.get());
+    message.message = std::move(stamped);
+  }
+
+  auto& stream = streams_[message.stream_id];
+  if (stream.messages.empty()) {
+    stream.stream_id = message.stream_id;
+    schedule_.push_back(message.stream_id);
+  }
+  stream.messages.push_back(std::move(message));
+  ++num_pending_;
+}
+
+size_t SenderTask::GatherBatch() {
+  size_t num_buffers = 0;
+  size_t num_bytes = 0;
+
+  cursors_.clear();
+  for (const uint32_t kStreamId : schedule_) {
+    auto& stream = streams_[kStreamId];
+    cursors_.push_back({&stream, 0, stream.offset});
+  }
+
+  if (partial_stream_) {
+    // The receiver would be confused by anything but the rest of this frame.
+    auto& stream = streams_[*partial_stream_];
+    const auto& kMessage = *stream.messages.front().message;
+    buffers_[0].iov_base = const_cast<uint8_t*>(kMessage.data()) +
+                           stream.offset;
+    buffers_[0].iov_len = stream.frame_end - stream.offset;
+    buffer_streams_[0] = &stream;
+    num_buffers = 1;
+    num_bytes = buffers_[0].iov_len;
+
+    for (auto& cursor : cursors_) {
+      if (cursor.stream == &stream) {
+        cursor.offset = stream.frame_end;
+        if (cursor.offset == kMessage.size()) {
+          ++cursor.message_index;
+          cursor.offset = 0;
+        }
+      }
+    }
+  }
+
+  // Each stream gets to add about a fragment's worth of frames per turn.
+  bool added = true;
+  while (added && num_buffers < kMaxBatchSize && num_bytes < kMaxBatchBytes) {
+    added = false;
+    for (auto& cursor : cursors_) {
+      size_t turn_bytes = 0;
+      while (turn_bytes < wire_protocol::kMaxFragmentSize &&
+             num_buffers < kMaxBatchSize && num_bytes < kMaxBatchBytes &&
+             cursor.message_index < cursor.stream->messages.size()) {
+        turn_bytes += AddFrame(&cursor, num_buffers++);
+        added = true;
+      }
+      num_bytes += turn_bytes;
+    }
+  }
+
+  // Start with somebody else next time.
+  if (schedule_.size() > 1) {
+    schedule_.push_back(schedule_.front());
+    schedule_.pop_front();
+  }
+
+  return num_buffers;
+}
+
+size_t SenderTask::AddFrame(Cursor* cursor, size_t num_buffers) {
+  const auto& kMessage =
+      *cursor->stream->messages[cursor->message_index].message;
+  const size_t kFrameSize =
+      wire_protocol::GetFrameSize(kMessage.data() + cursor->offset);
+
+  // sendmsg() never writes through this, despite the type.
+  buffers_[num_buffers].iov_base =
+      const_cast<uint8_t*>(kMessage.data()) + cursor->offset;
+  buffers_[num_buffers].iov_len = kFrameSize;
+  buffer_streams_[num_buffers] = cursor->stream;
+
+  cursor->offset += kFrameSize;
+  if (cursor->offset >= kMessage.size()) {
+    ++cursor->message_index;
+    cursor->offset = 0;
+  }
+
+  return kFrameSize;
+}
+
+void SenderTask::CompleteSent(size_t num_sent, size_t num_buffers) {
+  for (size_t i = 0; i < num_buffers; ++i) {
+    auto& stream = *buffer_streams_[i];
+    const size_t kLength = buffers_[i].iov_len;
+    if (num_sent < kLength) {
+      if (num_sent > 0) {
+        // Only part of this frame went out.
+        stream.frame_end = stream.offset + kLength;
+        stream.offset += num_sent;
+        partial_stream_ = stream.stream_id;
+      }
+      break;
+    }
+
+    num_sent -= kLength;
+    stream.offset += kLength;
+    stream.frame_end = stream.offset;
+    if (partial_stream_ == stream.stream_id) {
+      partial_stream_.reset();
+    }
+
+    auto& message = stream.messages.front();
+    if (stream.offset < message.message->size()) {
+      // There are more fragments to go.
+      continue;
+    }
+
+    Tracer::Default().Record(message.trace_id, TraceStage::SEND,
+                             message.stage_start_us, Tracer::Now());
+    if (message.completion != nullptr) {
+      // Wake up whoever is waiting on this particular message.
+      message.completion->set_value(
+          static_cast<int>(message.message->size()));
+    }
+    stream.messages.pop_front();
+    stream.offset = 0;
+    stream.frame_end = 0;
+    --num_pending_;
+  }
+
+  // Forget about streams that have nothing left to send.
+  for (auto stream_id = schedule_.begin(); stream_id != schedule_.end();) {
+    const auto kStream = streams_.find(*stream_id);
+    if (kStream->second.messages.empty()) {
+      streams_.erase(kStream);
+      stream_id = schedule_.erase(stream_id);
+    } else {
+      ++stream_id;
+    }
+  }
+}
+
+void SenderTask::FailPending(int result) {
+  for (auto& stream_and_state : streams_) {
+    for (auto& message : stream_and_state.second.messages) {
+      if (message.completion != nullptr) {
+        message.completion->set_value(result);
+      }
+    }
+  }
+  streams_.clear();
+  schedule_.clear();
+  num_pending_ = 0;
+  partial_stream_.reset();
+}
 
 }  // namespace message_passing
@@ -1,10 +1,18 @@
 #ifndef CSCI6780_SENDER_TASK_H
 #define CSCI6780_SENDER_TASK_H
 
-#include <functional>
+#include <sys/uio.h>
+
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <future>
 #include <memory>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
+#include "../transport/connection_interface.h"
 #include "../types.h"
 #include "queue/queue.h"
 #include "socket_task_interface.h"
@@ -14,45 +22,163 @@ namespace message_passing {
 /**
  * @brief Task that is responsible for reading
  *  messages off a queue and sending them.
+ * @details Whenever several messages are waiting, they are all written with a
+ *  single call. If the kernel only accepts part of the data, the
+ *  rest is sent on the next run, picking up where it left off.
+ *
+ *  Messages on different streams are sent in turns, frame by frame, with
+ *  each stream getting about one fragment's worth of data per turn. Since
+ *  large messages on streams other than 0 are split into fragments, a bulk
+ *  transfer on one stream only delays messages on other streams by a
+ *  fragment or so. Messages on the same stream go out in order.
  */
 class SenderTask : public ISocketTask {
  public:
-  /// Type alias for the send callback function.
-  using SendCallback = std::function<void(MessageId, int)>;
+  /// Maximum number of messages to hold on a send queue. Once it is full,
+  /// senders have to wait for this task to catch up.
+  static constexpr uint32_t kSendQueueLength = 1024;
+
+  /// A serialized message. It is immutable once queued, so the same buffer
+  /// can be shared between the send queues of several connections.
+  using Buffer = std::shared_ptr<const std::vector<uint8_t>>;
 
   /// Queue message containing messages to be sent.
   struct SendQueueMessage {
     /// Unique ID for the message.
     MessageId message_id;
     /// The serialized message.
-    std::vector<uint8_t> message;
+    Buffer message;
 
-    /// Whether to send this message asynchronously.
-    bool send_async;
+    /// Set to the result of `send()` once the message has been sent. Null
+    /// for asynchronous sends, which nobody waits on.
+    std::shared_ptr<std::promise<int>> completion;
+
+    /// The stream that the message was serialized for.
+    uint32_t stream_id = 0;
+    /// The trace that the message belongs to, or 0 if it isn't traced.
+    uint64_t trace_id = 0;
+    /// For traced messages, when the message entered the stage that it is
+    /// in now.
+    int64_t stage_start_us = 0;
   };
 
   /**
-   * @param send_fd The file descriptor to send on.
+   * @param connection The connection to send on.
    * @param send_queue The queue that messages to send will be received on.
-   * @param send_callback Callback function to call with the message ID and the
-   *    result of `send()` every time a message is sent.
    */
-  SenderTask(int send_fd,
-             std::shared_ptr<queue::Queue<SendQueueMessage>> send_queue,
-             SendCallback send_callback);
+  SenderTask(std::shared_ptr<IConnection> connection,
+             std::shared_ptr<queue::Queue<SendQueueMessage>> send_queue);
   ~SenderTask() override = default;
 
   Status RunAtomic() final;
+  void OnCancel() final;
   [[nodiscard]] int GetFd() const final;
 
  private:
-  /// File descriptor to send messages on.
-  int send_fd_;
+  /// Maximum number of frames to gather into a single send.
+  static constexpr size_t kMaxBatchSize = 64;
+  /// Stop gathering frames for a send once it has this many bytes.
+  static constexpr size_t kMaxBatchBytes = 256 * 1024;
+  /// Maximum number of messages to take off the queue before they are sent.
+  /// This is how far ahead the task can look for messages on other streams.
+  static constexpr size_t kMaxPendingMessages = 256;
+
+  /**
+   * @brief Messages on one stream that have been taken off the queue but not
+   *  completely sent.
+   */
+  struct Stream {
+    /// Which stream this is.
+    uint32_t stream_id = 0;
+    /// The messages, in order.
+    std::deque<SendQueueMessage> messages{};
+    /// Number of bytes of the first message that were already sent.
+    size_t offset = 0;
+    /// If a frame of the first message was only partly sent, where that
+    /// frame ends. Otherwise, the same as `offset`.
+    size_t frame_end = 0;
+  };
+
+  /**
+   * @brief Where a stream is up to while a send is being put together.
+   */
+  struct Cursor {
+    /// The stream.
+    Stream* stream;
+    /// The message that the next frame comes from.
+    size_t message_index;
+    /// Where the next frame starts in that message.
+    size_t offset;
+  };
+
+  /**
+   * @brief Moves whatever is waiting on the queue into `streams_`, without
+   *  blocking for more than one queue timeout.
+   * @return True if there is anything to send.
+   */
+  bool FillPending();
+
+  /**
+   * @brief Moves a message that was just taken off the queue into
+   *  `streams_`.
+   * @details For traced messages, this fills in the send time, which means
+   *  that they get their own copy of the buffer.
+   * @param message The message.
+   */
+  void AddPending(SendQueueMessage message);
+
+  /**
+   * @brief Picks the frames to write next. Whatever is left of a frame that
+   *  was only partly written comes first, and then the streams take turns.
+   * @return The number of buffers that it filled in.
+   */
+  size_t GatherBatch();
+
+  /**
+   * @brief Adds the next frame of a stream to the batch.
+   * @param cursor Where the stream is up to. It will be moved past the frame.
+   * @param num_buffers The number of buffers already in the batch.
+   * @return The number of bytes that it added.
+   */
+  size_t AddFrame(Cursor* cursor, size_t num_buffers);
+
+  /**
+   * @brief Finishes messages that have been completely written, and records
+   *  progress on the one that was partially written.
+   * @param num_sent The number of bytes that were written.
+   * @param num_buffers The number of buffers that were in the batch.
+   */
+  void CompleteSent(size_t num_sent, size_t num_buffers);
+
+  /**
+   * @brief Fails all the pending messages.
+   * @param result The result to report for each of them.
+   */
+  void FailPending(int result);
+
+  /// Connection to send messages on.
+  std::shared_ptr<IConnection> connection_;
 
   /// Queue to receive messages on.
   std::shared_ptr<queue::Queue<SendQueueMessage>> send_queue_;
-  /// Callback to run when a send completes.
-  SendCallback send_callback_;
+
+  /// Messages that have been taken off the queue but not completely sent,
+  /// by stream.
+  std::unordered_map<uint32_t, Stream> streams_{};
+  /// Streams that have something to send, in the order that they take turns.
+  std::deque<uint32_t> schedule_{};
+  /// Total number of messages in `streams_`.
+  size_t num_pending_ = 0;
+  /// The stream whose frame was only partly written, if there is one.
+  /// Nothing else can be sent until the rest of that frame is.
+  std::optional<uint32_t> partial_stream_{};
+
+  /// The batch that is being sent.
+  std::array<struct iovec, kMaxBatchSize> buffers_{};
+  /// The stream that each buffer in the batch belongs to.
+  std::array<Stream*, kMaxBatchSize> buffer_streams_{};
+  /// Scratch space for `GatherBatch()`.
+  std::vector<Cursor> cursors_{};
 };
 
 }  // namespace message_passing
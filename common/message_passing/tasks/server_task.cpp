@@ -2,94 +2,60 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
-#include <sys/select.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-#include <cerrno>
-#include <cstring>
+#include <chrono>
 #include <loguru.hpp>
 #include <utility>
 #include <vector>
 
+#include "../transport/loopback_connection.h"
+#include "../transport/shm_connection.h"
+#include "../transport/socket_connection.h"
 #include "../utils.h"
 
 namespace message_passing {
 namespace {
 
-/// Timeout to use when accepting connections.
-const struct timeval kSelectTimeout = {1, 0};
-
-/**
- * @brief Represents status of `accept()` calls.
- */
-enum class AcceptStatus { SUCCESS, FAILURE, TIMEOUT };
-
-/**
- * @brief Performs an `accept()` call with a timeout.
- * @param socket_fd The socket FD to accept on.
- * @param endpoint[out] Will be filled with the client information for the
- *  connection we accepted.
- * @param client_fd[out] Will be set to the FD of the connected client.
- * @return The resulting status.
- */
-AcceptStatus AcceptWithTimeout(int socket_fd, Endpoint *endpoint,
-                               int *client_fd) {
-  fd_set read_fds;
-  FD_ZERO(&read_fds);
-  FD_SET(socket_fd, &read_fds);
-
-  // Wait for a connection with a timeout.
-  auto timeout = kSelectTimeout;
-  const int kNumReady =
-      select(socket_fd + 1, &read_fds, nullptr, nullptr, &timeout);
-  if (kNumReady < 0) {
-    LOG_S(ERROR) << "select() failed: " << std::strerror(errno);
-    return AcceptStatus::FAILURE;
-  } else if (kNumReady == 0) {
-    // Timed out.
-    return AcceptStatus::TIMEOUT;
-  }
-
-  // Accept the connection.
-  struct sockaddr_in client_address {};
-  socklen_t address_size = sizeof(client_address);
-  *client_fd =
-      accept(socket_fd, reinterpret_cast<struct sockaddr *>(&client_address),
-             &address_size);
-  if (*client_fd < 0) {
-    LOG_S(ERROR) << "accept() failed: " << std::strerror(errno);
-    return AcceptStatus::FAILURE;
-  }
-
-  // Fill in the client information.
-  endpoint->hostname = inet_ntoa(client_address.sin_addr);
-  endpoint->port = client_address.sin_port;
-  LOG_S(INFO) << "Accepting new connection from " << endpoint->hostname << ":"
-              << endpoint->port << ".";
-
-  return AcceptStatus::SUCCESS;
-}
+/// How often to check for disconnected clients.
+constexpr auto kReapInterval = std::chrono::milliseconds(250);
 
 }  // namespace
 
 ServerTask::ServerTask(
-    uint16_t listen_port, std::shared_ptr<thread_pool::ThreadPool> thread_pool,
+    Endpoint listen_endpoint,
+    std::shared_ptr<thread_pool::ThreadPool> thread_pool,
     std::shared_ptr<queue::Queue<ReceiverTask::ReceiveQueueMessage>>
         receive_queue,
-    NewClientCallback new_client_callback,
-    SenderTask::SendCallback send_callback)
-    : listen_port_(listen_port),
+    NewClientCallback new_client_callback, uint32_t num_acceptors,
+    int backlog)
+    : listen_endpoint_(std::move(listen_endpoint)),
       thread_pool_(std::move(thread_pool)),
       receive_queue_(std::move(receive_queue)),
       new_client_callback_(std::move(new_client_callback)),
-      send_callback_(std::move(send_callback)) {}
+      num_acceptors_(num_acceptors),
+      backlog_(backlog),
+      listeners_(std::make_unique<listener::ListenerGroup>(
+          *thread_pool_,
+          [this](int client_fd, const struct sockaddr_storage &address) {
+            AcceptClient(client_fd, address);
+          })) {}
 
 thread_pool::Task::Status ServerTask::SetUp() {
-  // Set up the server socket.
-  const auto kAddress = MakeAddress(listen_port_);
-  server_socket_ = SetUpListenerSocket(kAddress);
-  if (server_socket_ < 0) {
+  // Set up the server sockets.
+  bool listening;
+  if (listen_endpoint_.transport == Transport::LOOPBACK) {
+    listening = ListenLoopback();
+  } else if (listen_endpoint_.transport != Transport::TCP) {
+    const int kServerSocket =
+        SetUpUnixListenerSocket(listen_endpoint_.socket_path);
+    listening = kServerSocket >= 0 && listeners_->AddListener(kServerSocket);
+  } else {
+    listening =
+        listeners_->ListenTcp(listen_endpoint_.port, num_acceptors_, backlog_);
+  }
+  if (!listening) {
     return Status::FAILED;
   }
 
@@ -100,38 +66,84 @@ thread_pool::Task::Status ServerTask::RunAtomic() {
   // Clean up any disconnected clients.
   CloseDisconnected();
 
-  // Accept a new client.
-  Endpoint client_endpoint;
-  int client_fd;
-  const auto kAcceptResult =
-      AcceptWithTimeout(server_socket_, &client_endpoint, &client_fd);
-  if (kAcceptResult == AcceptStatus::TIMEOUT) {
-    // Timeout. We'll try again later.
-    return Status::RUNNING;
-  } else if (kAcceptResult == AcceptStatus::FAILURE) {
+  if (listen_endpoint_.transport != Transport::LOOPBACK &&
+      !listeners_->IsRunning()) {
+    LOG_S(ERROR) << "All acceptors have exited.";
     return Status::FAILED;
   }
 
+  cancelled_.Wait(kReapInterval);
+  return Status::RUNNING;
+}
+
+void ServerTask::AcceptClient(int client_fd,
+                              const struct sockaddr_storage &address) {
+  const Endpoint kClientEndpoint = MakeClientEndpoint(address);
+
+  std::shared_ptr<IConnection> connection;
+  if (listen_endpoint_.transport == Transport::SHARED_MEMORY) {
+    connection = ShmConnection::Accept(client_fd);
+    if (connection == nullptr) {
+      // Just drop this client. It will notice when it tries to connect.
+      close(client_fd);
+      return;
+    }
+  } else {
+    connection = std::make_shared<SocketConnection>(client_fd);
+  }
+
+  StartClient(connection, kClientEndpoint);
+}
+
+bool ServerTask::ListenLoopback() {
+  std::lock_guard<std::mutex> lock(loopback_mutex_);
+  if (loopback_stopped_) {
+    return false;
+  }
+
+  loopback_listener_ = LoopbackListener::Listen(
+      listen_endpoint_.socket_path,
+      [this](std::shared_ptr<LoopbackConnection> connection) {
+        const Endpoint kClientEndpoint = {"", ++next_unix_client_id_,
+                                          Transport::LOOPBACK,
+                                          listen_endpoint_.socket_path};
+        LOG_S(INFO) << "Accepting new loopback connection #"
+                    << kClientEndpoint.port << " on "
+                    << kClientEndpoint.socket_path << ".";
+        StartClient(std::move(connection), kClientEndpoint);
+      });
+  return loopback_listener_ != nullptr;
+}
+
+void ServerTask::StartClient(std::shared_ptr<IConnection> connection,
+                             const Endpoint &client_endpoint) {
   // Create tasks to handle the client.
   auto send_queue =
-      std::make_shared<queue::Queue<SenderTask::SendQueueMessage>>();
-  auto sender_task =
-      std::make_shared<SenderTask>(client_fd, send_queue, send_callback_);
-  auto receiver_task = std::make_shared<ReceiverTask>(client_fd, receive_queue_,
+      std::make_shared<queue::Queue<SenderTask::SendQueueMessage>>(
+          SenderTask::kSendQueueLength);
+  auto sender_task = std::make_shared<SenderTask>(connection, send_queue);
+  auto receiver_task = std::make_shared<ReceiverTask>(connection, receive_queue_,
                                                       client_endpoint);
 
-  thread_pool_->AddTask(sender_task);
-  thread_pool_->AddTask(receiver_task);
-  tasks_.insert(sender_task);
-  tasks_.insert(receiver_task);
-
-  // Run the new client callback.
+  // Run the new client callback. This has to happen before the receiver
+  // starts, so that anyone who gets a message from the client can reply to
+  // it right away.
   new_client_callback_(client_endpoint, send_queue);
 
-  return Status::RUNNING;
+  thread_pool_->AddTask(sender_task);
+  thread_pool_->AddTask(receiver_task);
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    tasks_.insert(sender_task);
+    tasks_.insert(receiver_task);
+  }
 }
 
 void ServerTask::CleanUp() {
+  // Stop accepting first, so that no new tasks show up while we're cancelling.
+  StopListening();
+
+  std::lock_guard<std::mutex> lock(tasks_mutex_);
   LOG_S(INFO) << "Server task is exiting, cancelling " << tasks_.size()
               << " tasks.";
 
@@ -145,13 +157,53 @@ void ServerTask::CleanUp() {
     close(kTask->GetFd());
   }
 
-  // Finally, close the actual server socket.
-  close(server_socket_);
+  if (listen_endpoint_.transport == Transport::UNIX ||
+      listen_endpoint_.transport == Transport::SHARED_MEMORY) {
+    // Don't leave the socket file lying around.
+    unlink(listen_endpoint_.socket_path.c_str());
+  }
+}
+
+void ServerTask::OnCancel() { cancelled_.Signal(); }
+
+int ServerTask::GetFd() const { return -1; }
+
+void ServerTask::StopListening() {
+  listeners_->Stop();
+
+  std::lock_guard<std::mutex> lock(loopback_mutex_);
+  loopback_stopped_ = true;
+  loopback_listener_.reset();
 }
 
-int ServerTask::GetFd() const { return server_socket_; }
+Endpoint ServerTask::MakeClientEndpoint(
+    const struct sockaddr_storage &address) {
+  Endpoint endpoint;
+  if (address.ss_family == AF_UNIX) {
+    // Unix socket clients are usually unnamed, so we make up an ID for them.
+    endpoint = {"", ++next_unix_client_id_, listen_endpoint_.transport,
+                listen_endpoint_.socket_path};
+    LOG_S(INFO) << "Accepting new connection #" << endpoint.port << " on "
+                << endpoint.socket_path << ".";
+    return endpoint;
+  }
+
+  const auto &kInetAddress =
+      reinterpret_cast<const struct sockaddr_in &>(address);
+  // inet_ntoa() uses a static buffer, and acceptors run on several threads.
+  char hostname[INET_ADDRSTRLEN];
+  if (inet_ntop(AF_INET, &kInetAddress.sin_addr, hostname, sizeof(hostname)) !=
+      nullptr) {
+    endpoint.hostname = hostname;
+  }
+  endpoint.port = kInetAddress.sin_port;
+  LOG_S(INFO) << "Accepting new connection from " << endpoint.hostname << ":"
+              << endpoint.port << ".";
+  return endpoint;
+}
 
 void ServerTask::CloseDisconnected() {
+  std::lock_guard<std::mutex> lock(tasks_mutex_);
   std::vector<std::shared_ptr<ISocketTask>> deletable_tasks;
 
   for (const auto &kTask : tasks_) {
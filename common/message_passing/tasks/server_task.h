@@ -1,23 +1,34 @@
 #ifndef CSCI6780_MESSAGE_PASSING_SERVER_TASK_H
 #define CSCI6780_MESSAGE_PASSING_SERVER_TASK_H
 
+#include <sys/socket.h>
+
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_set>
 
+#include "../transport/connection_interface.h"
+#include "../transport/loopback_connection.h"
 #include "../types.h"
+#include "listener/listener_group.h"
 #include "queue/queue.h"
 #include "receiver_task.h"
 #include "sender_task.h"
 #include "socket_task_interface.h"
 #include "thread_pool/thread_pool.h"
+#include "thread_pool/wakeup_event.h"
 
 namespace message_passing {
 
 /**
  * @brief Task that's responsible for listening
  *  on a server socket and handling clients.
+ * @details Connections are accepted by a `listener::ListenerGroup`, so for TCP
+ *  there can be several acceptor threads sharing the port. This task just
+ *  reaps the clients that have disconnected.
  */
 class ServerTask : public ISocketTask {
  public:
@@ -31,37 +42,85 @@ class ServerTask : public ISocketTask {
       std::shared_ptr<queue::Queue<SenderTask::SendQueueMessage>>)>;
 
   /**
-   * @param listen_port The port that the server should listen on.
+   * @param listen_endpoint The endpoint that the server should listen on. For
+   *    TCP, only the port is used. For shared memory, clients connect on the
+   *    Unix socket first, then switch over to shared memory. Loopback
+   *    endpoints can only be reached from within this process.
    * @param thread_pool The thread pool to use for handling server-related
    *    tasks.
    * @param receive_queue The queue that we want received messages to be pushed
    *    onto.
    * @param new_client_callback The callback to run whenever a new client
-   *    connects.
-   * @param send_callback The callback to run whenever a message gets sent
-   *    to any client.
+   *    connects. It may be called from several threads at once.
+   * @param num_acceptors The number of acceptor threads to use for TCP. Unix
+   *    sockets always use one.
+   * @param backlog The length of the accept queue for each listener socket.
    */
-  ServerTask(uint16_t listen_port,
+  ServerTask(Endpoint listen_endpoint,
              std::shared_ptr<thread_pool::ThreadPool> thread_pool,
              std::shared_ptr<queue::Queue<ReceiverTask::ReceiveQueueMessage>>
                  receive_queue,
              NewClientCallback new_client_callback,
-             SenderTask::SendCallback send_callback);
+             uint32_t num_acceptors = listener::kDefaultNumAcceptors,
+             int backlog = SOMAXCONN);
   ~ServerTask() override = default;
 
   Status SetUp() final;
   Status RunAtomic() final;
   void CleanUp() final;
+  void OnCancel() final;
+  /**
+   * @return Always -1, since the listening sockets are owned by the
+   *    acceptors.
+   */
   [[nodiscard]] int GetFd() const final;
 
+  /**
+   * @brief Stops accepting new connections. Unlike cancelling the task, the
+   *    listening sockets are guaranteed to be shut down when this returns.
+   */
+  void StopListening();
+
  private:
+  /**
+   * @brief Sets up the tasks for a client that just connected. This gets
+   *    run on one of the acceptor threads.
+   * @param client_fd The FD of the new connection.
+   * @param address The address of the client.
+   */
+  void AcceptClient(int client_fd, const struct sockaddr_storage& address);
+
+  /**
+   * @brief Starts accepting in-process loopback connections.
+   * @return True if it succeeded, false otherwise.
+   */
+  bool ListenLoopback();
+
+  /**
+   * @brief Starts the tasks that handle a newly connected client.
+   * @param connection The connection to the client.
+   * @param client_endpoint The endpoint to report for the client.
+   */
+  void StartClient(std::shared_ptr<IConnection> connection,
+                   const Endpoint& client_endpoint);
+
   /**
    * @brief Cleans up the tasks associated with disconnected clients.
    */
   void CloseDisconnected();
 
-  /// The port to listen on.
-  uint16_t listen_port_;
+  /**
+   * @brief Works out the endpoint to use for a client that just connected.
+   * @param address The address that `accept()` returned for the client.
+   * @return The endpoint.
+   */
+  Endpoint MakeClientEndpoint(const struct sockaddr_storage& address);
+
+  /// The endpoint to listen on.
+  Endpoint listen_endpoint_;
+  /// Used to give Unix socket clients distinct endpoints, since they don't
+  /// have a port.
+  std::atomic<uint16_t> next_unix_client_id_ = 0;
   /// The thread pool to use for internal tasks.
   std::shared_ptr<thread_pool::ThreadPool> thread_pool_;
   /// The queue that we want to receive messages on.
@@ -69,14 +128,27 @@ class ServerTask : public ISocketTask {
       receive_queue_;
   /// All the tasks that we've started so far.
   std::unordered_set<std::shared_ptr<ISocketTask>> tasks_;
+  /// Protects access to `tasks_`.
+  std::mutex tasks_mutex_{};
 
   /// Callback to run when a client connects.
   NewClientCallback new_client_callback_;
-  /// Callback to run when a message is sent.
-  SenderTask::SendCallback send_callback_;
 
-  /// Socket we are listening on.
-  int server_socket_ = -1;
+  /// Number of acceptor threads to use for TCP.
+  uint32_t num_acceptors_;
+  /// Accept queue length for the listener sockets.
+  int backlog_;
+  /// Accepts new connections.
+  std::unique_ptr<listener::ListenerGroup> listeners_;
+  /// Signalled when the task is cancelled, so that it doesn't have to finish
+  /// waiting for the next reap.
+  thread_pool::WakeupEvent cancelled_{};
+  /// Accepts new connections instead of `listeners_` for loopback endpoints.
+  std::unique_ptr<LoopbackListener> loopback_listener_;
+  /// Set once we've stopped listening, so that we don't start again.
+  bool loopback_stopped_ = false;
+  /// Protects `loopback_listener_` and `loopback_stopped_`.
+  std::mutex loopback_mutex_{};
 };
 
 }  // namespace message_passing
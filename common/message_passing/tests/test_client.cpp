@@ -8,6 +8,7 @@
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <future>
 #include <loguru.hpp>
 #include <memory>
 #include <thread>
@@ -371,6 +372,37 @@ TEST(Client, RequestResponse) {
   EXPECT_EQ(kTestParameterString, response.parameter());
 }
 
+/**
+ * @test Tests that a request sent after the server has closed the
+ *    connection fails instead of waiting forever.
+ */
+TEST(Client, RequestAfterDisconnect) {
+  // Arrange.
+  auto config = MakeConfig();
+
+  // The server closes the connection after the first message.
+  SingleShotServer server(kTestEndpoint.port);
+  ASSERT_TRUE(server.Begin());
+  config.client->SendAsync(MakeTestMessage());
+  server.GetMessage();
+
+  // Wait for the client to notice.
+  for (int i = 0; i < 100 && config.client->IsHealthy(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  ASSERT_FALSE(config.client->IsHealthy());
+
+  // Act.
+  TestResponse response;
+  auto result = config.client->SendRequestAsync(MakeTestMessage(), &response);
+
+  // Assert.
+  // It should have failed right away.
+  ASSERT_EQ(std::future_status::ready,
+            result.wait_for(std::chrono::seconds(1)));
+  EXPECT_FALSE(result.get());
+}
+
 /**
  * @test Tests that receiving with a timeout works.
  */
@@ -0,0 +1,147 @@
+/**
+ * @file Tests for the `ConnectionCache` class.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "../connection_cache.h"
+#include "../server.h"
+#include "test_messages.pb.h"
+#include "thread_pool/thread_pool.h"
+
+namespace message_passing::tests {
+namespace {
+
+using test_messages::TestMessage;
+using thread_pool::ThreadPool;
+
+/// Listening port to use for the server. It differs from the other
+/// message_passing tests, so that they can run in parallel.
+constexpr uint16_t kServerPort = 1241;
+/// Parameter string to use for test messages.
+const char* kTestParameterString = "a parameter string value";
+/// Server endpoint to use for testing.
+const Endpoint kTestEndpoint = {"127.0.0.1", kServerPort};
+/// How many times to try connecting before we give up.
+constexpr uint8_t kConnectionRetries = 5;
+
+/**
+ * @brief Creates a message to use for testing.
+ * @return The message that it created.
+ */
+TestMessage MakeTestMessage() {
+  TestMessage test_message;
+  test_message.set_parameter(kTestParameterString);
+
+  return test_message;
+}
+
+/**
+ * @brief Sends a message through a cached client, retrying while the server
+ *  starts up.
+ * @param cache The cache to get the client from.
+ * @return True if the message was eventually sent.
+ */
+bool SendWithRetry(ConnectionCache* cache) {
+  for (uint8_t num_retries = 0; num_retries < kConnectionRetries;
+       ++num_retries) {
+    if (cache->Get(kTestEndpoint)->Send(MakeTestMessage()) > 0) {
+      return true;
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+
+  return false;
+}
+
+}  // namespace
+
+/**
+ * @test Tests that repeated requests for the same endpoint share one
+ *  connection.
+ */
+TEST(ConnectionCache, ReusesConnection) {
+  // Arrange.
+  auto thread_pool = std::make_shared<ThreadPool>();
+  Server server(thread_pool, kServerPort);
+  ConnectionCache cache(thread_pool);
+
+  // Act.
+  ASSERT_TRUE(SendWithRetry(&cache));
+  const auto kClient1 = cache.Get(kTestEndpoint);
+  const auto kClient2 = cache.Get(kTestEndpoint);
+  ASSERT_GT(kClient2->Send(MakeTestMessage()), 0);
+
+  // Receive both messages on the server.
+  TestMessage message1, message2;
+  Endpoint source1, source2;
+  ASSERT_TRUE(server.Receive(&message1, &source1));
+  ASSERT_TRUE(server.Receive(&message2, &source2));
+
+  // Assert.
+  // It should have handed out the same client both times.
+  EXPECT_EQ(kClient1, kClient2);
+  EXPECT_EQ(1U, cache.Size());
+  // Both messages should have arrived over the same connection.
+  EXPECT_EQ(source1, source2);
+  EXPECT_EQ(1U, server.GetConnected().size());
+}
+
+/**
+ * @test Tests that idle connections get evicted.
+ */
+TEST(ConnectionCache, EvictsIdle) {
+  // Arrange.
+  auto thread_pool = std::make_shared<ThreadPool>();
+  ConnectionCache cache(thread_pool, std::chrono::milliseconds(10));
+
+  // Check out a client, and hold on to it for now.
+  auto client = cache.Get(kTestEndpoint);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // Act.
+  cache.EvictIdle();
+  const auto kSizeWhileInUse = cache.Size();
+  // Release the client and try again.
+  client.reset();
+  cache.EvictIdle();
+
+  // Assert.
+  // It should not evict clients that are in use.
+  EXPECT_EQ(1U, kSizeWhileInUse);
+  // It should evict them once they are released.
+  EXPECT_EQ(0U, cache.Size());
+}
+
+/**
+ * @test Tests that a client that failed to connect is replaced.
+ */
+TEST(ConnectionCache, ReplacesUnhealthy) {
+  // Arrange.
+  auto thread_pool = std::make_shared<ThreadPool>();
+  ConnectionCache cache(thread_pool);
+
+  // There is no server, so this should fail to connect.
+  const auto kClient1 = cache.Get(kTestEndpoint);
+  ASSERT_LT(kClient1->Send(MakeTestMessage()), 0);
+
+  // Act.
+  const auto kClient2 = cache.Get(kTestEndpoint);
+
+  // Assert.
+  // The failed client should be flagged as unhealthy.
+  EXPECT_FALSE(kClient1->IsHealthy());
+  // It should have created a new client.
+  EXPECT_NE(kClient1, kClient2);
+  EXPECT_TRUE(kClient2->IsHealthy());
+  EXPECT_EQ(1U, cache.Size());
+}
+
+}  // namespace message_passing::tests
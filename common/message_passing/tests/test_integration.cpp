@@ -3,12 +3,21 @@
  */
 
 #include <gtest/gtest.h>
+#include <unistd.h>
 
+#include <chrono>
 #include <cstdint>
 #include <functional>
+#include <future>
 #include <loguru.hpp>
 #include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "../client.h"
 #include "../server.h"
@@ -23,7 +32,7 @@ using test_messages::TestResponse;
 using thread_pool::ThreadPool;
 
 /// Listening port to use for the server.
-constexpr uint16_t kServerPort = 1234;
+constexpr uint16_t kServerPort = 1243;
 /// Parameter string to use for test messages.
 const char* kTestParameterString = "a parameter string value";
 /// Server endpoint to use for testing.
@@ -146,5 +155,447 @@ TEST(MessagePassingIntegration, RequestResponse) {
   EXPECT_EQ(got_server_endpoint, kTestEndpoint);
 }
 
+/**
+ * @test Tests that multiple requests can be in flight on the same connection,
+ * and that responses are matched to the right request even when they arrive
+ * out of order.
+ */
+TEST(MessagePassingIntegration, PipelinedRequests) {
+  // Arrange.
+  auto config = MakeConfig();
+  // Make sure the client is connected before we start.
+  ASSERT_TRUE(Retry([&]() { return config.client->Send(TestMessage()) > 0; }));
+  TestMessage connect_message;
+  ASSERT_TRUE(config.server->Receive(&connect_message));
+
+  constexpr uint8_t kNumRequests = 5;
+
+  // Act.
+  // Send all the requests without waiting for any responses.
+  std::vector<TestResponse> responses(kNumRequests);
+  std::vector<std::future<bool>> results;
+  for (uint8_t i = 0; i < kNumRequests; ++i) {
+    TestMessage request;
+    request.set_parameter(std::to_string(i));
+    results.push_back(
+        config.client->SendRequestAsync(request, &responses[i]));
+  }
+
+  // Receive all the requests on the server.
+  std::vector<TestMessage> requests(kNumRequests);
+  std::vector<RequestId> request_ids(kNumRequests);
+  Endpoint client_endpoint;
+  for (uint8_t i = 0; i < kNumRequests; ++i) {
+    ASSERT_TRUE(config.server->Receive(&requests[i], &client_endpoint,
+                                       &request_ids[i]));
+  }
+
+  // Respond in reverse order.
+  for (int i = kNumRequests - 1; i >= 0; --i) {
+    TestResponse response;
+    response.set_parameter("response to " + requests[i].parameter());
+    ASSERT_TRUE(config.server->SendResponse(response, client_endpoint,
+                                            request_ids[i]));
+  }
+
+  // Assert.
+  for (uint8_t i = 0; i < kNumRequests; ++i) {
+    // Every request should have gotten its own response.
+    EXPECT_TRUE(results[i].get());
+    EXPECT_EQ("response to " + std::to_string(i), responses[i].parameter());
+    // Every request should have a distinct, non-zero ID.
+    EXPECT_NE(0U, request_ids[i]);
+  }
+  EXPECT_EQ(kNumRequests, std::unordered_set<RequestId>(request_ids.begin(),
+                                                        request_ids.end())
+                              .size());
+}
+
+/**
+ * @test Tests that synchronous sends from several threads sharing one client
+ * each get their own result.
+ */
+TEST(MessagePassingIntegration, ConcurrentSyncSends) {
+  // Arrange.
+  auto config = MakeConfig();
+  ASSERT_TRUE(Retry([&]() { return config.client->Send(TestMessage()) > 0; }));
+  TestMessage connect_message;
+  ASSERT_TRUE(config.server->Receive(&connect_message));
+
+  constexpr uint8_t kNumThreads = 4;
+  constexpr uint8_t kSendsPerThread = 10;
+  const auto kTestMessage = MakeTestMessage();
+
+  // Act.
+  std::vector<std::thread> threads;
+  std::vector<std::vector<int>> results(kNumThreads);
+  for (uint8_t i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&, i]() {
+      for (uint8_t j = 0; j < kSendsPerThread; ++j) {
+        results[i].push_back(config.client->Send(kTestMessage));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Assert.
+  // Every send should have succeeded.
+  for (const auto& kThreadResults : results) {
+    ASSERT_EQ(kSendsPerThread, kThreadResults.size());
+    for (const int kResult : kThreadResults) {
+      EXPECT_GT(kResult, 0);
+    }
+  }
+
+  // The server should have gotten all the messages.
+  for (uint16_t i = 0; i < kNumThreads * kSendsPerThread; ++i) {
+    TestMessage got_message;
+    ASSERT_TRUE(config.server->Receive(&got_message));
+    EXPECT_EQ(kTestMessage.parameter(), got_message.parameter());
+  }
+}
+
+/**
+ * @test Tests that a burst of asynchronous messages all arrive intact and in
+ * order.
+ */
+TEST(MessagePassingIntegration, ManyMessagesInOrder) {
+  // Arrange.
+  auto config = MakeConfig();
+  ASSERT_TRUE(Retry([&]() { return config.client->Send(TestMessage()) > 0; }));
+  TestMessage connect_message;
+  ASSERT_TRUE(config.server->Receive(&connect_message));
+
+  constexpr uint16_t kNumMessages = 1000;
+
+  // Act.
+  // Queue everything at once so that the sender has a chance to batch them.
+  for (uint16_t i = 0; i < kNumMessages; ++i) {
+    TestMessage message;
+    message.set_parameter(std::to_string(i));
+    ASSERT_TRUE(config.client->SendAsync(message));
+  }
+
+  // Assert.
+  for (uint16_t i = 0; i < kNumMessages; ++i) {
+    TestMessage got_message;
+    ASSERT_TRUE(config.server->Receive(&got_message));
+    EXPECT_EQ(std::to_string(i), got_message.parameter());
+  }
+}
+
+/**
+ * @test Tests that a broadcast reaches every client that the filter selects,
+ * and no others.
+ */
+TEST(MessagePassingIntegration, Broadcast) {
+  // Arrange.
+  constexpr size_t kNumClients = 4;
+  auto thread_pool = std::make_shared<ThreadPool>();
+  auto server = std::make_unique<Server>(thread_pool, kServerPort);
+  std::vector<std::unique_ptr<Client>> clients;
+  std::vector<Endpoint> client_endpoints;
+  for (size_t i = 0; i < kNumClients; ++i) {
+    clients.push_back(std::make_unique<Client>(thread_pool, kTestEndpoint));
+    ASSERT_TRUE(
+        Retry([&]() { return clients.back()->Send(TestMessage()) > 0; }));
+
+    // Find out which endpoint the server sees for this client.
+    TestMessage connect_message;
+    Endpoint client_endpoint;
+    ASSERT_TRUE(server->Receive(&connect_message, &client_endpoint));
+    client_endpoints.push_back(client_endpoint);
+  }
+  // Leave out the last client.
+  const Endpoint kExcluded = client_endpoints.back();
+
+  // Act.
+  const auto kTestMessage = MakeTestMessage();
+  const int kNumDispatched = server->Broadcast(
+      kTestMessage,
+      [&kExcluded](const Endpoint& endpoint) { return endpoint != kExcluded; });
+
+  // Assert.
+  EXPECT_EQ(static_cast<int>(kNumClients) - 1, kNumDispatched);
+  for (size_t i = 0; i < kNumClients - 1; ++i) {
+    TestMessage got_message;
+    ASSERT_TRUE(clients[i]->Receive(std::chrono::seconds(5), &got_message));
+    EXPECT_EQ(kTestMessage.parameter(), got_message.parameter());
+  }
+  TestMessage unexpected_message;
+  EXPECT_FALSE(clients.back()->Receive(std::chrono::milliseconds(200),
+                                       &unexpected_message));
+}
+
+/**
+ * @test Tests that the client and server can talk over a Unix domain socket.
+ */
+TEST(MessagePassingIntegration, UnixSocket) {
+  // Arrange.
+  const auto kSocketEndpoint = MakeUnixEndpoint(
+      "/tmp/test_mp_integration_" + std::to_string(getpid()) + ".sock");
+  auto thread_pool = std::make_shared<ThreadPool>();
+  auto server = std::make_unique<Server>(thread_pool, kSocketEndpoint);
+  auto client = std::make_unique<Client>(thread_pool, kSocketEndpoint);
+
+  // Act.
+  // Send a request to the server.
+  const auto kTestRequest = MakeTestMessage();
+  ASSERT_TRUE(Retry([&]() { return client->Send(kTestRequest) > 0; }));
+
+  // Receive the request.
+  TestMessage got_request;
+  Endpoint client_endpoint;
+  ASSERT_TRUE(server->Receive(&got_request, &client_endpoint));
+
+  // Send the response.
+  const auto kTestResponse = MakeTestResponse();
+  ASSERT_GT(server->Send(kTestResponse, client_endpoint), 0);
+
+  // Receive the response.
+  TestResponse got_response;
+  ASSERT_TRUE(Retry([&]() { return client->Receive(&got_response); }));
+
+  // Assert.
+  // The messages should match what was sent.
+  EXPECT_EQ(kTestRequest.parameter(), got_request.parameter());
+  EXPECT_EQ(kTestResponse.parameter(), got_response.parameter());
+  // The server should know that the client used the Unix socket.
+  EXPECT_EQ(Transport::UNIX, client_endpoint.transport);
+  EXPECT_EQ(kSocketEndpoint.socket_path, client_endpoint.socket_path);
+}
+
+/**
+ * @test Tests that the client and server can talk over the in-process
+ * loopback transport, and that the server notices when the client goes away.
+ */
+TEST(MessagePassingIntegration, Loopback) {
+  // Arrange.
+  const auto kLoopbackEndpoint = MakeLoopbackEndpoint("test_mp_integration");
+  auto thread_pool = std::make_shared<ThreadPool>();
+  auto server = std::make_unique<Server>(thread_pool, kLoopbackEndpoint);
+  auto client = std::make_unique<Client>(thread_pool, kLoopbackEndpoint);
+
+  // Act.
+  // Send a request to the server.
+  const auto kTestRequest = MakeTestMessage();
+  ASSERT_TRUE(Retry([&]() { return client->Send(kTestRequest) > 0; }));
+
+  // Receive the request.
+  TestMessage got_request;
+  Endpoint client_endpoint;
+  ASSERT_TRUE(server->Receive(&got_request, &client_endpoint));
+
+  // Send the response.
+  const auto kTestResponse = MakeTestResponse();
+  ASSERT_GT(server->Send(kTestResponse, client_endpoint), 0);
+
+  // Receive the response.
+  TestResponse got_response;
+  ASSERT_TRUE(client->Receive(&got_response));
+
+  // Disconnect the client.
+  client.reset();
+  TestMessage disconnect_message;
+  const bool kDisconnectResult =
+      server->Receive(std::chrono::seconds(5), &disconnect_message);
+
+  // Assert.
+  // The messages should match what was sent.
+  EXPECT_EQ(kTestRequest.parameter(), got_request.parameter());
+  EXPECT_EQ(kTestResponse.parameter(), got_response.parameter());
+  // The server should know that the client used the loopback transport.
+  EXPECT_EQ(Transport::LOOPBACK, client_endpoint.transport);
+  // The disconnect should have been reported as a failed receive.
+  EXPECT_FALSE(kDisconnectResult);
+}
+
+/**
+ * @test Tests that a traced request and its response are recorded as one
+ * trace that covers every stage, and that the trace can be exported.
+ */
+TEST(MessagePassingIntegration, Tracing) {
+  // Arrange.
+  const auto kLoopbackEndpoint = MakeLoopbackEndpoint("test_mp_tracing");
+  auto thread_pool = std::make_shared<ThreadPool>();
+  auto server = std::make_unique<Server>(thread_pool, kLoopbackEndpoint);
+  auto client = std::make_unique<Client>(thread_pool, kLoopbackEndpoint);
+
+  auto& tracer = Tracer::Default();
+  tracer.Clear();
+  tracer.Start(1);
+
+  // Act.
+  // Do a round trip.
+  ASSERT_TRUE(Retry([&]() { return client->Send(MakeTestMessage()) > 0; }));
+  TestMessage got_request;
+  Endpoint client_endpoint;
+  ASSERT_TRUE(server->Receive(&got_request, &client_endpoint));
+  ASSERT_GT(server->Send(MakeTestResponse(), client_endpoint), 0);
+  TestResponse got_response;
+  ASSERT_TRUE(client->Receive(&got_response));
+
+  tracer.Stop();
+  std::ostringstream exported;
+  tracer.WriteChromeTrace(exported);
+
+  // Assert.
+  // Everything should belong to the trace that the client started.
+  const auto kSpans = tracer.GetSpans();
+  ASSERT_FALSE(kSpans.empty());
+  std::set<TraceStage> stages;
+  for (const auto& kSpan : kSpans) {
+    EXPECT_EQ(kSpans.front().trace_id, kSpan.trace_id);
+    EXPECT_LE(kSpan.start_us, kSpan.end_us);
+    stages.insert(kSpan.stage);
+  }
+  // Both the request and the response should have gone through every stage.
+  EXPECT_EQ(8U, stages.size());
+  EXPECT_EQ(0U, tracer.GetNumDropped());
+
+  EXPECT_NE(std::string::npos, exported.str().find("\"traceEvents\""));
+  EXPECT_NE(std::string::npos, exported.str().find("\"name\":\"handler\""));
+
+  tracer.Clear();
+}
+
+/**
+ * @test Tests that a small message on one stream doesn't have to wait for a
+ * large one on another stream to finish.
+ */
+TEST(MessagePassingIntegration, StreamsInterleave) {
+  // Arrange.
+  const auto kLoopbackEndpoint = MakeLoopbackEndpoint("test_mp_streams");
+  auto thread_pool = std::make_shared<ThreadPool>();
+  auto server = std::make_unique<Server>(thread_pool, kLoopbackEndpoint);
+  auto client = std::make_unique<Client>(thread_pool, kLoopbackEndpoint);
+
+  ASSERT_TRUE(Retry([&]() { return client->Send(TestMessage()) > 0; }));
+  TestMessage connect_message;
+  ASSERT_TRUE(server->Receive(&connect_message));
+
+  TestMessage bulk_message;
+  bulk_message.set_parameter(std::string(8 * 1024 * 1024, 'x'));
+  constexpr StreamId kBulkStream = 1;
+
+  // Act.
+  // The bulk message goes first, but on its own stream.
+  ASSERT_TRUE(client->SendAsync(bulk_message, kBulkStream));
+  ASSERT_TRUE(client->SendAsync(MakeTestMessage()));
+
+  TestMessage first_message;
+  ASSERT_TRUE(server->Receive(std::chrono::seconds(5), &first_message));
+  TestMessage second_message;
+  ASSERT_TRUE(server->Receive(std::chrono::seconds(5), &second_message));
+
+  // Assert.
+  // The small message should have overtaken the bulk one.
+  EXPECT_EQ(kTestParameterString, first_message.parameter());
+  EXPECT_EQ(bulk_message.parameter(), second_message.parameter());
+}
+
+/**
+ * @test Tests that a client sending faster than the server reads eventually
+ * runs out of space instead of buffering without limit, and that everything
+ * it managed to send still arrives in order.
+ */
+TEST(MessagePassingIntegration, Backpressure) {
+  // Arrange.
+  const auto kLoopbackEndpoint = MakeLoopbackEndpoint("test_mp_backpressure");
+  auto thread_pool = std::make_shared<ThreadPool>();
+  auto server = std::make_unique<Server>(thread_pool, kLoopbackEndpoint);
+  auto client = std::make_unique<Client>(thread_pool, kLoopbackEndpoint);
+
+  ASSERT_TRUE(Retry([&]() { return client->Send(TestMessage()) > 0; }));
+  TestMessage connect_message;
+  ASSERT_TRUE(server->Receive(&connect_message));
+
+  // Far more than the queues and the connection can hold between them.
+  constexpr uint32_t kMaxMessages = 1000000;
+  const std::string kPadding(64, 'x');
+
+  // Act.
+  // Keep sending until the client reports that it's full. The server isn't
+  // reading yet, so that has to happen eventually.
+  uint32_t num_sent = 0;
+  bool got_backpressure = false;
+  while (num_sent < kMaxMessages && !got_backpressure) {
+    TestMessage message;
+    message.set_parameter(std::to_string(num_sent) + kPadding);
+    if (client->SendAsync(message, std::chrono::milliseconds(500))) {
+      ++num_sent;
+    } else {
+      got_backpressure = true;
+    }
+  }
+
+  // Now read everything.
+  std::vector<TestMessage> got_messages(num_sent);
+  for (auto& got_message : got_messages) {
+    ASSERT_TRUE(server->Receive(std::chrono::seconds(5), &got_message));
+  }
+
+  // Assert.
+  EXPECT_TRUE(got_backpressure);
+  // Everything that was accepted should have arrived in order.
+  for (uint32_t i = 0; i < num_sent; ++i) {
+    ASSERT_EQ(std::to_string(i) + kPadding, got_messages[i].parameter());
+  }
+}
+
+/**
+ * @test Tests that the client and server can talk over shared memory, with
+ * enough data to wrap around the rings several times.
+ */
+TEST(MessagePassingIntegration, SharedMemory) {
+  // Arrange.
+  const auto kShmEndpoint = MakeSharedMemoryEndpoint(
+      "/tmp/test_mp_integration_shm_" + std::to_string(getpid()) + ".sock");
+  auto thread_pool = std::make_shared<ThreadPool>();
+  auto server = std::make_unique<Server>(thread_pool, kShmEndpoint);
+  auto client = std::make_unique<Client>(thread_pool, kShmEndpoint);
+
+  ASSERT_TRUE(Retry([&]() { return client->Send(TestMessage()) > 0; }));
+  TestMessage connect_message;
+  Endpoint client_endpoint;
+  ASSERT_TRUE(server->Receive(&connect_message, &client_endpoint));
+
+  // Each message is big enough that they won't all fit in the ring at once.
+  constexpr uint16_t kNumMessages = 4096;
+  const std::string kPadding(1024, 'x');
+
+  // Act.
+  std::thread sender([&]() {
+    for (uint16_t i = 0; i < kNumMessages; ++i) {
+      TestMessage message;
+      message.set_parameter(std::to_string(i) + kPadding);
+      client->SendAsync(message);
+    }
+  });
+
+  std::vector<TestMessage> got_messages(kNumMessages);
+  for (auto& got_message : got_messages) {
+    ASSERT_TRUE(server->Receive(&got_message));
+  }
+  sender.join();
+
+  // Reply to make sure the other direction works too.
+  const auto kTestResponse = MakeTestResponse();
+  ASSERT_GT(server->Send(kTestResponse, client_endpoint), 0);
+  TestResponse got_response;
+  ASSERT_TRUE(client->Receive(&got_response));
+
+  // Assert.
+  // Everything should have arrived intact and in order.
+  for (uint16_t i = 0; i < kNumMessages; ++i) {
+    EXPECT_EQ(std::to_string(i) + kPadding, got_messages[i].parameter());
+  }
+  EXPECT_EQ(kTestResponse.parameter(), got_response.parameter());
+  // The server should know that the client used shared memory.
+  EXPECT_EQ(Transport::SHARED_MEMORY, client_endpoint.transport);
+}
+
 }  // namespace
 }  // namespace message_passing::tests
\ No newline at end of file
@@ -32,7 +32,7 @@ using wire_protocol::MessageParser;
 using wire_protocol::Serialize;
 
 /// Listening port to use for testing.
-constexpr uint16_t kServerPort = 1234;
+constexpr uint16_t kServerPort = 1242;
 /// Parameter string to use for test messages.
 const char* kTestParameterString = "a parameter string value";
 /// Server endpoint to use for testing.
@@ -352,6 +352,67 @@ TEST(Server, ReceiveInterleaved) {
   close(kClient2Fd);
 }
 
+/**
+ * @test Tests that a partial message from one client does not hold up
+ * complete messages from other clients.
+ */
+TEST(Server, ReceiveNotBlockedByPartialMessage) {
+  // Arrange.
+  auto config = MakeConfig();
+
+  // Create two new clients.
+  const int kClient1Fd = Connect(kTestEndpoint);
+  const int kClient2Fd = Connect(kTestEndpoint);
+
+  // Use different messages so we can tell which client they came from.
+  TestMessage slow_message;
+  slow_message.set_parameter("slow client");
+  std::vector<uint8_t> slow_serialized;
+  ASSERT_TRUE(Serialize(slow_message, &slow_serialized));
+  TestMessage fast_message;
+  fast_message.set_parameter("fast client");
+  std::vector<uint8_t> fast_serialized;
+  ASSERT_TRUE(Serialize(fast_message, &fast_serialized));
+
+  // The first client only sends part of its message.
+  const size_t kFirstHalfSize = slow_serialized.size() / 2;
+  const size_t kSecondHalfSize = slow_serialized.size() - kFirstHalfSize;
+  ASSERT_EQ(kFirstHalfSize,
+            send(kClient1Fd, slow_serialized.data(), kFirstHalfSize, 0));
+  // Give the server a chance to read the partial message first.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // The second client sends its entire message.
+  ASSERT_EQ(fast_serialized.size(),
+            send(kClient2Fd, fast_serialized.data(), fast_serialized.size(),
+                 0));
+
+  // Act.
+  // We should get the complete message without waiting for the first client.
+  TestMessage received_message_1;
+  const bool kReceiveResult1 = config.server->Receive(
+      std::chrono::seconds(5), &received_message_1);
+
+  // Now let the first client finish.
+  ASSERT_EQ(kSecondHalfSize,
+            send(kClient1Fd, slow_serialized.data() + kFirstHalfSize,
+                 kSecondHalfSize, 0));
+  TestMessage received_message_2;
+  const bool kReceiveResult2 = config.server->Receive(
+      std::chrono::seconds(5), &received_message_2);
+
+  // Assert.
+  // It should have received the second client's message first.
+  EXPECT_TRUE(kReceiveResult1);
+  EXPECT_EQ(fast_message.parameter(), received_message_1.parameter());
+  // It should then have received the first client's message.
+  EXPECT_TRUE(kReceiveResult2);
+  EXPECT_EQ(slow_message.parameter(), received_message_2.parameter());
+
+  // Cleanup the sockets.
+  close(kClient1Fd);
+  close(kClient2Fd);
+}
+
 /**
  * @test Tests that we can send a single message.
  */
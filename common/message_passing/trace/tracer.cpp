@@ -0,0 +1,175 @@
+#include "tracer.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <loguru.hpp>
+
+namespace message_passing {
+namespace {
+
+/**
+ * @brief The message that a thread is currently handling.
+ */
+struct HandlerState {
+  /// The tracer that the handler stage will be recorded to.
+  Tracer* tracer = nullptr;
+  /// The trace of the message, or 0 if it isn't handling a traced message.
+  uint64_t trace_id = 0;
+  /// When the handler started.
+  int64_t start_us = 0;
+};
+
+/// What the current thread is handling.
+thread_local HandlerState g_handler_state{};
+
+/**
+ * @param stage A stage.
+ * @return The name to show for the stage.
+ */
+const char* GetStageName(TraceStage stage) {
+  switch (stage) {
+    case TraceStage::ENQUEUE:
+      return "enqueue";
+    case TraceStage::SEND_QUEUE:
+      return "send_queue";
+    case TraceStage::SEND:
+      return "send";
+    case TraceStage::NETWORK:
+      return "network";
+    case TraceStage::RECEIVE:
+      return "receive";
+    case TraceStage::RECEIVE_QUEUE:
+      return "receive_queue";
+    case TraceStage::PARSE:
+      return "parse";
+    case TraceStage::HANDLER:
+      return "handler";
+  }
+
+  return "unknown";
+}
+
+}  // namespace
+
+void Tracer::Start(uint32_t sample_interval) {
+  sample_interval_ = sample_interval;
+  enabled_ = true;
+}
+
+void Tracer::Stop() { enabled_ = false; }
+
+uint64_t Tracer::StartTrace() {
+  if (!IsEnabled()) {
+    return 0;
+  }
+  const uint32_t kInterval = sample_interval_;
+  if (kInterval == 0 || num_considered_++ % kInterval != 0) {
+    // Not sampled.
+    return 0;
+  }
+
+  // The process ID goes in the top half, so that traces from different
+  // processes don't collide. The bottom half is never 0.
+  const uint32_t kTraceNumber = ++num_traces_;
+  return (static_cast<uint64_t>(getpid()) << 32) |
+         (kTraceNumber == 0 ? ++num_traces_ : kTraceNumber);
+}
+
+void Tracer::Record(uint64_t trace_id, TraceStage stage, int64_t start_us,
+                    int64_t end_us) {
+  if (trace_id == 0 || !IsEnabled()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (spans_.size() >= kMaxSpans) {
+    ++num_dropped_;
+    return;
+  }
+  spans_.push_back({trace_id, stage, start_us, end_us});
+}
+
+void Tracer::EnterHandler(uint64_t trace_id) {
+  LeaveHandler();
+  if (trace_id != 0 && IsEnabled()) {
+    g_handler_state = {this, trace_id, Now()};
+  }
+}
+
+uint64_t Tracer::LeaveHandler() {
+  HandlerState& state = g_handler_state;
+  if (state.tracer != this || state.trace_id == 0) {
+    return 0;
+  }
+
+  const uint64_t kTraceId = state.trace_id;
+  Record(kTraceId, TraceStage::HANDLER, state.start_us, Now());
+  state = {};
+  return kTraceId;
+}
+
+std::vector<Tracer::Span> Tracer::GetSpans() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return spans_;
+}
+
+size_t Tracer::GetNumDropped() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_dropped_;
+}
+
+void Tracer::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  spans_.clear();
+  num_dropped_ = 0;
+}
+
+void Tracer::WriteChromeTrace(std::ostream& out) {
+  const auto kSpans = GetSpans();
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto& kSpan : kSpans) {
+    if (!first) {
+      out << ",";
+    }
+    first = false;
+
+    // Rows are keyed by the trace ID rather than by who recorded the span, so
+    // that exports from different processes merge into the same rows.
+    out << "\n{\"name\":\"" << GetStageName(kSpan.stage)
+        << "\",\"cat\":\"message_passing\",\"ph\":\"X\",\"ts\":"
+        << kSpan.start_us << ",\"dur\":" << kSpan.end_us - kSpan.start_us
+        << ",\"pid\":" << (kSpan.trace_id >> 32)
+        << ",\"tid\":" << (kSpan.trace_id & 0xFFFFFFFF)
+        << ",\"args\":{\"trace_id\":\"" << std::hex << kSpan.trace_id
+        << std::dec << "\",\"recorded_by\":" << getpid() << "}}";
+  }
+  out << "\n]}\n";
+}
+
+bool Tracer::WriteChromeTrace(const std::string& path) {
+  std::ofstream out(path);
+  if (!out) {
+    LOG_S(ERROR) << "Could not open " << path << " to write the trace.";
+    return false;
+  }
+
+  WriteChromeTrace(out);
+  return static_cast<bool>(out);
+}
+
+int64_t Tracer::Now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+Tracer& Tracer::Default() {
+  static auto* tracer = new Tracer();
+  return *tracer;
+}
+
+}  // namespace message_passing
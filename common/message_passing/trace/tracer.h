@@ -0,0 +1,191 @@
+#ifndef CSCI6780_MESSAGE_PASSING_TRACER_H
+#define CSCI6780_MESSAGE_PASSING_TRACER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace message_passing {
+
+/**
+ * @brief The stages that a message goes through on its way from one node to
+ *    another.
+ */
+enum class TraceStage {
+  /// Serializing the message.
+  ENQUEUE,
+  /// Waiting for space on the send queue, and then for the sender task to
+  /// take the message off of it.
+  SEND_QUEUE,
+  /// Writing the message to the connection, including any time spent
+  /// waiting for the connection to accept more data.
+  SEND,
+  /// From when the sender started writing the message until the receiver
+  /// read the end of it.
+  NETWORK,
+  /// Splitting the received data into frames and queueing them.
+  RECEIVE,
+  /// Waiting on the receive queue for somebody to call `Receive()`.
+  RECEIVE_QUEUE,
+  /// Parsing the protobuf message.
+  PARSE,
+  /// From when `Receive()` returned the message until the same thread sent
+  /// something or went back to receiving.
+  HANDLER,
+};
+
+/**
+ * @brief Records how long traced messages spend in each stage, so that a
+ *    slow request can be broken down afterwards.
+ * @details Only a sample of the messages is traced. The node that sends a
+ *    message decides whether to trace it, and if so, the trace ID and the
+ *    send time go along with it in the frame header. Each node records the
+ *    stages that happen on its end, so a trace that crosses processes can be
+ *    put back together by loading the exports from every process together.
+ *
+ *    Replies that a server sends carry on the trace of the message that it
+ *    is handling, so a whole request and its response show up as one trace.
+ *
+ *    Everything here is thread-safe. When tracing is stopped, recording is a
+ *    single atomic load.
+ */
+class Tracer {
+ public:
+  /// Maximum number of spans to keep. Once this many have been recorded,
+  /// new ones are dropped until the tracer is cleared.
+  static constexpr size_t kMaxSpans = 1 << 20;
+
+  /**
+   * @brief A stage that one message spent some time in.
+   */
+  struct Span {
+    /// The trace that the message belongs to.
+    uint64_t trace_id;
+    /// Which stage this was.
+    TraceStage stage;
+    /// When the stage started, in microseconds since the Unix epoch.
+    int64_t start_us;
+    /// When the stage ended, in microseconds since the Unix epoch.
+    int64_t end_us;
+  };
+
+  /**
+   * @brief Starts recording.
+   * @param sample_interval Traces every this many messages that this process
+   *    sends. If it is 0, messages from this process aren't traced, but the
+   *    stages of traced messages from other processes still are.
+   */
+  void Start(uint32_t sample_interval);
+
+  /**
+   * @brief Stops recording. Spans that were already recorded are kept.
+   */
+  void Stop();
+
+  /**
+   * @return True if the tracer is recording.
+   */
+  [[nodiscard]] bool IsEnabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Decides whether to trace a new message.
+   * @return The trace ID to use for the message, or 0 if it shouldn't be
+   *    traced.
+   */
+  uint64_t StartTrace();
+
+  /**
+   * @brief Records a stage of a traced message. Does nothing if the tracer
+   *    isn't recording, or the message isn't traced.
+   * @param trace_id The trace that the message belongs to.
+   * @param stage The stage.
+   * @param start_us When the stage started.
+   * @param end_us When the stage ended.
+   */
+  void Record(uint64_t trace_id, TraceStage stage, int64_t start_us,
+              int64_t end_us);
+
+  /**
+   * @brief Marks the calling thread as handling a traced message.
+   * @param trace_id The trace that the message belongs to. If it is 0, this
+   *    just ends the current handler.
+   */
+  void EnterHandler(uint64_t trace_id);
+
+  /**
+   * @brief Ends the handler stage of the message that the calling thread is
+   *    handling, if any.
+   * @return The trace ID of that message, or 0 if there wasn't one.
+   */
+  uint64_t LeaveHandler();
+
+  /**
+   * @return A copy of everything that has been recorded so far.
+   */
+  std::vector<Span> GetSpans();
+
+  /**
+   * @return The number of spans that were dropped because the tracer was
+   *    full.
+   */
+  size_t GetNumDropped();
+
+  /**
+   * @brief Throws away everything that has been recorded.
+   */
+  void Clear();
+
+  /**
+   * @brief Exports everything that has been recorded in the Chrome trace
+   *    event format, which can be loaded into `chrome://tracing` or
+   *    Perfetto. Each trace gets its own row.
+   * @param out Where to write the JSON.
+   */
+  void WriteChromeTrace(std::ostream& out);
+
+  /**
+   * @brief Same as the other `WriteChromeTrace()`, but writes to a file.
+   * @param path The file to write.
+   * @return True if it succeeded, false if the file couldn't be written.
+   */
+  bool WriteChromeTrace(const std::string& path);
+
+  /**
+   * @return The current time, in microseconds since the Unix epoch. Wall
+   *    clock time is used so that spans from different processes on the
+   *    same host line up.
+   */
+  static int64_t Now();
+
+  /**
+   * @return The tracer that nodes record to.
+   */
+  static Tracer& Default();
+
+ private:
+  /// Whether we are recording.
+  std::atomic<bool> enabled_ = false;
+  /// How often to trace messages that we send. 0 means never.
+  std::atomic<uint32_t> sample_interval_ = 0;
+  /// Counts messages that were considered for tracing.
+  std::atomic<uint64_t> num_considered_ = 0;
+  /// Used to make trace IDs.
+  std::atomic<uint32_t> num_traces_ = 0;
+
+  /// Protects the spans.
+  std::mutex mutex_{};
+  /// Everything that has been recorded.
+  std::vector<Span> spans_{};
+  /// Number of spans that didn't fit.
+  size_t num_dropped_ = 0;
+};
+
+}  // namespace message_passing
+
+#endif  // CSCI6780_MESSAGE_PASSING_TRACER_H
@@ -0,0 +1,61 @@
+#ifndef CSCI6780_MESSAGE_PASSING_CONNECTION_INTERFACE_H
+#define CSCI6780_MESSAGE_PASSING_CONNECTION_INTERFACE_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace message_passing {
+
+/**
+ * @brief Interface for the byte stream underneath a connection between two
+ *  nodes. Framing is handled above this level, so implementations only have
+ *  to move bytes in order.
+ * @details Each connection is used by exactly one sending thread and one
+ *  receiving thread at a time.
+ */
+class IConnection {
+ public:
+  virtual ~IConnection() = default;
+
+  /**
+   * @brief Sends data, which might be split over several buffers. Like
+   *  `sendmsg()`, it might only send part of the data.
+   * @param buffers The buffers to send.
+   * @param num_buffers The number of buffers.
+   * @return The number of bytes sent, or -1 on failure, with `errno` set.
+   *  `EAGAIN` means that it timed out and can be retried, and `EINTR` means
+   *  that it was interrupted.
+   */
+  virtual ssize_t Send(const struct iovec* buffers, size_t num_buffers) = 0;
+
+  /**
+   * @brief Receives data. Like `recv()`, it will give up after a short
+   *  timeout so that the caller can check whether it's been cancelled.
+   * @param buffer The buffer to receive into.
+   * @param size The size of the buffer.
+   * @return The number of bytes received, 0 if the other end disconnected,
+   *  or -1 on failure, with `errno` set. `EAGAIN` means that it timed out,
+   *  and `EINTR` means that it was interrupted.
+   */
+  virtual ssize_t Receive(uint8_t* buffer, size_t size) = 0;
+
+  /**
+   * @brief Wakes up any `Send()` or `Receive()` that is waiting on this
+   *  connection. From then on, they fail with `EINTR` instead of waiting, so
+   *  this is only meant for tearing the connection down.
+   */
+  virtual void Interrupt() = 0;
+
+  /**
+   * @return The file descriptor of the socket that this connection was made
+   *  on. The caller is responsible for closing it.
+   */
+  [[nodiscard]] virtual int GetFd() const = 0;
+};
+
+}  // namespace message_passing
+
+#endif  // CSCI6780_MESSAGE_PASSING_CONNECTION_INTERFACE_H
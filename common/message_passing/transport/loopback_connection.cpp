@@ -0,0 +1,217 @@
+#include "loopback_connection.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <loguru.hpp>
+#include <unordered_map>
+#include <utility>
+
+namespace message_passing {
+namespace {
+
+/// How long to wait before timing out, to match the socket timeout.
+constexpr auto kTimeout = std::chrono::seconds(1);
+
+/**
+ * @brief Keeps track of all the names that are currently being listened on.
+ */
+struct ListenerRegistry {
+  /// Maps names to the listener for that name.
+  std::unordered_map<std::string, LoopbackListener*> listeners{};
+  /// Protects access to `listeners`. It is held while accept callbacks run,
+  /// so that listeners can't go away in the middle of one.
+  std::mutex mutex{};
+};
+
+/**
+ * @return The registry for this process.
+ */
+ListenerRegistry& GetRegistry() {
+  static ListenerRegistry registry;
+  return registry;
+}
+
+}  // namespace
+
+std::shared_ptr<LoopbackConnection> LoopbackConnection::Connect(
+    const std::string& name) {
+  auto& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  const auto kNameAndListener = registry.listeners.find(name);
+  if (kNameAndListener == registry.listeners.end()) {
+    LOG_S(ERROR) << "Nobody is listening on loopback endpoint " << name << ".";
+    return nullptr;
+  }
+
+  const int kClientFd = eventfd(0, EFD_CLOEXEC);
+  const int kServerFd = eventfd(0, EFD_CLOEXEC);
+  if (kClientFd < 0 || kServerFd < 0) {
+    LOG_S(ERROR) << "Failed to create placeholder FDs: "
+                 << std::strerror(errno);
+    close(kClientFd);
+    close(kServerFd);
+    return nullptr;
+  }
+
+  auto client_to_server = std::make_shared<Pipe>();
+  auto server_to_client = std::make_shared<Pipe>();
+  // The constructor is private, so we can't use make_shared().
+  std::shared_ptr<LoopbackConnection> client_end(
+      new LoopbackConnection(client_to_server, server_to_client, kClientFd));
+  std::shared_ptr<LoopbackConnection> server_end(
+      new LoopbackConnection(server_to_client, client_to_server, kServerFd));
+
+  kNameAndListener->second->callback_(std::move(server_end));
+  return client_end;
+}
+
+LoopbackConnection::LoopbackConnection(std::shared_ptr<Pipe> send_pipe,
+                                       std::shared_ptr<Pipe> receive_pipe,
+                                       int placeholder_fd)
+    : send_pipe_(std::move(send_pipe)),
+      receive_pipe_(std::move(receive_pipe)),
+      placeholder_fd_(placeholder_fd) {}
+
+LoopbackConnection::~LoopbackConnection() {
+  // Let the other end know that we're gone.
+  Close(send_pipe_.get());
+  Close(receive_pipe_.get());
+}
+
+ssize_t LoopbackConnection::Send(const struct iovec* buffers,
+                                 size_t num_buffers) {
+  std::unique_lock<std::mutex> lock(send_pipe_->mutex);
+
+  // Wait for some space.
+  const bool kReady = send_pipe_->writable.wait_for(lock, kTimeout, [this] {
+    return send_pipe_->closed || interrupted_ ||
+           send_pipe_->data.size() - send_pipe_->read_offset < kPipeCapacity;
+  });
+  if (send_pipe_->closed) {
+    errno = EPIPE;
+    return -1;
+  }
+  if (send_pipe_->data.size() - send_pipe_->read_offset >= kPipeCapacity) {
+    // Either we timed out, or we were interrupted.
+    errno = kReady ? EINTR : EAGAIN;
+    return -1;
+  }
+
+  // Copy as much as will fit.
+  size_t space =
+      kPipeCapacity - (send_pipe_->data.size() - send_pipe_->read_offset);
+  size_t num_sent = 0;
+  for (size_t i = 0; i < num_buffers && space > 0; ++i) {
+    const auto* kData = static_cast<const uint8_t*>(buffers[i].iov_base);
+    const size_t kToCopy = std::min(space, buffers[i].iov_len);
+    send_pipe_->data.insert(send_pipe_->data.end(), kData, kData + kToCopy);
+    num_sent += kToCopy;
+    space -= kToCopy;
+  }
+
+  lock.unlock();
+  send_pipe_->readable.notify_one();
+  return static_cast<ssize_t>(num_sent);
+}
+
+ssize_t LoopbackConnection::Receive(uint8_t* buffer, size_t size) {
+  std::unique_lock<std::mutex> lock(receive_pipe_->mutex);
+
+  // Wait for some data.
+  const bool kReady =
+      receive_pipe_->readable.wait_for(lock, kTimeout, [this] {
+        return receive_pipe_->closed || interrupted_ ||
+               receive_pipe_->read_offset < receive_pipe_->data.size();
+      });
+  const size_t kAvailable =
+      receive_pipe_->data.size() - receive_pipe_->read_offset;
+  if (kAvailable == 0) {
+    if (receive_pipe_->closed) {
+      // Like a socket, we return 0 once everything has been read.
+      return 0;
+    }
+    // Either we timed out, or we were interrupted.
+    errno = kReady ? EINTR : EAGAIN;
+    return -1;
+  }
+
+  const size_t kToCopy = std::min(size, kAvailable);
+  std::memcpy(buffer, receive_pipe_->data.data() + receive_pipe_->read_offset,
+              kToCopy);
+  receive_pipe_->read_offset += kToCopy;
+
+  // Reclaim the space at the front once it's worth it.
+  if (receive_pipe_->read_offset == receive_pipe_->data.size()) {
+    receive_pipe_->data.clear();
+    receive_pipe_->read_offset = 0;
+  } else if (receive_pipe_->read_offset > kPipeCapacity / 2) {
+    receive_pipe_->data.erase(
+        receive_pipe_->data.begin(),
+        receive_pipe_->data.begin() +
+            static_cast<std::ptrdiff_t>(receive_pipe_->read_offset));
+    receive_pipe_->read_offset = 0;
+  }
+
+  lock.unlock();
+  receive_pipe_->writable.notify_one();
+  return static_cast<ssize_t>(kToCopy);
+}
+
+void LoopbackConnection::Interrupt() {
+  interrupted_ = true;
+
+  // Take the locks, so that nobody can miss the notification between
+  // checking the flag and starting to wait.
+  for (Pipe* pipe : {send_pipe_.get(), receive_pipe_.get()}) {
+    {
+      std::lock_guard<std::mutex> lock(pipe->mutex);
+    }
+    pipe->readable.notify_all();
+    pipe->writable.notify_all();
+  }
+}
+
+int LoopbackConnection::GetFd() const { return placeholder_fd_; }
+
+void LoopbackConnection::Close(Pipe* pipe) {
+  {
+    std::lock_guard<std::mutex> lock(pipe->mutex);
+    pipe->closed = true;
+  }
+  pipe->readable.notify_all();
+  pipe->writable.notify_all();
+}
+
+std::unique_ptr<LoopbackListener> LoopbackListener::Listen(
+    const std::string& name, AcceptCallback callback) {
+  auto& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  if (registry.listeners.find(name) != registry.listeners.end()) {
+    LOG_S(ERROR) << "Loopback endpoint " << name << " is already in use.";
+    return nullptr;
+  }
+
+  // The constructor is private, so we can't use make_unique().
+  std::unique_ptr<LoopbackListener> listener(
+      new LoopbackListener(name, std::move(callback)));
+  registry.listeners[name] = listener.get();
+  return listener;
+}
+
+LoopbackListener::LoopbackListener(std::string name, AcceptCallback callback)
+    : name_(std::move(name)), callback_(std::move(callback)) {}
+
+LoopbackListener::~LoopbackListener() {
+  auto& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.listeners.erase(name_);
+}
+
+}  // namespace message_passing
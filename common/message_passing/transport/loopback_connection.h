@@ -0,0 +1,137 @@
+#ifndef CSCI6780_MESSAGE_PASSING_LOOPBACK_CONNECTION_H
+#define CSCI6780_MESSAGE_PASSING_LOOPBACK_CONNECTION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "connection_interface.h"
+
+namespace message_passing {
+
+/**
+ * @brief Connection between two nodes in the same process, which passes data
+ *  through memory without involving the kernel at all. This is mostly useful
+ *  for measuring the overhead of the framework itself.
+ * @details Each direction is a bounded byte pipe protected by a mutex. The
+ *  connection is closed when either end is destroyed. It still has a file
+ *  descriptor so that it can be managed like the other connections, but the
+ *  descriptor is just a placeholder that is never read or written.
+ */
+class LoopbackConnection : public IConnection {
+ public:
+  /// Maximum number of bytes that can be buffered in each direction.
+  static constexpr size_t kPipeCapacity = 1 << 20;
+
+  /**
+   * @brief Connects to a loopback listener in this process.
+   * @param name The name that the listener was registered with.
+   * @return The connection, or nullptr if nobody is listening on that name.
+   */
+  static std::shared_ptr<LoopbackConnection> Connect(const std::string& name);
+
+  ~LoopbackConnection() override;
+
+  ssize_t Send(const struct iovec* buffers, size_t num_buffers) final;
+  ssize_t Receive(uint8_t* buffer, size_t size) final;
+  void Interrupt() final;
+  [[nodiscard]] int GetFd() const final;
+
+ private:
+  /**
+   * @brief One direction of the connection.
+   */
+  struct Pipe {
+    /// Data that has been sent but not yet received.
+    std::vector<uint8_t> data{};
+    /// Offset of the first byte in `data` that hasn't been received.
+    size_t read_offset = 0;
+    /// Set once either end goes away.
+    bool closed = false;
+
+    /// Protects everything in the pipe.
+    std::mutex mutex{};
+    /// Notified when data is added, or the pipe is closed.
+    std::condition_variable readable{};
+    /// Notified when data is removed, or the pipe is closed.
+    std::condition_variable writable{};
+  };
+
+  /**
+   * @param send_pipe The pipe we write to.
+   * @param receive_pipe The pipe we read from.
+   * @param placeholder_fd The file descriptor to report from `GetFd()`.
+   */
+  LoopbackConnection(std::shared_ptr<Pipe> send_pipe,
+                     std::shared_ptr<Pipe> receive_pipe, int placeholder_fd);
+
+  /**
+   * @brief Marks a pipe as closed and wakes up anyone waiting on it.
+   * @param pipe The pipe.
+   */
+  static void Close(Pipe* pipe);
+
+  /// The pipe we write to.
+  std::shared_ptr<Pipe> send_pipe_;
+  /// The pipe we read from.
+  std::shared_ptr<Pipe> receive_pipe_;
+  /// Set once we're interrupted. Only affects this end.
+  std::atomic<bool> interrupted_ = false;
+  /// Placeholder file descriptor.
+  int placeholder_fd_;
+};
+
+/**
+ * @brief Accepts loopback connections made to a particular name. The name is
+ *  registered for as long as this object exists.
+ */
+class LoopbackListener {
+ public:
+  /**
+   * @brief Callback that gets run whenever a new client connects. It is
+   *  called on the connecting thread, with the server end of the connection.
+   */
+  using AcceptCallback =
+      std::function<void(std::shared_ptr<LoopbackConnection>)>;
+
+  /**
+   * @brief Starts listening on a name.
+   * @param name The name to listen on.
+   * @param callback The callback to run for new connections.
+   * @return The listener, or nullptr if the name is already taken.
+   */
+  static std::unique_ptr<LoopbackListener> Listen(const std::string& name,
+                                                  AcceptCallback callback);
+
+  /**
+   * @brief Stops listening. No callbacks will be running once this returns.
+   */
+  ~LoopbackListener();
+
+  LoopbackListener(const LoopbackListener& other) = delete;
+  LoopbackListener& operator=(const LoopbackListener& other) = delete;
+
+ private:
+  /**
+   * @param name The name to listen on.
+   * @param callback The callback to run for new connections.
+   */
+  LoopbackListener(std::string name, AcceptCallback callback);
+
+  /// The name we are listening on.
+  std::string name_;
+  /// Callback to run for new connections.
+  AcceptCallback callback_;
+
+  friend class LoopbackConnection;
+};
+
+}  // namespace message_passing
+
+#endif  // CSCI6780_MESSAGE_PASSING_LOOPBACK_CONNECTION_H
@@ -0,0 +1,414 @@
+#include "shm_connection.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <loguru.hpp>
+#include <new>
+
+namespace message_passing {
+namespace {
+
+/// Number of doorbells that each connection uses.
+constexpr size_t kNumEventFds = 4;
+/// How long to wait on a doorbell before timing out, in milliseconds.
+constexpr int kDoorbellTimeoutMs = 1000;
+/// How many times to retry receiving the shared memory from the server.
+constexpr uint8_t kHandshakeRetries = 5;
+
+// The rings are shared between processes, so the atomics must not fall back
+// to using locks.
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Shared memory rings need lock-free 64-bit atomics.");
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "Shared memory rings need lock-free 32-bit atomics.");
+
+/**
+ * @brief Closes a set of file descriptors, ignoring any that are invalid.
+ * @param fds The file descriptors.
+ * @param num_fds The number of file descriptors.
+ */
+void CloseAll(const int* fds, size_t num_fds) {
+  for (size_t i = 0; i < num_fds; ++i) {
+    if (fds[i] >= 0) {
+      close(fds[i]);
+    }
+  }
+}
+
+}  // namespace
+
+/// The positions only ever increase, so the amount of data in the ring is
+/// simply the difference between them. They are kept on separate cache lines
+/// so that the reader and writer don't fight over them.
+struct ShmConnection::RingHeader {
+  /// Total number of bytes ever written.
+  alignas(64) std::atomic<uint64_t> write_position{0};
+  /// Set when the reader is about to wait for data.
+  std::atomic<uint32_t> reader_waiting{0};
+
+  /// Total number of bytes ever read.
+  alignas(64) std::atomic<uint64_t> read_position{0};
+  /// Set when the writer is about to wait for space.
+  std::atomic<uint32_t> writer_waiting{0};
+};
+
+namespace {
+
+/// Space reserved for each ring header, so the data stays nicely aligned.
+constexpr size_t kRingHeaderSize = 256;
+/// Space taken up by each ring, including the header.
+constexpr size_t kRingStride = kRingHeaderSize + ShmConnection::kRingSize;
+/// Total size of the shared memory for a connection.
+constexpr size_t kMemorySize = 2 * kRingStride;
+
+static_assert((ShmConnection::kRingSize & (ShmConnection::kRingSize - 1)) == 0,
+              "Ring size must be a power of two.");
+
+}  // namespace
+
+std::shared_ptr<ShmConnection> ShmConnection::Accept(int socket_fd) {
+  // Create the shared memory.
+  const int kMemoryFd = memfd_create("message_passing", MFD_CLOEXEC);
+  if (kMemoryFd < 0) {
+    LOG_S(ERROR) << "memfd_create() failed: " << std::strerror(errno);
+    return nullptr;
+  }
+  if (ftruncate(kMemoryFd, kMemorySize) < 0) {
+    LOG_S(ERROR) << "ftruncate() failed: " << std::strerror(errno);
+    close(kMemoryFd);
+    return nullptr;
+  }
+
+  // Create the doorbells.
+  int event_fds[kNumEventFds];
+  for (auto& event_fd : event_fds) {
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+  if (std::any_of(std::begin(event_fds), std::end(event_fds),
+                  [](int fd) { return fd < 0; })) {
+    LOG_S(ERROR) << "eventfd() failed: " << std::strerror(errno);
+    CloseAll(event_fds, kNumEventFds);
+    close(kMemoryFd);
+    return nullptr;
+  }
+
+  auto connection = Map(socket_fd, kMemoryFd, event_fds, true, true);
+  if (connection == nullptr) {
+    CloseAll(event_fds, kNumEventFds);
+    close(kMemoryFd);
+    return nullptr;
+  }
+
+  // Send everything to the client. At least one byte of real data has to go
+  // along with the file descriptors.
+  int fds_to_send[kNumEventFds + 1] = {kMemoryFd};
+  std::copy(std::begin(event_fds), std::end(event_fds), fds_to_send + 1);
+
+  uint8_t payload = 0;
+  struct iovec payload_buffer = {&payload, sizeof(payload)};
+  union {
+    char buffer[CMSG_SPACE(sizeof(fds_to_send))];
+    struct cmsghdr align;
+  } control{};
+
+  struct msghdr message {};
+  message.msg_iov = &payload_buffer;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = sizeof(control.buffer);
+
+  struct cmsghdr* control_header = CMSG_FIRSTHDR(&message);
+  control_header->cmsg_level = SOL_SOCKET;
+  control_header->cmsg_type = SCM_RIGHTS;
+  control_header->cmsg_len = CMSG_LEN(sizeof(fds_to_send));
+  std::memcpy(CMSG_DATA(control_header), fds_to_send, sizeof(fds_to_send));
+
+  const ssize_t kSendResult = sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+  // The mapping keeps the memory alive, so we don't need this anymore.
+  close(kMemoryFd);
+  if (kSendResult < 0) {
+    LOG_S(ERROR) << "Failed to send shared memory to client: "
+                 << std::strerror(errno);
+    return nullptr;
+  }
+
+  return connection;
+}
+
+std::shared_ptr<ShmConnection> ShmConnection::Connect(int socket_fd) {
+  int received_fds[kNumEventFds + 1];
+  std::fill(std::begin(received_fds), std::end(received_fds), -1);
+
+  uint8_t payload;
+  struct iovec payload_buffer = {&payload, sizeof(payload)};
+  union {
+    char buffer[CMSG_SPACE(sizeof(received_fds))];
+    struct cmsghdr align;
+  } control{};
+
+  struct msghdr message {};
+  message.msg_iov = &payload_buffer;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = sizeof(control.buffer);
+
+  // The socket has a receive timeout, so give the server a few chances.
+  ssize_t receive_result = -1;
+  for (uint8_t num_retries = 0; num_retries < kHandshakeRetries;
+       ++num_retries) {
+    receive_result = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+    if (receive_result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      break;
+    }
+  }
+  if (receive_result <= 0) {
+    LOG_S(ERROR) << "Failed to receive shared memory from server.";
+    return nullptr;
+  }
+
+  struct cmsghdr* control_header = CMSG_FIRSTHDR(&message);
+  if (control_header == nullptr || control_header->cmsg_level != SOL_SOCKET ||
+      control_header->cmsg_type != SCM_RIGHTS ||
+      control_header->cmsg_len != CMSG_LEN(sizeof(received_fds))) {
+    LOG_S(ERROR) << "Server did not send shared memory.";
+    if (control_header != nullptr && control_header->cmsg_type == SCM_RIGHTS) {
+      // Don't leak whatever it did send.
+      const size_t kNumReceived =
+          (control_header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      std::memcpy(received_fds, CMSG_DATA(control_header),
+                  std::min(kNumReceived, kNumEventFds + 1) * sizeof(int));
+      CloseAll(received_fds, kNumEventFds + 1);
+    }
+    return nullptr;
+  }
+  std::memcpy(received_fds, CMSG_DATA(control_header), sizeof(received_fds));
+
+  auto connection =
+      Map(socket_fd, received_fds[0], received_fds + 1, false, false);
+  close(received_fds[0]);
+  if (connection == nullptr) {
+    CloseAll(received_fds + 1, kNumEventFds);
+  }
+
+  return connection;
+}
+
+std::shared_ptr<ShmConnection> ShmConnection::Map(int socket_fd,
+                                                  int memory_fd,
+                                                  const int* event_fds,
+                                                  bool is_server,
+                                                  bool initialize) {
+  void* memory = mmap(nullptr, kMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      memory_fd, 0);
+  if (memory == MAP_FAILED) {
+    LOG_S(ERROR) << "mmap() failed: " << std::strerror(errno);
+    return nullptr;
+  }
+
+  // The first ring carries data from the client to the server, and the
+  // second carries data from the server to the client.
+  auto* base = static_cast<uint8_t*>(memory);
+  Ring rings[2];
+  for (size_t i = 0; i < 2; ++i) {
+    uint8_t* ring_start = base + i * kRingStride;
+    rings[i].header = initialize ? new (ring_start) RingHeader()
+                                 : reinterpret_cast<RingHeader*>(ring_start);
+    rings[i].data = ring_start + kRingHeaderSize;
+    rings[i].data_ready_fd = event_fds[2 * i];
+    rings[i].space_ready_fd = event_fds[2 * i + 1];
+  }
+
+  const Ring& kSendRing = is_server ? rings[1] : rings[0];
+  const Ring& kReceiveRing = is_server ? rings[0] : rings[1];
+  return std::shared_ptr<ShmConnection>(
+      new ShmConnection(socket_fd, memory, kSendRing, kReceiveRing));
+}
+
+ShmConnection::ShmConnection(int socket_fd, void* memory, Ring send_ring,
+                             Ring receive_ring)
+    : socket_fd_(socket_fd),
+      memory_(memory),
+      send_ring_(send_ring),
+      receive_ring_(receive_ring) {}
+
+ShmConnection::~ShmConnection() {
+  const int kEventFds[kNumEventFds] = {
+      send_ring_.data_ready_fd, send_ring_.space_ready_fd,
+      receive_ring_.data_ready_fd, receive_ring_.space_ready_fd};
+  CloseAll(kEventFds, kNumEventFds);
+  munmap(memory_, kMemorySize);
+}
+
+ssize_t ShmConnection::Send(const struct iovec* buffers, size_t num_buffers) {
+  size_t total_size = 0;
+  for (size_t i = 0; i < num_buffers; ++i) {
+    total_size += buffers[i].iov_len;
+  }
+  if (total_size == 0) {
+    return 0;
+  }
+
+  RingHeader* header = send_ring_.header;
+  while (true) {
+    const uint64_t kWritePosition =
+        header->write_position.load(std::memory_order_relaxed);
+    const uint64_t kReadPosition =
+        header->read_position.load(std::memory_order_acquire);
+    const size_t kFreeSpace = kRingSize - (kWritePosition - kReadPosition);
+
+    if (kFreeSpace > 0) {
+      // Copy as much as fits, wrapping around the end of the ring.
+      const size_t kNumToSend = std::min(kFreeSpace, total_size);
+      size_t num_copied = 0;
+      for (size_t i = 0; i < num_buffers && num_copied < kNumToSend; ++i) {
+        const auto* source = static_cast<const uint8_t*>(buffers[i].iov_base);
+        size_t remaining = std::min(buffers[i].iov_len, kNumToSend - num_copied);
+        while (remaining > 0) {
+          const size_t kOffset = (kWritePosition + num_copied) & (kRingSize - 1);
+          const size_t kChunk = std::min(remaining, kRingSize - kOffset);
+          std::memcpy(send_ring_.data + kOffset, source, kChunk);
+          source += kChunk;
+          remaining -= kChunk;
+          num_copied += kChunk;
+        }
+      }
+
+      header->write_position.store(kWritePosition + kNumToSend,
+                                   std::memory_order_seq_cst);
+      // Only bother the reader if it's asleep.
+      if (header->reader_waiting.load(std::memory_order_seq_cst) != 0) {
+        RingDoorbell(send_ring_.data_ready_fd);
+      }
+      return static_cast<ssize_t>(kNumToSend);
+    }
+
+    // The ring is full. Let the reader know we're waiting, then check again
+    // in case it made space in the meantime.
+    header->writer_waiting.store(1, std::memory_order_seq_cst);
+    if (header->read_position.load(std::memory_order_seq_cst) !=
+        kReadPosition) {
+      header->writer_waiting.store(0, std::memory_order_relaxed);
+      continue;
+    }
+
+    const auto kWaitResult = WaitForDoorbell(send_ring_.space_ready_fd);
+    header->writer_waiting.store(0, std::memory_order_relaxed);
+    if (kWaitResult == WaitResult::TIMEOUT) {
+      errno = EAGAIN;
+      return -1;
+    } else if (kWaitResult == WaitResult::INTERRUPTED) {
+      errno = EINTR;
+      return -1;
+    } else if (kWaitResult == WaitResult::CLOSED) {
+      errno = EPIPE;
+      return -1;
+    }
+  }
+}
+
+ssize_t ShmConnection::Receive(uint8_t* buffer, size_t size) {
+  RingHeader* header = receive_ring_.header;
+  while (true) {
+    const uint64_t kReadPosition =
+        header->read_position.load(std::memory_order_relaxed);
+    const uint64_t kWritePosition =
+        header->write_position.load(std::memory_order_acquire);
+
+    if (kWritePosition != kReadPosition) {
+      // Copy as much as we can, wrapping around the end of the ring.
+      const size_t kNumToReceive =
+          std::min(static_cast<size_t>(kWritePosition - kReadPosition), size);
+      size_t num_copied = 0;
+      while (num_copied < kNumToReceive) {
+        const size_t kOffset = (kReadPosition + num_copied) & (kRingSize - 1);
+        const size_t kChunk =
+            std::min(kNumToReceive - num_copied, kRingSize - kOffset);
+        std::memcpy(buffer + num_copied, receive_ring_.data + kOffset, kChunk);
+        num_copied += kChunk;
+      }
+
+      header->read_position.store(kReadPosition + kNumToReceive,
+                                  std::memory_order_seq_cst);
+      // Only bother the writer if it's asleep.
+      if (header->writer_waiting.load(std::memory_order_seq_cst) != 0) {
+        RingDoorbell(receive_ring_.space_ready_fd);
+      }
+      return static_cast<ssize_t>(kNumToReceive);
+    }
+
+    // The ring is empty. Let the writer know we're waiting, then check again
+    // in case it added data in the meantime.
+    header->reader_waiting.store(1, std::memory_order_seq_cst);
+    if (header->write_position.load(std::memory_order_seq_cst) !=
+        kWritePosition) {
+      header->reader_waiting.store(0, std::memory_order_relaxed);
+      continue;
+    }
+
+    const auto kWaitResult = WaitForDoorbell(receive_ring_.data_ready_fd);
+    header->reader_waiting.store(0, std::memory_order_relaxed);
+    if (kWaitResult == WaitResult::TIMEOUT) {
+      errno = EAGAIN;
+      return -1;
+    } else if (kWaitResult == WaitResult::INTERRUPTED) {
+      errno = EINTR;
+      return -1;
+    } else if (kWaitResult == WaitResult::CLOSED &&
+               header->write_position.load(std::memory_order_acquire) ==
+                   kWritePosition) {
+      // The other side is gone, and it didn't leave anything for us.
+      return 0;
+    }
+  }
+}
+
+void ShmConnection::Interrupt() { interrupted_.Signal(); }
+
+int ShmConnection::GetFd() const { return socket_fd_; }
+
+ShmConnection::WaitResult ShmConnection::WaitForDoorbell(int doorbell_fd) {
+  // Nothing else is ever sent on the socket, so if it becomes readable, the
+  // other side must have hung up.
+  struct pollfd poll_fds[3] = {{doorbell_fd, POLLIN, 0},
+                               {socket_fd_, POLLIN, 0},
+                               {interrupted_.GetFd(), POLLIN, 0}};
+  const int kNumReady = poll(poll_fds, 3, kDoorbellTimeoutMs);
+  if (kNumReady < 0) {
+    return errno == EINTR ? WaitResult::TIMEOUT : WaitResult::CLOSED;
+  } else if (kNumReady == 0) {
+    return WaitResult::TIMEOUT;
+  }
+
+  if (poll_fds[2].revents != 0) {
+    return WaitResult::INTERRUPTED;
+  }
+
+  if (poll_fds[1].revents != 0) {
+    return WaitResult::CLOSED;
+  }
+
+  // Reset the doorbell.
+  uint64_t count;
+  if (read(doorbell_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+    return WaitResult::CLOSED;
+  }
+  return WaitResult::RUNG;
+}
+
+void ShmConnection::RingDoorbell(int doorbell_fd) {
+  const uint64_t kIncrement = 1;
+  if (write(doorbell_fd, &kIncrement, sizeof(kIncrement)) < 0 &&
+      errno != EAGAIN) {
+    LOG_S(WARNING) << "Failed to ring doorbell: " << std::strerror(errno);
+  }
+}
+
+}  // namespace message_passing
@@ -0,0 +1,132 @@
+#ifndef CSCI6780_MESSAGE_PASSING_SHM_CONNECTION_H
+#define CSCI6780_MESSAGE_PASSING_SHM_CONNECTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "connection_interface.h"
+#include "thread_pool/wakeup_event.h"
+
+namespace message_passing {
+
+/**
+ * @brief Connection between two processes on the same host that passes data
+ *  through shared memory instead of the kernel.
+ * @details The connection is set up over a Unix socket. The accepting side
+ *  creates a shared memory region holding two single-producer,
+ *  single-consumer byte rings, one for each direction, and passes it to the
+ *  other side along with eventfd doorbells. After that, the socket is only
+ *  used to notice when the other side goes away. Doorbells are only rung when
+ *  the other side is actually waiting, so a busy connection doesn't make any
+ *  system calls at all.
+ */
+class ShmConnection : public IConnection {
+ public:
+  /// Size of each of the two rings, in bytes. Must be a power of two.
+  static constexpr size_t kRingSize = 1 << 20;
+
+  /**
+   * @brief Sets up shared memory for a client that just connected, and sends
+   *  it to the client.
+   * @param socket_fd The Unix socket that the client connected on.
+   * @return The connection, or nullptr if it failed.
+   */
+  static std::shared_ptr<ShmConnection> Accept(int socket_fd);
+
+  /**
+   * @brief Receives the shared memory for a connection from the server.
+   * @param socket_fd The Unix socket that we connected to the server with.
+   * @return The connection, or nullptr if it failed.
+   */
+  static std::shared_ptr<ShmConnection> Connect(int socket_fd);
+
+  ~ShmConnection() override;
+
+  ssize_t Send(const struct iovec* buffers, size_t num_buffers) final;
+  ssize_t Receive(uint8_t* buffer, size_t size) final;
+  void Interrupt() final;
+  [[nodiscard]] int GetFd() const final;
+
+ private:
+  /// Ring header that lives in shared memory. Defined in the source file.
+  struct RingHeader;
+
+  /**
+   * @brief Our view of one of the rings.
+   */
+  struct Ring {
+    /// The header in shared memory.
+    RingHeader* header;
+    /// Start of the data in shared memory.
+    uint8_t* data;
+    /// Rung by the writer when it adds data.
+    int data_ready_fd;
+    /// Rung by the reader when it makes space.
+    int space_ready_fd;
+  };
+
+  /// Possible outcomes of waiting on a doorbell.
+  enum class WaitResult {
+    /// The doorbell was rung.
+    RUNG,
+    /// Nothing happened before the timeout.
+    TIMEOUT,
+    /// The other side disconnected.
+    CLOSED,
+    /// We were interrupted.
+    INTERRUPTED,
+  };
+
+  /**
+   * @brief Maps the shared memory and sets up the connection.
+   * @param socket_fd The Unix socket the connection was made on.
+   * @param memory_fd The shared memory.
+   * @param event_fds The four doorbells: data and space for the
+   *  client-to-server ring, then data and space for the server-to-client
+   *  ring.
+   * @param is_server Whether we're the accepting side.
+   * @param initialize Whether the shared memory needs to be initialized.
+   * @return The connection, or nullptr if mapping failed.
+   */
+  static std::shared_ptr<ShmConnection> Map(int socket_fd, int memory_fd,
+                                            const int* event_fds,
+                                            bool is_server, bool initialize);
+
+  /**
+   * @param socket_fd The Unix socket the connection was made on.
+   * @param memory The start of the mapped shared memory.
+   * @param send_ring The ring we write to.
+   * @param receive_ring The ring we read from.
+   */
+  ShmConnection(int socket_fd, void* memory, Ring send_ring,
+                Ring receive_ring);
+
+  /**
+   * @brief Waits for a doorbell to be rung.
+   * @param doorbell_fd The doorbell to wait on.
+   * @return What happened.
+   */
+  WaitResult WaitForDoorbell(int doorbell_fd);
+
+  /**
+   * @brief Rings a doorbell.
+   * @param doorbell_fd The doorbell.
+   */
+  static void RingDoorbell(int doorbell_fd);
+
+  /// The Unix socket the connection was made on.
+  int socket_fd_;
+  /// The start of the mapped shared memory.
+  void* memory_;
+  /// The ring we write to.
+  Ring send_ring_;
+  /// The ring we read from.
+  Ring receive_ring_;
+  /// Signalled when we're interrupted.
+  thread_pool::WakeupEvent interrupted_{};
+};
+
+}  // namespace message_passing
+
+#endif  // CSCI6780_MESSAGE_PASSING_SHM_CONNECTION_H
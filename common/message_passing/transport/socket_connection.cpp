@@ -0,0 +1,74 @@
+#include "socket_connection.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+
+namespace message_passing {
+namespace {
+
+/// How long to wait for the socket before timing out, in milliseconds.
+constexpr int kSocketTimeoutMs = 1000;
+
+}  // namespace
+
+SocketConnection::SocketConnection(int socket_fd) : socket_fd_(socket_fd) {}
+
+ssize_t SocketConnection::Send(const struct iovec* buffers,
+                               size_t num_buffers) {
+  struct msghdr header {};
+  header.msg_iov = const_cast<struct iovec*>(buffers);
+  header.msg_iovlen = num_buffers;
+
+  while (true) {
+    // A peer that went away should be reported as an error, not a SIGPIPE.
+    const ssize_t kResult =
+        sendmsg(socket_fd_, &header, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (kResult >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      return kResult;
+    }
+
+    // The socket is full.
+    if (!WaitForSocket(POLLOUT)) {
+      return -1;
+    }
+  }
+}
+
+ssize_t SocketConnection::Receive(uint8_t* buffer, size_t size) {
+  while (true) {
+    const ssize_t kResult = recv(socket_fd_, buffer, size, MSG_DONTWAIT);
+    if (kResult >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      return kResult;
+    }
+
+    // Nothing to read yet.
+    if (!WaitForSocket(POLLIN)) {
+      return -1;
+    }
+  }
+}
+
+void SocketConnection::Interrupt() { interrupted_.Signal(); }
+
+int SocketConnection::GetFd() const { return socket_fd_; }
+
+bool SocketConnection::WaitForSocket(short events) {
+  struct pollfd poll_fds[2] = {{socket_fd_, events, 0},
+                               {interrupted_.GetFd(), POLLIN, 0}};
+  const int kNumReady = poll(poll_fds, 2, kSocketTimeoutMs);
+  if (poll_fds[1].revents != 0) {
+    errno = EINTR;
+    return false;
+  }
+  if (kNumReady <= 0) {
+    // Signals are treated like timeouts, since the caller retries either way.
+    errno = EAGAIN;
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace message_passing
@@ -0,0 +1,45 @@
+#ifndef CSCI6780_MESSAGE_PASSING_SOCKET_CONNECTION_H
+#define CSCI6780_MESSAGE_PASSING_SOCKET_CONNECTION_H
+
+#include "connection_interface.h"
+#include "thread_pool/wakeup_event.h"
+
+namespace message_passing {
+
+/**
+ * @brief Connection that sends data directly over a TCP or Unix socket.
+ * @details The socket is only ever used without blocking. When it isn't
+ *  ready, we `poll()` it along with an eventfd, so that `Interrupt()` can wake
+ *  us up.
+ */
+class SocketConnection : public IConnection {
+ public:
+  /**
+   * @param socket_fd The connected socket.
+   */
+  explicit SocketConnection(int socket_fd);
+  ~SocketConnection() override = default;
+
+  ssize_t Send(const struct iovec* buffers, size_t num_buffers) final;
+  ssize_t Receive(uint8_t* buffer, size_t size) final;
+  void Interrupt() final;
+  [[nodiscard]] int GetFd() const final;
+
+ private:
+  /**
+   * @brief Waits for the socket to become ready.
+   * @param events The `poll()` events to wait for.
+   * @return True if the socket is ready, false if it timed out or we were
+   *  interrupted, with `errno` set accordingly.
+   */
+  bool WaitForSocket(short events);
+
+  /// The connected socket.
+  int socket_fd_;
+  /// Signalled when we're interrupted.
+  thread_pool::WakeupEvent interrupted_{};
+};
+
+}  // namespace message_passing
+
+#endif  // CSCI6780_MESSAGE_PASSING_SOCKET_CONNECTION_H
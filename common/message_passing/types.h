@@ -13,6 +13,27 @@ namespace message_passing {
 
 /// Message ID type.
 using MessageId = uint64_t;
+/// Request ID type, used for matching responses to requests.
+using RequestId = uint64_t;
+/// Stream ID type. Messages on different streams of the same connection can
+/// overtake each other. Stream 0 is the default.
+using StreamId = uint32_t;
+
+/**
+ * @brief The different ways that nodes can be connected.
+ */
+enum class Transport {
+  /// TCP over IPv4, using the hostname and port.
+  TCP,
+  /// Unix domain socket, using the socket path. Only works on one host.
+  UNIX,
+  /// Shared memory rings, set up over a Unix domain socket at the socket
+  /// path. Only works on one host.
+  SHARED_MEMORY,
+  /// In-memory pipes between nodes in the same process, using the socket
+  /// path as a name. Mostly useful for tests and benchmarks.
+  LOOPBACK,
+};
 
 /**
  * @brief Represents an endpoint to send messages to.
@@ -20,22 +41,59 @@ using MessageId = uint64_t;
 struct Endpoint {
   /// The destination host.
   std::string hostname;
-  /// The destination port.
+  /// The destination port. For clients that connected over anything other
+  /// than TCP, this is a counter that tells the connections apart.
   uint16_t port;
+
+  /// How to connect to the endpoint.
+  Transport transport = Transport::TCP;
+  /// Path to the socket, if the transport is `Transport::UNIX` or
+  /// `Transport::SHARED_MEMORY`. For `Transport::LOOPBACK`, this is just a
+  /// name.
+  std::string socket_path{};
 };
 
+/**
+ * @brief Convenience function for naming a Unix domain socket.
+ * @param socket_path The path to the socket.
+ * @return An endpoint that refers to the socket.
+ */
+inline Endpoint MakeUnixEndpoint(const std::string& socket_path) {
+  return {"", 0, Transport::UNIX, socket_path};
+}
+
+/**
+ * @brief Convenience function for naming a shared memory endpoint.
+ * @param socket_path The path to the Unix socket used to set up connections.
+ * @return An endpoint that refers to the socket.
+ */
+inline Endpoint MakeSharedMemoryEndpoint(const std::string& socket_path) {
+  return {"", 0, Transport::SHARED_MEMORY, socket_path};
+}
+
+/**
+ * @brief Convenience function for naming an in-process loopback endpoint.
+ * @param name The name that the server listens on.
+ * @return An endpoint that refers to the name.
+ */
+inline Endpoint MakeLoopbackEndpoint(const std::string& name) {
+  return {"", 0, Transport::LOOPBACK, name};
+}
+
 /// Custom hash specialization for endpoints.
 struct EndpointHash {
   std::size_t operator()(
       const message_passing::Endpoint& endpoint) const noexcept {
     return std::hash<std::string>{}(endpoint.hostname) ^
-           std::hash<uint16_t>{}(endpoint.port);
+           std::hash<uint16_t>{}(endpoint.port) ^
+           std::hash<std::string>{}(endpoint.socket_path);
   }
 };
 
 /// Equality operator for endpoints.
 inline bool operator==(const Endpoint& e1, const Endpoint& e2) {
-  return e1.hostname == e2.hostname && e1.port == e2.port;
+  return e1.hostname == e2.hostname && e1.port == e2.port &&
+         e1.transport == e2.transport && e1.socket_path == e2.socket_path;
 }
 
 /// Inequality operator for endpoints.
@@ -1,6 +1,8 @@
 #include "utils.h"
 
 #include <arpa/inet.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include <cerrno>
 #include <cstring>
@@ -12,6 +14,39 @@ namespace {
 /// Timeout in seconds for socket operations.
 constexpr uint32_t kSocketTimeout = 1;
 
+/**
+ * @brief Sets the receive timeout on a socket, so that receiver tasks can
+ *  periodically check whether they've been cancelled.
+ * @param sock The socket.
+ */
+void SetReceiveTimeout(int sock) {
+  struct timeval timeout {};
+  timeout.tv_sec = kSocketTimeout;
+  timeout.tv_usec = 0;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout,
+             sizeof(timeout));
+}
+
+/**
+ * @brief Creates an address structure for a Unix domain socket.
+ * @param socket_path The path to the socket.
+ * @param address[out] The address structure to fill in.
+ * @return True if it succeeded, false if the path is too long.
+ */
+bool MakeUnixAddress(const std::string& socket_path,
+                     struct sockaddr_un* address) {
+  *address = {};
+  address->sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address->sun_path)) {
+    LOG_S(ERROR) << "Socket path " << socket_path << " is too long.";
+    return false;
+  }
+
+  std::strncpy(address->sun_path, socket_path.c_str(),
+               sizeof(address->sun_path) - 1);
+  return true;
+}
+
 }  // namespace
 
 struct sockaddr_in MakeAddress(uint16_t port) {
@@ -34,18 +69,16 @@ int SetUpSocket(const sockaddr_in& address, const std::string& hostname) {
   if (inet_pton(AF_INET, hostname.c_str(),
                 (struct sockaddr*)&address.sin_addr) <= 0) {
     LOG_S(ERROR) << "inet_pton: " << std::strerror(errno);
+    close(sock);
     return -1;
   }
 
   // Set a timeout.
-  struct timeval timeout {};
-  timeout.tv_sec = kSocketTimeout;
-  timeout.tv_usec = 0;
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout,
-             sizeof(timeout));
+  SetReceiveTimeout(sock);
 
   if (connect(sock, (struct sockaddr*)&address, sizeof(address)) < 0) {
     LOG_S(ERROR) << "Connection Failed: " << std::strerror(errno);
+    close(sock);
     return -1;
   }
 
@@ -55,14 +88,17 @@ int SetUpSocket(const sockaddr_in& address, const std::string& hostname) {
 int SetUpListenerSocket(const struct sockaddr_in &address) {
   // Open a TCP socket.
   const int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-  if (server_fd == 0) {
+  if (server_fd < 0) {
     LOG_S(ERROR) << "Failed to create server socket";
     return -1;
   }
 
   // Allow the server to re-bind to this port if it was restarted quickly.
+  // Note that these are separate options, and can't be OR'd together.
   const int option = 1;
-  if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &option,
+  if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &option,
+                 sizeof(option)) ||
+      setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &option,
                  sizeof(option))) {
     LOG_S(ERROR) << "Failed to set socket options";
     // This is not a fatal error.
@@ -71,14 +107,85 @@ int SetUpListenerSocket(const struct sockaddr_in &address) {
   // Bind to the port.
   if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
     LOG_S(ERROR) << "bind() failed on server socket";
+    close(server_fd);
     return -1;
   }
-  if (listen(server_fd, 1) < 0) {
+  if (listen(server_fd, SOMAXCONN) < 0) {
     LOG_S(ERROR) << "listen() failed on server socket";
+    close(server_fd);
     return -1;
   }
 
   return server_fd;
 }
 
+int SetUpUnixSocket(const std::string& socket_path) {
+  struct sockaddr_un address {};
+  if (!MakeUnixAddress(socket_path, &address)) {
+    return -1;
+  }
+
+  const int kSock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (kSock < 0) {
+    LOG_S(ERROR) << "Socket creation error: " << std::strerror(errno);
+    return -1;
+  }
+
+  // Set a timeout.
+  SetReceiveTimeout(kSock);
+
+  if (connect(kSock, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    LOG_S(ERROR) << "Connection Failed: " << std::strerror(errno);
+    close(kSock);
+    return -1;
+  }
+
+  return kSock;
+}
+
+int SetUpUnixListenerSocket(const std::string& socket_path) {
+  struct sockaddr_un address {};
+  if (!MakeUnixAddress(socket_path, &address)) {
+    return -1;
+  }
+
+  const int kServerFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (kServerFd < 0) {
+    LOG_S(ERROR) << "Failed to create server socket";
+    return -1;
+  }
+
+  // Unlike TCP ports, the socket file sticks around after the server exits,
+  // so it has to be removed before we can bind again.
+  unlink(socket_path.c_str());
+
+  if (bind(kServerFd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    LOG_S(ERROR) << "bind() failed on server socket";
+    close(kServerFd);
+    return -1;
+  }
+  if (listen(kServerFd, SOMAXCONN) < 0) {
+    LOG_S(ERROR) << "listen() failed on server socket";
+    close(kServerFd);
+    return -1;
+  }
+
+  return kServerFd;
+}
+
+int ConnectTo(const Endpoint& endpoint) {
+  switch (endpoint.transport) {
+    case Transport::UNIX:
+    case Transport::SHARED_MEMORY:
+      // Shared memory connections are set up over a Unix socket.
+      return SetUpUnixSocket(endpoint.socket_path);
+    case Transport::LOOPBACK:
+      LOG_S(ERROR) << "Loopback endpoints don't use sockets.";
+      return -1;
+    case Transport::TCP:
+    default:
+      return SetUpSocket(MakeAddress(endpoint.port), endpoint.hostname);
+  }
+}
+
 }  // namespace message_passing
\ No newline at end of file
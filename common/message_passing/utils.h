@@ -10,6 +10,8 @@
 #include <cstdint>
 #include <string>
 
+#include "types.h"
+
 namespace message_passing {
 
 /**
@@ -34,6 +36,29 @@ int SetUpSocket(const sockaddr_in& address, const std::string& hostname);
  */
 int SetUpListenerSocket(const struct sockaddr_in& address);
 
+/**
+ * @brief Connects to a server listening on a Unix domain socket.
+ * @param socket_path The path to the socket.
+ * @return The FD of the client socket, or -1 on failure.
+ */
+int SetUpUnixSocket(const std::string& socket_path);
+
+/**
+ * @brief Sets up a Unix domain socket for listening. Any stale socket file
+ *    left at the same path is removed first.
+ * @param socket_path The path to create the socket at.
+ * @return The server socket it created, or -1 if it failed.
+ */
+int SetUpUnixListenerSocket(const std::string& socket_path);
+
+/**
+ * @brief Connects to an endpoint, using whichever transport it specifies.
+ * @param endpoint The endpoint to connect to. Loopback endpoints are not
+ *    supported, since they don't use sockets.
+ * @return The FD of the client socket, or -1 on failure.
+ */
+int ConnectTo(const Endpoint& endpoint);
+
 }  // namespace message_passing
 
 #endif  // CSCI6780_MESSAGE_PASSING_UTILS_H
@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <mutex>
 #include <queue>
+#include <utility>
 
 #include <loguru.hpp>
 
@@ -47,6 +48,63 @@ class Queue {
     queue_not_empty_.notify_one();
   }
 
+  /**
+   * @brief Same as `Push()`, but blocks for a maximum amount of time while
+   *    the queue is full before failing.
+   * @tparam Rep The underlying numeric type for the duration.
+   * @tparam Period The underlying period for the duration.
+   * @param timeout The timeout.
+   * @param element The element to push.
+   * @return True if it successfully pushed onto the queue, false if the
+   *    operation timed out.
+   */
+  template <class Rep, class Period>
+  bool PushTimed(const std::chrono::duration<Rep, Period>& timeout,
+                 const T& element) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+
+      // Wait for the queue not to be full.
+      if (max_length_ != 0 &&
+          !queue_not_full_.wait_for<Rep, Period>(
+              lock, timeout, [this] { return queue_.size() < max_length_; })) {
+        // Timeout expired.
+        LOG_S(1) << "Queue push timeout expired.";
+        return false;
+      }
+
+      queue_.push(element);
+    }
+
+    // Notify that the queue is no longer empty.
+    queue_not_empty_.notify_one();
+
+    return true;
+  }
+
+  /**
+   * @brief Same as `Push()`, but never blocks.
+   * @param element The element to push.
+   * @return True if it successfully pushed onto the queue, false if the
+   *    queue was full.
+   */
+  bool TryPush(const T& element) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (max_length_ != 0 && queue_.size() >= max_length_) {
+        return false;
+      }
+
+      queue_.push(element);
+    }
+
+    // Notify that the queue is no longer empty.
+    queue_not_empty_.notify_one();
+
+    return true;
+  }
+
   /**
    * @brief Pops an element from the queue.
    * @return The element from the queue.
@@ -77,15 +135,20 @@ class Queue {
     if (queue_.empty()) {
       // Wait for the queue not to be empty.
       if (!queue_not_empty_.wait_for<Rep, Period>(
-          lock, timeout, [this] { return !queue_.empty(); })) {
+          lock, timeout, [this] { return !queue_.empty() || interrupted_; })) {
         // Timeout expired.
         LOG_S(1) << "Queue pop timeout expired.";
         return false;
       }
+      if (queue_.empty()) {
+        // Somebody wanted us to stop waiting.
+        interrupted_ = false;
+        return false;
+      }
     }
 
     // Pop from the queue.
-    *element = queue_.front();
+    *element = std::move(queue_.front());
     queue_.pop();
 
     // Notify that the queue is no longer full.
@@ -94,6 +157,46 @@ class Queue {
     return true;
   }
 
+  /**
+   * @brief Same as `Pop()`, but never blocks.
+   * @param element[out] The output element will be written here.
+   * @return True if it successfully popped from the queue, false if the
+   *    queue was empty.
+   */
+  bool TryPop(T* element) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (queue_.empty()) {
+        return false;
+      }
+
+      *element = std::move(queue_.front());
+      queue_.pop();
+    }
+
+    // Notify that the queue is no longer full.
+    queue_not_full_.notify_one();
+
+    return true;
+  }
+
+  /**
+   * @brief Makes a thread that is blocked in `PopTimed()` give up right away,
+   *    as if it had timed out. If nobody is waiting, the next call to
+   *    `PopTimed()` that would have to wait gives up instead.
+   * @details This is useful for waking up a consumer that should stop, such
+   *    as a task that is being cancelled.
+   */
+  void Interrupt() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      interrupted_ = true;
+    }
+
+    queue_not_empty_.notify_all();
+  }
+
   /**
    * @return True if the queue is empty.
    */
@@ -108,6 +211,8 @@ class Queue {
   uint32_t max_length_;
   /// Underlying non-thread-safe queue.
   std::queue<T> queue_;
+  /// Whether the next wait in `PopTimed()` should give up.
+  bool interrupted_ = false;
 
   /// Mutex to use for protecting queue access.
   std::mutex mutex_{};
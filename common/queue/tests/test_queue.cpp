@@ -2,6 +2,7 @@
  * @file Unit tests for `queue`.
  */
 
+#include <chrono>
 #include <thread>
 #include <vector>
 
@@ -130,4 +131,94 @@ TEST(Queue, PopTimeout) {
   EXPECT_EQ(42, got_element);
 }
 
+/**
+ * @test Tests that `TryPop` returns elements when there are some, and fails
+ * immediately when there are none.
+ */
+TEST(Queue, TryPop) {
+  // Arrange.
+  Queue<int> queue;
+  queue.Push(42);
+
+  // Act.
+  int got_element = 0;
+  const bool kFirstPopResult = queue.TryPop(&got_element);
+  const bool kSecondPopResult = queue.TryPop(&got_element);
+
+  // Assert.
+  // The first pop should have gotten the element.
+  EXPECT_TRUE(kFirstPopResult);
+  EXPECT_EQ(42, got_element);
+  // The second pop should have failed because the queue is empty.
+  EXPECT_FALSE(kSecondPopResult);
+}
+
+/**
+ * @test Tests that `TryPush` and `PushTimed` fail when the queue is full, and
+ * succeed again once there is space.
+ */
+TEST(Queue, PushFull) {
+  // Arrange.
+  Queue<int> queue(2);
+  queue.Push(1);
+
+  const auto kTimeout = std::chrono::milliseconds(100);
+
+  // Act.
+  const bool kFirstPushResult = queue.TryPush(2);
+  const bool kSecondPushResult = queue.TryPush(3);
+  const bool kTimedPushResult = queue.PushTimed(kTimeout, 3);
+  queue.Pop();
+  const bool kPushAfterPopResult = queue.PushTimed(kTimeout, 3);
+
+  // Assert.
+  EXPECT_TRUE(kFirstPushResult);
+  // The queue was full for these.
+  EXPECT_FALSE(kSecondPushResult);
+  EXPECT_FALSE(kTimedPushResult);
+  // Popping should have made space.
+  EXPECT_TRUE(kPushAfterPopResult);
+  EXPECT_EQ(2, queue.Pop());
+  EXPECT_EQ(3, queue.Pop());
+}
+
+/**
+ * @test Tests that `Interrupt` wakes up a waiting consumer, and that it is
+ * remembered if nobody is waiting yet.
+ */
+TEST(Queue, Interrupt) {
+  // Arrange.
+  Queue<int> queue;
+  const auto kTimeout = std::chrono::seconds(10);
+
+  // Act.
+  // Interrupt before anybody is waiting.
+  queue.Interrupt();
+  int got_element = 0;
+  const auto kStartTime = std::chrono::steady_clock::now();
+  const bool kFirstPopResult = queue.PopTimed(kTimeout, &got_element);
+
+  // Interrupt while somebody is waiting.
+  bool second_pop_result = true;
+  std::thread consumer([&]() {
+    second_pop_result = queue.PopTimed(kTimeout, &got_element);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  queue.Interrupt();
+  consumer.join();
+  const auto kElapsed = std::chrono::steady_clock::now() - kStartTime;
+
+  // The interrupt should be used up now.
+  queue.Push(42);
+  const bool kThirdPopResult = queue.PopTimed(kTimeout, &got_element);
+
+  // Assert.
+  EXPECT_FALSE(kFirstPopResult);
+  EXPECT_FALSE(second_pop_result);
+  // Neither of them should have waited for the timeout.
+  EXPECT_LT(kElapsed, std::chrono::seconds(1));
+  EXPECT_TRUE(kThirdPopResult);
+  EXPECT_EQ(42, got_element);
+}
+
 }  // namespace queue::tests
\ No newline at end of file
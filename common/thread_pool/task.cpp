@@ -13,4 +13,6 @@ Task::Status Task::SetUp() { return Status::RUNNING; }
 
 void Task::CleanUp() {}
 
+void Task::OnCancel() {}
+
 }  // namespace thread_pool
\ No newline at end of file
@@ -52,6 +52,15 @@ class Task {
    */
   virtual void CleanUp();
 
+  /**
+   * @brief Will be called by the pool as soon as the task is cancelled, from
+   *    the thread that cancelled it. Tasks that block inside `RunAtomic()`
+   *    should override this to wake themselves up, so that they notice the
+   *    cancellation right away instead of after their next timeout.
+   * @note This may run concurrently with `RunAtomic()`.
+   */
+  virtual void OnCancel();
+
   /**
    * @brief Gets a unique handle for this task.
    */
@@ -10,6 +10,7 @@
 
 #include "../task.h"
 #include "../thread_pool.h"
+#include "../wakeup_event.h"
 #include "gtest/gtest.h"
 
 namespace thread_pool::tests {
@@ -92,6 +93,24 @@ class DelayTask : public Task {
   std::chrono::milliseconds delay_time_;
 };
 
+/**
+ * @brief A task that blocks for a long time in each iteration, unless it is
+ *    woken up by being cancelled.
+ */
+class BlockingTask : public Task {
+ public:
+  Status RunAtomic() final {
+    wakeup_.Wait(std::chrono::seconds(10));
+    return Status::RUNNING;
+  }
+
+  void OnCancel() final { wakeup_.Signal(); }
+
+ private:
+  /// Signalled when the task is cancelled.
+  WakeupEvent wakeup_{};
+};
+
 /**
  * @brief A task with non-trivial SetUp and CleanUp methods.
  */
@@ -216,6 +235,29 @@ TEST(ThreadPool, TaskCancellation) {
   EXPECT_EQ(Task::Status::CANCELLED, pool.GetTaskStatus(task2));
 }
 
+/**
+ * @test Tests that cancelling a task wakes it up if it is blocked.
+ */
+TEST(ThreadPool, CancelWakesTask) {
+  // Arrange.
+  ThreadPool pool;
+  auto task = std::make_shared<BlockingTask>();
+  pool.AddTask(task);
+  // Give it a chance to start blocking.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // Act.
+  const auto kStartTime = std::chrono::steady_clock::now();
+  pool.CancelTask(task);
+  pool.WaitForCompletion(task);
+  const auto kCancelTime = std::chrono::steady_clock::now() - kStartTime;
+
+  // Assert.
+  EXPECT_EQ(Task::Status::CANCELLED, pool.GetTaskStatus(task));
+  // It should not have waited for its timeout.
+  EXPECT_LT(kCancelTime, std::chrono::seconds(1));
+}
+
 /**
  * @test Tests that destroying the pool cancels running tasks.
  */
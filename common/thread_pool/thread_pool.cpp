@@ -1,6 +1,8 @@
 #include "thread_pool.h"
 
 #include <loguru.hpp>
+#include <memory>
+#include <vector>
 
 namespace thread_pool {
 
@@ -12,17 +14,23 @@ ThreadPool::ThreadPool(uint32_t num_threads)
 ThreadPool::~ThreadPool() {
   LOG_S(INFO) << "Closing thread pool.";
 
+  std::vector<std::shared_ptr<Task>> cancelled_tasks;
   {
     std::lock_guard<std::mutex> lock(mutex_);
 
     // Cancel all tasks.
     for (const auto& handle_and_task : handle_to_task_) {
       cancelled_tasks_.insert(handle_and_task.first);
+      cancelled_tasks.push_back(handle_and_task.second);
     }
 
     // Indicate that we should stop the pool threads.
     should_close_ = true;
   }
+  // Wake up any tasks that are blocked, so we don't have to wait for them.
+  for (const auto& kTask : cancelled_tasks) {
+    kTask->OnCancel();
+  }
   LOG_S(1) << "Joining internal threads...";
   // Wake up the internal threads and force them to check should_close_. We do
   // this by notifying the condition variables and writing dummy data to the
@@ -188,10 +196,15 @@ Task::Status ThreadPool::GetTaskStatus(const std::shared_ptr<Task>& task) {
 }
 
 void ThreadPool::CancelTask(const std::shared_ptr<Task>& task) {
-  std::lock_guard<std::mutex> lock(mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    LOG_S(INFO) << "Cancelling task " << task->GetHandle() << ".";
+    cancelled_tasks_.insert(task->GetHandle());
+  }
 
-  LOG_S(INFO) << "Cancelling task " << task->GetHandle() << ".";
-  cancelled_tasks_.insert(task->GetHandle());
+  // The task might call back into the pool, so don't hold the lock.
+  task->OnCancel();
 }
 
 void ThreadPool::WaitForCompletion() {
@@ -0,0 +1,48 @@
+#include "wakeup_event.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <loguru.hpp>
+
+namespace thread_pool {
+
+WakeupEvent::WakeupEvent()
+    : event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  if (event_fd_ < 0) {
+    LOG_S(ERROR) << "Failed to create wakeup event: " << std::strerror(errno);
+  }
+}
+
+WakeupEvent::~WakeupEvent() {
+  if (event_fd_ >= 0) {
+    close(event_fd_);
+  }
+}
+
+void WakeupEvent::Signal() {
+  // Nobody ever reads the counter, so it stays readable.
+  const uint64_t kIncrement = 1;
+  if (write(event_fd_, &kIncrement, sizeof(kIncrement)) < 0 &&
+      errno != EAGAIN) {
+    LOG_S(WARNING) << "Failed to signal wakeup event: "
+                   << std::strerror(errno);
+  }
+}
+
+bool WakeupEvent::IsSignalled() const {
+  return Wait(std::chrono::milliseconds(0));
+}
+
+bool WakeupEvent::Wait(std::chrono::milliseconds timeout) const {
+  struct pollfd poll_fd = {event_fd_, POLLIN, 0};
+  return poll(&poll_fd, 1, static_cast<int>(timeout.count())) > 0;
+}
+
+int WakeupEvent::GetFd() const { return event_fd_; }
+
+}  // namespace thread_pool
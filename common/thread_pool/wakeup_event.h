@@ -0,0 +1,53 @@
+#ifndef CSCI6780_THREAD_POOL_WAKEUP_EVENT_H
+#define CSCI6780_THREAD_POOL_WAKEUP_EVENT_H
+
+#include <chrono>
+
+namespace thread_pool {
+
+/**
+ * @brief An eventfd that stays readable once it has been signalled.
+ * @details Tasks that wait on file descriptors can add this to their
+ *    `poll()` set and signal it from `Task::OnCancel()`, so that cancelling
+ *    them takes effect immediately instead of after their next timeout.
+ */
+class WakeupEvent {
+ public:
+  WakeupEvent();
+  ~WakeupEvent();
+
+  WakeupEvent(const WakeupEvent& other) = delete;
+  WakeupEvent& operator=(const WakeupEvent& other) = delete;
+
+  /**
+   * @brief Signals the event, waking anyone who is waiting on it. It stays
+   *    signalled from then on.
+   */
+  void Signal();
+
+  /**
+   * @return True if the event has been signalled.
+   */
+  [[nodiscard]] bool IsSignalled() const;
+
+  /**
+   * @brief Waits for the event to be signalled.
+   * @param timeout The maximum amount of time to wait.
+   * @return True if it was signalled, false if it timed out.
+   */
+  bool Wait(std::chrono::milliseconds timeout) const;
+
+  /**
+   * @return The eventfd, which becomes readable once the event is signalled.
+   *    It should only be polled, never read.
+   */
+  [[nodiscard]] int GetFd() const;
+
+ private:
+  /// The underlying eventfd.
+  int event_fd_;
+};
+
+}  // namespace thread_pool
+
+#endif  // CSCI6780_THREAD_POOL_WAKEUP_EVENT_H
@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include "../wire_protocol.h"
@@ -30,6 +31,40 @@ TestMessage MakeTestMessage() {
   return test_message;
 }
 
+/**
+ * @brief Splits a serialized message into the frames that it was sent as.
+ * @param serialized The serialized message.
+ * @return Each frame, including its length prefix.
+ */
+std::vector<std::vector<uint8_t>> SplitFrames(
+    const std::vector<uint8_t>& serialized) {
+  std::vector<std::vector<uint8_t>> frames;
+  for (size_t offset = 0; offset < serialized.size();) {
+    const size_t kFrameSize = GetFrameSize(serialized.data() + offset);
+    frames.emplace_back(serialized.begin() + offset,
+                        serialized.begin() + offset + kFrameSize);
+    offset += kFrameSize;
+  }
+
+  return frames;
+}
+
+/**
+ * @brief Serializes a message that is big enough to be split into four
+ *  fragments on a stream.
+ * @return The fragments.
+ */
+std::vector<std::vector<uint8_t>> MakeFragments() {
+  TestMessage large_message;
+  large_message.set_parameter(std::string(kMaxFragmentSize * 3 + 17, 'x'));
+  FrameHeader header;
+  header.stream_id = 1;
+  std::vector<uint8_t> large;
+  EXPECT_TRUE(Serialize(large_message, header, &large));
+
+  return SplitFrames(large);
+}
+
 /**
  * @brief Fixture to use for tests that split the message at different points.
  */
@@ -153,4 +188,323 @@ TEST(WireProtocol, RoundTripMultiMessage) {
   EXPECT_FALSE(parser.HasCompleteMessage());
 }
 
+/**
+ * @test Tests that the frame parser can split a stream containing multiple
+ * messages, even when the data arrives one byte at a time.
+ */
+TEST(WireProtocol, FrameParserByteAtATime) {
+  // Arrange.
+  // Serialize two messages, the second of which is empty.
+  std::vector<uint8_t> serialized_1;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), &serialized_1));
+  std::vector<uint8_t> serialized_2;
+  ASSERT_TRUE(Serialize(TestMessage(), &serialized_2));
+
+  std::vector<uint8_t> combined(serialized_1);
+  combined.insert(combined.end(), serialized_2.begin(), serialized_2.end());
+
+  // Act.
+  FrameParser parser;
+  for (const uint8_t kByte : combined) {
+    parser.AddNewData(&kByte, 1);
+  }
+
+  // Assert.
+  // The first frame should be the body of the first message.
+  std::vector<uint8_t> frame;
+  ASSERT_TRUE(parser.GetFrame(&frame));
+  TestMessage got_message;
+  EXPECT_TRUE(got_message.ParseFromArray(frame.data(), frame.size()));
+  EXPECT_STREQ(kTestParameterString, got_message.parameter().c_str());
+
+  // The second frame should be empty.
+  ASSERT_TRUE(parser.GetFrame(&frame));
+  EXPECT_TRUE(frame.empty());
+
+  // It should have no more frames.
+  EXPECT_FALSE(parser.HasCompleteFrame());
+  EXPECT_FALSE(parser.GetFrame(&frame));
+}
+
+/**
+ * @test Tests that headers make it through the frame parser, and that frames
+ * with and without headers can be mixed on the same stream.
+ */
+TEST(WireProtocol, FrameParserHeader) {
+  // Arrange.
+  constexpr uint64_t kRequestId = 0x0102030405060708;
+  std::vector<uint8_t> with_header;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), {kRequestId}, &with_header));
+  std::vector<uint8_t> without_header;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), &without_header));
+
+  // Act.
+  FrameParser parser;
+  parser.AddNewData(with_header.data(), with_header.size());
+  parser.AddNewData(without_header.data(), without_header.size());
+
+  // Assert.
+  // The first frame should have the header, which shouldn't be part of the
+  // message itself.
+  std::vector<uint8_t> frame;
+  FrameHeader header;
+  ASSERT_TRUE(parser.GetFrame(&frame, &header));
+  EXPECT_EQ(kRequestId, header.request_id);
+  TestMessage got_message;
+  EXPECT_TRUE(got_message.ParseFromArray(frame.data(), frame.size()));
+  EXPECT_STREQ(kTestParameterString, got_message.parameter().c_str());
+
+  // The second frame should have a default header.
+  ASSERT_TRUE(parser.GetFrame(&frame, &header));
+  EXPECT_EQ(0U, header.request_id);
+  EXPECT_TRUE(got_message.ParseFromArray(frame.data(), frame.size()));
+  EXPECT_STREQ(kTestParameterString, got_message.parameter().c_str());
+}
+
+/**
+ * @test Tests that the trace fields make it through the frame parser, and
+ * that the send time can be filled in after the message is serialized.
+ */
+TEST(WireProtocol, FrameParserTraceHeader) {
+  // Arrange.
+  constexpr uint64_t kTraceId = 0x1122334455667788;
+  constexpr int64_t kSentAtUs = 1700000000123456;
+  std::vector<uint8_t> traced;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), {0, kTraceId}, &traced));
+  std::vector<uint8_t> untraced;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), {7}, &untraced));
+
+  // Act.
+  const bool kSetTraced = SetSendTime(kSentAtUs, &traced);
+  const bool kSetUntraced = SetSendTime(kSentAtUs, &untraced);
+  FrameParser parser;
+  parser.AddNewData(traced.data(), traced.size());
+  parser.AddNewData(untraced.data(), untraced.size());
+
+  // Assert.
+  EXPECT_TRUE(kSetTraced);
+  EXPECT_FALSE(kSetUntraced);
+
+  std::vector<uint8_t> frame;
+  FrameHeader header;
+  ASSERT_TRUE(parser.GetFrame(&frame, &header));
+  EXPECT_EQ(0U, header.request_id);
+  EXPECT_EQ(kTraceId, header.trace_id);
+  EXPECT_EQ(kSentAtUs, header.sent_at_us);
+  TestMessage got_message;
+  EXPECT_TRUE(got_message.ParseFromArray(frame.data(), frame.size()));
+  EXPECT_STREQ(kTestParameterString, got_message.parameter().c_str());
+
+  // Untraced messages shouldn't pick up any trace fields.
+  ASSERT_TRUE(parser.GetFrame(&frame, &header));
+  EXPECT_EQ(7U, header.request_id);
+  EXPECT_EQ(0U, header.trace_id);
+  EXPECT_EQ(0, header.sent_at_us);
+}
+
+/**
+ * @test Tests that large messages on a stream are split into fragments, and
+ * that the frame parser puts them back together even when they are
+ * interleaved with frames from other streams.
+ */
+TEST(WireProtocol, FrameParserStreams) {
+  // Arrange.
+  TestMessage large_message;
+  large_message.set_parameter(std::string(kMaxFragmentSize * 3 + 17, 'x'));
+  std::vector<uint8_t> large;
+  FrameHeader large_header;
+  large_header.request_id = 5;
+  large_header.stream_id = 1;
+  ASSERT_TRUE(Serialize(large_message, large_header, &large));
+
+  std::vector<uint8_t> small;
+  FrameHeader small_header;
+  small_header.stream_id = 2;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), small_header, &small));
+  std::vector<uint8_t> unstreamed;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), &unstreamed));
+
+  // Split the large message back up into its fragments.
+  std::vector<std::vector<uint8_t>> fragments;
+  for (size_t offset = 0; offset < large.size();) {
+    const size_t kFrameSize = GetFrameSize(large.data() + offset);
+    fragments.emplace_back(large.begin() + offset,
+                           large.begin() + offset + kFrameSize);
+    offset += kFrameSize;
+  }
+
+  // Act.
+  // The other messages go in between the fragments.
+  FrameParser parser;
+  parser.AddNewData(fragments[0].data(), fragments[0].size());
+  parser.AddNewData(small.data(), small.size());
+  for (size_t i = 1; i < fragments.size(); ++i) {
+    parser.AddNewData(fragments[i].data(), fragments[i].size());
+    if (i == 1) {
+      parser.AddNewData(unstreamed.data(), unstreamed.size());
+    }
+  }
+
+  // Assert.
+  EXPECT_EQ(4U, fragments.size());
+
+  // Messages should come out in the order that they were completed.
+  std::vector<uint8_t> frame;
+  FrameHeader header;
+  TestMessage got_message;
+  ASSERT_TRUE(parser.GetFrame(&frame, &header));
+  EXPECT_EQ(2U, header.stream_id);
+  EXPECT_TRUE(got_message.ParseFromArray(frame.data(), frame.size()));
+  EXPECT_STREQ(kTestParameterString, got_message.parameter().c_str());
+
+  ASSERT_TRUE(parser.GetFrame(&frame, &header));
+  EXPECT_EQ(0U, header.stream_id);
+  EXPECT_TRUE(got_message.ParseFromArray(frame.data(), frame.size()));
+  EXPECT_STREQ(kTestParameterString, got_message.parameter().c_str());
+
+  ASSERT_TRUE(parser.GetFrame(&frame, &header));
+  EXPECT_EQ(1U, header.stream_id);
+  EXPECT_EQ(5U, header.request_id);
+  EXPECT_TRUE(got_message.ParseFromArray(frame.data(), frame.size()));
+  EXPECT_EQ(large_message.parameter(), got_message.parameter());
+
+  EXPECT_FALSE(parser.HasCompleteFrame());
+}
+
+/**
+ * @test Tests that the frame parser recycles its buffers once the frames it
+ * handed out are released.
+ */
+TEST(WireProtocol, FrameParserReusesBuffers) {
+  // Arrange.
+  std::vector<uint8_t> serialized;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), {42}, &serialized));
+  buffer_pool::BufferPool pool;
+  FrameParser parser(pool);
+
+  // Act.
+  for (int i = 0; i < 100; ++i) {
+    parser.AddNewData(serialized.data(), serialized.size());
+
+    buffer_pool::Buffer frame;
+    FrameHeader header;
+    ASSERT_TRUE(parser.GetFrame(&frame, &header));
+    ASSERT_EQ(42U, header.request_id);
+    TestMessage got_message;
+    ASSERT_TRUE(got_message.ParseFromArray(frame.data(), frame.size()));
+    ASSERT_STREQ(kTestParameterString, got_message.parameter().c_str());
+  }
+
+  // Assert.
+  // Every frame should have gone into the same buffer.
+  EXPECT_EQ(1U, pool.GetNumAllocations());
+}
+
+/**
+ * @test Tests that the frame parser refuses messages that are too big, and
+ * too many partly received streams.
+ */
+TEST(WireProtocol, FrameParserLimits) {
+  // Arrange.
+  std::vector<uint8_t> small;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), &small));
+
+  TestMessage large_message;
+  large_message.set_parameter(std::string(kMaxFragmentSize * 2, 'x'));
+  std::vector<std::vector<uint8_t>> first_fragments;
+  for (uint32_t stream = 1; stream <= 3; ++stream) {
+    std::vector<uint8_t> large;
+    FrameHeader header;
+    header.stream_id = stream;
+    ASSERT_TRUE(Serialize(large_message, header, &large));
+    first_fragments.emplace_back(large.begin(),
+                                 large.begin() + GetFrameSize(large.data()));
+  }
+
+  buffer_pool::BufferPool pool;
+  FrameParser size_parser(pool, 1);
+  FrameParser stream_parser(pool, kDefaultMaxMessageSize, 2);
+
+  // Act.
+  size_parser.AddNewData(small.data(), small.size());
+  for (const auto& kFragment : first_fragments) {
+    stream_parser.AddNewData(kFragment.data(), kFragment.size());
+  }
+  // Nothing after the error should be parsed.
+  stream_parser.AddNewData(small.data(), small.size());
+
+  // Assert.
+  EXPECT_TRUE(size_parser.HasFailed());
+  EXPECT_FALSE(size_parser.HasCompleteFrame());
+  EXPECT_TRUE(stream_parser.HasFailed());
+  EXPECT_FALSE(stream_parser.HasCompleteFrame());
+}
+
+/**
+ * @test Tests that the frame parser fails on a header that claims to be
+ * bigger than its frame, instead of handing out an empty message.
+ */
+TEST(WireProtocol, FrameParserMalformedHeader) {
+  // Arrange.
+  std::vector<uint8_t> serialized;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), {42}, &serialized));
+  // The header size comes right after the length.
+  serialized[sizeof(uint32_t)] = 0xFF;
+  std::vector<uint8_t> small;
+  ASSERT_TRUE(Serialize(MakeTestMessage(), &small));
+
+  FrameParser parser;
+
+  // Act.
+  parser.AddNewData(serialized.data(), serialized.size());
+  parser.AddNewData(small.data(), small.size());
+
+  // Assert.
+  EXPECT_TRUE(parser.HasFailed());
+  EXPECT_FALSE(parser.HasCompleteFrame());
+}
+
+/**
+ * @test Tests that the frame parser fails when the fragments of a message add
+ * up to more than its declared size.
+ */
+TEST(WireProtocol, FrameParserFragmentOverflow) {
+  // Arrange.
+  const auto kFragments = MakeFragments();
+  ASSERT_EQ(4U, kFragments.size());
+
+  FrameParser parser;
+
+  // Act.
+  // Sending the second fragment twice pushes the message over its size.
+  for (const size_t kIndex : {0, 1, 1, 2, 3}) {
+    parser.AddNewData(kFragments[kIndex].data(), kFragments[kIndex].size());
+  }
+
+  // Assert.
+  EXPECT_TRUE(parser.HasFailed());
+  EXPECT_FALSE(parser.HasCompleteFrame());
+}
+
+/**
+ * @test Tests that the frame parser fails when a stream ends before all of a
+ * message has arrived.
+ */
+TEST(WireProtocol, FrameParserShortStream) {
+  // Arrange.
+  const auto kFragments = MakeFragments();
+  ASSERT_EQ(4U, kFragments.size());
+
+  FrameParser parser;
+
+  // Act.
+  // Skip the middle fragments, and go straight to the last one.
+  parser.AddNewData(kFragments[0].data(), kFragments[0].size());
+  parser.AddNewData(kFragments[3].data(), kFragments[3].size());
+
+  // Assert.
+  EXPECT_TRUE(parser.HasFailed());
+  EXPECT_FALSE(parser.HasCompleteFrame());
+}
+
 }  // namespace wire_protocol::tests
@@ -1,20 +1,426 @@
 #include "wire_protocol.h"
 
+#include <utility>
+
 namespace wire_protocol {
 
+namespace {
+
+/// Set in the length prefix of frames that include a header.
+constexpr uint32_t kHeaderFlag = 0x80000000;
+/// Number of bytes the header fields take up on the wire for untraced
+/// messages.
+constexpr uint8_t kHeaderSize = sizeof(FrameHeader::request_id);
+/// Number of bytes the header fields take up on the wire for traced messages.
+constexpr uint8_t kTracedHeaderSize = kHeaderSize +
+                                      sizeof(FrameHeader::trace_id) +
+                                      sizeof(FrameHeader::sent_at_us);
+/// Number of bytes the header fields take up on the wire for messages on a
+/// stream other than 0. These always include the trace fields, even if they
+/// aren't used, followed by the stream ID, the fragment flags, and the size
+/// of the whole message.
+constexpr uint8_t kStreamHeaderSize = kTracedHeaderSize +
+                                      sizeof(FrameHeader::stream_id) + 1 +
+                                      sizeof(uint32_t);
+/// Set in the fragment flags of every fragment except the last one.
+constexpr uint8_t kMoreFragmentsFlag = 0x01;
+/// Offset of the send time in a serialized traced message.
+constexpr size_t kSendTimeOffset = sizeof(uint32_t) + 1 + kHeaderSize +
+                                   sizeof(FrameHeader::trace_id);
+
+/**
+ * @brief Serializes a message, leaving space before it for a prefix.
+ * @param message The message to serialize.
+ * @param prefix_size Number of bytes to reserve for the prefix.
+ * @param[out] serialized Will be set to the serialized output data.
+ * @return True if it succeeded in serializing, false otherwise.
+ */
+bool SerializeWithPrefix(const google::protobuf::Message& message,
+                         size_t prefix_size,
+                         std::vector<uint8_t>* serialized) {
+  const size_t kMessageSize = message.ByteSizeLong();
+  if (kMessageSize + prefix_size >= kHeaderFlag) {
+    // The length would collide with the header flag.
+    return false;
+  }
+
+  serialized->resize(prefix_size + kMessageSize);
+  return message.SerializeToArray(serialized->data() + prefix_size,
+                                  static_cast<int>(kMessageSize));
+}
+
+/**
+ * @brief Writes an integer in big-endian order, like the length.
+ * @param value The value to write.
+ * @param num_bytes How many bytes to write it in.
+ * @param[out] data Where to write it.
+ * @return A pointer to just after the value.
+ */
+uint8_t* WriteField(uint64_t value, size_t num_bytes, uint8_t* data) {
+  for (size_t i = num_bytes; i > 0; --i) {
+    *data++ = static_cast<uint8_t>(value >> ((i - 1) * 8));
+  }
+  return data;
+}
+
+/**
+ * @brief Reads an integer that was written with `WriteField()`.
+ * @param data Where to read it from.
+ * @param num_bytes How many bytes it was written in.
+ * @return The value.
+ */
+uint64_t ReadField(const uint8_t* data, size_t num_bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < num_bytes; ++i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+/**
+ * @brief Writes a length prefix to the start of a buffer.
+ * @param length The length to write.
+ * @param[out] data Where to write it.
+ */
+void WriteLength(uint32_t length, uint8_t* data) {
+  const uint32_t kLengthNetwork = htonl(length);
+  std::copy(reinterpret_cast<const uint8_t*>(&kLengthNetwork),
+            reinterpret_cast<const uint8_t*>(&kLengthNetwork + 1), data);
+}
+
+/**
+ * @brief Writes the length prefix and header of a frame that has a header.
+ * @param header The header.
+ * @param header_size How many bytes of header fields to write.
+ * @param payload_size The number of bytes of message data in the frame.
+ * @param flags The fragment flags. Only written for stream headers.
+ * @param message_size The size of the whole message. Only written for stream
+ *  headers.
+ * @param[out] data Where to write it.
+ * @return A pointer to just after the header, where the message data goes.
+ */
+uint8_t* WriteHeader(const FrameHeader& header, uint8_t header_size,
+                     size_t payload_size, uint8_t flags, uint32_t message_size,
+                     uint8_t* data) {
+  WriteLength(static_cast<uint32_t>(1 + header_size + payload_size) |
+                  kHeaderFlag,
+              data);
+  data += sizeof(uint32_t);
+  *data++ = header_size;
+
+  data = WriteField(header.request_id, sizeof(header.request_id), data);
+  if (header_size >= kTracedHeaderSize) {
+    data = WriteField(header.trace_id, sizeof(header.trace_id), data);
+    data = WriteField(header.sent_at_us, sizeof(header.sent_at_us), data);
+  }
+  if (header_size >= kStreamHeaderSize) {
+    data = WriteField(header.stream_id, sizeof(header.stream_id), data);
+    *data++ = flags;
+    data = WriteField(message_size, sizeof(message_size), data);
+  }
+
+  return data;
+}
+
+/**
+ * @brief Serializes a message on a stream, splitting it into fragments if it
+ *  is too big.
+ * @param message The message to serialize.
+ * @param header The header to send with each fragment.
+ * @param[out] serialized Will be set to the fragments, back to back.
+ * @return True if it succeeded in serializing, false otherwise.
+ */
+bool SerializeFragments(const google::protobuf::Message& message,
+                        const FrameHeader& header,
+                        std::vector<uint8_t>* serialized) {
+  constexpr size_t kPrefixSize = sizeof(uint32_t) + 1 + kStreamHeaderSize;
+  const size_t kMessageSize = message.ByteSizeLong();
+  if (kMessageSize > std::numeric_limits<uint32_t>::max()) {
+    // Too big to describe in the header.
+    return false;
+  }
+
+  if (kMessageSize <= kMaxFragmentSize) {
+    // It fits in one fragment, so we can serialize it in place.
+    if (!SerializeWithPrefix(message, kPrefixSize, serialized)) {
+      return false;
+    }
+    WriteHeader(header, kStreamHeaderSize, kMessageSize, 0, kMessageSize,
+                serialized->data());
+    return true;
+  }
+
+  std::vector<uint8_t> payload(kMessageSize);
+  if (!message.SerializeToArray(payload.data(),
+                                static_cast<int>(kMessageSize))) {
+    return false;
+  }
+
+  const size_t kNumFragments =
+      (kMessageSize + kMaxFragmentSize - 1) / kMaxFragmentSize;
+  serialized->resize(kNumFragments * kPrefixSize + kMessageSize);
+  uint8_t* output = serialized->data();
+  for (size_t offset = 0; offset < kMessageSize;
+       offset += kMaxFragmentSize) {
+    const size_t kFragmentSize =
+        std::min(kMaxFragmentSize, kMessageSize - offset);
+    const uint8_t kFlags =
+        offset + kFragmentSize < kMessageSize ? kMoreFragmentsFlag : 0;
+    output = WriteHeader(header, kStreamHeaderSize, kFragmentSize, kFlags,
+                         kMessageSize, output);
+    output = std::copy(payload.data() + offset,
+                       payload.data() + offset + kFragmentSize, output);
+  }
+
+  return true;
+}
+
+}  // namespace
+
 bool Serialize(const google::protobuf::Message& message,
                std::vector<uint8_t>* serialized) {
-  // Compute and pack the size.
-  const uint32_t kMessageSize = message.ByteSizeLong();
-  const uint32_t kMessageSizeNetwork = htonl(kMessageSize);
-  serialized->resize(sizeof(kMessageSize) + kMessageSize);
-  std::copy(reinterpret_cast<const uint8_t*>(&kMessageSizeNetwork),
-            reinterpret_cast<const uint8_t*>(&kMessageSizeNetwork + 1),
-            serialized->data());
-
-  // Serialize the actual message.
-  return message.SerializeToArray(
-      serialized->data() + sizeof(kMessageSizeNetwork), kMessageSize);
+  if (!SerializeWithPrefix(message, sizeof(uint32_t), serialized)) {
+    return false;
+  }
+
+  // Pack the size.
+  WriteLength(serialized->size() - sizeof(uint32_t), serialized->data());
+  return true;
+}
+
+bool Serialize(const google::protobuf::Message& message,
+               const FrameHeader& header, std::vector<uint8_t>* serialized) {
+  if (header.stream_id != 0) {
+    return SerializeFragments(message, header, serialized);
+  }
+
+  // Length, then the size of the header, then the header itself. The trace
+  // fields are only sent for traced messages.
+  const uint8_t kSize = header.trace_id == 0 ? kHeaderSize : kTracedHeaderSize;
+  const size_t kPrefixSize = sizeof(uint32_t) + 1 + kSize;
+  if (!SerializeWithPrefix(message, kPrefixSize, serialized)) {
+    return false;
+  }
+
+  WriteHeader(header, kSize, serialized->size() - kPrefixSize, 0, 0,
+              serialized->data());
+  return true;
+}
+
+size_t GetFrameSize(const uint8_t* data) {
+  uint32_t length_network;
+  std::copy(data, data + sizeof(length_network),
+            reinterpret_cast<uint8_t*>(&length_network));
+  return sizeof(length_network) + (ntohl(length_network) & ~kHeaderFlag);
+}
+
+bool SetSendTime(int64_t sent_at_us, std::vector<uint8_t>* serialized) {
+  if (serialized->size() < kSendTimeOffset + sizeof(sent_at_us) ||
+      (*serialized)[sizeof(uint32_t)] < kTracedHeaderSize) {
+    // There's no room for it.
+    return false;
+  }
+
+  uint32_t length_network;
+  std::copy(serialized->begin(), serialized->begin() + sizeof(uint32_t),
+            reinterpret_cast<uint8_t*>(&length_network));
+  if ((ntohl(length_network) & kHeaderFlag) == 0) {
+    // No header at all.
+    return false;
+  }
+
+  WriteField(sent_at_us, sizeof(sent_at_us),
+             serialized->data() + kSendTimeOffset);
+  return true;
+}
+
+FrameParser::FrameParser(buffer_pool::BufferPool& pool,
+                         size_t max_message_size, size_t max_partial_messages)
+    : pool_(&pool),
+      max_message_size_(max_message_size),
+      max_partial_messages_(max_partial_messages) {}
+
+void FrameParser::AddNewData(const uint8_t* data, size_t size) {
+  size_t offset = 0;
+  while (offset < size && !failed_) {
+    if (got_length_bytes_ < kNumLengthBytes) {
+      // Copy any of the remaining length bytes.
+      const size_t kLengthBytesToCopy =
+          std::min(size - offset,
+                   static_cast<size_t>(kNumLengthBytes - got_length_bytes_));
+      std::copy(data + offset, data + offset + kLengthBytesToCopy,
+                partial_length_.begin() + got_length_bytes_);
+      got_length_bytes_ += kLengthBytesToCopy;
+      offset += kLengthBytesToCopy;
+
+      if (got_length_bytes_ < kNumLengthBytes) {
+        // We ran out of data in the middle of the length.
+        return;
+      }
+
+      // Actually parse and save the length.
+      MessageLengthType message_size_network;
+      std::copy(partial_length_.begin(), partial_length_.end(),
+                reinterpret_cast<uint8_t*>(&message_size_network));
+      expected_length_ = ntohl(message_size_network);
+      has_header_ = (expected_length_ & kHeaderFlag) != 0;
+      expected_length_ &= ~kHeaderFlag;
+      if (expected_length_ > max_message_size_) {
+        failed_ = true;
+        return;
+      }
+      partial_frame_ = pool_->Acquire(expected_length_);
+
+      if (expected_length_ == 0) {
+        // Empty messages have no body to wait for.
+        CompleteFrame();
+        continue;
+      }
+    }
+
+    // Copy as much of the frame body as we have.
+    const size_t kNumBytesToCopy =
+        std::min(size - offset,
+                 static_cast<size_t>(expected_length_ - got_frame_bytes_));
+    std::copy(data + offset, data + offset + kNumBytesToCopy,
+              partial_frame_.data() + got_frame_bytes_);
+    got_frame_bytes_ += kNumBytesToCopy;
+    offset += kNumBytesToCopy;
+
+    if (got_frame_bytes_ == expected_length_) {
+      CompleteFrame();
+    }
+  }
+}
+
+bool FrameParser::HasCompleteFrame() const {
+  return !complete_frames_.empty();
+}
+
+bool FrameParser::HasFailed() const { return failed_; }
+
+bool FrameParser::GetFrame(std::vector<uint8_t>* frame, FrameHeader* header) {
+  buffer_pool::Buffer buffer;
+  if (!GetFrame(&buffer, header)) {
+    return false;
+  }
+
+  frame->assign(buffer.data(), buffer.data() + buffer.size());
+  return true;
+}
+
+bool FrameParser::GetFrame(buffer_pool::Buffer* frame, FrameHeader* header) {
+  if (complete_frames_.empty()) {
+    return false;
+  }
+
+  auto& next_frame = complete_frames_.front();
+  *frame = std::move(next_frame.payload);
+  if (header != nullptr) {
+    *header = next_frame.header;
+  }
+  complete_frames_.pop_front();
+  return true;
+}
+
+void FrameParser::CompleteFrame() {
+  Frame frame{{}, std::move(partial_frame_)};
+  bool more_fragments = false;
+  uint32_t message_size = 0;
+
+  if (has_header_) {
+    // The first byte is the size of the header, so that we can skip over
+    // fields that we don't know about.
+    const size_t kHeaderBytes =
+        frame.payload.empty() ? 0 : frame.payload.data()[0] + 1;
+    if (kHeaderBytes == 0 || kHeaderBytes > frame.payload.size()) {
+      // Malformed header, so there's no way to make sense of this frame, or
+      // anything after it.
+      failed_ = true;
+      return;
+    } else {
+      // Only read the fields that the sender included.
+      const uint8_t* fields = frame.payload.data() + 1;
+      if (kHeaderBytes > kHeaderSize) {
+        frame.header.request_id = ReadField(fields, kHeaderSize);
+      }
+      if (kHeaderBytes > kTracedHeaderSize) {
+        fields += kHeaderSize;
+        frame.header.trace_id =
+            ReadField(fields, sizeof(FrameHeader::trace_id));
+        fields += sizeof(FrameHeader::trace_id);
+        frame.header.sent_at_us = static_cast<int64_t>(
+            ReadField(fields, sizeof(FrameHeader::sent_at_us)));
+      }
+      if (kHeaderBytes > kStreamHeaderSize) {
+        fields = frame.payload.data() + 1 + kTracedHeaderSize;
+        frame.header.stream_id =
+            ReadField(fields, sizeof(FrameHeader::stream_id));
+        fields += sizeof(FrameHeader::stream_id);
+        more_fragments = (*fields++ & kMoreFragmentsFlag) != 0;
+        message_size = ReadField(fields, sizeof(message_size));
+      }
+      frame.payload.TrimFront(kHeaderBytes);
+    }
+  }
+
+  if (frame.header.stream_id != 0) {
+    AddFragment(std::move(frame), more_fragments, message_size);
+  } else {
+    complete_frames_.push_back(std::move(frame));
+  }
+  partial_frame_ = {};
+  got_frame_bytes_ = 0;
+  got_length_bytes_ = 0;
+  expected_length_ = 0;
+  has_header_ = false;
+}
+
+void FrameParser::AddFragment(Frame fragment, bool more_fragments,
+                              uint32_t message_size) {
+  const uint32_t kStreamId = fragment.header.stream_id;
+  auto partial = partial_messages_.find(kStreamId);
+  if (partial == partial_messages_.end()) {
+    if (!more_fragments) {
+      // The whole message fit in one fragment.
+      complete_frames_.push_back(std::move(fragment));
+      return;
+    }
+    if (message_size > max_message_size_ ||
+        partial_messages_.size() >= max_partial_messages_) {
+      failed_ = true;
+      return;
+    }
+
+    partial = partial_messages_
+                  .emplace(kStreamId, PartialMessage{fragment.header,
+                                                     pool_->Acquire(
+                                                         message_size)})
+                  .first;
+  }
+
+  auto& message = partial->second;
+  const size_t kFragmentSize = fragment.payload.size();
+  if (message.got_bytes + kFragmentSize > message.payload.size()) {
+    // The fragments don't add up, so there's no way to make sense of the
+    // message.
+    failed_ = true;
+    return;
+  }
+
+  std::copy(fragment.payload.data(), fragment.payload.data() + kFragmentSize,
+            message.payload.data() + message.got_bytes);
+  message.got_bytes += kFragmentSize;
+
+  if (!more_fragments) {
+    if (message.got_bytes != message.payload.size()) {
+      // Some of it is missing.
+      failed_ = true;
+      return;
+    }
+    complete_frames_.push_back({message.header, std::move(message.payload)});
+    partial_messages_.erase(partial);
+  }
 }
 
 }  // namespace wire_protocol
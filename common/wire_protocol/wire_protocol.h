@@ -9,15 +9,65 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <limits>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#include "buffer_pool/buffer_pool.h"
 #include "google/protobuf/message.h"
 
 namespace wire_protocol {
 
+/// Largest amount of message data to put in a single fragment. Messages on
+/// streams other than 0 that are bigger than this are split up.
+constexpr size_t kMaxFragmentSize = 64 * 1024;
+
+/// Largest message that `FrameParser` accepts by default. This keeps a bad
+/// length prefix from making us allocate gigabytes.
+constexpr size_t kDefaultMaxMessageSize = 64 * 1024 * 1024;
+/// Most streams that `FrameParser` will reassemble messages for at once by
+/// default.
+constexpr size_t kDefaultMaxPartialMessages = 64;
+
+/**
+ * @brief Extra information that can be sent along with a message.
+ * @details Frames that carry a header are marked by setting the high bit of
+ *  the length prefix. Frames without one are exactly the same as before, so
+ *  peers that only use `MessageParser` can still talk to us as long as we
+ *  don't send them headers.
+ */
+struct FrameHeader {
+  /// Identifies a request so that the response can be matched up with it.
+  /// Zero means that the message is not part of a request.
+  uint64_t request_id = 0;
+
+  /// Identifies the trace that the message belongs to. Zero means that the
+  /// message is not being traced, in which case the trace fields aren't sent.
+  uint64_t trace_id = 0;
+  /// When the sender started writing the message to the connection, in
+  /// microseconds since the Unix epoch. Only meaningful for traced messages.
+  int64_t sent_at_us = 0;
+
+  /// The logical stream that the message belongs to. Messages on the same
+  /// stream arrive in the order they were sent, but messages on different
+  /// streams can overtake each other. Messages on stream 0 are always sent
+  /// whole. On any other stream, large messages are split into fragments, so
+  /// that they can be interleaved with messages on other streams.
+  uint32_t stream_id = 0;
+
+  /**
+   * @return True if none of the fields are set, in which case the message
+   *  can be sent without a header.
+   */
+  [[nodiscard]] bool IsEmpty() const {
+    return request_id == 0 && trace_id == 0 && stream_id == 0;
+  }
+};
+
 /**
  * @brief Serializes a message to the wire format. Once this is done, it can
  *  be safely sent over a socket.
@@ -29,8 +79,176 @@ namespace wire_protocol {
 bool Serialize(const google::protobuf::Message& message,
                std::vector<uint8_t>* serialized);
 
+/**
+ * @brief Serializes a message to the wire format, along with a header. Only
+ *  `FrameParser` understands these frames.
+ * @details If the header has a stream ID, the result might be several
+ *  frames, one for each fragment, back to back. `GetFrameSize()` can be used
+ *  to find the boundaries between them.
+ * @param message The message to serialize.
+ * @param header The header to send with the message.
+ * @param[out] serialized Will be set to the serialized output data. The size
+ *  will be updated accordingly.
+ * @return True if it succeeded in serializing, false otherwise.
+ */
+bool Serialize(const google::protobuf::Message& message,
+               const FrameHeader& header, std::vector<uint8_t>* serialized);
+
+/**
+ * @brief Gets the size of a serialized frame.
+ * @param data The start of the frame. It must contain at least the length
+ *  prefix.
+ * @return The number of bytes in the frame, including the length prefix.
+ */
+size_t GetFrameSize(const uint8_t* data);
+
+/**
+ * @brief Fills in the send time of a serialized traced message.
+ * @param sent_at_us The time to fill in, in microseconds since the Unix epoch.
+ * @param[in,out] serialized A message that was serialized with a header that
+ *  has a trace ID.
+ * @return True if it set the time, false if the message isn't traced.
+ */
+bool SetSendTime(int64_t sent_at_us, std::vector<uint8_t>* serialized);
+
+/**
+ * @brief Splits a stream of serialized data into individual frames, without
+ *  parsing the messages themselves.
+ * @details This is useful when the type of the message isn't known at the
+ *  point where data is read off the socket. Each frame is the serialized
+ *  protobuf data for one message, with the length prefix removed. Frames are
+ *  read straight into buffers from a `BufferPool`, so once the pool is warm,
+ *  parsing doesn't allocate.
+ */
+class FrameParser {
+ public:
+  /**
+   * @param pool The pool to get frame buffers from. It must outlive the
+   *  parser and any frames it returns.
+   * @param max_message_size The largest frame or reassembled message to
+   *  accept. Anything bigger is a protocol error.
+   * @param max_partial_messages The most streams that can have a message
+   *  partly received at once. Going over this is a protocol error.
+   */
+  explicit FrameParser(
+      buffer_pool::BufferPool& pool = buffer_pool::BufferPool::Default(),
+      size_t max_message_size = kDefaultMaxMessageSize,
+      size_t max_partial_messages = kDefaultMaxPartialMessages);
+
+  /**
+   * @brief Adds new serialized data to the parser.
+   * @param data The data to add.
+   * @param size The number of bytes in the data.
+   */
+  void AddNewData(const uint8_t* data, size_t size);
+
+  /**
+   * @return True if at least one complete frame has been parsed.
+   */
+  [[nodiscard]] bool HasCompleteFrame() const;
+
+  /**
+   * @brief Removes the oldest complete frame from the parser.
+   * @param[out] frame Set to the contents of the frame.
+   * @param[out] header Set to the header that was sent with the frame, or a
+   *  default header if it had none. Ignored if it is nullptr.
+   * @return True if it got a frame, false if there were no complete frames.
+   */
+  bool GetFrame(std::vector<uint8_t>* frame, FrameHeader* header = nullptr);
+
+  /**
+   * @brief Same as the other `GetFrame()`, but hands over the pooled buffer
+   *  instead of copying it.
+   * @param[out] frame Set to the contents of the frame.
+   * @param[out] header Set to the header that was sent with the frame, or a
+   *  default header if it had none. Ignored if it is nullptr.
+   * @return True if it got a frame, false if there were no complete frames.
+   */
+  bool GetFrame(buffer_pool::Buffer* frame, FrameHeader* header = nullptr);
+
+  /**
+   * @return True if the data was malformed or broke one of the limits. Once
+   *  this happens, the rest of the data can't be trusted, so all new data is
+   *  ignored and the connection should be dropped.
+   */
+  [[nodiscard]] bool HasFailed() const;
+
+ private:
+  /// Type we use to store the length in serialized messages.
+  using MessageLengthType = uint32_t;
+  /// Size of the length prefix to each message.
+  static constexpr uint8_t kNumLengthBytes = sizeof(MessageLengthType);
+
+  /**
+   * @brief A frame that has been completely read.
+   */
+  struct Frame {
+    /// The header sent with the frame.
+    FrameHeader header;
+    /// The serialized message.
+    buffer_pool::Buffer payload;
+  };
+
+  /**
+   * @brief A message on a stream that has only partly arrived.
+   */
+  struct PartialMessage {
+    /// The header from the first fragment.
+    FrameHeader header;
+    /// Where the fragments are put back together.
+    buffer_pool::Buffer payload;
+    /// How many bytes of the message have arrived so far.
+    size_t got_bytes = 0;
+  };
+
+  /**
+   * @brief Finishes the frame that is currently being parsed and prepares for
+   *  the next one.
+   */
+  void CompleteFrame();
+
+  /**
+   * @brief Adds a fragment to the message that it belongs to, and finishes
+   *  that message if it was the last fragment.
+   * @param fragment The fragment.
+   * @param more_fragments Whether more fragments of the message will follow.
+   * @param message_size The size of the whole message.
+   */
+  void AddFragment(Frame fragment, bool more_fragments, uint32_t message_size);
+
+  /// The current partial length data.
+  std::array<uint8_t, kNumLengthBytes> partial_length_{};
+  /// How many of the length bytes we've read so far.
+  uint32_t got_length_bytes_ = 0;
+
+  /// Where frame buffers come from.
+  buffer_pool::BufferPool* pool_;
+  /// The largest frame or message we accept.
+  size_t max_message_size_;
+  /// The most messages we reassemble at once.
+  size_t max_partial_messages_;
+  /// Whether we have seen a protocol error.
+  bool failed_ = false;
+
+  /// The frame that we are currently reading.
+  buffer_pool::Buffer partial_frame_{};
+  /// How many bytes of the current frame we've read so far.
+  uint32_t got_frame_bytes_ = 0;
+  /// The length of the frame we're currently reading.
+  uint32_t expected_length_ = 0;
+  /// Whether the frame we're currently reading starts with a header.
+  bool has_header_ = false;
+
+  /// Frames that have been completely read, but not retrieved yet.
+  std::deque<Frame> complete_frames_{};
+  /// Messages that we have some of the fragments for, by stream.
+  std::unordered_map<uint32_t, PartialMessage> partial_messages_{};
+};
+
 /**
  * @brief A parser for serialized messages.
+ * @note This only understands frames without a header. Use `FrameParser` for
+ *  streams that might contain headers.
  * @tparam MessageType The type of message to parse.
  */
 template <class MessageType>
@@ -2,6 +2,8 @@
 
 #include <memory>
 #include <sstream>
+#include <utility>
+#include <vector>
 
 #include "client_tasks/download_task.h"
 #include "client_tasks/terminate_task.h"
@@ -64,7 +66,7 @@ bool Client::WaitForMessage() {
   return connected_;
 }
 
-void Client::HandleResponse() {
+ftp_messages::Response Client::HandleResponse() {
   ftp_messages::Response msg;
 
   parser_.GetMessage(&msg);
@@ -86,17 +88,23 @@ void Client::HandleResponse() {
   } else if (msg.has_put()) {
     auto put_response = msg.put();
     std::cout << "command_id: " << std::to_string(put_response.command_id());
+    if (put_response.deduplicated()) {
+      std::cout << " (already on the server, nothing to send)";
+    }
   } else if (msg.has_get()) {
     auto get_response = msg.get();
     std::cout << "command_id: " << std::to_string(get_response.command_id());
   }
   std::cout << std::endl;
+
+  return msg;
 }
 
 void Client::FtpShell() {
   ftp_messages::Request r;
   ftp_messages::Request r_old;
   std::shared_ptr<client_tasks::UploadTask> put_task;
+  std::vector<std::shared_ptr<client_tasks::UploadTask>> stripe_tasks;
   std::shared_ptr<client_tasks::DownloadTask> get_task;
   thread_pool::ThreadPool pool;
   while (connected_) {
@@ -134,7 +142,13 @@ void Client::FtpShell() {
         pool.WaitForCompletion(get_task);
       } else if (r_old.has_put()) {
         pool.CancelTask(put_task);
+        for (const auto &kStripeTask : stripe_tasks) {
+          pool.CancelTask(kStripeTask);
+        }
         pool.WaitForCompletion(put_task);
+        for (const auto &kStripeTask : stripe_tasks) {
+          pool.WaitForCompletion(kStripeTask);
+        }
       }
 
       continue;
@@ -146,26 +160,44 @@ void Client::FtpShell() {
       connected_ = false;
       continue;
     }
+    if (r.has_put()) {
+      // The task decides whether to send the file in stripes.
+      put_task = std::make_shared<client_tasks::UploadTask>(client_fd_,
+                                                            ip->GetFilename());
+      put_task->PrepareRequest(r.mutable_put());
+    } else if (r.has_get()) {
+      // The task decides which part of the file to ask for first.
+      get_task = std::make_shared<client_tasks::DownloadTask>(
+          ip->GetFilename(), client_fd_, hostname_, nport_, tport_);
+      get_task->PrepareRequest(r.mutable_get());
+    }
     wire_protocol::Serialize(r, &outgoing_msg_buf_);
     SendReq();
     WaitForMessage();
-    HandleResponse();
+    // Anything after the response is the start of the file, if one follows.
+    std::vector<uint8_t> leftover = parser_.GetOverflow();
+    const auto kResponse = HandleResponse();
     if (r.has_put()) {
-      // If put command, FileContents will have to be sent.
-      auto contents = ip->GetContentsMessage();
-      wire_protocol::Serialize(contents, &outgoing_msg_buf_);
-      put_task = std::make_shared<client_tasks::UploadTask>(client_fd_,
-                                                            outgoing_msg_buf_);
+      // If put command, the file will have to be sent.
+      put_task->SetResponse(kResponse.put());
       pool.AddTask(put_task);
+      // Send the rest of the stripes in parallel.
+      stripe_tasks = put_task->MakeStripeTasks(hostname_, nport_);
+      for (const auto &kStripeTask : stripe_tasks) {
+        pool.AddTask(kStripeTask);
+      }
 
       if (!ip->IsForking()) {
         // Wait synchronously for put.
         pool.WaitForCompletion(put_task);
+        for (const auto &kStripeTask : stripe_tasks) {
+          pool.WaitForCompletion(kStripeTask);
+        }
       }
+      r_old = r;
     } else if (r.has_get()) {
-      // If get command, FileContents will have to be received.
-      get_task = std::make_shared<client_tasks::DownloadTask>(ip->GetFilename(),
-                                                              client_fd_);
+      // If get command, the file will have to be received.
+      get_task->SetResponse(kResponse.get(), std::move(leftover));
       pool.AddTask(get_task);
 
       if (!ip->IsForking()) {
@@ -173,6 +205,17 @@ void Client::FtpShell() {
         pool.WaitForCompletion(get_task);
       }
       r_old = r;
+    } else if (r.has_list()) {
+      // Large directories come back a page at a time.
+      std::string cursor = kResponse.list().next_cursor();
+      while (connected_ && !cursor.empty()) {
+        r.mutable_list()->set_cursor(cursor);
+        wire_protocol::Serialize(r, &outgoing_msg_buf_);
+        if (!SendReq() || !WaitForMessage()) {
+          break;
+        }
+        cursor = HandleResponse().list().next_cursor();
+      }
     }
   }
 }
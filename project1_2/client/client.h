@@ -53,8 +53,9 @@ class Client {
 
   /**
    * @brief extracts relevant information to be displayed to user from response
+   * @return the response that was handled
    */
-  void HandleResponse();
+  ftp_messages::Response HandleResponse();
 
  private:
   /// tracking connection status
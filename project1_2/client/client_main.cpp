@@ -2,6 +2,7 @@
  * @brief Entry point for the FTP client.
  */
 
+#include <csignal>
 #include <loguru.hpp>
 
 #include "client.h"
@@ -11,6 +12,9 @@ int main(int argc, char **argv) {
 
   // initialize client logging
   loguru::init(argc, argv);
+  // A server that drops a connection should fail that transfer rather than
+  // killing the client.
+  std::signal(SIGPIPE, SIG_IGN);
   loguru::add_file("client_error.log", loguru::Append, loguru::Verbosity_ERROR);
   loguru::add_file("client_latest_error.log", loguru::Truncate,
                    loguru::Verbosity_ERROR);
@@ -1,19 +1,204 @@
 #include "download_task.h"
 
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <loguru.hpp>
 #include <utility>
 
 namespace client_tasks {
+namespace {
+
+/// How long to wait for data before checking again, in milliseconds.
+/// Cancellation wakes us up early.
+constexpr int kPollTimeoutMs = 250;
+
+/// Size of the buffer to read responses into.
+constexpr size_t kResponseBufferSize = 4096;
+
+}  // namespace
 
-DownloadTask::DownloadTask(std::string filename, int client_fd)
+DownloadTask::DownloadTask(std::string filename, int client_fd,
+                           std::string hostname, uint16_t nport,
+                           uint16_t tport)
     : filename_(std::move(filename)),
       client_fd_(client_fd),
-      receiver_(client_fd_){};
+      hostname_(std::move(hostname)),
+      nport_(nport),
+      tport_(tport),
+      legacy_receiver_(client_fd_),
+      tracker_(filename_ + ".ranges"){};
+
+void DownloadTask::PrepareRequest(ftp_messages::GetRequest* request) {
+  first_offset_ = tracker_.Load();
+  max_chunk_size_ = request->max_chunk_size();
+
+  request->set_offset(first_offset_);
+  request->set_length(RangeTracker::kRangeSize);
+}
+
+void DownloadTask::SetResponse(const ftp_messages::GetResponse& response,
+                               std::vector<uint8_t> initial_data) {
+  response_ = response;
+  initial_data_ = std::move(initial_data);
+}
+
+thread_pool::Task::Status DownloadTask::SetUp() {
+  if (!response_.raw_chunks()) {
+    return thread_pool::Task::Status::RUNNING;
+  }
+
+  auto main_lane = std::make_unique<Lane>();
+  main_lane->socket = client_fd_;
+  main_lane->state = LaneState::RECEIVING;
+  main_lane->command_id = response_.command_id();
+
+  if (response_.path().empty()) {
+    // The server couldn't open the file, so all that's coming is an aborted
+    // stream. Leave anything from an earlier attempt alone.
+    main_lane->receiver.emplace(client_fd_, -1, std::move(initial_data_));
+    lanes_.push_back(std::move(main_lane));
+    return thread_pool::Task::Status::RUNNING;
+  }
+
+  const std::string kPartPath = filename_ + ".part";
+  bool can_save = tracker_.SetFile(response_.file_size(),
+                                   response_.modified_time_ns());
+  if (!can_save) {
+    LOG_S(ERROR) << "Failed to save progress for " << filename_ << ".";
+  } else {
+    // Ranges are written wherever they belong, so don't truncate what an
+    // earlier attempt left behind.
+    file_fd_ = open(kPartPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file_fd_ < 0 || ftruncate(file_fd_, response_.file_size()) != 0) {
+      LOG_S(ERROR) << "Failed to open " << kPartPath << ": "
+                   << strerror(errno);
+      if (file_fd_ >= 0) {
+        close(file_fd_);
+        file_fd_ = -1;
+      }
+      can_save = false;
+    }
+  }
+
+  if (!can_save) {
+    // Nothing we receive could be marked as done, so give up. The server is
+    // already sending the first range, though, so `CleanUp()` still has to
+    // deal with it.
+    if (!tracker_.HasProgress()) {
+      tracker_.Remove();
+    }
+    main_lane->receiver.emplace(client_fd_, -1, std::move(initial_data_));
+    lanes_.push_back(std::move(main_lane));
+    return thread_pool::Task::Status::FAILED;
+  }
+
+  main_lane->range = tracker_.GetRange(first_offset_);
+  if (main_lane->range) {
+    tracker_.Claim(main_lane->range->index);
+  }
+  main_lane->receiver.emplace(client_fd_, file_fd_, std::move(initial_data_),
+                              first_offset_);
+  lanes_.push_back(std::move(main_lane));
+
+  // Fetch the rest of the file in parallel.
+  while (lanes_.size() < kMaxConnections && tracker_.GetNumUnclaimed() > 0 &&
+         AddLane()) {
+  }
+
+  return thread_pool::Task::Status::RUNNING;
+}
 
 thread_pool::Task::Status DownloadTask::RunAtomic() {
-  if (!receiver_.HasCompleteFile()) {
-    const auto bytes_read = receiver_.ReceiveNextChunk();
+  if (!response_.raw_chunks()) {
+    return RunLegacy();
+  }
+
+  // Put idle connections to work, in case a range was given up.
+  bool busy = false;
+  for (size_t i = lanes_.size(); i-- > 0;) {
+    Lane* lane = lanes_[i].get();
+    if (lane->state == LaneState::IDLE && tracker_.GetNumUnclaimed() > 0 &&
+        !StartNextRange(lane)) {
+      if (i == 0) {
+        return thread_pool::Task::Status::FAILED;
+      }
+      RemoveLane(i);
+      continue;
+    }
+    busy |= lane->state != LaneState::IDLE;
+  }
+  if (!busy) {
+    return tracker_.IsComplete() ? thread_pool::Task::Status::DONE
+                                 : thread_pool::Task::Status::FAILED;
+  }
+
+  // Wait for any of the connections to have something for us.
+  std::vector<struct pollfd> poll_fds;
+  int timeout_ms = kPollTimeoutMs;
+  for (const auto& kLane : lanes_) {
+    // Negative FDs are ignored, and there's nothing to read on idle ones.
+    poll_fds.push_back(
+        {kLane->state == LaneState::IDLE ? -1 : kLane->socket, POLLIN, 0});
+    if (kLane->receiver && kLane->receiver->HasBufferedData()) {
+      // That data won't wake up poll().
+      timeout_ms = 0;
+    }
+  }
+  poll_fds.push_back({cancelled_.GetFd(), POLLIN, 0});
+
+  const int kNumReady = poll(poll_fds.data(), poll_fds.size(), timeout_ms);
+  if (poll_fds.back().revents != 0) {
+    // The pool will notice that we were cancelled.
+    return thread_pool::Task::Status::RUNNING;
+  }
+  if (kNumReady < 0) {
+    if (errno == EINTR) {
+      return thread_pool::Task::Status::RUNNING;
+    }
+    LOG_S(ERROR) << "poll() failed: " << strerror(errno);
+    return thread_pool::Task::Status::FAILED;
+  }
+
+  // Go backwards, so that removing a connection doesn't skip any.
+  for (size_t i = lanes_.size(); i-- > 0;) {
+    Lane* lane = lanes_[i].get();
+    const bool kHasBufferedData =
+        lane->receiver && lane->receiver->HasBufferedData();
+    if (poll_fds[i].revents == 0 && !kHasBufferedData) {
+      continue;
+    }
+
+    bool success = true;
+    if (lane->state == LaneState::AWAITING_RESPONSE) {
+      success = ReadResponse(lane);
+    } else if (lane->state == LaneState::RECEIVING) {
+      success = ReadRange(lane);
+    }
+    if (success) {
+      continue;
+    }
+
+    if (i == 0) {
+      // We need the main connection for other commands, so we can't just
+      // give up on it.
+      return thread_pool::Task::Status::FAILED;
+    }
+    // Somebody else can fetch the range.
+    RemoveLane(i);
+  }
+
+  return thread_pool::Task::Status::RUNNING;
+}
+
+thread_pool::Task::Status DownloadTask::RunLegacy() {
+  if (!legacy_receiver_.HasCompleteFile()) {
+    const auto bytes_read = legacy_receiver_.ReceiveNextChunk();
     if (bytes_read < 0) {
       if (errno == EWOULDBLOCK || errno == EAGAIN) {
         // This is merely a timeout, and we should just spin again.
@@ -21,7 +206,7 @@ thread_pool::Task::Status DownloadTask::RunAtomic() {
       }
 
       LOG_S(ERROR) << "Socket error: " << strerror(errno);
-      receiver_.Reset();
+      legacy_receiver_.Reset();
       return thread_pool::Task::Status::FAILED;
     } else if (bytes_read == 0) {
       // Orderly shutdown from server.
@@ -32,7 +217,7 @@ thread_pool::Task::Status DownloadTask::RunAtomic() {
   } else {
     // Parse the complete message.
     std::vector<uint8_t> contents;
-    receiver_.GetFileContents(&contents);
+    legacy_receiver_.GetFileContents(&contents);
     client_util::SaveIncomingFile({contents.begin(), contents.end()},
                                   filename_);
 
@@ -40,8 +225,217 @@ thread_pool::Task::Status DownloadTask::RunAtomic() {
   }
 }
 
+bool DownloadTask::StartNextRange(Lane* lane) {
+  lane->range = tracker_.ClaimNext();
+  if (!lane->range) {
+    // Nothing left to fetch.
+    lane->state = LaneState::IDLE;
+    return true;
+  }
+
+  // Use the absolute path, since other connections might be in a different
+  // directory.
+  ftp_messages::Request request;
+  auto* get = request.mutable_get();
+  get->set_filename(response_.path());
+  get->set_max_chunk_size(max_chunk_size_);
+  get->set_offset(lane->range->offset);
+  get->set_length(lane->range->length);
+
+  std::vector<uint8_t> outgoing;
+  if (!wire_protocol::Serialize(request, &outgoing) ||
+      client_util::SendForever(lane->socket, outgoing.data(), outgoing.size(),
+                               0) < 0) {
+    LOG_S(ERROR) << "Failed to request a range of " << filename_ << ": "
+                 << strerror(errno);
+    tracker_.Release(lane->range->index);
+    lane->range.reset();
+    lane->state = LaneState::IDLE;
+    return false;
+  }
+
+  lane->parser.ResetParser();
+  lane->state = LaneState::AWAITING_RESPONSE;
+  return true;
+}
+
+bool DownloadTask::ReadResponse(Lane* lane) {
+  std::vector<uint8_t> incoming(kResponseBufferSize);
+  const auto kBytesRead =
+      recv(lane->socket, incoming.data(), incoming.size(), 0);
+  if (kBytesRead < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+    // This is merely a timeout, and we should just spin again.
+    return true;
+  } else if (kBytesRead <= 0) {
+    LOG_S(ERROR) << "Lost connection while getting " << filename_ << ".";
+    return false;
+  }
+
+  incoming.resize(kBytesRead);
+  lane->parser.AddNewData(incoming);
+  if (!lane->parser.HasCompleteMessage()) {
+    return true;
+  }
+
+  // Anything after the response is the start of the range.
+  std::vector<uint8_t> initial_data = lane->parser.GetOverflow();
+  ftp_messages::Response response;
+  const bool kParsed = lane->parser.GetMessage(&response);
+  lane->parser.ResetParser();
+
+  const auto& kGet = response.get();
+  lane->command_id = kGet.command_id();
+  lane->state = LaneState::RECEIVING;
+  if (!kParsed || !kGet.raw_chunks()) {
+    LOG_S(ERROR) << "Got an invalid response while getting " << filename_
+                 << ".";
+    return false;
+  }
+
+  if (kGet.path().empty() || kGet.file_size() != response_.file_size() ||
+      kGet.modified_time_ns() != response_.modified_time_ns()) {
+    // We can't mix ranges from different versions of the file. The server
+    // is still going to send something, so throw it away.
+    LOG_S(ERROR) << filename_ << " changed on the server during download.";
+    tracker_.Release(lane->range->index);
+    lane->range.reset();
+    lane->receiver.emplace(lane->socket, -1, std::move(initial_data));
+    return false;
+  }
+
+  lane->receiver.emplace(lane->socket, file_fd_, std::move(initial_data),
+                         lane->range->offset);
+  return true;
+}
+
+bool DownloadTask::ReadRange(Lane* lane) {
+  const auto kBytesRead = lane->receiver->ReceiveNextChunk();
+  if (kBytesRead < 0) {
+    if (errno == EWOULDBLOCK || errno == EAGAIN) {
+      // This is merely a timeout, and we should just spin again.
+      return true;
+    }
+
+    LOG_S(ERROR) << "Download error: " << strerror(errno);
+    return false;
+  } else if (kBytesRead == 0) {
+    // Orderly shutdown from server.
+    LOG_S(ERROR) << "Server closed the connection while sending " << filename_
+                 << ".";
+    return false;
+  }
+
+  if (!lane->receiver->HasCompleteFile()) {
+    return true;
+  }
+  if (lane->receiver->WasAborted()) {
+    LOG_S(WARNING) << "Server aborted the download of " << filename_ << ".";
+    return false;
+  }
+
+  if (lane->range) {
+    tracker_.Complete(lane->range->index);
+  }
+  lane->receiver.reset();
+  return StartNextRange(lane);
+}
+
+bool DownloadTask::AddLane() {
+  const int kSocket = client_util::SetUpSocket(
+      client_util::MakeAddress(nport_), hostname_);
+  if (kSocket < 0) {
+    return false;
+  }
+
+  auto lane = std::make_unique<Lane>();
+  lane->socket = kSocket;
+  if (!StartNextRange(lane.get())) {
+    close(kSocket);
+    return false;
+  }
+
+  lanes_.push_back(std::move(lane));
+  return true;
+}
+
+void DownloadTask::RemoveLane(size_t lane_index) {
+  Lane* lane = lanes_[lane_index].get();
+  if (lane->range) {
+    tracker_.Release(lane->range->index);
+  }
+  // If the server is still sending, this makes it stop.
+  close(lane->socket);
+
+  lanes_.erase(lanes_.begin() + lane_index);
+}
+
+void DownloadTask::TerminateMainLane() {
+  ftp_messages::Request request;
+  request.mutable_terminate()->set_command_id(lanes_[0]->command_id);
+
+  std::vector<uint8_t> outgoing;
+  const int kSocket = client_util::SetUpSocket(
+      client_util::MakeAddress(tport_), hostname_);
+  if (kSocket < 0 || !wire_protocol::Serialize(request, &outgoing) ||
+      client_util::SendForever(kSocket, outgoing.data(), outgoing.size(), 0) <
+          0) {
+    // We'll just have to read the rest of the range.
+    LOG_S(WARNING) << "Failed to terminate the download of " << filename_
+                   << ".";
+  }
+  if (kSocket >= 0) {
+    close(kSocket);
+  }
+}
+
 void DownloadTask::CleanUp() {
-  receiver_.CleanUp();
+  if (!response_.raw_chunks()) {
+    legacy_receiver_.CleanUp();
+    return;
+  }
+
+  while (lanes_.size() > 1) {
+    RemoveLane(lanes_.size() - 1);
+  }
+
+  if (!lanes_.empty()) {
+    // Make sure we leave the main connection at a message boundary.
+    Lane* main_lane = lanes_[0].get();
+    while (main_lane->state == LaneState::AWAITING_RESPONSE &&
+           !main_lane->receiver && ReadResponse(main_lane)) {
+    }
+    if (main_lane->receiver) {
+      if (!main_lane->receiver->HasCompleteFile()) {
+        // There's no point in reading the rest of the range.
+        TerminateMainLane();
+      }
+      main_lane->receiver->CleanUp();
+    }
+    lanes_.clear();
+  }
+
+  if (file_fd_ < 0) {
+    return;
+  }
+  close(file_fd_);
+
+  const std::string kPartPath = filename_ + ".part";
+  if (tracker_.IsComplete()) {
+    if (std::rename(kPartPath.c_str(), filename_.c_str()) != 0) {
+      LOG_S(ERROR) << "Failed to save " << filename_ << ": "
+                   << strerror(errno);
+    }
+    tracker_.Remove();
+  } else if (!tracker_.HasProgress()) {
+    // Nothing worth resuming.
+    std::remove(kPartPath.c_str());
+    tracker_.Remove();
+  } else {
+    LOG_S(INFO) << "Download of " << filename_
+                << " was interrupted. Get it again to resume.";
+  }
 }
 
+void DownloadTask::OnCancel() { cancelled_.Signal(); }
+
 }  // namespace client_tasks
@@ -1,37 +1,188 @@
 /**
- * @file Task for downloading a FileContents message asynchronously
+ * @file Task for downloading a file asynchronously
  */
 
 #ifndef PROJECT1_DOWNLOAD_TASK_H
 #define PROJECT1_DOWNLOAD_TASK_H
 
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "chunked_files/chunked_file_receiver.h"
+#include "chunked_files/file_stream_receiver.h"
+#include "ftp_messages.pb.h"
+#include "range_tracker.h"
 #include "thread_pool/task.h"
+#include "thread_pool/wakeup_event.h"
+#include "wire_protocol/wire_protocol.h"
 #include "../client_util.h"
 
 namespace client_tasks {
+
+/**
+ * @brief Downloads a file from the server.
+ * @details The file is split into ranges. The first one comes over the main
+ *    connection, in response to the original request, and the rest are
+ *    fetched in parallel over extra connections. Ranges are written into a
+ *    `.part` file as they arrive, and it is renamed once all of them are
+ *    there. If the download is interrupted, the ranges that finished are
+ *    remembered, and getting the same file again only fetches the rest.
+ */
 class DownloadTask : public thread_pool::Task {
  public:
+  /// Most connections to download a single file over, including the main
+  /// one.
+  static constexpr size_t kMaxConnections = 4;
+
   /**
    * @param filename the name of the file to be saved
-   * @param client_fd the socket to retrieve the FileContents message
+   * @param client_fd the main connection to the server
+   * @param hostname the address of the server, for opening extra connections
+   * @param nport the normal port on the server
+   * @param tport the terminate port on the server
+   */
+  DownloadTask(std::string filename, int client_fd, std::string hostname,
+               uint16_t nport, uint16_t tport);
+
+  /**
+   * @brief Fills in the request for the main connection. If an earlier
+   *    download of this file was interrupted, it asks for the first range
+   *    that is missing.
+   * @param request[out] The request to fill in.
+   */
+  void PrepareRequest(ftp_messages::GetRequest* request);
+
+  /**
+   * @brief Sets the response that the server sent on the main connection.
+   *    This must be called before the task is started.
+   * @param response The response.
+   * @param initial_data file data that was already read from the socket
+   *    along with the response
    */
-  DownloadTask(std::string filename, int client_fd);
+  void SetResponse(const ftp_messages::GetResponse& response,
+                   std::vector<uint8_t> initial_data);
+
+  Status SetUp() override;
 
   Status RunAtomic() override;
 
+  /**
+   * @brief Leaves the main connection ready for the next command, and keeps
+   *    whatever was downloaded so that it can be resumed.
+   */
   void CleanUp() override;
 
+  void OnCancel() override;
+
  protected:
+  /// Where a connection is in fetching its range.
+  enum class LaneState {
+    /// Not fetching anything.
+    IDLE,
+    /// Sent a request, and waiting for the response.
+    AWAITING_RESPONSE,
+    /// Receiving the file data.
+    RECEIVING,
+  };
+
+  /// One connection that we are downloading over.
+  struct Lane {
+    /// The socket.
+    int socket;
+    /// What it's doing.
+    LaneState state = LaneState::IDLE;
+    /// The range it is fetching.
+    std::optional<Range> range{};
+    /// The ID of the command that is fetching the range.
+    uint32_t command_id = 0;
+    /// Parses the response to each request.
+    wire_protocol::MessageParser<ftp_messages::Response> parser{};
+    /// Receives the file data. Only set while receiving.
+    std::optional<chunked_files::FileStreamReceiver> receiver{};
+  };
+
+  /**
+   * @brief Downloads a file that isn't coming as raw chunks, which only
+   *    happens with old servers. That can't be done in parallel.
+   * @return The status of the task.
+   */
+  Status RunLegacy();
+
+  /**
+   * @brief Asks for the next range that nobody has claimed, if there is one.
+   * @param lane The connection to ask on.
+   * @return False if the request couldn't be sent.
+   */
+  bool StartNextRange(Lane* lane);
+
+  /**
+   * @brief Reads the response to a range request.
+   * @param lane The connection it is coming on.
+   * @return False if the server can't send the range.
+   */
+  bool ReadResponse(Lane* lane);
+
+  /**
+   * @brief Reads the next part of a range.
+   * @param lane The connection it is coming on.
+   * @return False if the range can't be received.
+   */
+  bool ReadRange(Lane* lane);
+
+  /**
+   * @brief Opens a new connection and starts fetching a range on it.
+   * @return True if it did.
+   */
+  bool AddLane();
+
+  /**
+   * @brief Closes an extra connection, and gives up its range.
+   * @param lane_index The index of the connection.
+   */
+  void RemoveLane(size_t lane_index);
+
+  /**
+   * @brief Tells the server to stop sending on the main connection.
+   */
+  void TerminateMainLane();
 
   /// the name of the file to be retrieved
   std::string filename_{};
 
-  /// client socket
+  /// main connection
   int client_fd_;
 
-  /// Receiver for chunked files.
-  chunked_files::ChunkedFileReceiver receiver_;
+  /// the address of the server
+  std::string hostname_;
+  /// the normal port on the server
+  uint16_t nport_;
+  /// the terminate port on the server
+  uint16_t tport_;
+
+  /// The response to the original request.
+  ftp_messages::GetResponse response_{};
+  /// Data that was read along with the response.
+  std::vector<uint8_t> initial_data_{};
+  /// The offset that the original request asked for.
+  uint64_t first_offset_ = 0;
+  /// The largest chunk that the original request asked for.
+  uint32_t max_chunk_size_ = 0;
+
+  /// Receiver for files that don't come as raw chunks.
+  chunked_files::ChunkedFileReceiver legacy_receiver_;
+
+  /// Keeps track of which ranges we have.
+  RangeTracker tracker_;
+  /// FD of the `.part` file that we are saving ranges to.
+  int file_fd_ = -1;
+  /// Every connection we are using. The main one is always first.
+  std::vector<std::unique_ptr<Lane>> lanes_{};
+
+  /// Signalled when the task is cancelled, to wake up `poll()`.
+  thread_pool::WakeupEvent cancelled_{};
 };
-}
+}  // namespace client_tasks
 #endif  // PROJECT1_DOWNLOAD_TASK_H
@@ -0,0 +1,118 @@
+#include "range_tracker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+namespace client_tasks {
+
+RangeTracker::RangeTracker(std::string state_path)
+    : state_path_(std::move(state_path)) {}
+
+uint64_t RangeTracker::Load() {
+  saved_done_.clear();
+
+  // The first line identifies the version of the file, and every line after
+  // that is the index of a range that finished.
+  std::ifstream state(state_path_);
+  if (!(state >> saved_file_size_ >> saved_modified_time_ns_)) {
+    return 0;
+  }
+  size_t index;
+  while (state >> index) {
+    saved_done_.insert(index);
+  }
+
+  size_t first_missing = 0;
+  while (saved_done_.count(first_missing) != 0) {
+    ++first_missing;
+  }
+  return first_missing * kRangeSize;
+}
+
+bool RangeTracker::SetFile(uint64_t file_size, int64_t modified_time_ns) {
+  file_size_ = file_size;
+  // Even an empty file has one (empty) range to fetch.
+  const size_t kNumRanges =
+      std::max<uint64_t>((file_size + kRangeSize - 1) / kRangeSize, 1);
+  ranges_.assign(kNumRanges, RangeState::PENDING);
+
+  if (file_size == saved_file_size_ &&
+      modified_time_ns == saved_modified_time_ns_) {
+    // Pick up where we left off.
+    for (const size_t kIndex : saved_done_) {
+      if (kIndex < kNumRanges) {
+        ranges_[kIndex] = RangeState::DONE;
+      }
+    }
+    return true;
+  }
+
+  // The saved progress was for a different version of the file, so start
+  // over.
+  saved_done_.clear();
+  saved_file_size_ = file_size;
+  saved_modified_time_ns_ = modified_time_ns;
+  std::ofstream state(state_path_, std::ios::trunc);
+  state << file_size << " " << modified_time_ns << "\n";
+  return static_cast<bool>(state);
+}
+
+std::optional<Range> RangeTracker::GetRange(uint64_t offset) const {
+  const size_t kIndex = offset / kRangeSize;
+  if (kIndex >= ranges_.size() || offset % kRangeSize != 0) {
+    return std::nullopt;
+  }
+  return MakeRange(kIndex);
+}
+
+void RangeTracker::Claim(size_t index) { ranges_[index] = RangeState::CLAIMED; }
+
+std::optional<Range> RangeTracker::ClaimNext() {
+  const auto kNext =
+      std::find(ranges_.begin(), ranges_.end(), RangeState::PENDING);
+  if (kNext == ranges_.end()) {
+    return std::nullopt;
+  }
+
+  *kNext = RangeState::CLAIMED;
+  return MakeRange(kNext - ranges_.begin());
+}
+
+void RangeTracker::Release(size_t index) {
+  if (ranges_[index] == RangeState::CLAIMED) {
+    ranges_[index] = RangeState::PENDING;
+  }
+}
+
+void RangeTracker::Complete(size_t index) {
+  ranges_[index] = RangeState::DONE;
+  saved_done_.insert(index);
+
+  // Appending keeps whatever finished before a crash.
+  std::ofstream state(state_path_, std::ios::app);
+  state << index << "\n";
+}
+
+size_t RangeTracker::GetNumUnclaimed() const {
+  return std::count(ranges_.begin(), ranges_.end(), RangeState::PENDING);
+}
+
+bool RangeTracker::IsComplete() const {
+  return !ranges_.empty() &&
+         std::all_of(ranges_.begin(), ranges_.end(), [](RangeState state) {
+           return state == RangeState::DONE;
+         });
+}
+
+bool RangeTracker::HasProgress() const { return !saved_done_.empty(); }
+
+void RangeTracker::Remove() { std::remove(state_path_.c_str()); }
+
+Range RangeTracker::MakeRange(size_t index) const {
+  const uint64_t kOffset = index * kRangeSize;
+  return {index, kOffset, std::min(kRangeSize, file_size_ - kOffset)};
+}
+
+}  // namespace client_tasks
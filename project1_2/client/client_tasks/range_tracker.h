@@ -0,0 +1,147 @@
+/**
+ * @file Keeps track of which ranges of a download are done
+ */
+
+#ifndef PROJECT1_RANGE_TRACKER_H
+#define PROJECT1_RANGE_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace client_tasks {
+
+/// One range of a file being downloaded.
+struct Range {
+  /// Which range this is.
+  size_t index;
+  /// Where in the file it starts.
+  uint64_t offset;
+  /// How many bytes it covers.
+  uint64_t length;
+};
+
+/**
+ * @brief Splits a file into fixed-size ranges, and keeps track of which ones
+ *    have been downloaded.
+ * @details Completed ranges are saved to a state file as they finish, so an
+ *    interrupted download can pick up where it left off. The state file is
+ *    only trusted if the file on the server still has the same size and
+ *    modification time.
+ */
+class RangeTracker {
+ public:
+  /// Size of each range, except possibly the last one.
+  static constexpr uint64_t kRangeSize = 16 * 1024 * 1024;
+
+  /**
+   * @param state_path Where to save progress.
+   */
+  explicit RangeTracker(std::string state_path);
+
+  /**
+   * @brief Loads progress saved by an earlier attempt, if there is any.
+   * @return The offset of the first range that the earlier attempt didn't
+   *    finish, which is 0 if there was no earlier attempt.
+   */
+  uint64_t Load();
+
+  /**
+   * @brief Sets the version of the file that we are downloading. Saved
+   *    progress is kept if it was for the same version, and thrown away
+   *    otherwise.
+   * @param file_size The size of the file.
+   * @param modified_time_ns When the file was last modified.
+   * @return False if the state file could not be written.
+   */
+  bool SetFile(uint64_t file_size, int64_t modified_time_ns);
+
+  /**
+   * @param offset An offset in the file.
+   * @return The range that starts at that offset, or nothing if it is past
+   *    the end of the file.
+   */
+  [[nodiscard]] std::optional<Range> GetRange(uint64_t offset) const;
+
+  /**
+   * @brief Claims a range, so that nobody else takes it.
+   * @param index The range to claim.
+   */
+  void Claim(size_t index);
+
+  /**
+   * @brief Claims the next range that isn't done or claimed yet.
+   * @return The range, or nothing if there are none left.
+   */
+  std::optional<Range> ClaimNext();
+
+  /**
+   * @brief Gives up on a claimed range, so that it can be claimed again.
+   * @param index The range.
+   */
+  void Release(size_t index);
+
+  /**
+   * @brief Marks a range as done, and saves that.
+   * @param index The range.
+   */
+  void Complete(size_t index);
+
+  /**
+   * @return The number of ranges that are neither done nor claimed.
+   */
+  [[nodiscard]] size_t GetNumUnclaimed() const;
+
+  /**
+   * @return True if every range is done.
+   */
+  [[nodiscard]] bool IsComplete() const;
+
+  /**
+   * @return True if at least one range is done, counting ones saved by an
+   *    earlier attempt.
+   */
+  [[nodiscard]] bool HasProgress() const;
+
+  /**
+   * @brief Deletes the state file.
+   */
+  void Remove();
+
+ private:
+  /// State of a single range.
+  enum class RangeState {
+    PENDING,
+    CLAIMED,
+    DONE,
+  };
+
+  /**
+   * @brief Makes a `Range` from its index.
+   * @param index The index.
+   * @return The range.
+   */
+  [[nodiscard]] Range MakeRange(size_t index) const;
+
+  /// Where progress is saved.
+  std::string state_path_;
+
+  /// Size of the file the saved progress is for.
+  uint64_t saved_file_size_ = 0;
+  /// Modification time of the file the saved progress is for.
+  int64_t saved_modified_time_ns_ = 0;
+  /// Ranges that the saved progress says are done.
+  std::set<size_t> saved_done_{};
+
+  /// Size of the file we are downloading.
+  uint64_t file_size_ = 0;
+  /// State of each range of the file.
+  std::vector<RangeState> ranges_{};
+};
+
+}  // namespace client_tasks
+
+#endif  // PROJECT1_RANGE_TRACKER_H
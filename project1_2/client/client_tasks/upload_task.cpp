@@ -1,40 +1,222 @@
 #include "upload_task.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
 #include <loguru.hpp>
+#include <utility>
 
+#include "content_hash/sha256.h"
+#include "wire_protocol/wire_protocol.h"
+#include "../client_util.h"
 
 namespace client_tasks {
+namespace {
+
+/// Size of the buffer to read responses into.
+constexpr size_t kResponseBufferSize = 1024;
+
+}  // namespace
+
+UploadTask::UploadTask(int client_fd, std::string filename)
+    : client_fd_(client_fd),
+      filename_(std::move(filename)),
+      upload_failed_(std::make_shared<std::atomic<bool>>(false)) {}
 
-UploadTask::UploadTask(int client_fd, const std::vector<uint8_t>& file_data)
-    : client_fd_(client_fd), sender_(client_fd_) {
-  sender_.SetFileContents(file_data);
+UploadTask::UploadTask(std::string filename, std::string hostname,
+                       uint16_t nport, ftp_messages::PutRequest request,
+                       std::shared_ptr<std::atomic<bool>> failed)
+    : client_fd_(-1),
+      owns_socket_(true),
+      filename_(std::move(filename)),
+      hostname_(std::move(hostname)),
+      nport_(nport),
+      stripe_request_(std::move(request)),
+      offset_(stripe_request_.offset()),
+      length_(stripe_request_.length()),
+      upload_id_(stripe_request_.upload_id()),
+      upload_failed_(std::move(failed)) {}
+
+void UploadTask::PrepareRequest(ftp_messages::PutRequest* request) {
+  const int kFileFd = open(filename_.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat file_stat {};
+  if (kFileFd < 0 || fstat(kFileFd, &file_stat) != 0) {
+    // SetUp() will fail to open it, and abort the upload.
+    if (kFileFd >= 0) {
+      close(kFileFd);
+    }
+    return;
+  }
+  file_size_ = file_stat.st_size;
+
+  // If the server already has these contents, it can skip the upload.
+  request->set_file_size(file_size_);
+  request->set_content_hash(content_hash::HashFile(kFileFd));
+  close(kFileFd);
+
+  // Only split the file if every stripe is big enough to be worth a
+  // connection.
+  num_stripes_ = std::clamp<uint64_t>(file_size_ / kMinStripeSize, 1,
+                                      kMaxStripes);
+  if (num_stripes_ == 1) {
+    return;
+  }
+  stripe_size_ = (file_size_ + num_stripes_ - 1) / num_stripes_;
+  length_ = stripe_size_;
+
+  request->set_num_stripes(num_stripes_);
+  request->set_offset(0);
+  request->set_length(length_);
 }
 
-thread_pool::Task::Status UploadTask::RunAtomic() {
-  if (sender_.SentCompleteFile()) {
-    return thread_pool::Task::Status::DONE;
+void UploadTask::SetResponse(const ftp_messages::PutResponse& response) {
+  max_chunk_size_ = response.max_chunk_size();
+  upload_id_ = response.upload_id();
+  path_ = response.path();
+  deduplicated_ = response.deduplicated();
+
+  if (deduplicated_) {
+    // The server already wrote the file, so there are no stripes to send.
+    num_stripes_ = 1;
+    return;
+  }
+
+  if (num_stripes_ > 1 && upload_id_ == 0) {
+    // The server can't take stripes, so it is expecting the whole file on
+    // this connection.
+    num_stripes_ = 1;
+    length_ = 0;
+  }
+}
+
+std::vector<std::shared_ptr<UploadTask>> UploadTask::MakeStripeTasks(
+    const std::string& hostname, uint16_t nport) {
+  std::vector<std::shared_ptr<UploadTask>> tasks;
+  for (uint32_t i = 1; i < num_stripes_; ++i) {
+    const uint64_t kOffset = i * stripe_size_;
+
+    // Use the absolute path, since the new connection starts out in a
+    // different directory.
+    ftp_messages::PutRequest request;
+    request.set_filename(path_);
+    request.set_raw_chunks(true);
+    request.set_file_size(file_size_);
+    request.set_num_stripes(num_stripes_);
+    request.set_upload_id(upload_id_);
+    request.set_offset(kOffset);
+    request.set_length(std::min(stripe_size_, file_size_ - kOffset));
+
+    // The constructor is protected, so we can't use make_shared().
+    tasks.emplace_back(new UploadTask(filename_, hostname, nport,
+                                      std::move(request), upload_failed_));
   }
 
-  const int kSendResult = sender_.SendNextChunk();
+  return tasks;
+}
+
+bool UploadTask::RequestStripe() {
+  client_fd_ = client_util::SetUpSocket(client_util::MakeAddress(nport_),
+                                        hostname_);
+  if (client_fd_ < 0) {
+    return false;
+  }
 
-  if (kSendResult < 0) {
-    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-      // Time out. Give it another try.
-      return thread_pool::Task::Status::RUNNING;
+  ftp_messages::Request request;
+  *request.mutable_put() = stripe_request_;
+  std::vector<uint8_t> outgoing;
+  if (!wire_protocol::Serialize(request, &outgoing) ||
+      client_util::SendForever(client_fd_, outgoing.data(), outgoing.size(),
+                               0) < 0) {
+    failed_ = true;
+    return false;
+  }
+
+  // The server doesn't send anything else until it has the stripe, so
+  // there is nothing past the response.
+  wire_protocol::MessageParser<ftp_messages::Response> parser;
+  std::vector<uint8_t> incoming;
+  while (!parser.HasCompleteMessage()) {
+    incoming.resize(kResponseBufferSize);
+    const auto kBytesRead = client_util::ReceiveForever(
+        client_fd_, incoming.data(), incoming.size(), 0);
+    if (kBytesRead <= 0) {
+      failed_ = true;
+      return false;
     }
+    incoming.resize(kBytesRead);
+    parser.AddNewData(incoming);
+  }
 
-    LOG_S(ERROR) << "Socket error: " << strerror(errno);
-    return thread_pool::Task::Status::FAILED;
+  ftp_messages::Response response;
+  if (!parser.GetMessage(&response)) {
+    failed_ = true;
+    return false;
+  }
+  max_chunk_size_ = response.put().max_chunk_size();
+  // If the server couldn't add the stripe, it is still waiting for one, but
+  // will throw it away.
+  return response.put().upload_id() == upload_id_;
+}
+
+thread_pool::Task::Status UploadTask::SetUp() {
+  if (deduplicated_) {
+    return thread_pool::Task::Status::DONE;
+  }
+  if (owns_socket_ && !RequestStripe()) {
+    LOG_S(ERROR) << "Failed to start a stripe of " << filename_ << ".";
+    *upload_failed_ = true;
+    if (client_fd_ < 0 || failed_) {
+      return thread_pool::Task::Status::FAILED;
+    }
+  }
+
+  const int kFileFd = open(filename_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (kFileFd < 0) {
+    LOG_S(ERROR) << "Failed to open " << filename_ << ": " << strerror(errno);
+    *upload_failed_ = true;
+  }
+  // Even if the file isn't there, the server is waiting for it, so we still
+  // need a sender to abort the upload.
+  sender_.emplace(client_fd_, kFileFd, max_chunk_size_);
+  sender_->SetRange(offset_, length_);
 
-  } else if (kSendResult == 0) {
-    // Orderly shutdown from server. In this case, we assume that the server
-    // side was terminated.
-    LOG_S(INFO) << "Server disconnected, assuming termination.";
+  return *upload_failed_ ? thread_pool::Task::Status::FAILED
+                         : thread_pool::Task::Status::RUNNING;
+}
+
+thread_pool::Task::Status UploadTask::RunAtomic() {
+  if (sender_->SentCompleteFile()) {
     return thread_pool::Task::Status::DONE;
   }
+  if (*upload_failed_) {
+    // Another stripe failed, so there's no point in sending this one.
+    return thread_pool::Task::Status::FAILED;
+  }
+
+  if (sender_->SendNextChunk() < 0) {
+    LOG_S(ERROR) << "Failed to upload " << filename_ << ".";
+    failed_ = true;
+    *upload_failed_ = true;
+    return thread_pool::Task::Status::FAILED;
+  }
 
   return thread_pool::Task::Status::RUNNING;
 }
 
+void UploadTask::CleanUp() {
+  if (sender_ && !failed_ && !sender_->SentCompleteFile()) {
+    // We stopped at a chunk boundary, so we can still end the stream cleanly.
+    sender_->Abort();
+    // Make sure the other stripes stop too.
+    *upload_failed_ = true;
+  }
+  if (owns_socket_ && client_fd_ >= 0) {
+    close(client_fd_);
+  }
+}
+
 }  // namespace client_tasks
@@ -5,29 +5,139 @@
 #ifndef PROJECT1_UPLOAD_TASK_H
 #define PROJECT1_UPLOAD_TASK_H
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "thread_pool/task.h"
-#include "wire_protocol/wire_protocol.h"
-#include "chunked_files/chunked_file_sender.h"
+#include "chunked_files/file_stream_sender.h"
 #include "ftp_messages.pb.h"
 
 namespace client_tasks {
 
+/**
+ * @brief Uploads a file to the server.
+ * @details Large files are split into stripes. The first stripe goes over
+ *    the main connection, and each of the others gets its own connection and
+ *    its own task, so they are sent in parallel. The server only keeps the
+ *    file once every stripe is in. The request carries a hash of the file,
+ *    and if the server already has the same contents, nothing is sent at
+ *    all.
+ */
 class UploadTask : public thread_pool::Task {
  public:
+  /// Most connections to upload a single file over, including the main one.
+  static constexpr uint32_t kMaxStripes = 4;
+  /// Smallest stripe worth opening another connection for.
+  static constexpr uint64_t kMinStripeSize = 16 * 1024 * 1024;
+
+  /**
+   * @param client_fd The main connection to the server
+   * @param filename The name of the local file to upload. It is streamed
+   *    from disk as raw chunks.
+   */
+  UploadTask(int client_fd, std::string filename);
+
   /**
-   * @param client_fd The socket used to upload the FileContents
-   * @param file_data The buffer containing the file data to upload.
+   * @brief Fills in the request for the main connection, deciding how many
+   *    stripes to send the file in, and hashing it.
+   * @param request[out] The request to fill in.
    */
-  explicit UploadTask(int client_fd, const std::vector<uint8_t>& file_data);
+  void PrepareRequest(ftp_messages::PutRequest* request);
+
+  /**
+   * @brief Sets the response that the server sent on the main connection.
+   *    This must be called before the task is started.
+   * @param response The response.
+   */
+  void SetResponse(const ftp_messages::PutResponse& response);
+
+  /**
+   * @brief Makes the tasks that send the rest of the stripes, each over a
+   *    new connection.
+   * @param hostname The address of the server.
+   * @param nport The normal port on the server.
+   * @return The tasks, which should be run alongside this one.
+   */
+  std::vector<std::shared_ptr<UploadTask>> MakeStripeTasks(
+      const std::string& hostname, uint16_t nport);
+
+  Status SetUp() override;
 
   Status RunAtomic() override;
 
+  /**
+   * @brief Tells the server to discard the file if the upload didn't finish,
+   *    for instance because it was terminated.
+   */
+  void CleanUp() override;
+
  protected:
+  /**
+   * @brief Constructor for the tasks that send the extra stripes.
+   * @param filename The name of the local file to upload.
+   * @param hostname The address of the server.
+   * @param nport The normal port on the server.
+   * @param request The request for the stripe.
+   * @param failed Shared by all the stripes of the file, and set if any of
+   *    them fails.
+   */
+  UploadTask(std::string filename, std::string hostname, uint16_t nport,
+             ftp_messages::PutRequest request,
+             std::shared_ptr<std::atomic<bool>> failed);
+
+  /**
+   * @brief Connects to the server and asks it to accept a stripe.
+   * @return True if the server is waiting for the stripe.
+   */
+  bool RequestStripe();
+
   /// client socket
   int client_fd_;
+  /// Whether we opened the socket ourselves, and so have to close it.
+  bool owns_socket_ = false;
+
+  /// the name of the file to upload
+  std::string filename_;
+
+  /// the address of the server, only used by extra stripes
+  std::string hostname_{};
+  /// the normal port on the server, only used by extra stripes
+  uint16_t nport_ = 0;
+  /// the request to send for an extra stripe
+  ftp_messages::PutRequest stripe_request_{};
+
+  /// the size of the file
+  uint64_t file_size_ = 0;
+  /// how many stripes the file is sent in
+  uint32_t num_stripes_ = 1;
+  /// the size of every stripe but the last
+  uint64_t stripe_size_ = 0;
+  /// where this task's stripe starts
+  uint64_t offset_ = 0;
+  /// how long this task's stripe is, or 0 for the rest of the file
+  uint64_t length_ = 0;
+
+  /// the largest chunk that the server asked for
+  uint32_t max_chunk_size_ = 0;
+  /// the striped upload on the server, or 0 if the file is sent in one piece
+  uint64_t upload_id_ = 0;
+  /// the absolute path of the file on the server
+  std::string path_{};
+  /// whether the server already had the contents, so nothing has to be sent
+  bool deduplicated_ = false;
 
-  /// Chunked file sender
-  chunked_files::ChunkedFileSender sender_;
+  /// Sender for the file. Only set once the file is open.
+  std::optional<chunked_files::FileStreamSender> sender_{};
+  /// Whether we hit a socket error, in which case we can't send anything
+  /// else.
+  bool failed_ = false;
+  /// Set if any stripe of the file fails, since then the server won't keep
+  /// it anyway.
+  std::shared_ptr<std::atomic<bool>> upload_failed_;
 };
 }  // namespace client_tasks
 #endif  // PROJECT1_UPLOAD_TASK_H
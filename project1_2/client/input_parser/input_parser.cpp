@@ -1,5 +1,7 @@
 #include "input_parser.h"
 
+#include "chunked_files/file_stream_sender.h"
+
 namespace client::input_parser {
 using ftp_messages::ChangeDirRequest;
 using ftp_messages::DeleteRequest;
@@ -11,7 +13,6 @@ using ftp_messages::PwdRequest;
 using ftp_messages::QuitRequest;
 using ftp_messages::TerminateRequest;
 using ftp_messages::Request;
-using ftp_messages::FileContents;
 
 InputParser::InputParser(std::string &cmd) {
   fn_ = "";
@@ -21,7 +22,6 @@ InputParser::InputParser(std::string &cmd) {
 
   std::istringstream iss(cmd);
   std::string word;
-  server::file_handler::FileHandler fh;
   iss >> word;
   auto itr = commands_.find(word);
   if (itr == commands_.end()) {
@@ -31,9 +31,6 @@ InputParser::InputParser(std::string &cmd) {
   req_ = itr->second;
   switch(itr->second) {
     case PUTF:
-      iss >> this->fn_;
-      contents_ = fh.Get(fn_);
-      break;
     case GETF:
     case DEL:
       iss >> fn_;
@@ -61,13 +58,6 @@ std::string InputParser::GetFilename() { return fn_; }
 bool InputParser::IsValid() { return is_valid_; }
 bool InputParser::IsForking() { return is_forking_; }
 
-FileContents InputParser::GetContentsMessage() {
-  FileContents contents;
-  std::string c(contents_.begin(), contents_.end());
-  contents.set_contents(c);
-  return contents;
-}
-
 Request InputParser::CreateReq() {
     switch (req_) {
         case GETF:
@@ -103,11 +93,14 @@ Request InputParser::CreateReq() {
 Request InputParser::CreateGetReq() {
   Request request;
   request.mutable_get()->set_filename(fn_);
+  request.mutable_get()->set_max_chunk_size(chunked_files::kMaxChunkSize);
   return request;
 }
 Request InputParser::CreatePutReq() {
   Request request;
   request.mutable_put()->set_filename(fn_);
+  // The file is streamed from disk by the upload task.
+  request.mutable_put()->set_raw_chunks(true);
   return request;
 }
 Request InputParser::CreateDelReq() {
@@ -117,7 +110,7 @@ Request InputParser::CreateDelReq() {
 }
 Request InputParser::CreateListReq() {
   Request request;
-  request.mutable_list()->Clear();
+  request.mutable_list()->set_max_entries(kListPageSize);
   return request;
 }
 Request InputParser::CreateCdReq() {
@@ -24,6 +24,10 @@ class InputParser {
  public:
   enum ReqType { GETF, PUTF, DEL, LS, CD, MKDIR, PWD, QUIT, TERMINATE };
 
+  /// How many names to ask for at a time when listing a directory. It is a
+  /// multiple of 3 so that the columns line up across pages.
+  static constexpr uint32_t kListPageSize = 999;
+
   /**
    * @brief Initializes relevant info about this input command
    * @param cmd the user input
@@ -47,12 +51,6 @@ class InputParser {
    */
   bool IsForking();
 
-  /**
-   * @brief gets the contents of a file
-   * @return file contents message
-   */
-  ftp_messages::FileContents GetContentsMessage();
-
   /**
    * creates the request to be sent
    * @return
@@ -126,7 +124,6 @@ class InputParser {
   std::string fn_;
   std::string dn_;
   std::string cid_;
-  std::vector<uint8_t> contents_;
 };
 };      // namespace client::input_parser
 #endif  // PROJECT1_INPUT_PARSER_H
@@ -0,0 +1,220 @@
+#include "content_index.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <loguru.hpp>
+#include <sstream>
+#include <utility>
+
+namespace server::file_handler {
+namespace {
+
+/// Starts a record that adds a file.
+constexpr char kAddRecord = '+';
+/// Starts a record that removes a file.
+constexpr char kRemoveRecord = '-';
+
+/**
+ * @brief Writes all of a string to a file.
+ * @param file_fd The file.
+ * @param data The string.
+ * @return False on failure.
+ */
+bool WriteAll(int file_fd, const std::string& data) {
+  size_t offset = 0;
+  while (offset < data.size()) {
+    const ssize_t kWritten =
+        write(file_fd, data.data() + offset, data.size() - offset);
+    if (kWritten < 0 && errno == EINTR) {
+      continue;
+    } else if (kWritten < 0) {
+      return false;
+    }
+    offset += kWritten;
+  }
+  return true;
+}
+
+}  // namespace
+
+ContentIndex::ContentIndex(std::string index_path)
+    : index_path_(
+          std::filesystem::absolute(index_path).lexically_normal().string()) {
+  Load();
+}
+
+ContentIndex::~ContentIndex() {
+  if (index_fd_ >= 0) {
+    close(index_fd_);
+  }
+}
+
+void ContentIndex::Add(const std::string& path,
+                       const std::string& content_hash, int file_fd) {
+  struct stat file_stat {};
+  if (fstat(file_fd, &file_stat) != 0 ||
+      path.find('\n') != std::string::npos) {
+    // We can't vouch for it, so just make sure we don't offer a stale entry.
+    Remove(path);
+    return;
+  }
+
+  Entry entry = {content_hash, file_stat.st_dev, file_stat.st_ino,
+                 file_stat.st_size,
+                 file_stat.st_mtim.tv_sec * 1000000000LL +
+                     file_stat.st_mtim.tv_nsec};
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Append(FormatAdd(path, entry));
+  Insert(path, std::move(entry));
+}
+
+void ContentIndex::Remove(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (by_path_.count(path) == 0) {
+    return;
+  }
+
+  Append(std::string(1, kRemoveRecord) + " " + path + "\n");
+  Erase(path);
+}
+
+int ContentIndex::Find(const std::string& content_hash, uint64_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto [candidate, end] = by_hash_.equal_range(content_hash);
+  while (candidate != end) {
+    const std::string kPath = candidate->second;
+    const Entry& kEntry = by_path_.at(kPath);
+    ++candidate;
+    if (static_cast<uint64_t>(kEntry.size) != size) {
+      continue;
+    }
+
+    // Check the file we actually opened, in case it is being replaced.
+    const int kFileFd = open(kPath.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat file_stat {};
+    if (kFileFd >= 0 && fstat(kFileFd, &file_stat) == 0 &&
+        file_stat.st_dev == kEntry.device && file_stat.st_ino == kEntry.inode &&
+        file_stat.st_size == kEntry.size &&
+        file_stat.st_mtim.tv_sec * 1000000000LL + file_stat.st_mtim.tv_nsec ==
+            kEntry.modified_time_ns) {
+      return kFileFd;
+    }
+    if (kFileFd >= 0) {
+      close(kFileFd);
+    }
+
+    // It was changed or deleted without going through the server.
+    Append(std::string(1, kRemoveRecord) + " " + kPath + "\n");
+    Erase(kPath);
+  }
+
+  return -1;
+}
+
+bool ContentIndex::IsIndexFile(const std::string& path) const {
+  // Load() also writes a temporary copy while it compacts the index.
+  return path == index_path_ || path == index_path_ + ".tmp";
+}
+
+void ContentIndex::Load() {
+  std::ifstream stream(index_path_);
+  std::string line;
+  while (std::getline(stream, line)) {
+    // Every record is the type, some fields, and then the path, which takes
+    // up the rest of the line.
+    std::istringstream fields(line);
+    char type = 0;
+    fields >> type;
+    if (type == kAddRecord) {
+      Entry entry{};
+      fields >> entry.content_hash >> entry.device >> entry.inode >>
+          entry.size >> entry.modified_time_ns;
+      std::string path;
+      if (fields.get() == ' ' && std::getline(fields, path) && !path.empty()) {
+        Insert(path, std::move(entry));
+        continue;
+      }
+    } else if (type == kRemoveRecord) {
+      std::string path;
+      if (fields.get() == ' ' && std::getline(fields, path)) {
+        Erase(path);
+        continue;
+      }
+    }
+    LOG_S(WARNING) << "Ignoring a bad record in the content index: " << line;
+  }
+  stream.close();
+
+  // Write out just what is left, so the log doesn't grow forever.
+  const std::string kTempPath = index_path_ + ".tmp";
+  const int kTempFd =
+      open(kTempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  std::string contents;
+  for (const auto& [kPath, kEntry] : by_path_) {
+    contents += FormatAdd(kPath, kEntry);
+  }
+  if (kTempFd < 0 || !WriteAll(kTempFd, contents) ||
+      std::rename(kTempPath.c_str(), index_path_.c_str()) != 0) {
+    LOG_S(WARNING) << "Failed to compact the content index: "
+                   << std::strerror(errno);
+  }
+  if (kTempFd >= 0) {
+    close(kTempFd);
+  }
+
+  index_fd_ = open(index_path_.c_str(),
+                   O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (index_fd_ < 0) {
+    LOG_S(ERROR) << "Failed to open the content index " << index_path_
+                 << ": " << std::strerror(errno);
+  }
+}
+
+void ContentIndex::Insert(const std::string& path, Entry entry) {
+  Erase(path);
+  by_hash_.emplace(entry.content_hash, path);
+  by_path_.emplace(path, std::move(entry));
+}
+
+void ContentIndex::Erase(const std::string& path) {
+  const auto kEntry = by_path_.find(path);
+  if (kEntry == by_path_.end()) {
+    return;
+  }
+
+  auto [candidate, end] = by_hash_.equal_range(kEntry->second.content_hash);
+  for (; candidate != end; ++candidate) {
+    if (candidate->second == path) {
+      by_hash_.erase(candidate);
+      break;
+    }
+  }
+  by_path_.erase(kEntry);
+}
+
+void ContentIndex::Append(const std::string& record) {
+  if (index_fd_ >= 0 && !WriteAll(index_fd_, record)) {
+    LOG_S(WARNING) << "Failed to update the content index: "
+                   << std::strerror(errno);
+  }
+}
+
+std::string ContentIndex::FormatAdd(const std::string& path,
+                                    const Entry& entry) {
+  std::ostringstream record;
+  record << kAddRecord << " " << entry.content_hash << " " << entry.device
+         << " " << entry.inode << " " << entry.size << " "
+         << entry.modified_time_ns << " " << path << "\n";
+  return record.str();
+}
+
+}  // namespace server::file_handler
@@ -0,0 +1,137 @@
+/**
+ * @file Persistent index of file contents by hash
+ */
+
+#ifndef PROJECT1_CONTENT_INDEX_H
+#define PROJECT1_CONTENT_INDEX_H
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace server::file_handler {
+
+/**
+ * @brief Remembers the SHA-256 of every file written through the server, so
+ *    that uploads of contents we already have can reuse the existing file.
+ * @details The index is a log of additions and removals, which is appended
+ *    to as files change and compacted whenever it is loaded. Along with each
+ *    hash, it records the file's inode, size and modification time, and a
+ *    file is only offered as a match if those are unchanged, so files that
+ *    were modified behind our back are never mistaken for their old
+ *    contents. A single instance must be shared among threads.
+ */
+class ContentIndex {
+ public:
+  /**
+   * @param index_path Where to keep the index. It is loaded from there if it
+   *    exists.
+   */
+  explicit ContentIndex(std::string index_path);
+  ~ContentIndex();
+
+  ContentIndex(const ContentIndex& other) = delete;
+  ContentIndex& operator=(const ContentIndex& other) = delete;
+
+  /**
+   * @brief Records the hash of a file, replacing anything recorded for that
+   *    path before.
+   * @param path The absolute, normalized path of the file.
+   * @param content_hash The SHA-256 of the contents, as hex.
+   * @param file_fd The file, open for reading, so that we know exactly which
+   *    version was hashed. This doesn't take ownership of it.
+   */
+  void Add(const std::string& path, const std::string& content_hash,
+           int file_fd);
+
+  /**
+   * @brief Forgets about a file, because it is being deleted or overwritten.
+   * @param path The absolute, normalized path of the file.
+   */
+  void Remove(const std::string& path);
+
+  /**
+   * @brief Finds a file with the given contents.
+   * @param content_hash The SHA-256 of the contents, as hex.
+   * @param size The size of the contents.
+   * @return The file, open for reading, which the caller is responsible for
+   *    closing, or -1 if there isn't one. It is guaranteed to be the same
+   *    version of the file that was hashed.
+   */
+  int Find(const std::string& content_hash, uint64_t size);
+
+  /**
+   * @brief Checks whether a path is one of the files that the index itself
+   *    is kept in. Clients must not be allowed to touch those.
+   * @param path The absolute, normalized path.
+   * @return True if it is.
+   */
+  [[nodiscard]] bool IsIndexFile(const std::string& path) const;
+
+ private:
+  /// What we know about an indexed file.
+  struct Entry {
+    /// The SHA-256 of the contents, as hex.
+    std::string content_hash;
+    /// The version of the file that was hashed.
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    int64_t modified_time_ns;
+  };
+
+  /**
+   * @brief Reads the index from disk, and rewrites it without the entries
+   *    that were removed.
+   */
+  void Load();
+
+  /**
+   * @brief Records an entry in memory.
+   * @note The mutex must be held.
+   * @param path The path of the file.
+   * @param entry The entry.
+   */
+  void Insert(const std::string& path, Entry entry);
+
+  /**
+   * @brief Removes an entry from memory.
+   * @note The mutex must be held.
+   * @param path The path of the file.
+   */
+  void Erase(const std::string& path);
+
+  /**
+   * @brief Appends one record to the index on disk.
+   * @note The mutex must be held.
+   * @param record The record, including the newline.
+   */
+  void Append(const std::string& record);
+
+  /**
+   * @brief Formats the record for adding an entry.
+   * @param path The path of the file.
+   * @param entry The entry.
+   * @return The record.
+   */
+  static std::string FormatAdd(const std::string& path, const Entry& entry);
+
+  /// Where the index is kept, as an absolute, normalized path.
+  std::string index_path_;
+  /// The index, open for appending, or -1 if it couldn't be opened.
+  int index_fd_ = -1;
+
+  /// Protects access to internal data structures.
+  std::mutex mutex_{};
+  /// Entries by path.
+  std::unordered_map<std::string, Entry> by_path_{};
+  /// Paths by hash.
+  std::unordered_multimap<std::string, std::string> by_hash_{};
+};
+
+}  // namespace server::file_handler
+
+#endif  // PROJECT1_CONTENT_INDEX_H
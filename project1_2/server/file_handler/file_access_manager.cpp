@@ -1,5 +1,6 @@
 #include "file_access_manager.h"
 
+#include <functional>
 #include <loguru.hpp>
 
 namespace server::file_handler {
@@ -26,40 +27,84 @@ path UniquePath(const path& relative) {
 
 }  // namespace
 
-void FileAccessManager::LockFile(const path& path) {
+void FileAccessManager::LockFile(const path& path, LockMode mode) {
+  // Do this before locking anything, since it might have to ask the OS for
+  // the current directory.
   const auto kPathKey = UniquePath(path).string();
+  Shard& shard = GetShard(kPathKey);
 
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  auto& file_lock = shard.file_locks[kPathKey];
+  if (!file_lock) {
+    file_lock = std::make_unique<FileLock>();
+  }
+  // The entry can't be removed while we are waiting on it, so this stays
+  // valid even if the map rehashes.
+  FileLock* state = file_lock.get();
 
-    // Make sure the file is not currently locked.
-    if (locked_files_.find(kPathKey) != locked_files_.end()) {
-      // Wait for file to be unlocked.
-      file_unlocked_.wait(lock, [this, kPathKey]() {
-        return locked_files_.find(kPathKey) == locked_files_.end();
-      });
-    }
+  if (mode == LockMode::SHARED) {
+    // Let waiting writers go first.
+    ++state->num_waiting_readers;
+    state->readers_ready.wait(lock, [state]() {
+      return !state->has_writer && state->num_waiting_writers == 0;
+    });
+    --state->num_waiting_readers;
+
+    LOG_S(1) << "Locking " << kPathKey << " for reading.";
+    ++state->num_readers;
+  } else {
+    ++state->num_waiting_writers;
+    state->writer_ready.wait(lock, [state]() {
+      return !state->has_writer && state->num_readers == 0;
+    });
+    --state->num_waiting_writers;
 
-    // Lock the file.
     LOG_S(1) << "Locking " << kPathKey << ".";
-    locked_files_.insert(kPathKey);
+    state->has_writer = true;
   }
 }
 
-void FileAccessManager::UnlockFile(const path& path) {
+void FileAccessManager::UnlockFile(const path& path, LockMode mode) {
   const auto kPathKey = UniquePath(path).string();
+  Shard& shard = GetShard(kPathKey);
 
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const auto kFileLock = shard.file_locks.find(kPathKey);
+  const bool kWasLocked =
+      kFileLock != shard.file_locks.end() &&
+      (mode == LockMode::SHARED ? kFileLock->second->num_readers > 0
+                                : kFileLock->second->has_writer);
+  if (!kWasLocked) {
+    LOG_S(WARNING) << "Unlocking file that was never locked.";
+    return;
+  }
+  FileLock* state = kFileLock->second.get();
 
-    // Mark the file as unlocked.
-    LOG_S(1) << "Unlocking " << kPathKey << ".";
-    LOG_IF_S(WARNING, locked_files_.find(kPathKey) == locked_files_.end())
-        << "Unlocking file that was never locked.";
-    locked_files_.erase(kPathKey);
+  // Mark the file as unlocked.
+  LOG_S(1) << "Unlocking " << kPathKey << ".";
+  if (mode == LockMode::SHARED) {
+    --state->num_readers;
+  } else {
+    state->has_writer = false;
   }
-  // Notify the next waiter.
-  file_unlocked_.notify_one();
+
+  if (state->num_readers == 0 && !state->has_writer) {
+    if (state->num_waiting_writers > 0) {
+      // Only one writer can go, and it goes before any readers.
+      state->writer_ready.notify_one();
+    } else if (state->num_waiting_readers > 0) {
+      // All the readers can go at once.
+      state->readers_ready.notify_all();
+    } else {
+      // Nobody needs this anymore.
+      shard.file_locks.erase(kFileLock);
+    }
+  }
+}
+
+FileAccessManager::Shard& FileAccessManager::GetShard(
+    const std::string& path_key) {
+  return shards_[std::hash<std::string>{}(path_key) % kNumShards];
 }
 
-}  // namespace server::file_handler
\ No newline at end of file
+}  // namespace server::file_handler
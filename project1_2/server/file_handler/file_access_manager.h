@@ -1,45 +1,97 @@
 #ifndef PROJECT1_FILE_ACCESS_MANAGER_H
 #define PROJECT1_FILE_ACCESS_MANAGER_H
 
+#include <array>
+#include <condition_variable>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <mutex>
 #include <string>
-#include <unordered_set>
-#include <condition_variable>
+#include <unordered_map>
 
 namespace server::file_handler {
 
+/// How a file is locked.
+enum class LockMode {
+  /// Any number of threads can hold the lock at once, but only while nobody
+  /// holds it exclusively.
+  SHARED,
+  /// Only one thread can hold the lock.
+  EXCLUSIVE,
+};
+
 /**
  * @brief Facilitates synchronization among multiple threads that are
  *  using the file system.
  * @details This class is meant to be used with `FileHandlers`. Note that
  *  a single instance must be shared among threads for it to be effective.
+ *  Each file has its own reader-writer lock. Threads waiting for an
+ *  exclusive lock go ahead of new shared ones, so a steady stream of readers
+ *  can't lock out writers. The lock table is split into shards by path, so
+ *  threads working on unrelated files rarely contend.
  */
 class FileAccessManager {
  public:
   /**
-   * @brief Locks a particular file. When a file is locked, any calls to
-   *    this method for the same file in other threads will block.
+   * @brief Locks a particular file. This blocks while any other thread holds
+   *    a lock on the same file that conflicts with this one.
    * @param path The path to the file.
+   * @param mode Whether other threads can lock the file at the same time.
    */
-  void LockFile(const std::filesystem::path& path);
+  void LockFile(const std::filesystem::path& path,
+                LockMode mode = LockMode::EXCLUSIVE);
 
   /**
    * @brief Unlocks a particular file. This will allow other threads to lock
    *    it.
    * @param path The path to the file.
+   * @param mode The mode that it was locked with.
    */
-  void UnlockFile(const std::filesystem::path& path);
+  void UnlockFile(const std::filesystem::path& path,
+                  LockMode mode = LockMode::EXCLUSIVE);
 
  private:
-  /// Protects access to internal data structures.
-  std::mutex mutex_{};
-  /// This variable is notified when a file is unlocked.
-  std::condition_variable file_unlocked_{};
+  /// Lock state of a single file.
+  struct FileLock {
+    /// Number of threads holding a shared lock.
+    uint32_t num_readers = 0;
+    /// Whether a thread holds an exclusive lock.
+    bool has_writer = false;
+    /// Number of threads waiting for a shared lock.
+    uint32_t num_waiting_readers = 0;
+    /// Number of threads waiting for an exclusive lock.
+    uint32_t num_waiting_writers = 0;
+
+    /// Notified when threads waiting for a shared lock can take it.
+    std::condition_variable readers_ready{};
+    /// Notified when a thread waiting for an exclusive lock can take it.
+    std::condition_variable writer_ready{};
+  };
 
-  /// Set of absolute paths to files that are currently locked.
-  std::unordered_set<std::string> locked_files_{};
+  /// Part of the lock table. Aligned to a cache line, so that threads using
+  /// different shards don't slow each other down.
+  struct alignas(64) Shard {
+    /// Protects access to the files in this shard.
+    std::mutex mutex{};
+    /// Lock state of every file in this shard that is locked, or that
+    /// somebody is waiting to lock, keyed by absolute path. Entries are
+    /// removed once they are no longer in use.
+    std::unordered_map<std::string, std::unique_ptr<FileLock>> file_locks{};
+  };
+
+  /// Number of shards to split the lock table into.
+  static constexpr size_t kNumShards = 64;
+
+  /**
+   * @brief Finds the shard that a file belongs to.
+   * @param path_key The absolute path of the file.
+   * @return The shard.
+   */
+  Shard& GetShard(const std::string& path_key);
 
+  /// The lock table.
+  std::array<Shard, kNumShards> shards_{};
 };
 
 }  // namespace server::file_handler
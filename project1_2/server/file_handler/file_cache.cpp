@@ -0,0 +1,96 @@
+#include "file_cache.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <loguru.hpp>
+#include <utility>
+
+namespace server::file_handler {
+
+bool FileCache::Version::operator==(const Version& other) const {
+  return device == other.device && inode == other.inode &&
+         size == other.size && modified_time_ns == other.modified_time_ns;
+}
+
+FileCache::FileCache(size_t capacity, size_t max_file_size)
+    : max_file_size_(max_file_size), cache_(capacity) {}
+
+FileCache::Contents FileCache::Get(const std::string& path, int file_fd) {
+  Version version{};
+  if (!GetVersion(file_fd, &version) ||
+      static_cast<size_t>(version.size) > max_file_size_) {
+    return nullptr;
+  }
+
+  Contents cached = cache_.Find(path, version);
+  if (cached != nullptr) {
+    ++hits_;
+    return cached;
+  }
+  ++misses_;
+
+  // Read it outside of the cache's lock, so other lookups don't have to wait
+  // for the disk.
+  Contents contents = ReadContents(file_fd, version.size);
+  Version version_after{};
+  if (contents == nullptr || !GetVersion(file_fd, &version_after) ||
+      !(version_after == version)) {
+    // It changed while we were reading it, so what we got might be torn.
+    return nullptr;
+  }
+
+  // If somebody else read it at the same time, this replaces theirs.
+  evictions_ += cache_.Insert(path, contents, version, contents->size());
+  return contents;
+}
+
+void FileCache::Invalidate(const std::string& path) {
+  cache_.Invalidate(path);
+}
+
+FileCache::Stats FileCache::GetStats() const {
+  Stats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.evictions = evictions_;
+  stats.size = cache_.GetSize();
+  return stats;
+}
+
+bool FileCache::GetVersion(int file_fd, Version* version) {
+  struct stat file_stat {};
+  if (fstat(file_fd, &file_stat) != 0) {
+    return false;
+  }
+
+  *version = {file_stat.st_dev, file_stat.st_ino, file_stat.st_size,
+              file_stat.st_mtim.tv_sec * 1000000000LL +
+                  file_stat.st_mtim.tv_nsec};
+  return true;
+}
+
+FileCache::Contents FileCache::ReadContents(int file_fd, off_t size) {
+  auto contents = std::make_shared<std::vector<uint8_t>>(size);
+
+  // Use pread(), since somebody else might be using the file position.
+  off_t offset = 0;
+  while (offset < size) {
+    const ssize_t kBytesRead =
+        pread(file_fd, contents->data() + offset, size - offset, offset);
+    if (kBytesRead < 0 && errno == EINTR) {
+      continue;
+    } else if (kBytesRead <= 0) {
+      LOG_S(WARNING) << "Failed to read file for caching: "
+                     << (kBytesRead < 0 ? std::strerror(errno) : "truncated");
+      return nullptr;
+    }
+    offset += kBytesRead;
+  }
+
+  return contents;
+}
+
+}  // namespace server::file_handler
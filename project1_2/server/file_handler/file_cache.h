@@ -0,0 +1,121 @@
+/**
+ * @file In-memory cache of file contents
+ */
+
+#ifndef PROJECT1_FILE_CACHE_H
+#define PROJECT1_FILE_CACHE_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lru_cache.h"
+
+namespace server::file_handler {
+
+/**
+ * @brief Keeps the contents of recently used files in memory, so that
+ *    popular files don't have to be read from disk every time.
+ * @details The capacity is in bytes. Every lookup checks the inode, size and
+ *    modification time of the file that the caller has open, so a file that
+ *    was replaced or resized without going through us is read again. A
+ *    single instance must be shared among threads for it to be effective.
+ */
+class FileCache {
+ public:
+  /// Contents of a cached file.
+  using Contents = std::shared_ptr<const std::vector<uint8_t>>;
+
+  /// Default for the most bytes to keep in memory.
+  static constexpr size_t kDefaultCapacity = 256 * 1024 * 1024;
+  /// Default for the largest file to cache.
+  static constexpr size_t kDefaultMaxFileSize = 8 * 1024 * 1024;
+
+  /// Counters for how well the cache is doing.
+  struct Stats {
+    /// Lookups that were served from memory.
+    uint64_t hits = 0;
+    /// Lookups that had to read the file.
+    uint64_t misses = 0;
+    /// Entries that were thrown out to make room.
+    uint64_t evictions = 0;
+    /// Number of bytes currently cached.
+    size_t size = 0;
+  };
+
+  /**
+   * @param capacity The most bytes to keep in memory.
+   * @param max_file_size The largest file to cache. Larger files are better
+   *    off being streamed from disk.
+   */
+  explicit FileCache(size_t capacity = kDefaultCapacity,
+                     size_t max_file_size = kDefaultMaxFileSize);
+
+  /**
+   * @brief Gets the contents of a file, reading them in if they aren't
+   *    cached yet, or have changed.
+   * @param path The absolute, normalized path of the file.
+   * @param file_fd The file, open for reading. This doesn't take ownership
+   *    of it.
+   * @return The contents of the file, or nullptr if it is too large to cache
+   *    or could not be read.
+   */
+  Contents Get(const std::string& path, int file_fd);
+
+  /**
+   * @brief Removes a file from the cache, because it is about to change.
+   * @param path The absolute, normalized path of the file.
+   */
+  void Invalidate(const std::string& path);
+
+  /**
+   * @return The current counters.
+   */
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  /// Identifies one particular version of a file.
+  struct Version {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    int64_t modified_time_ns;
+
+    bool operator==(const Version& other) const;
+  };
+
+  /**
+   * @brief Finds out which version of a file we have open.
+   * @param file_fd The file.
+   * @param version[out] Set to the version.
+   * @return False if it couldn't stat the file.
+   */
+  static bool GetVersion(int file_fd, Version* version);
+
+  /**
+   * @brief Reads a whole file.
+   * @param file_fd The file.
+   * @param size The size of the file.
+   * @return The contents, or nullptr if the file couldn't be read.
+   */
+  static Contents ReadContents(int file_fd, off_t size);
+
+  /// The largest file to cache.
+  size_t max_file_size_;
+  /// The cached files.
+  LruCache<Contents, Version> cache_;
+
+  /// Counters, which are updated without locking.
+  std::atomic<uint64_t> hits_ = 0;
+  std::atomic<uint64_t> misses_ = 0;
+  std::atomic<uint64_t> evictions_ = 0;
+};
+
+}  // namespace server::file_handler
+
+#endif  // PROJECT1_FILE_CACHE_H
@@ -1,6 +1,55 @@
 #include "file_handler.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <loguru.hpp>
+
 namespace server::file_handler {
+namespace {
+
+/// Comes between the final name and the random part in temporary file names.
+constexpr char kTempInfix[] = ".upload-";
+/// Length of the random part that `mkostemp()` fills in.
+constexpr size_t kTempRandomLength = 6;
+
+/**
+ * @brief Gets the process's file mode creation mask.
+ * @details `umask()` can only read it by changing it, which would race with
+ *    other threads creating files, so this reads it from procfs instead.
+ * @return The mask, or the usual 022 if it can't be read.
+ */
+mode_t GetUmask() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("Umask:", 0) == 0) {
+      return static_cast<mode_t>(std::stoul(line.substr(6), nullptr, 8));
+    }
+  }
+  return 022;
+}
+
+/**
+ * @brief Picks the permissions for a file that is about to be written.
+ * @param path The file.
+ * @return The mode of the file it replaces, or else the mode that `open()`
+ *    would have given a new file.
+ */
+mode_t GetNewFileMode(const std::filesystem::path &path) {
+  struct stat existing {};
+  if (stat(path.c_str(), &existing) == 0 && S_ISREG(existing.st_mode)) {
+    return existing.st_mode & 07777;
+  }
+
+  // The mask can't change while we're running, so only read it once.
+  static const mode_t kUmask = GetUmask();
+  return 0666 & ~kUmask;
+}
+
+}  // namespace
 
 FileHandler::FileHandler() : current_dir_(std::filesystem::current_path()) {}
 
@@ -10,20 +59,61 @@ bool FileHandler::Delete(const std::string &filename) {
 }  // Delete
 bool FileHandler::Put(const std::string &filename,
                       const std::vector<uint8_t> &contents) {
-  // convert contents to string format
-  std::string str_contents(contents.begin(), contents.end());
-
-  // open file
-  std::ofstream stream(current_dir_ / filename);
-
-  // write contents to file
-  stream << str_contents;
+  // Write a new file and swap it in rather than rewriting the old one, since
+  // the old one might be hard linked to other names.
+  std::string temp_path;
+  const int kFd = FileHandler::CreateTemp(filename, &temp_path);
+  if (kFd < 0) {
+    return false;
+  }
 
-  // close file
-  stream.close();
+  size_t offset = 0;
+  while (offset < contents.size()) {
+    const ssize_t kWritten =
+        write(kFd, contents.data() + offset, contents.size() - offset);
+    if (kWritten < 0 && errno == EINTR) {
+      continue;
+    } else if (kWritten < 0) {
+      break;
+    }
+    offset += kWritten;
+  }
+  close(kFd);
 
+  if (offset < contents.size() || !FileHandler::Commit(temp_path, filename)) {
+    std::filesystem::remove(temp_path);
+    return false;
+  }
   return true;
 }  // Put
+int FileHandler::CreateTemp(const std::string &filename,
+                            std::string *temp_path) {
+  const auto kPath = current_dir_ / filename;
+  // The name has to be recognizable so that `IsTempName()` can leave it out
+  // of listings while it's being written.
+  std::string path_template =
+      kPath.parent_path() /
+      ("." + kPath.filename().string() + kTempInfix +
+       std::string(kTempRandomLength, 'X'));
+
+  const int kFd = mkostemp(path_template.data(), O_CLOEXEC);
+  if (kFd < 0) {
+    return -1;
+  }
+  // mkostemp() only gives the owner access, but this will be a normal file.
+  fchmod(kFd, GetNewFileMode(kPath));
+
+  *temp_path = path_template;
+  return kFd;
+}  // CreateTemp
+
+bool FileHandler::Commit(const std::string &temp_path,
+                         const std::string &filename) {
+  std::error_code error;
+  std::filesystem::rename(temp_path, current_dir_ / filename, error);
+  return !error;
+}  // Commit
+
 bool FileHandler::MakeDir(const std::string &name) {
   return std::filesystem::create_directory(current_dir_ / name);
 
@@ -48,6 +138,10 @@ std::vector<uint8_t> FileHandler::Get(const std::string &filename) const {
 
 }  // Get
 
+int FileHandler::Open(const std::string &filename) const {
+  return open((current_dir_ / filename).c_str(), O_RDONLY | O_CLOEXEC);
+}  // Open
+
 bool FileHandler::UpDir() {
   current_dir_ = current_dir_.parent_path();
   return true;
@@ -59,6 +153,9 @@ std::vector<std::string> FileHandler::List() const {
        std::filesystem::directory_iterator(current_dir_)) {
     std::string str(file.path());
     str.erase(0, current_dir_.string().length() + 1);
+    if (IsTempName(str)) {
+      continue;
+    }
     list.push_back(str);
   }
 
@@ -66,6 +163,59 @@ std::vector<std::string> FileHandler::List() const {
 
 }  // List
 
+std::vector<std::string> FileHandler::ListPage(const std::string &after,
+                                               size_t max_entries,
+                                               bool *more) const {
+  auto listing = List();
+  std::sort(listing.begin(), listing.end());
+  return GetPage(listing, after, max_entries, more);
+}  // ListPage
+
+std::vector<std::string> FileHandler::GetPage(
+    const std::vector<std::string> &listing, const std::string &after,
+    size_t max_entries, bool *more) {
+  // The cursor is just the last name on the previous page, so paging keeps
+  // working even if files come and go in between.
+  const auto kBegin = after.empty()
+                          ? listing.begin()
+                          : std::upper_bound(listing.begin(), listing.end(),
+                                             after);
+  const size_t kRemaining = listing.end() - kBegin;
+  const size_t kPageSize =
+      max_entries == 0 ? kRemaining : std::min(max_entries, kRemaining);
+
+  *more = kPageSize < kRemaining;
+  return {kBegin, kBegin + kPageSize};
+}  // GetPage
+
+bool FileHandler::IsTempName(const std::string &name) {
+  const size_t kInfixLength = sizeof(kTempInfix) - 1;
+  if (name.size() <= 1 + kInfixLength + kTempRandomLength || name[0] != '.') {
+    return false;
+  }
+  return name.compare(name.size() - kTempRandomLength - kInfixLength,
+                      kInfixLength, kTempInfix) == 0;
+}  // IsTempName
+
+void FileHandler::RemoveStaleTemps(const std::filesystem::path &root) {
+  std::error_code error;
+  for (auto it = std::filesystem::recursive_directory_iterator(
+           root, std::filesystem::directory_options::skip_permission_denied,
+           error);
+       !error && it != std::filesystem::recursive_directory_iterator();
+       it.increment(error)) {
+    if (it->is_regular_file(error) &&
+        IsTempName(it->path().filename().string())) {
+      LOG_S(INFO) << "Removing unfinished upload " << it->path() << ".";
+      std::filesystem::remove(it->path(), error);
+    }
+  }
+  if (error) {
+    LOG_S(WARNING) << "Failed to clean up unfinished uploads in " << root
+                   << ": " << error.message();
+  }
+}  // RemoveStaleTemps
+
 std::string FileHandler::GetCurrentDir() const {
   return current_dir_;
 }
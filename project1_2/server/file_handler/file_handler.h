@@ -5,6 +5,7 @@
 #ifndef PROJECT1_FILE_HANDLER_H
 #define PROJECT1_FILE_HANDLER_H
 
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -27,13 +28,25 @@ class FileHandler : public IFileHandler {
   [[nodiscard]] std::vector<uint8_t> Get(
       const std::string& filename) const override;
 
+  [[nodiscard]] int Open(const std::string& filename) const override;
+
   bool Put(const std::string& filename,
            const std::vector<uint8_t>& contents) override;
 
+  [[nodiscard]] int CreateTemp(const std::string& filename,
+                               std::string* temp_path) override;
+
+  bool Commit(const std::string& temp_path,
+              const std::string& filename) override;
+
   bool Delete(const std::string& filename) override;
 
   [[nodiscard]] std::vector<std::string> List() const final;
 
+  [[nodiscard]] std::vector<std::string> ListPage(const std::string& after,
+                                                  size_t max_entries,
+                                                  bool* more) const override;
+
   bool ChangeDir(const std::string& sub_folder) final;
 
   bool UpDir() final;
@@ -42,6 +55,35 @@ class FileHandler : public IFileHandler {
 
   [[nodiscard]] std::string GetCurrentDir() const final;
 
+  /**
+   * @brief Checks whether a name belongs to a file made by `CreateTemp()`.
+   *    These are left out of listings.
+   * @param name The file name, without any directories.
+   * @return True if it is a temporary file.
+   */
+  static bool IsTempName(const std::string& name);
+
+  /**
+   * @brief Deletes temporary files left behind by uploads that never
+   *    finished, e.g. because the server crashed. This must only be run
+   *    while nothing is uploading.
+   * @param root The directory to clean up, along with everything under it.
+   */
+  static void RemoveStaleTemps(const std::filesystem::path& root);
+
+ protected:
+  /**
+   * @brief Picks one page out of a directory listing.
+   * @param listing The whole listing, sorted by name.
+   * @param after Only include names that come after this one.
+   * @param max_entries The most names to include, or 0 for all of them.
+   * @param[out] more Set to whether there are names after the page.
+   * @return The page.
+   */
+  static std::vector<std::string> GetPage(
+      const std::vector<std::string>& listing, const std::string& after,
+      size_t max_entries, bool* more);
+
  private:
   /// Keeps track of the current directory.
   std::filesystem::path current_dir_;
@@ -5,6 +5,7 @@
 #ifndef PROJECT1_FILE_HANDLER_INTERFACE_H
 #define PROJECT1_FILE_HANDLER_INTERFACE_H
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -27,6 +28,15 @@ class IFileHandler {
 
   virtual ~IFileHandler() = default;
 
+  /**
+   * @brief Opens a file in the current remote directory on the server for
+   *    reading, so that it can be streamed without loading it into memory.
+   * @param filename The name of the file to open.
+   * @return The file descriptor, which the caller is responsible for closing,
+   *    or -1 on failure.
+   */
+  [[nodiscard]] virtual int Open(const std::string& filename) const = 0;
+
   /**
    * @brief Creates a new file in the current remote directory on the server.
    * @param filename The name of the file to create.
@@ -36,6 +46,29 @@ class IFileHandler {
   virtual bool Put(const std::string& filename,
                    const std::vector<uint8_t>& contents) = 0;
 
+  /**
+   * @brief Creates an empty temporary file to write a new file into before
+   *    it is committed with `Commit()`. It goes in the same directory as the
+   *    final file, so that committing it is atomic.
+   * @param filename The name that the file will have once it is committed.
+   * @param[out] temp_path Set to the path of the temporary file.
+   * @return The file descriptor, open for writing, which the caller is
+   *    responsible for closing, or -1 on failure.
+   */
+  [[nodiscard]] virtual int CreateTemp(const std::string& filename,
+                                       std::string* temp_path) = 0;
+
+  /**
+   * @brief Atomically replaces a file with a temporary file that was created
+   *    with `CreateTemp()`. Anyone who already has the old file open keeps
+   *    seeing the old contents.
+   * @param temp_path The path of the temporary file.
+   * @param filename The name of the file to replace.
+   * @return True on success, false on failure.
+   */
+  virtual bool Commit(const std::string& temp_path,
+                      const std::string& filename) = 0;
+
   /**
    * @brief Deletes a file in the current remote directory on the server.
    * @param filename The name of the file to delete.
@@ -49,6 +82,19 @@ class IFileHandler {
    */
   [[nodiscard]] virtual std::vector<std::string> List() const = 0;
 
+  /**
+   * @brief Lists one page of the files in the current remote directory, in
+   *    order by name, so that large directories can be listed a piece at a
+   *    time.
+   * @param after Only list files whose names come after this one. Empty to
+   *    start from the beginning.
+   * @param max_entries The most names to return, or 0 for all of them.
+   * @param[out] more Set to whether there are files after the ones returned.
+   * @return The page of files.
+   */
+  [[nodiscard]] virtual std::vector<std::string> ListPage(
+      const std::string& after, size_t max_entries, bool* more) const = 0;
+
   /**
    * @brief Changes to a new directory that is a sub-folder of the current one.
    * @param sub_folder The sub-folder to enter.
@@ -5,15 +5,15 @@
 namespace server::file_handler {
 
 FileLockGuard::FileLockGuard(FileAccessManager *manager,
-                             std::filesystem::path path)
-    : manager_(manager), path_(std::move(path)) {
+                             std::filesystem::path path, LockMode mode)
+    : manager_(manager), path_(std::move(path)), mode_(mode) {
   // Lock the file.
-  manager_->LockFile(path_);
+  manager_->LockFile(path_, mode_);
 }
 
 FileLockGuard::~FileLockGuard() {
   // Unlock the file.
-  manager_->UnlockFile(path_);
+  manager_->UnlockFile(path_, mode_);
 }
 
 }  // namespace server::file_handler
@@ -16,8 +16,10 @@ class FileLockGuard {
   /**
    * @param manager The `FileAccessManager` to use for locking.
    * @param path The path to the file to lock.
+   * @param mode Whether other threads can lock the file at the same time.
    */
-  FileLockGuard(FileAccessManager* manager, std::filesystem::path path);
+  FileLockGuard(FileAccessManager* manager, std::filesystem::path path,
+                LockMode mode = LockMode::EXCLUSIVE);
 
   ~FileLockGuard();
 
@@ -26,6 +28,8 @@ class FileLockGuard {
   FileAccessManager* manager_;
   /// Path that we have locked.
   std::filesystem::path path_;
+  /// How we have locked it.
+  LockMode mode_;
 };
 
 }  // namespace server::file_handler
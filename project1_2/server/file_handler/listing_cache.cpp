@@ -0,0 +1,82 @@
+#include "listing_cache.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <loguru.hpp>
+#include <utility>
+
+#include "file_handler.h"
+
+namespace server::file_handler {
+
+bool ListingCache::Version::operator==(const Version& other) const {
+  return device == other.device && inode == other.inode &&
+         modified_time_ns == other.modified_time_ns;
+}
+
+ListingCache::ListingCache(size_t capacity) : cache_(capacity) {}
+
+ListingCache::Listing ListingCache::Get(const std::string& path) {
+  Version version{};
+  if (!GetVersion(path, &version)) {
+    return nullptr;
+  }
+
+  Listing cached = cache_.Find(path, version);
+  if (cached != nullptr) {
+    return cached;
+  }
+
+  // A large directory can take a while to read, so don't hold up other
+  // lookups in the meantime.
+  Listing listing = ReadListing(path);
+  Version version_after{};
+  if (listing == nullptr || !GetVersion(path, &version_after) ||
+      !(version_after == version)) {
+    // It changed while we were reading it. The listing is still as good as
+    // one taken a moment earlier, but it's not worth keeping.
+    return listing;
+  }
+
+  cache_.Insert(path, listing, version, listing->size());
+  return listing;
+}
+
+void ListingCache::Invalidate(const std::string& path) {
+  cache_.Invalidate(path);
+}
+
+bool ListingCache::GetVersion(const std::string& path, Version* version) {
+  struct stat dir_stat {};
+  if (stat(path.c_str(), &dir_stat) != 0) {
+    return false;
+  }
+
+  *version = {dir_stat.st_dev, dir_stat.st_ino,
+              dir_stat.st_mtim.tv_sec * 1000000000LL + dir_stat.st_mtim.tv_nsec};
+  return true;
+}
+
+ListingCache::Listing ListingCache::ReadListing(const std::string& path) {
+  auto listing = std::make_shared<std::vector<std::string>>();
+
+  std::error_code error;
+  for (auto it = std::filesystem::directory_iterator(path, error);
+       !error && it != std::filesystem::directory_iterator();
+       it.increment(error)) {
+    if (!FileHandler::IsTempName(it->path().filename().string())) {
+      listing->push_back(it->path().filename());
+    }
+  }
+  if (error) {
+    LOG_S(WARNING) << "Failed to list " << path << ": " << error.message();
+    return nullptr;
+  }
+
+  std::sort(listing->begin(), listing->end());
+  return listing;
+}
+
+}  // namespace server::file_handler
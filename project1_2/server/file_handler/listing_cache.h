@@ -0,0 +1,90 @@
+/**
+ * @file In-memory cache of directory listings
+ */
+
+#ifndef PROJECT1_LISTING_CACHE_H
+#define PROJECT1_LISTING_CACHE_H
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lru_cache.h"
+
+namespace server::file_handler {
+
+/**
+ * @brief Keeps sorted listings of recently listed directories in memory, so
+ *    that paging through a large directory doesn't mean reading all of it
+ *    for every page.
+ * @details The capacity is in names. Writes that go through the file handler
+ *    invalidate the listing. Changes made some other way are noticed by
+ *    checking the directory's inode and modification time, which can miss a
+ *    change that lands in the same timestamp tick as the listing was read
+ *    in, until the directory changes again.
+ */
+class ListingCache {
+ public:
+  /// Names of the files in a directory, sorted.
+  using Listing = std::shared_ptr<const std::vector<std::string>>;
+
+  /// Default for the most names to keep in memory.
+  static constexpr size_t kDefaultCapacity = 4 * 1024 * 1024;
+
+  /**
+   * @param capacity The most names to keep in memory, across all
+   *    directories.
+   */
+  explicit ListingCache(size_t capacity = kDefaultCapacity);
+
+  /**
+   * @brief Gets the listing of a directory, reading it in if it isn't cached
+   *    yet, or has changed.
+   * @param path The absolute, normalized path of the directory.
+   * @return The listing, or nullptr if the directory could not be read.
+   */
+  Listing Get(const std::string& path);
+
+  /**
+   * @brief Removes a directory from the cache, because something in it is
+   *    about to change.
+   * @param path The absolute, normalized path of the directory.
+   */
+  void Invalidate(const std::string& path);
+
+ private:
+  /// Identifies one particular version of a directory.
+  struct Version {
+    dev_t device;
+    ino_t inode;
+    int64_t modified_time_ns;
+
+    bool operator==(const Version& other) const;
+  };
+
+  /**
+   * @brief Finds out which version of a directory is there now.
+   * @param path The directory.
+   * @param version[out] Set to the version.
+   * @return False if it couldn't stat the directory.
+   */
+  static bool GetVersion(const std::string& path, Version* version);
+
+  /**
+   * @brief Reads a whole directory.
+   * @param path The directory.
+   * @return The sorted listing, or nullptr if it couldn't be read.
+   */
+  static Listing ReadListing(const std::string& path);
+
+  /// The cached listings.
+  LruCache<Listing, Version> cache_;
+};
+
+}  // namespace server::file_handler
+
+#endif  // PROJECT1_LISTING_CACHE_H
@@ -0,0 +1,150 @@
+/**
+ * @file Least-recently-used bookkeeping shared by the server's caches
+ */
+
+#ifndef PROJECT1_LRU_CACHE_H
+#define PROJECT1_LRU_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace server::file_handler {
+
+/**
+ * @brief A thread-safe map from paths to shared, immutable values, which
+ *    evicts the least recently used entries once their total size goes over
+ *    a capacity.
+ * @details Each entry remembers which version of the path it was made from,
+ *    and a lookup with a different version drops it. Since values are
+ *    shared, evicting one doesn't disturb anyone who is still using it.
+ * @tparam Value The cached value. It must be a `std::shared_ptr`.
+ * @tparam Version Identifies a version of a path. It must support `==`.
+ */
+template <class Value, class Version>
+class LruCache {
+ public:
+  /**
+   * @param capacity The largest total size to keep.
+   */
+  explicit LruCache(size_t capacity) : capacity_(capacity) {}
+
+  /**
+   * @brief Looks up an entry, and marks it as the most recently used.
+   * @param path The path.
+   * @param version The current version of the path. An entry for any other
+   *    version is removed.
+   * @return The value, or nullptr if it isn't cached.
+   */
+  Value Find(const std::string& path, const Version& version) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto kEntry = entries_.find(path);
+    if (kEntry == entries_.end()) {
+      return nullptr;
+    }
+    if (!(kEntry->second.version == version)) {
+      Remove(kEntry);
+      return nullptr;
+    }
+
+    // Move it to the front of the line.
+    lru_.splice(lru_.begin(), lru_, kEntry->second.lru_position);
+    return kEntry->second.value;
+  }
+
+  /**
+   * @brief Adds an entry, replacing any existing one for the same path, and
+   *    makes room for it.
+   * @param path The path.
+   * @param value The value.
+   * @param version The version of the path that the value came from.
+   * @param size How much of the capacity the value uses.
+   * @return The number of other entries that were evicted.
+   */
+  size_t Insert(const std::string& path, Value value, const Version& version,
+                size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto kEntry = entries_.find(path);
+    if (kEntry != entries_.end()) {
+      Remove(kEntry);
+    }
+
+    lru_.push_front(path);
+    entries_[path] = {std::move(value), version, size, lru_.begin()};
+    size_ += size;
+
+    // Make room, starting with whatever was used longest ago.
+    size_t num_evicted = 0;
+    while (size_ > capacity_ && lru_.size() > 1) {
+      Remove(entries_.find(lru_.back()));
+      ++num_evicted;
+    }
+    return num_evicted;
+  }
+
+  /**
+   * @brief Removes the entry for a path, if there is one.
+   * @param path The path.
+   */
+  void Invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto kEntry = entries_.find(path);
+    if (kEntry != entries_.end()) {
+      Remove(kEntry);
+    }
+  }
+
+  /**
+   * @return The total size of the entries.
+   */
+  [[nodiscard]] size_t GetSize() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+  }
+
+ private:
+  /// A cached value.
+  struct Entry {
+    /// The value.
+    Value value;
+    /// Which version of the path it came from.
+    Version version;
+    /// How much of the capacity it uses.
+    size_t size;
+    /// Where the entry is in `lru_`.
+    std::list<std::string>::iterator lru_position;
+  };
+
+  /// Type of the map that holds the entries.
+  using EntryMap = std::unordered_map<std::string, Entry>;
+
+  /**
+   * @brief Removes an entry.
+   * @note The mutex must be held.
+   * @param entry The entry to remove.
+   */
+  void Remove(typename EntryMap::iterator entry) {
+    size_ -= entry->second.size;
+    lru_.erase(entry->second.lru_position);
+    entries_.erase(entry);
+  }
+
+  /// The largest total size to keep.
+  size_t capacity_;
+
+  /// Protects access to internal data structures.
+  mutable std::mutex mutex_{};
+  /// Cached entries by path.
+  EntryMap entries_{};
+  /// Paths of cached entries, most recently used first.
+  std::list<std::string> lru_{};
+  /// Total size of the cached entries.
+  size_t size_ = 0;
+};
+
+}  // namespace server::file_handler
+
+#endif  // PROJECT1_LRU_CACHE_H
@@ -1,14 +1,25 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <ctime>
 #include <filesystem>
+#include <fstream>
 #include <memory>
 #include <random>
 #include <sstream>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "../content_index.h"
 #include "../file_access_manager.h"
+#include "../file_cache.h"
+#include "../listing_cache.h"
 #include "../thread_safe_file_handler.h"
+#include "content_hash/sha256.h"
 #include "gtest/gtest.h"
 
 using std::filesystem::path;
@@ -95,6 +106,156 @@ TEST(FileHandler, PutGet) {
   EXPECT_TRUE(std::filesystem::exists(kTestFile));
 }
 
+/**
+ * @test Tests that we can write a file and then read it back through a file
+ *    descriptor.
+ */
+TEST(FileHandler, PutOpen) {
+  // Arrange.
+  TestDir test_dir;
+
+  // File to test with.
+  const path kTestFile = test_dir.Get() / "test_file.txt";
+  // Data to write.
+  const std::vector<uint8_t> kTestData = {1, 2, 3, 4, 5};
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(managers.read_manager,
+                                     managers.write_manager);
+
+  // Act.
+  ASSERT_TRUE(file_handler.Put(kTestFile, kTestData));
+  const int kFd = file_handler.Open(kTestFile);
+  ASSERT_GE(kFd, 0);
+  std::vector<uint8_t> got_data(kTestData.size() + 1);
+  const ssize_t kBytesRead = read(kFd, got_data.data(), got_data.size());
+  close(kFd);
+
+  // Assert.
+  // It should have gotten the correct data.
+  ASSERT_EQ(kBytesRead, static_cast<ssize_t>(kTestData.size()));
+  got_data.resize(kBytesRead);
+  EXPECT_EQ(kTestData, got_data);
+  // Opening a file that doesn't exist should fail.
+  EXPECT_LT(file_handler.Open(test_dir.Get() / "missing.txt"), 0);
+}
+
+/**
+ * @test Tests that committing a temporary file replaces the old file, without
+ *    disturbing anyone who is already reading it.
+ */
+TEST(FileHandler, CreateTempCommit) {
+  // Arrange.
+  TestDir test_dir;
+
+  // File to test with.
+  const path kTestFile = test_dir.Get() / "test_file.txt";
+  // Old and new data.
+  const std::vector<uint8_t> kOldData = {1, 2, 3};
+  const std::vector<uint8_t> kNewData = {4, 5, 6, 7};
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(managers.read_manager,
+                                     managers.write_manager);
+  ASSERT_TRUE(file_handler.Put(kTestFile, kOldData));
+  const int kReaderFd = file_handler.Open(kTestFile);
+  ASSERT_GE(kReaderFd, 0);
+
+  // Act.
+  std::string temp_path;
+  const int kTempFd = file_handler.CreateTemp(kTestFile, &temp_path);
+  ASSERT_GE(kTempFd, 0);
+  ASSERT_EQ(write(kTempFd, kNewData.data(), kNewData.size()),
+            static_cast<ssize_t>(kNewData.size()));
+  close(kTempFd);
+  // The old file should be intact until we commit.
+  const auto kBeforeCommit = file_handler.Get(kTestFile);
+  ASSERT_TRUE(file_handler.Commit(temp_path, kTestFile));
+
+  std::vector<uint8_t> reader_data(kOldData.size() + 1);
+  const ssize_t kBytesRead =
+      read(kReaderFd, reader_data.data(), reader_data.size());
+  close(kReaderFd);
+
+  // Assert.
+  EXPECT_EQ(kOldData, kBeforeCommit);
+  EXPECT_EQ(kNewData, file_handler.Get(kTestFile));
+  // The temporary file should be gone.
+  EXPECT_FALSE(std::filesystem::exists(temp_path));
+  // The existing reader should still see the old contents.
+  ASSERT_EQ(kBytesRead, static_cast<ssize_t>(kOldData.size()));
+  reader_data.resize(kBytesRead);
+  EXPECT_EQ(kOldData, reader_data);
+}
+
+/**
+ * @test Tests that files that are still being written don't show up in
+ *    listings, and are cleaned up if they are left behind.
+ */
+TEST(FileHandler, TempFilesHidden) {
+  // Arrange.
+  TestDir test_dir;
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(managers.read_manager,
+                                     managers.write_manager, nullptr,
+                                     std::make_shared<ListingCache>());
+  ASSERT_TRUE(file_handler.ChangeDir(test_dir.Get()));
+  ASSERT_TRUE(file_handler.Put("a", {1}));
+  std::string temp_path;
+  const int kTempFd = file_handler.CreateTemp("b", &temp_path);
+  ASSERT_GE(kTempFd, 0);
+  close(kTempFd);
+
+  // Act.
+  bool more = false;
+  const auto kCached = file_handler.ListPage("", 0, &more);
+  const auto kUncached = file_handler.List();
+  FileHandler::RemoveStaleTemps(test_dir.Get());
+
+  // Assert.
+  EXPECT_EQ(kCached, std::vector<std::string>({"a"}));
+  EXPECT_EQ(kUncached, std::vector<std::string>({"a"}));
+  EXPECT_FALSE(std::filesystem::exists(temp_path));
+  EXPECT_TRUE(std::filesystem::exists(test_dir.Get() / "a"));
+}
+
+/**
+ * @test Tests that new files get the usual permissions, and replaced files
+ *    keep theirs.
+ */
+TEST(FileHandler, PutPermissions) {
+  // Arrange.
+  TestDir test_dir;
+  const path kNewFile = test_dir.Get() / "new.txt";
+  const path kExistingFile = test_dir.Get() / "existing.txt";
+  const auto kPerms = [](const path &file) {
+    return std::filesystem::status(file).permissions();
+  };
+
+  // The tests are single-threaded, so it's safe to read the mask this way.
+  const mode_t kUmask = umask(022);
+  umask(kUmask);
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(managers.read_manager,
+                                     managers.write_manager);
+  ASSERT_TRUE(file_handler.Put(kExistingFile, {1}));
+  std::filesystem::permissions(kExistingFile,
+                               std::filesystem::perms::owner_read |
+                                   std::filesystem::perms::owner_write |
+                                   std::filesystem::perms::owner_exec);
+
+  // Act.
+  ASSERT_TRUE(file_handler.Put(kNewFile, {1, 2}));
+  ASSERT_TRUE(file_handler.Put(kExistingFile, {1, 2}));
+
+  // Assert.
+  EXPECT_EQ(kPerms(kNewFile),
+            static_cast<std::filesystem::perms>(0666 & ~kUmask));
+  EXPECT_EQ(kPerms(kExistingFile), static_cast<std::filesystem::perms>(0700));
+}
+
 /**
  * @test Tests that we can write a file and then delete it.
  */
@@ -219,4 +380,403 @@ TEST(FileHandler, PutGetConcurrentSameFile) {
   EXPECT_EQ(kTestData, kGotData);
 }
 
-}  // namespace server::file_handler::tests
\ No newline at end of file
+/**
+ * @test Tests that many threads can lock a file shared, but that an exclusive
+ *    lock waits for all of them.
+ */
+TEST(FileAccessManager, SharedLocks) {
+  // Arrange.
+  TestDir test_dir;
+  const path kTestFile = test_dir.Get() / "test_file.txt";
+  FileAccessManager manager;
+
+  // Act.
+  manager.LockFile(kTestFile, LockMode::SHARED);
+  // This would block forever if shared locks excluded each other.
+  std::thread reader([&]() {
+    manager.LockFile(kTestFile, LockMode::SHARED);
+    manager.UnlockFile(kTestFile, LockMode::SHARED);
+  });
+  reader.join();
+
+  std::atomic<bool> writer_locked = false;
+  std::thread writer([&]() {
+    manager.LockFile(kTestFile, LockMode::EXCLUSIVE);
+    writer_locked = true;
+    manager.UnlockFile(kTestFile, LockMode::EXCLUSIVE);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const bool kLockedWhileShared = writer_locked;
+
+  manager.UnlockFile(kTestFile, LockMode::SHARED);
+  writer.join();
+
+  // Assert.
+  // The writer should have waited for the reader.
+  EXPECT_FALSE(kLockedWhileShared);
+  EXPECT_TRUE(writer_locked);
+}
+
+/**
+ * @test Tests that a waiting writer goes ahead of readers that show up after
+ *    it.
+ */
+TEST(FileAccessManager, WriterPreference) {
+  // Arrange.
+  TestDir test_dir;
+  const path kTestFile = test_dir.Get() / "test_file.txt";
+  FileAccessManager manager;
+
+  // Counts the threads in the order they get the lock.
+  std::atomic<uint32_t> num_locked = 0;
+  uint32_t writer_order = 0;
+  uint32_t reader_order = 0;
+
+  // Act.
+  manager.LockFile(kTestFile, LockMode::SHARED);
+  std::thread writer([&]() {
+    manager.LockFile(kTestFile, LockMode::EXCLUSIVE);
+    writer_order = ++num_locked;
+    manager.UnlockFile(kTestFile, LockMode::EXCLUSIVE);
+  });
+  // Give the writer time to start waiting.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::thread reader([&]() {
+    manager.LockFile(kTestFile, LockMode::SHARED);
+    reader_order = ++num_locked;
+    manager.UnlockFile(kTestFile, LockMode::SHARED);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const uint32_t kNumLockedEarly = num_locked;
+
+  manager.UnlockFile(kTestFile, LockMode::SHARED);
+  writer.join();
+  reader.join();
+
+  // Assert.
+  // Neither should get the lock while the first reader has it, since the new
+  // reader has to wait for the writer.
+  EXPECT_EQ(kNumLockedEarly, 0u);
+  // The writer should have gone first.
+  EXPECT_EQ(writer_order, 1u);
+  EXPECT_EQ(reader_order, 2u);
+}
+
+/**
+ * @test Tests that holding a lock on one file doesn't block other files, even
+ *    ones that end up in the same part of the lock table.
+ */
+TEST(FileAccessManager, ManyFiles) {
+  // Arrange.
+  TestDir test_dir;
+  const path kLockedFile = test_dir.Get() / "locked.txt";
+  FileAccessManager manager;
+
+  // Enough files that some of them share a shard with the locked one.
+  constexpr uint32_t kNumFiles = 1000;
+  constexpr uint32_t kNumThreads = 4;
+
+  // Act.
+  manager.LockFile(kLockedFile, LockMode::EXCLUSIVE);
+  // These would block forever if they waited on the locked file.
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&, i]() {
+      for (uint32_t j = 0; j < kNumFiles; ++j) {
+        const path kFile =
+            test_dir.Get() /
+            ("file_" + std::to_string(i) + "_" + std::to_string(j));
+        manager.LockFile(kFile, LockMode::EXCLUSIVE);
+        manager.UnlockFile(kFile, LockMode::EXCLUSIVE);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Assert.
+  // The locked file should still be locked.
+  std::atomic<bool> reader_locked = false;
+  std::thread reader([&]() {
+    manager.LockFile(kLockedFile, LockMode::SHARED);
+    reader_locked = true;
+    manager.UnlockFile(kLockedFile, LockMode::SHARED);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(reader_locked);
+
+  manager.UnlockFile(kLockedFile, LockMode::EXCLUSIVE);
+  reader.join();
+  EXPECT_TRUE(reader_locked);
+}
+
+/**
+ * @test Tests that repeated reads come from the cache, and that writing the
+ *    file keeps stale contents from being served.
+ */
+TEST(FileCache, HitAndInvalidate) {
+  // Arrange.
+  TestDir test_dir;
+  const path kTestFile = test_dir.Get() / "test_file.txt";
+  const std::vector<uint8_t> kTestData1 = {1, 2, 3, 4, 5};
+  const std::vector<uint8_t> kTestData2 = {6, 7, 8};
+
+  AccessManagers managers = CreateAccessManagers();
+  auto cache = std::make_shared<FileCache>();
+  ThreadSafeFileHandler file_handler(managers.read_manager,
+                                     managers.write_manager, cache);
+
+  // Act.
+  ASSERT_TRUE(file_handler.Put(kTestFile, kTestData1));
+  const auto kGotData1 = file_handler.Get(kTestFile);
+  const auto kGotData2 = file_handler.Get(kTestFile);
+  const auto kStatsBeforePut = cache->GetStats();
+
+  ASSERT_TRUE(file_handler.Put(kTestFile, kTestData2));
+  const auto kGotData3 = file_handler.Get(kTestFile);
+  const auto kStatsAfterPut = cache->GetStats();
+
+  // Assert.
+  EXPECT_EQ(kGotData1, kTestData1);
+  EXPECT_EQ(kGotData2, kTestData1);
+  // The second read should have come from memory.
+  EXPECT_EQ(kStatsBeforePut.misses, 1u);
+  EXPECT_EQ(kStatsBeforePut.hits, 1u);
+  EXPECT_EQ(kStatsBeforePut.size, kTestData1.size());
+
+  // After the write, it should have read the file again.
+  EXPECT_EQ(kGotData3, kTestData2);
+  EXPECT_EQ(kStatsAfterPut.misses, 2u);
+  EXPECT_EQ(kStatsAfterPut.size, kTestData2.size());
+}
+
+/**
+ * @test Tests that the least recently used file is evicted once the cache is
+ *    full, and that files that are too large aren't cached at all.
+ */
+TEST(FileCache, Eviction) {
+  // Arrange.
+  TestDir test_dir;
+  const path kTestFile1 = test_dir.Get() / "test_file_1.txt";
+  const path kTestFile2 = test_dir.Get() / "test_file_2.txt";
+  const path kTestFile3 = test_dir.Get() / "test_file_3.txt";
+  const path kLargeFile = test_dir.Get() / "large_file.txt";
+  const std::vector<uint8_t> kTestData(100, 1);
+
+  AccessManagers managers = CreateAccessManagers();
+  // Room for two of the files.
+  auto cache = std::make_shared<FileCache>(250, 150);
+  ThreadSafeFileHandler file_handler(managers.read_manager,
+                                     managers.write_manager, cache);
+  ASSERT_TRUE(file_handler.Put(kTestFile1, kTestData));
+  ASSERT_TRUE(file_handler.Put(kTestFile2, kTestData));
+  ASSERT_TRUE(file_handler.Put(kTestFile3, kTestData));
+  ASSERT_TRUE(file_handler.Put(kLargeFile, std::vector<uint8_t>(200, 2)));
+
+  // Act.
+  EXPECT_EQ(file_handler.Get(kTestFile1), kTestData);
+  EXPECT_EQ(file_handler.Get(kTestFile2), kTestData);
+  // Now the second file is the least recently used.
+  EXPECT_EQ(file_handler.Get(kTestFile1), kTestData);
+  EXPECT_EQ(file_handler.Get(kTestFile3), kTestData);
+  const auto kStatsAfterEviction = cache->GetStats();
+  // This should still be cached.
+  EXPECT_EQ(file_handler.Get(kTestFile1), kTestData);
+  // This should not.
+  EXPECT_EQ(file_handler.Get(kTestFile2), kTestData);
+  // This should never be cached.
+  EXPECT_EQ(file_handler.Get(kLargeFile), std::vector<uint8_t>(200, 2));
+  const auto kFinalStats = cache->GetStats();
+
+  // Assert.
+  EXPECT_EQ(kStatsAfterEviction.evictions, 1u);
+  EXPECT_EQ(kStatsAfterEviction.size, 200u);
+  EXPECT_EQ(kFinalStats.hits, 2u);
+  EXPECT_EQ(kFinalStats.misses, 4u);
+}
+
+/**
+ * @test Tests that a directory can be listed a page at a time, in order.
+ */
+TEST(ListingCache, Pages) {
+  // Arrange.
+  TestDir test_dir;
+  const std::vector<std::string> kFilenames = {"a", "b", "c", "d", "e"};
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(managers.read_manager,
+                                     managers.write_manager, nullptr,
+                                     std::make_shared<ListingCache>());
+  ASSERT_TRUE(file_handler.ChangeDir(test_dir.Get()));
+  // Write them out of order.
+  for (auto it = kFilenames.rbegin(); it != kFilenames.rend(); ++it) {
+    ASSERT_TRUE(file_handler.Put(*it, {1}));
+  }
+
+  // Act.
+  bool more1 = false;
+  const auto kPage1 = file_handler.ListPage("", 2, &more1);
+  bool more2 = false;
+  const auto kPage2 = file_handler.ListPage(kPage1.back(), 2, &more2);
+  bool more3 = false;
+  const auto kPage3 = file_handler.ListPage(kPage2.back(), 2, &more3);
+  bool more_all = true;
+  const auto kAll = file_handler.ListPage("", 0, &more_all);
+
+  // Assert.
+  EXPECT_EQ(kPage1, std::vector<std::string>({"a", "b"}));
+  EXPECT_TRUE(more1);
+  EXPECT_EQ(kPage2, std::vector<std::string>({"c", "d"}));
+  EXPECT_TRUE(more2);
+  EXPECT_EQ(kPage3, std::vector<std::string>({"e"}));
+  EXPECT_FALSE(more3);
+  // Without a limit, it should list everything.
+  EXPECT_EQ(kAll, kFilenames);
+  EXPECT_FALSE(more_all);
+}
+
+/**
+ * @test Tests that cached listings pick up files that are added and removed.
+ */
+TEST(ListingCache, Invalidate) {
+  // Arrange.
+  TestDir test_dir;
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(managers.read_manager,
+                                     managers.write_manager, nullptr,
+                                     std::make_shared<ListingCache>());
+  ASSERT_TRUE(file_handler.ChangeDir(test_dir.Get()));
+  ASSERT_TRUE(file_handler.Put("a", {1}));
+  ASSERT_TRUE(file_handler.Put("c", {1}));
+
+  // Act.
+  bool more = false;
+  const auto kBefore = file_handler.ListPage("", 0, &more);
+  ASSERT_TRUE(file_handler.Put("b", {1}));
+  ASSERT_TRUE(file_handler.MakeDir("d/"));
+  const auto kAfterAdd = file_handler.ListPage("", 0, &more);
+  ASSERT_TRUE(file_handler.Delete("a"));
+  const auto kAfterDelete = file_handler.ListPage("", 0, &more);
+
+  // Assert.
+  EXPECT_EQ(kBefore, std::vector<std::string>({"a", "c"}));
+  EXPECT_EQ(kAfterAdd, std::vector<std::string>({"a", "b", "c", "d"}));
+  EXPECT_EQ(kAfterDelete, std::vector<std::string>({"b", "c", "d"}));
+}
+
+/**
+ * @test Tests that a file can be written by reusing another file with the
+ *    same contents, and that the index survives a restart.
+ */
+TEST(ContentIndex, PutDuplicate) {
+  // Arrange.
+  TestDir test_dir;
+  const path kIndexPath = test_dir.Get() / "index";
+  const path kOriginalFile = test_dir.Get() / "original.txt";
+  const path kCopyFile = test_dir.Get() / "copy.txt";
+  const path kRestartCopyFile = test_dir.Get() / "restart_copy.txt";
+  const std::vector<uint8_t> kTestData = {1, 2, 3, 4, 5};
+  const std::string kHash =
+      content_hash::HashData(kTestData.data(), kTestData.size());
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(
+      managers.read_manager, managers.write_manager, nullptr, nullptr,
+      std::make_shared<ContentIndex>(kIndexPath));
+  ASSERT_TRUE(file_handler.Put(kOriginalFile, kTestData));
+
+  // Act.
+  const bool kWrongSize =
+      file_handler.PutDuplicate(kHash, kTestData.size() + 1, kCopyFile);
+  const bool kCopied =
+      file_handler.PutDuplicate(kHash, kTestData.size(), kCopyFile);
+
+  // Load the index again, as if the server restarted.
+  ThreadSafeFileHandler restarted_file_handler(
+      managers.read_manager, managers.write_manager, nullptr, nullptr,
+      std::make_shared<ContentIndex>(kIndexPath));
+  const bool kCopiedAfterRestart = restarted_file_handler.PutDuplicate(
+      kHash, kTestData.size(), kRestartCopyFile);
+
+  // Assert.
+  EXPECT_FALSE(kWrongSize);
+  EXPECT_TRUE(kCopied);
+  EXPECT_EQ(file_handler.Get(kCopyFile), kTestData);
+  EXPECT_TRUE(kCopiedAfterRestart);
+  EXPECT_EQ(file_handler.Get(kRestartCopyFile), kTestData);
+}
+
+/**
+ * @test Tests that files which were deleted or changed are never reused.
+ */
+TEST(ContentIndex, StaleEntries) {
+  // Arrange.
+  TestDir test_dir;
+  const path kDeletedFile = test_dir.Get() / "deleted.txt";
+  const path kChangedFile = test_dir.Get() / "changed.txt";
+  const path kCopyFile = test_dir.Get() / "copy.txt";
+  const std::vector<uint8_t> kTestData1 = {1, 2, 3, 4, 5};
+  const std::vector<uint8_t> kTestData2 = {6, 7, 8, 9, 10};
+  const std::string kHash1 =
+      content_hash::HashData(kTestData1.data(), kTestData1.size());
+  const std::string kHash2 =
+      content_hash::HashData(kTestData2.data(), kTestData2.size());
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(
+      managers.read_manager, managers.write_manager, nullptr, nullptr,
+      std::make_shared<ContentIndex>(test_dir.Get() / "index"));
+  ASSERT_TRUE(file_handler.Put(kDeletedFile, kTestData1));
+  ASSERT_TRUE(file_handler.Put(kChangedFile, kTestData2));
+
+  // Act.
+  ASSERT_TRUE(file_handler.Delete(kDeletedFile));
+  // Change it without going through the file handler.
+  {
+    std::ofstream stream(kChangedFile, std::ios::binary | std::ios::app);
+    stream << "more";
+  }
+
+  // Assert.
+  EXPECT_FALSE(
+      file_handler.PutDuplicate(kHash1, kTestData1.size(), kCopyFile));
+  EXPECT_FALSE(
+      file_handler.PutDuplicate(kHash2, kTestData2.size(), kCopyFile));
+  EXPECT_FALSE(std::filesystem::exists(kCopyFile));
+}
+
+/**
+ * @test Tests that clients can't read or change the index itself.
+ */
+TEST(ContentIndex, IndexFileIsProtected) {
+  // Arrange.
+  TestDir test_dir;
+  const path kIndexPath = test_dir.Get() / "index";
+  const std::vector<uint8_t> kTestData = {1, 2, 3, 4, 5};
+
+  AccessManagers managers = CreateAccessManagers();
+  ThreadSafeFileHandler file_handler(
+      managers.read_manager, managers.write_manager, nullptr, nullptr,
+      std::make_shared<ContentIndex>(kIndexPath));
+  ASSERT_TRUE(file_handler.Put(test_dir.Get() / "file.txt", kTestData));
+  ASSERT_TRUE(std::filesystem::exists(kIndexPath));
+
+  // Act.
+  const bool kPut = file_handler.Put(kIndexPath, kTestData);
+  const bool kDeleted = file_handler.Delete(kIndexPath);
+  const bool kMadeDir = file_handler.MakeDir(kIndexPath.string() + ".tmp");
+  const auto kContents = file_handler.Get(kIndexPath);
+  const int kFd = file_handler.Open(test_dir.Get() / "." / "index");
+
+  // Assert.
+  EXPECT_FALSE(kPut);
+  EXPECT_FALSE(kDeleted);
+  EXPECT_FALSE(kMadeDir);
+  EXPECT_TRUE(kContents.empty());
+  EXPECT_EQ(kFd, -1);
+  EXPECT_TRUE(std::filesystem::exists(kIndexPath));
+}
+
+}  // namespace server::file_handler::tests
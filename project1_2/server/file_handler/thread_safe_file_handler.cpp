@@ -1,49 +1,283 @@
 #include "thread_safe_file_handler.h"
 
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
 #include <utility>
 
+#include "content_hash/sha256.h"
 #include "file_lock_guard.h"
 
 namespace server::file_handler {
+namespace {
+
+/**
+ * @brief Normalizes a path, so that there is only one key for each
+ *    directory in the listing cache.
+ * @param path The absolute path.
+ * @return The normalized path, without a trailing slash.
+ */
+std::filesystem::path NormalizeDir(const std::filesystem::path& path) {
+  auto normal_path = path.lexically_normal();
+  if (!normal_path.has_filename() && normal_path.has_relative_path()) {
+    normal_path = normal_path.parent_path();
+  }
+  return normal_path;
+}
+
+}  // namespace
 
 ThreadSafeFileHandler::ThreadSafeFileHandler(
     std::shared_ptr<FileAccessManager> read_manager,
-    std::shared_ptr<FileAccessManager> write_manager)
+    std::shared_ptr<FileAccessManager> write_manager,
+    std::shared_ptr<FileCache> cache,
+    std::shared_ptr<ListingCache> listing_cache,
+    std::shared_ptr<ContentIndex> content_index)
     : read_manager_(std::move(read_manager)),
-      write_manager_(std::move(write_manager)) {}
+      write_manager_(std::move(write_manager)),
+      cache_(std::move(cache)),
+      listing_cache_(std::move(listing_cache)),
+      content_index_(std::move(content_index)) {}
 
 std::vector<uint8_t> ThreadSafeFileHandler::Get(
     const std::string& filename) const {
-  FileLockGuard read_lock(read_manager_.get(), ToAbsolute(filename));
+  if (IsIndexFile(ToAbsolute(filename))) {
+    return {};
+  }
+
+  // Any number of readers can share the file, as long as nobody is writing.
+  FileLockGuard read_lock(read_manager_.get(), ToAbsolute(filename),
+                          LockMode::SHARED);
 
+  if (cache_) {
+    const int kFileFd = FileHandler::Open(filename);
+    if (kFileFd >= 0) {
+      const auto kContents = GetCached(filename, kFileFd);
+      close(kFileFd);
+      if (kContents != nullptr) {
+        return *kContents;
+      }
+    }
+  }
   return FileHandler::Get(filename);
 }
 
+int ThreadSafeFileHandler::Open(const std::string& filename) const {
+  if (IsIndexFile(ToAbsolute(filename))) {
+    errno = EACCES;
+    return -1;
+  }
+
+  // We only hold the lock while opening the file, since streaming it can take
+  // arbitrarily long. Put() and Commit() replace files rather than rewriting
+  // them, so we keep reading a consistent version.
+  FileLockGuard read_lock(read_manager_.get(), ToAbsolute(filename),
+                          LockMode::SHARED);
+
+  return FileHandler::Open(filename);
+}
+
 bool ThreadSafeFileHandler::Put(const std::string& filename,
                                 const std::vector<uint8_t>& contents) {
   const auto kPath = ToAbsolute(filename);
+  if (IsIndexFile(kPath)) {
+    return false;
+  }
   FileLockGuard read_lock(read_manager_.get(), kPath);
   FileLockGuard write_lock(write_manager_.get(), kPath);
 
-  return FileHandler::Put(filename, contents);
+  Invalidate(kPath);
+  InvalidateListing(kPath);
+  if (!FileHandler::Put(filename, contents)) {
+    return false;
+  }
+
+  if (content_index_) {
+    const int kFileFd = FileHandler::Open(filename);
+    if (kFileFd >= 0) {
+      content_index_->Add(kPath.lexically_normal(),
+                          content_hash::HashData(contents.data(),
+                                                 contents.size()),
+                          kFileFd);
+      close(kFileFd);
+    } else {
+      content_index_->Remove(kPath.lexically_normal());
+    }
+  }
+  return true;
+}
+
+bool ThreadSafeFileHandler::Commit(const std::string& temp_path,
+                                   const std::string& filename) {
+  // Keep the file open, so that we hash exactly what was committed.
+  const int kFileFd =
+      content_index_ ? open(temp_path.c_str(), O_RDONLY | O_CLOEXEC) : -1;
+  const bool kCommitted = CommitFile(temp_path, filename);
+
+  // Hash it once it is in place, since that reads all of it, and nobody
+  // should have to wait for that. If the file is replaced in the meantime,
+  // the index notices that the entry doesn't match anymore.
+  if (kCommitted && kFileFd >= 0) {
+    const auto kContentHash = content_hash::HashFile(kFileFd);
+    if (!kContentHash.empty()) {
+      content_index_->Add(ToAbsolute(filename).lexically_normal(),
+                          kContentHash, kFileFd);
+    }
+  }
+  if (kFileFd >= 0) {
+    close(kFileFd);
+  }
+  return kCommitted;
 }
 
 bool ThreadSafeFileHandler::Delete(const std::string& filename) {
   const auto kPath = ToAbsolute(filename);
+  if (IsIndexFile(kPath)) {
+    return false;
+  }
   FileLockGuard read_lock(read_manager_.get(), kPath);
   FileLockGuard write_lock(write_manager_.get(), kPath);
 
+  Invalidate(kPath);
+  InvalidateListing(kPath);
+  if (content_index_) {
+    content_index_->Remove(kPath.lexically_normal());
+  }
   return FileHandler::Delete(filename);
 }
 
 bool ThreadSafeFileHandler::MakeDir(const std::string& name) {
   const auto kPath = ToAbsolute(name);
+  if (IsIndexFile(NormalizeDir(kPath))) {
+    return false;
+  }
   FileLockGuard read_lock(read_manager_.get(), kPath);
   FileLockGuard write_lock(write_manager_.get(), kPath);
 
+  InvalidateListing(kPath);
   return FileHandler::MakeDir(name);
 }
 
+std::vector<std::string> ThreadSafeFileHandler::ListPage(
+    const std::string& after, size_t max_entries, bool* more) const {
+  if (listing_cache_) {
+    const auto kListing = listing_cache_->Get(NormalizeDir(GetCurrentDir()));
+    if (kListing != nullptr) {
+      return GetPage(*kListing, after, max_entries, more);
+    }
+  }
+  return FileHandler::ListPage(after, max_entries, more);
+}
+
+FileCache::Contents ThreadSafeFileHandler::GetCached(
+    const std::string& filename, int file_fd) const {
+  if (!cache_) {
+    return nullptr;
+  }
+  return cache_->Get(ToAbsolute(filename).lexically_normal(), file_fd);
+}
+
+FileCache::Stats ThreadSafeFileHandler::GetCacheStats() const {
+  return cache_ ? cache_->GetStats() : FileCache::Stats{};
+}
+
+bool ThreadSafeFileHandler::PutDuplicate(const std::string& content_hash,
+                                         uint64_t size,
+                                         const std::string& filename) {
+  if (!content_index_) {
+    return false;
+  }
+  const int kSourceFd = content_index_->Find(content_hash, size);
+  if (kSourceFd < 0) {
+    return false;
+  }
+
+  std::string temp_path;
+  int temp_fd = FileHandler::CreateTemp(filename, &temp_path);
+  if (temp_fd >= 0 && ioctl(temp_fd, FICLONE, kSourceFd) != 0) {
+    // The filesystem can't share data between files, so fall back to a hard
+    // link. Files are always replaced rather than rewritten, so the two
+    // names still can't affect each other. Link the file we actually
+    // checked, rather than whatever has its name now.
+    close(temp_fd);
+    unlink(temp_path.c_str());
+    const std::string kSourcePath =
+        "/proc/self/fd/" + std::to_string(kSourceFd);
+    temp_fd = -1;
+    if (linkat(AT_FDCWD, kSourcePath.c_str(), AT_FDCWD, temp_path.c_str(),
+               AT_SYMLINK_FOLLOW) == 0) {
+      temp_fd = open(temp_path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+  }
+  close(kSourceFd);
+  if (temp_fd < 0) {
+    if (!temp_path.empty()) {
+      unlink(temp_path.c_str());
+    }
+    return false;
+  }
+
+  const bool kCommitted = CommitFile(temp_path, filename);
+  if (kCommitted) {
+    content_index_->Add(ToAbsolute(filename).lexically_normal(), content_hash,
+                        temp_fd);
+  } else {
+    unlink(temp_path.c_str());
+  }
+  close(temp_fd);
+  return kCommitted;
+}
+
+bool ThreadSafeFileHandler::IsIndexFile(
+    const std::filesystem::path& path) const {
+  return content_index_ &&
+         content_index_->IsIndexFile(path.lexically_normal().string());
+}
+
+void ThreadSafeFileHandler::Invalidate(const std::filesystem::path& path) {
+  if (cache_) {
+    cache_->Invalidate(path.lexically_normal());
+  }
+}
+
+void ThreadSafeFileHandler::InvalidateListing(
+    const std::filesystem::path& path) {
+  if (!listing_cache_) {
+    return;
+  }
+
+  // Directories can be named with a trailing slash, which isn't part of
+  // their name.
+  listing_cache_->Invalidate(NormalizeDir(path).parent_path());
+}
+
+bool ThreadSafeFileHandler::CommitFile(const std::string& temp_path,
+                                       const std::string& filename) {
+  // The temporary file is private to its writer, so only the destination
+  // needs to be locked.
+  const auto kPath = ToAbsolute(filename);
+  if (IsIndexFile(kPath)) {
+    return false;
+  }
+  FileLockGuard read_lock(read_manager_.get(), kPath);
+  FileLockGuard write_lock(write_manager_.get(), kPath);
+
+  Invalidate(kPath);
+  InvalidateListing(kPath);
+  if (!FileHandler::Commit(temp_path, filename)) {
+    return false;
+  }
+
+  if (content_index_) {
+    content_index_->Remove(kPath.lexically_normal());
+  }
+  return true;
+}
+
 std::filesystem::path ThreadSafeFileHandler::ToAbsolute(
     const std::filesystem::path& path) const {
   return std::filesystem::path(GetCurrentDir()) / path;
@@ -6,7 +6,10 @@
 #include <vector>
 
 #include "file_access_manager.h"
+#include "content_index.h"
+#include "file_cache.h"
 #include "file_handler.h"
+#include "listing_cache.h"
 
 namespace server::file_handler {
 
@@ -19,18 +22,66 @@ class ThreadSafeFileHandler : public FileHandler {
  public:
   /**
    * @param read_manager Used for synchronizing access to files among multiple
-   *    instances in different threads.
+   *    instances in different threads. Reads lock files in it shared, and
+   *    writes lock them exclusively.
+   * @param write_manager Used for serializing writes to the same file.
+   * @param cache Keeps popular files in memory. It should be shared among
+   *    all instances. If it is null, nothing is cached.
+   * @param listing_cache Keeps directory listings in memory. It should be
+   *    shared among all instances. If it is null, every listing is read
+   *    from disk.
+   * @param content_index Remembers the hashes of files that are written, so
+   *    that uploads can be deduplicated. It should be shared among all
+   *    instances. If it is null, nothing is deduplicated.
    */
   explicit ThreadSafeFileHandler(
       std::shared_ptr<FileAccessManager> read_manager,
-      std::shared_ptr<FileAccessManager> write_manager);
+      std::shared_ptr<FileAccessManager> write_manager,
+      std::shared_ptr<FileCache> cache = nullptr,
+      std::shared_ptr<ListingCache> listing_cache = nullptr,
+      std::shared_ptr<ContentIndex> content_index = nullptr);
 
   [[nodiscard]] std::vector<uint8_t> Get(
       const std::string &filename) const final;
+  [[nodiscard]] int Open(const std::string &filename) const final;
   bool Put(const std::string &filename,
            const std::vector<uint8_t> &contents) final;
+  bool Commit(const std::string &temp_path,
+              const std::string &filename) final;
   bool Delete(const std::string &filename) final;
   bool MakeDir(const std::string &name) final;
+  [[nodiscard]] std::vector<std::string> ListPage(const std::string &after,
+                                                  size_t max_entries,
+                                                  bool *more) const final;
+
+  /**
+   * @brief Gets the contents of a file from the cache, reading them in if
+   *    needed.
+   * @param filename The name of the file.
+   * @param file_fd The file, as returned by `Open()`.
+   * @return The contents, or nullptr if there is no cache, or the file
+   *    can't be cached, in which case it should be streamed from disk.
+   */
+  [[nodiscard]] FileCache::Contents GetCached(const std::string &filename,
+                                              int file_fd) const;
+
+  /**
+   * @return Counters for the cache, which are all 0 if there is no cache.
+   */
+  [[nodiscard]] FileCache::Stats GetCacheStats() const;
+
+  /**
+   * @brief Writes a file by reusing an existing file with the same
+   *    contents, if there is one. The contents are cloned if the filesystem
+   *    supports it, and hard linked otherwise.
+   * @param content_hash The SHA-256 of the contents, as hex.
+   * @param size The size of the contents.
+   * @param filename The name of the file to write.
+   * @return True if the file was written, false if the contents have to be
+   *    uploaded after all.
+   */
+  bool PutDuplicate(const std::string &content_hash, uint64_t size,
+                    const std::string &filename);
 
  private:
   /**
@@ -42,10 +93,46 @@ class ThreadSafeFileHandler : public FileHandler {
   [[nodiscard]] std::filesystem::path ToAbsolute(
       const std::filesystem::path &path) const;
 
+  /**
+   * @brief Checks whether a path belongs to the content index, which
+   *    clients can't touch.
+   * @param path The absolute path.
+   * @return True if it does.
+   */
+  [[nodiscard]] bool IsIndexFile(const std::filesystem::path &path) const;
+
+  /**
+   * @brief Removes a file from the cache, if there is one.
+   * @param path The absolute path of the file.
+   */
+  void Invalidate(const std::filesystem::path &path);
+
+  /**
+   * @brief Removes the directory that a file is in from the listing cache,
+   *    if there is one.
+   * @param path The absolute path of the file.
+   */
+  void InvalidateListing(const std::filesystem::path &path);
+
+  /**
+   * @brief Commits a temporary file, and forgets anything cached or indexed
+   *    about the file it replaces.
+   * @param temp_path The path of the temporary file.
+   * @param filename The name of the file to replace.
+   * @return True on success, false on failure.
+   */
+  bool CommitFile(const std::string &temp_path, const std::string &filename);
+
   /// Synchronizes read access to files from multiple threads.
   std::shared_ptr<FileAccessManager> read_manager_;
   /// Synchronizes write access to files from multiple threads.
   std::shared_ptr<FileAccessManager> write_manager_;
+  /// Keeps popular files in memory.
+  std::shared_ptr<FileCache> cache_;
+  /// Keeps directory listings in memory.
+  std::shared_ptr<ListingCache> listing_cache_;
+  /// Remembers the hashes of files.
+  std::shared_ptr<ContentIndex> content_index_;
 };
 
 }  // namespace server::file_handler
@@ -1,25 +1,60 @@
 #include "server.h"
 
 #include <netinet/in.h>
+#include <filesystem>
 #include <memory>
 #include <loguru.hpp>
+#include "file_handler/file_handler.h"
 #include "server_tasks/nport_task.h"
+#include "server_tasks/striped_uploads.h"
 #include "server_tasks/tport_task.h"
 
 namespace server {
+namespace {
 
-Server::Server()
+/// Added to the name of the directory we serve to name the content index,
+/// which is kept next to it.
+constexpr char kContentIndexSuffix[] = ".ftp_content_index";
+
+/**
+ * @brief Picks where to keep the content index.
+ * @param content_index_path The path that was asked for, if any.
+ * @return The path to use.
+ */
+std::string GetContentIndexPath(const std::string& content_index_path) {
+  if (!content_index_path.empty()) {
+    return std::filesystem::absolute(content_index_path);
+  }
+
+  // Keep it out of the served tree, so clients can't see or change it.
+  const auto kServedDir = std::filesystem::current_path();
+  return kServedDir.parent_path() /
+         ("." + kServedDir.filename().string() + kContentIndexSuffix);
+}
+
+}  // namespace
+
+Server::Server(const std::string& content_index_path)
     : read_manager_(std::make_shared<file_handler::FileAccessManager>()),
-      write_manager_(std::make_shared<file_handler::FileAccessManager>()) {}
+      write_manager_(std::make_shared<file_handler::FileAccessManager>()),
+      file_cache_(std::make_shared<file_handler::FileCache>()),
+      listing_cache_(std::make_shared<file_handler::ListingCache>()),
+      content_index_(std::make_shared<file_handler::ContentIndex>(
+          GetContentIndexPath(content_index_path))) {
+  // Nothing is uploading yet, so anything left over is from a crash.
+  file_handler::FileHandler::RemoveStaleTemps(std::filesystem::current_path());
+}
 
 void Server::FtpService(uint16_t nPort, uint16_t tPort) {
   LOG_F(INFO, "FtpService now starting.");
   thread_pool::ThreadPool pool;
   auto active_ids = std::make_shared<server_tasks::CommandIDs>();
+  auto striped_uploads = std::make_shared<server_tasks::StripedUploads>();
 
   // pass active command list to nPortTask and tPortTask
   auto nPortTask = std::make_shared<server_tasks::NPortTask>(
-      active_ids, nPort, read_manager_, write_manager_);
+      active_ids, nPort, read_manager_, write_manager_, file_cache_,
+      listing_cache_, content_index_, striped_uploads);
   auto tPortTask = std::make_shared<server_tasks::TPortTask>(active_ids, tPort);
 
   pool.AddTask(nPortTask);
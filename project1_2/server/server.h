@@ -6,9 +6,13 @@
 #define PROJECT1_SERVER_H
 
 #include <cstdint>
+#include <string>
 
 #include "thread_pool/thread_pool.h"
+#include "file_handler/content_index.h"
 #include "file_handler/file_access_manager.h"
+#include "file_handler/file_cache.h"
+#include "file_handler/listing_cache.h"
 #include "server_tasks/command_ids.h"
 #include "vector"
 
@@ -20,7 +24,12 @@ namespace server {
  */
 class Server {
  public:
-  Server();
+  /**
+   * @param content_index_path Where to keep the index of file contents. It
+   *    must not be inside the directory that is being served. If it is
+   *    empty, it goes next to that directory.
+   */
+  explicit Server(const std::string& content_index_path = "");
 
   /**
    * @brief Starts the FTP service
@@ -35,6 +44,13 @@ class Server {
   /// File access managers. @note To be given to nPortTask and tPort Task
   std::shared_ptr<file_handler::FileAccessManager> read_manager_{};
   std::shared_ptr<file_handler::FileAccessManager> write_manager_{};
+  /// Keeps popular files in memory. @note Shared by all the agents.
+  std::shared_ptr<file_handler::FileCache> file_cache_{};
+  /// Keeps directory listings in memory. @note Shared by all the agents.
+  std::shared_ptr<file_handler::ListingCache> listing_cache_{};
+  /// Hashes of the files we have, for deduplicating uploads. @note Shared by
+  /// all the agents.
+  std::shared_ptr<file_handler::ContentIndex> content_index_{};
 };
 
 }  // namespace server
@@ -2,6 +2,7 @@
  * @brief Entry point for the FTP server.
  */
 
+#include <csignal>
 #include <cstdlib>
 #include <loguru.hpp>
 
@@ -12,7 +13,9 @@
  * @param program_name The name of the executable.
  */
 void PrintUsageAndExit(const char *program_name) {
-  LOG_F(INFO, "Incorrect program usage %s normal_port termination_port",
+  LOG_F(INFO,
+        "Incorrect program usage %s normal_port termination_port "
+        "[content_index_path]",
         program_name);
   exit(1);
 }
@@ -22,13 +25,16 @@ int main(int argc, char **argv) {
 
   // initialize server logging
   loguru::init(argc, argv);
+  // Clients can close extra download connections mid-transfer, which should
+  // just fail that transfer rather than killing the server.
+  std::signal(SIGPIPE, SIG_IGN);
   loguru::add_file("server_error.log", loguru::Append, loguru::Verbosity_ERROR);
   loguru::add_file("server_latest_error.log", loguru::Truncate,
                    loguru::Verbosity_ERROR);
   loguru::suggest_log_path("./logs", log_path, sizeof(log_path));
   loguru::add_file(log_path, loguru::FileMode::Truncate, loguru::Verbosity_MAX);
 
-  if (argc != 3) {
+  if (argc != 3 && argc != 4) {
     PrintUsageAndExit(argv[0]);
   }
 
@@ -44,6 +50,6 @@ int main(int argc, char **argv) {
   }
 
   // Create the server.
-  server::Server server;
+  server::Server server(argc == 4 ? argv[3] : "");
   server.FtpService(nPort, tPort);
 }
\ No newline at end of file
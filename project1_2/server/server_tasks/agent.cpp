@@ -1,15 +1,20 @@
 #include "agent.h"
 
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <cinttypes>
+#include <filesystem>
 #include <loguru.hpp>
+#include <optional>
 #include <string>
 #include <thread>
 #include <utility>
 
 #include "chunked_files/chunked_file_receiver.h"
-#include "chunked_files/chunked_file_sender.h"
+#include "chunked_files/file_stream_receiver.h"
+#include "chunked_files/file_stream_sender.h"
 
 namespace server {
 
@@ -25,9 +30,11 @@ const Response kEmptyResponse{};
 }  // namespace
 
 Agent::Agent(int client_fd, std::unique_ptr<ThreadSafeFileHandler> file_handler,
-             std::shared_ptr<server_tasks::CommandIDs> active_commands)
+             std::shared_ptr<server_tasks::CommandIDs> active_commands,
+             std::shared_ptr<server_tasks::StripedUploads> striped_uploads)
     : client_fd_(client_fd),
       active_commands_(std::move(active_commands)),
+      striped_uploads_(std::move(striped_uploads)),
       file_handler_(std::move(file_handler)) {}
 
 Agent::Agent(int client_fd,
@@ -91,6 +98,44 @@ Agent::ClientState Agent::ReadFileContents(std::vector<uint8_t> *file_contents,
   return ClientState::ACTIVE;
 }
 
+Agent::ClientState Agent::ReadFileStream(int file_fd, uint32_t command_id,
+                                         bool *complete, off_t offset,
+                                         uint64_t length) {
+  *complete = false;
+  chunked_files::FileStreamReceiver receiver(client_fd_, file_fd, {}, offset,
+                                             length);
+
+  while (!receiver.HasCompleteFile()) {
+    if (!active_commands_->Contains(command_id)) {
+      // The client stops sending and aborts, so read until then to leave the
+      // socket in a valid state.
+      if (!receiver.CleanUp()) {
+        return ClientState::ERROR;
+      }
+      LOG_F(INFO, "Command #%i successfully terminated.", command_id);
+      return ClientState::ACTIVE;
+    }
+
+    const auto bytes_read = receiver.ReceiveNextChunk();
+    if (bytes_read < 0) {
+      LOG_F(ERROR, "Failed to receive file from client (%i).", client_fd_);
+      return ClientState::ERROR;
+    } else if (bytes_read == 0) {
+      // Client has disconnected nicely.
+      return ClientState::DISCONNECTED;
+    }
+  }
+
+  *complete = file_fd >= 0 && !receiver.WasAborted();
+  if (*complete && length != kWholeFile &&
+      receiver.GetNumFileBytes() != length) {
+    LOG_F(ERROR, "Client (%i) sent the wrong amount of file data.",
+          client_fd_);
+    *complete = false;
+  }
+  return ClientState::ACTIVE;
+}
+
 Agent::ClientState Agent::ReadNextMessage(Request *message) {
   while (!parser_.HasCompleteMessage()) {
     incoming_message_buffer_.resize(kClientBufferSize);
@@ -172,30 +217,38 @@ bool Agent::SendResponse(const Response &response) {
   return true;
 }
 
-bool Agent::SendFileContents(const std::vector<uint8_t> &file_contents,
-                             uint16_t command_id) {
-  chunked_files::ChunkedFileSender sender(client_fd_);
-  sender.SetFileContents(file_contents);
-
-  // monitor for termination request for get and put commands
-  uint32_t total_bytes_sent = 0;
-  bool terminated = false;
-
-  // continue until we've sent the entire message
-  while (!sender.SentCompleteFile()) {
-    if (!terminated) {
-      int bytes_sent = sender.SendNextChunk();
-      if (bytes_sent != -1) {
-        total_bytes_sent += bytes_sent;
-      } else {
-        return false;
-      }
-    } else {
+bool Agent::SendFileStream(int file_fd, uint32_t command_id,
+                           const ftp_messages::GetRequest &request) {
+  if (file_fd < 0) {
+    LOG_F(ERROR, "Failed to open the file for client (%i).", client_fd_);
+    // We already told the client that a stream is coming, so end it.
+    return chunked_files::FileStreamSender(client_fd_, file_fd).Abort();
+  }
+
+  // Popular files are sent from memory, and anything else straight from
+  // disk.
+  std::optional<chunked_files::FileStreamSender> sender;
+  const auto kContents = file_handler_->GetCached(request.filename(), file_fd);
+  if (kContents != nullptr) {
+    close(file_fd);
+    sender.emplace(client_fd_, kContents, request.max_chunk_size());
+  } else {
+    sender.emplace(client_fd_, file_fd, request.max_chunk_size());
+  }
+  sender->SetRange(request.offset(), request.length());
+
+  // continue until we've sent the entire file
+  while (!sender->SentCompleteFile()) {
+    if (!active_commands_->Contains(command_id)) {
       LOG_F(INFO, "Command #%i for client #%i successfully terminated.",
             command_id, client_fd_);
-      return true;
+      // Let the client know it won't get the rest of the file.
+      return sender->Abort();
+    }
+
+    if (sender->SendNextChunk() < 0) {
+      return false;
     }
-    terminated = !active_commands_->Contains(command_id);
   }
   return true;
 }
@@ -214,15 +267,32 @@ Agent::ClientState Agent::HandleRequest(
 
   // make response
   r.mutable_get()->set_command_id(id);
+  // The file is streamed from disk rather than loaded into memory.
+  r.mutable_get()->set_raw_chunks(true);
+
+  // Open the file to stream from.
+  const int kFileFd = file_handler_->Open(request.filename());
+  struct stat file_stat {};
+  if (kFileFd >= 0 && fstat(kFileFd, &file_stat) == 0) {
+    // Tell the client enough to fetch other ranges of the same file.
+    r.mutable_get()->set_file_size(file_stat.st_size);
+    r.mutable_get()->set_path(std::filesystem::path(
+        file_handler_->GetCurrentDir()) / request.filename());
+    r.mutable_get()->set_modified_time_ns(
+        file_stat.st_mtim.tv_sec * 1000000000LL + file_stat.st_mtim.tv_nsec);
+  }
 
   // Send client the command id for possible termination
   SendResponse(r);
 
-  // Get the file data.
-  const auto file_data = file_handler_->Get(request.filename());
-
-  // Send the FileContents.
-  const auto kSendResult = SendFileContents(file_data, id);
+  // Send the file.
+  const auto kSendResult = SendFileStream(kFileFd, id, request);
+  const auto kCacheStats = file_handler_->GetCacheStats();
+  LOG_F(INFO,
+        "File cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64
+        " evictions, %zu bytes cached.",
+        kCacheStats.hits, kCacheStats.misses, kCacheStats.evictions,
+        kCacheStats.size);
 
   active_commands_->Delete(id);
   return kSendResult ? ClientState::ACTIVE : ClientState::ERROR;
@@ -237,6 +307,62 @@ Agent::ClientState Agent::HandleRequest(
   // register this command as an active command
   active_commands_->Insert(id);
   r.mutable_put()->set_command_id(id);
+  r.mutable_put()->set_max_chunk_size(chunked_files::kMaxChunkSize);
+
+  if (request.raw_chunks() && request.upload_id() == 0 &&
+      !request.content_hash().empty() &&
+      file_handler_->PutDuplicate(request.content_hash(), request.file_size(),
+                                  request.filename())) {
+    // We already had the contents, so there's nothing to receive.
+    LOG_F(INFO, "Reused existing contents for (%s) for client (%i).",
+          request.filename().c_str(), client_fd_);
+    active_commands_->Delete(id);
+    r.mutable_put()->set_deduplicated(true);
+    return SendResponse(r) ? ClientState::ACTIVE : ClientState::ERROR;
+  }
+  if (request.raw_chunks() &&
+      (request.num_stripes() > 1 || request.upload_id() != 0)) {
+    return ReceiveStripe(request, &r);
+  }
+  if (request.raw_chunks()) {
+    // Write to a temporary file as the data arrives, so nobody sees a
+    // partial file, and we don't hold the whole thing in memory.
+    std::string temp_path;
+    const int kFileFd =
+        file_handler_->CreateTemp(request.filename(), &temp_path);
+    if (kFileFd < 0) {
+      LOG_F(ERROR, "Failed to create a temporary file for client (%i).",
+            client_fd_);
+    }
+
+    // send client command id for possible termination
+    SendResponse(r);
+
+    bool complete = false;
+    const auto kState = ReadFileStream(kFileFd, id, &complete);
+    active_commands_->Delete(id);
+
+    if (kFileFd < 0) {
+      // The upload was drained so the connection stays in sync, but it
+      // wasn't stored anywhere.
+      return ClientState::ERROR;
+    }
+    close(kFileFd);
+    if (!complete) {
+      // Terminated or failed, so throw away what we got.
+      file_handler_->Delete(temp_path);
+      return kState;
+    }
+
+    if (!file_handler_->Commit(temp_path, request.filename())) {
+      std::string fn = request.filename();
+      LOG_F(ERROR, "Failed to write the file (%s) for client (%i).", fn.c_str(),
+            client_fd_);
+      file_handler_->Delete(temp_path);
+      return ClientState::ERROR;
+    }
+    return kState;
+  }
 
   // send client command id for possible termination
   SendResponse(r);
@@ -259,6 +385,70 @@ Agent::ClientState Agent::HandleRequest(
   return ClientState::ACTIVE;
 }
 
+Agent::ClientState Agent::ReceiveStripe(const ftp_messages::PutRequest &request,
+                                        Response *response) {
+  const uint32_t kId = response->put().command_id();
+
+  // Every stripe has to name the same file.
+  const std::string kPath =
+      (std::filesystem::path(file_handler_->GetCurrentDir()) /
+       request.filename())
+          .lexically_normal();
+
+  std::shared_ptr<server_tasks::StripedUploads::Upload> upload;
+  if (request.upload_id() == 0) {
+    // This is the first stripe, so set up the staging file for all of them.
+    std::string temp_path;
+    const int kFileFd =
+        file_handler_->CreateTemp(request.filename(), &temp_path);
+    if (kFileFd >= 0 && ftruncate(kFileFd, request.file_size()) == 0) {
+      upload = striped_uploads_->Start(kPath, temp_path, kFileFd,
+                                       request.file_size(),
+                                       request.num_stripes(), request.offset(),
+                                       request.length());
+    } else if (kFileFd >= 0) {
+      close(kFileFd);
+      file_handler_->Delete(temp_path);
+    }
+  } else {
+    upload = striped_uploads_->Join(request.upload_id(), kPath,
+                                    request.file_size(), request.offset(),
+                                    request.length());
+  }
+
+  if (upload) {
+    // Tell the client where the other stripes should go.
+    response->mutable_put()->set_upload_id(upload->id);
+    response->mutable_put()->set_path(upload->path);
+  } else {
+    LOG_F(ERROR, "Failed to set up a stripe for client (%i).", client_fd_);
+  }
+
+  // send client command id for possible termination
+  SendResponse(*response);
+
+  bool complete = false;
+  const auto kState = ReadFileStream(upload ? upload->fd : -1, kId, &complete,
+                                     request.offset(), request.length());
+  active_commands_->Delete(kId);
+  if (!upload) {
+    // The stripe was drained, but it wasn't stored anywhere.
+    return ClientState::ERROR;
+  }
+
+  if (striped_uploads_->Finish(upload->id, request.offset(), complete) ==
+      server_tasks::StripedUploads::Result::COMPLETE) {
+    // That was the last stripe.
+    if (!file_handler_->Commit(upload->temp_path, upload->path)) {
+      LOG_F(ERROR, "Failed to write the file (%s) for client (%i).",
+            upload->path.c_str(), client_fd_);
+      return ClientState::ERROR;
+    }
+    upload->committed = true;
+  }
+  return kState;
+}
+
 Agent::ClientState Agent::HandleRequest(
     const ftp_messages::DeleteRequest &request) {
   LOG_F(INFO, "Performing a DELETE operation for client (%i).", client_fd_);
@@ -279,8 +469,10 @@ Agent::ClientState Agent::HandleRequest(
     const ftp_messages::ListRequest &request) {
   LOG_F(INFO, "Performing a LIST operation for client (%i).", client_fd_);
 
-  // List the directory contents.
-  const auto &kDirectoryContents = file_handler_->List();
+  // List a page of the directory contents.
+  bool more = false;
+  const auto kDirectoryContents = file_handler_->ListPage(
+      request.cursor(), request.max_entries(), &more);
 
   // Send the response.
   Response response;
@@ -288,6 +480,9 @@ Agent::ClientState Agent::HandleRequest(
   for (const auto &kFilename : kDirectoryContents) {
     response.mutable_list()->add_filenames(kFilename);
   }
+  if (more) {
+    response.mutable_list()->set_next_cursor(kDirectoryContents.back());
+  }
   return SendResponse(response) ? ClientState::ACTIVE : ClientState::ERROR;
 }
 
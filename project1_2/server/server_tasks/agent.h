@@ -6,6 +6,7 @@
 #define PROJECT1_AGENT_H
 
 #include <cstdint>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -14,6 +15,7 @@
 #include "../file_handler/file_handler_interface.h"
 #include "../file_handler/thread_safe_file_handler.h"
 #include "command_ids.h"
+#include "striped_uploads.h"
 #include "ftp_messages.pb.h"
 
 namespace server {
@@ -30,10 +32,13 @@ namespace server {
          * @param file_handler The `FileHandler` to use internally. Note this class
          *    will take ownership of it.
          * @param active_commands The list of active commands to be used internally.
+         * @param striped_uploads Uploads that are coming over several
+         *    connections, shared with the other agents.
          */
         Agent(int client_fd,
               std::unique_ptr<file_handler::ThreadSafeFileHandler> file_handler,
-              std::shared_ptr<server_tasks::CommandIDs> active_commands);
+              std::shared_ptr<server_tasks::CommandIDs> active_commands,
+              std::shared_ptr<server_tasks::StripedUploads> striped_uploads);
 
         /**
          * @brief Constructor used for agents handling terminate commands.
@@ -61,6 +66,8 @@ namespace server {
 
         /// Size in bytes to use for the internal message buffer.
         static constexpr size_t kClientBufferSize = 1000;
+        /// Length to pass to `ReadFileStream()` when any amount is fine.
+        static constexpr uint64_t kWholeFile = std::numeric_limits<uint64_t>::max();
 
         /// Enumerates state of connected client.
         enum class ClientState {
@@ -86,6 +93,33 @@ namespace server {
          */
         ClientState ReadFileContents(std::vector<uint8_t> *file_contents, uint16_t command_id);
 
+        /**
+         * @brief Reads a file sent as raw chunks from the socket, writing it
+         *    to disk as it arrives.
+         * @param file_fd Where to write the file. If it is invalid, the file
+         *    is read and discarded.
+         * @param command_id The command ID, for checking for termination.
+         * @param complete[out] Set to true if we got the whole file and it
+         *    should be kept.
+         * @param offset Where in the file to start writing.
+         * @param length How much file data to expect. Anything past it is not
+         *    written, and the file is only complete if exactly this much
+         *    arrived.
+         * @return The updated state of the client.
+         */
+        ClientState ReadFileStream(int file_fd, uint32_t command_id, bool *complete,
+                                   off_t offset = 0, uint64_t length = kWholeFile);
+
+        /**
+         * @brief Receives one stripe of a file that is being uploaded over
+         *    several connections, and commits the file if it was the last one.
+         * @param request The request for the stripe.
+         * @param response The response, with the command ID filled in.
+         * @return The updated state of the client.
+         */
+        ClientState ReceiveStripe(const ftp_messages::PutRequest &request,
+                                  ftp_messages::Response *response);
+
         /**
          * @brief Dispatches an incoming request to the proper handler.
          * @param message The request.
@@ -124,11 +158,17 @@ namespace server {
         bool SendResponse(const ftp_messages::Response &response);
 
         /**
-         * @brief Sends the file contents for a get request
-         * @param file_contents the file contents to be sent
-         * @return True on Success, False if the command was terminated
+         * @brief Streams a file for a get request using raw chunks, either
+         *    from the file cache or straight from disk.
+         * @param file_fd The file to send. This takes ownership of it. If it
+         *    is invalid, the client just gets an aborted stream.
+         * @param command_id The command ID, for checking for termination.
+         * @param request The request, which says which range of the file to
+         *    send and how large the chunks can be.
+         * @return True on Success, False on a socket error
          */
-        bool SendFileContents(const std::vector<uint8_t> &file_contents, uint16_t command_id);
+        bool SendFileStream(int file_fd, uint32_t command_id,
+                            const ftp_messages::GetRequest &request);
 
         /// The FD to talk to the client on.
         int client_fd_;
@@ -136,6 +176,9 @@ namespace server {
         ///Active Commands @Note: To be inherited from the AgentTask
         std::shared_ptr<server_tasks::CommandIDs> active_commands_;
 
+        /// Uploads that are coming over several connections.
+        std::shared_ptr<server_tasks::StripedUploads> striped_uploads_;
+
         /// Internal buffer to use for incoming messages.
         std::vector<uint8_t> incoming_message_buffer_{};
         /// Internal buffer to use for outgoing messages.
@@ -8,9 +8,16 @@ namespace server_tasks {
 
     AgentTask::AgentTask(int id, std::shared_ptr<CommandIDs> commands,
                          std::shared_ptr<server::file_handler::FileAccessManager> read_mgr,
-                         std::shared_ptr<server::file_handler::FileAccessManager> write_mgr)
+                         std::shared_ptr<server::file_handler::FileAccessManager> write_mgr,
+                         std::shared_ptr<server::file_handler::FileCache> file_cache,
+                         std::shared_ptr<server::file_handler::ListingCache> listing_cache,
+                         std::shared_ptr<server::file_handler::ContentIndex> content_index,
+                         std::shared_ptr<StripedUploads> striped_uploads)
             : client_fd_(id), active_commands_(std::move(commands)),
-              read_manager_(std::move(read_mgr)), write_manager_(std::move(write_mgr)) {}
+              read_manager_(std::move(read_mgr)), write_manager_(std::move(write_mgr)),
+              file_cache_(std::move(file_cache)), listing_cache_(std::move(listing_cache)),
+              content_index_(std::move(content_index)),
+              striped_uploads_(std::move(striped_uploads)) {}
 
     AgentTask::AgentTask(int id, std::shared_ptr<CommandIDs> commands)
     : client_fd_(id), active_commands_(std::move(commands)) {}
@@ -21,8 +28,11 @@ namespace server_tasks {
         // if this is an agent for a normal command, these members should be initialized
         if (read_manager_ && write_manager_) {
             // give the agent a unique file handler with the shared access managers
-            auto fh = std::make_unique<server::file_handler::ThreadSafeFileHandler>(std::move(read_manager_), std::move(write_manager_));
-            agent_ = std::make_unique<server::Agent>(client_fd_,std::move(fh),active_commands_);
+            auto fh = std::make_unique<server::file_handler::ThreadSafeFileHandler>(std::move(read_manager_), std::move(write_manager_),
+                                                                                    std::move(file_cache_), std::move(listing_cache_),
+                                                                                    std::move(content_index_));
+            agent_ = std::make_unique<server::Agent>(client_fd_,std::move(fh),active_commands_,
+                                                     std::move(striped_uploads_));
         } else {
             // no need to give an Agent a file handler for termination commands
             agent_ = std::make_unique<server::Agent>(client_fd_,active_commands_);
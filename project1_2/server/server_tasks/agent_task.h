@@ -10,6 +10,7 @@
 #include "../file_handler/file_handler.h"
 #include "agent.h"
 #include "command_ids.h"
+#include "striped_uploads.h"
 
 namespace server_tasks {
     class AgentTask : public thread_pool::Task {
@@ -17,7 +18,11 @@ namespace server_tasks {
 
         AgentTask(int id, std::shared_ptr<CommandIDs> commands,
                   std::shared_ptr<server::file_handler::FileAccessManager> read_mgr,
-                  std::shared_ptr<server::file_handler::FileAccessManager> write_mgr);
+                  std::shared_ptr<server::file_handler::FileAccessManager> write_mgr,
+                  std::shared_ptr<server::file_handler::FileCache> file_cache,
+                  std::shared_ptr<server::file_handler::ListingCache> listing_cache,
+                  std::shared_ptr<server::file_handler::ContentIndex> content_index,
+                  std::shared_ptr<StripedUploads> striped_uploads);
 
         AgentTask(int id, std::shared_ptr<CommandIDs> commands);
 
@@ -39,6 +44,18 @@ namespace server_tasks {
         std::shared_ptr<server::file_handler::FileAccessManager> read_manager_;
         std::shared_ptr<server::file_handler::FileAccessManager> write_manager_;
 
+        ///The cache of popular files. @note To be inherited from NPortTask.
+        std::shared_ptr<server::file_handler::FileCache> file_cache_;
+
+        ///The cache of directory listings. @note To be inherited from NPortTask.
+        std::shared_ptr<server::file_handler::ListingCache> listing_cache_;
+
+        ///The hashes of the files on the server. @note To be inherited from NPortTask.
+        std::shared_ptr<server::file_handler::ContentIndex> content_index_;
+
+        ///Uploads that are coming over several connections. @note To be inherited from NPortTask.
+        std::shared_ptr<StripedUploads> striped_uploads_;
+
     };
 }
 #endif //PROJECT1_AGENT_TASK_H
@@ -1,7 +1,5 @@
 #include "nport_task.h"
 
-#include <sys/socket.h>
-
 #include <cstdio>
 #include <iostream>
 #include <utility>
@@ -11,32 +9,29 @@
 
 namespace server_tasks {
 
-thread_pool::Task::Status NPortTask::Listen() {
-  loguru::set_thread_name("TPort Thread");
-  LOG_F(INFO, "Server is listening for normal commands on port %i.", port_);
-
-  while (true) {
-    // Accept a new connection.
-    int client_fd = accept(server_fd_, nullptr, nullptr);
-    if (client_fd < 0) {
-      LOG_F(ERROR, "accept() failed");
-      return thread_pool::Task::Status::FAILED;
-    }
-
-    LOG_F(INFO, "Normal Port handling new connection from client #%i.",client_fd);
+void NPortTask::HandleClient(int client_fd) {
+  LOG_F(INFO, "Normal Port handling new connection from client #%i.",client_fd);
 
-    auto agent_task = std::make_shared<AgentTask>(
-        client_fd, active_ids_, read_manager_, write_manager_);
-    pool_.AddTask(agent_task);
-  }
+  auto agent_task = std::make_shared<AgentTask>(
+      client_fd, active_ids_, read_manager_, write_manager_, file_cache_,
+      listing_cache_, content_index_, striped_uploads_);
+  pool_.AddTask(agent_task);
 }
 
 NPortTask::NPortTask(
     std::shared_ptr<CommandIDs> active_ids, uint16_t port,
     std::shared_ptr<server::file_handler::FileAccessManager> read_mgr,
-    std::shared_ptr<server::file_handler::FileAccessManager> write_mgr)
+    std::shared_ptr<server::file_handler::FileAccessManager> write_mgr,
+    std::shared_ptr<server::file_handler::FileCache> file_cache,
+    std::shared_ptr<server::file_handler::ListingCache> listing_cache,
+    std::shared_ptr<server::file_handler::ContentIndex> content_index,
+    std::shared_ptr<StripedUploads> striped_uploads)
     : ServerTask(std::move(active_ids), port),
       read_manager_(std::move(read_mgr)),
-      write_manager_(std::move(write_mgr)) {}
+      write_manager_(std::move(write_mgr)),
+      file_cache_(std::move(file_cache)),
+      listing_cache_(std::move(listing_cache)),
+      content_index_(std::move(content_index)),
+      striped_uploads_(std::move(striped_uploads)) {}
 
 }  // namespace server_tasks
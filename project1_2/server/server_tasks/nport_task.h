@@ -7,10 +7,14 @@
 
 #include "thread_pool/task.h"
 #include "thread_pool/thread_pool.h"
+#include "../file_handler/content_index.h"
 #include "../file_handler/file_access_manager.h"
+#include "../file_handler/file_cache.h"
 #include "../file_handler/file_handler.h"
+#include "../file_handler/listing_cache.h"
 #include "command_ids.h"
 #include "server_task.h"
+#include "striped_uploads.h"
 
 namespace server_tasks {
 
@@ -25,21 +29,38 @@ class NPortTask : public ServerTask {
    * @param port The port to bind to
    * @param read_mgr The read file access manager
    * @param write_mgr The write file access manager
+   * @param file_cache The cache of popular files
+   * @param listing_cache The cache of directory listings
+   * @param content_index The hashes of the files on the server
+   * @param striped_uploads Uploads that are coming over several connections
    */
   NPortTask(std::shared_ptr<CommandIDs> active_ids, uint16_t port,
             std::shared_ptr<server::file_handler::FileAccessManager> read_mgr,
-            std::shared_ptr<server::file_handler::FileAccessManager> write_mgr);
+            std::shared_ptr<server::file_handler::FileAccessManager> write_mgr,
+            std::shared_ptr<server::file_handler::FileCache> file_cache,
+            std::shared_ptr<server::file_handler::ListingCache> listing_cache,
+            std::shared_ptr<server::file_handler::ContentIndex> content_index,
+            std::shared_ptr<StripedUploads> striped_uploads);
 
   /**
-   * @brief Listens for client socket connections.
-   * @return Status::RUNNING
+   * @brief Starts an agent for a client that connected to the normal port.
+   * @param client_fd The socket for the client.
    */
-  thread_pool::Task::Status Listen() override;
+  void HandleClient(int client_fd) override;
 
  private:
   /// The file access managers. @Note Inherited from the server.
   std::shared_ptr<server::file_handler::FileAccessManager> read_manager_;
   std::shared_ptr<server::file_handler::FileAccessManager> write_manager_;
+  /// The cache of popular files. @Note Inherited from the server.
+  std::shared_ptr<server::file_handler::FileCache> file_cache_;
+  /// The cache of directory listings. @Note Inherited from the server.
+  std::shared_ptr<server::file_handler::ListingCache> listing_cache_;
+  /// The hashes of the files on the server. @Note Inherited from the server.
+  std::shared_ptr<server::file_handler::ContentIndex> content_index_;
+  /// Uploads that are coming over several connections. @Note Shared by all
+  /// the agents.
+  std::shared_ptr<StripedUploads> striped_uploads_;
 };
 }  // namespace server_tasks
 #endif  // PROJECT1_NPORT_TASK_H
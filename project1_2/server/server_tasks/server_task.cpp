@@ -1,61 +1,43 @@
 #include "server_task.h"
 
 #include <utility>
+#include <loguru.hpp>
 namespace server_tasks {
 
-    ServerTask::ServerTask(std::shared_ptr<CommandIDs> active_ids, uint16_t port)
-    : port_(port),active_ids_(std::move(active_ids)){}
+    ServerTask::ServerTask(std::shared_ptr<CommandIDs> active_ids, uint16_t port, uint32_t num_acceptors)
+    : port_(port), num_acceptors_(num_acceptors), active_ids_(std::move(active_ids)){}
 
     thread_pool::Task::Status ServerTask::SetUp()  {
-        // Create the socket.
-        const auto kAddress = MakeAddress(port_);
+        // Bind the listener sockets.
+        listeners_ = std::make_unique<listener::ListenerGroup>(
+                pool_, [this](int client_fd, const struct sockaddr_storage &) {
+                    HandleClient(client_fd);
+                });
 
-        server_fd_ = SetUpSocket(kAddress);
-        if (server_fd_ < 0) {
+        if (!listeners_->ListenTcp(port_, num_acceptors_)) {
             return thread_pool::Task::Status::FAILED;
         } else {return thread_pool::Task::Status::RUNNING;}
     }
 
     thread_pool::Task::Status ServerTask::RunAtomic() {
-        return Listen();
-    }
-
-    struct sockaddr_in ServerTask::MakeAddress(uint16_t port) {
-        struct sockaddr_in address{};
-        address.sin_family = AF_INET;
-        address.sin_addr.s_addr = INADDR_ANY;
-        address.sin_port = htons(port);
-
-        return address;
-    }
-
-    int ServerTask::SetUpSocket(const struct sockaddr_in &address) {
-        // Open a TCP socket.
-        const int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (server_fd == 0) {
-            perror("Failed to create server socket");
-            return -1;
+        // The acceptors do all the work, we just make sure they're still alive.
+        if (!listeners_->IsRunning()) {
+            LOG_F(ERROR, "Stopped listening on port %i.", port_);
+            return thread_pool::Task::Status::FAILED;
         }
 
-        // Allow the server to re-bind to this port if it was restarted quickly.
-        const int option = 1;
-        if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &option,
-                       sizeof(option))) {
-            perror("Failed to set socket options");
-            // This is not a fatal error.
-        }
+        cancelled_.Wait(kMonitorInterval_);
+        return thread_pool::Task::Status::RUNNING;
+    }
 
-        // Bind to the port.
-        if (bind(server_fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
-            perror("bind() failed on server socket");
-            return -1;
-        }
-        if (listen(server_fd, kMaxQueueSize_) < 0) {
-            perror("listen() failed on server socket");
-            return -1;
+    void ServerTask::CleanUp() {
+        if (listeners_ != nullptr) {
+            listeners_->Stop();
         }
+    }
 
-        return server_fd;
+    void ServerTask::OnCancel() {
+        cancelled_.Signal();
     }
 }
 
@@ -7,8 +7,11 @@
 
 #include "thread_pool/task.h"
 #include "thread_pool/thread_pool.h"
+#include "thread_pool/wakeup_event.h"
+#include "listener/listener_group.h"
 #include "command_ids.h"
 #include <sys/socket.h>
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <netinet/in.h>
@@ -25,38 +28,28 @@ namespace server_tasks {
 
         thread_pool::Task::Status SetUp() override;
         thread_pool::Task::Status RunAtomic() override;
+        void CleanUp() override;
+        void OnCancel() override;
 
         /**
          * @brief Constructor for a server task.
          * @param active_ids The list of active command ID's
          * @param port The port to bind to
+         * @param num_acceptors The number of threads accepting connections on the port
          */
         ServerTask(std::shared_ptr<CommandIDs> active_ids,
-                   uint16_t port);
+                   uint16_t port,
+                   uint32_t num_acceptors = listener::kDefaultNumAcceptors);
 
 
     protected:
 
         /**
-         * @brief Listens on a socket.
-         * @return The status of the thread pool.
-         * @note This will be called in RunAtomic.
+         * @brief Handles a newly connected client.
+         * @param client_fd The socket for the client.
+         * @note This will be called from the acceptor threads, possibly several at once.
          */
-        virtual thread_pool::Task::Status Listen() = 0;
-
-        /**
-         * @brief Helper function to make address structure for socket creation
-         * @param port, the port # to bind to
-         * @return the address structure for socket creation
-         */
-        struct sockaddr_in MakeAddress(uint16_t port);
-
-        /**
-         * @brief Helper function to open a socket and bind to port.
-         * @param address the address structure
-         * @return the file descriptor for the socket
-         */
-        int SetUpSocket(const struct sockaddr_in &address);
+        virtual void HandleClient(int client_fd) = 0;
 
         ///The thread pool.
         thread_pool::ThreadPool pool_;
@@ -64,11 +57,17 @@ namespace server_tasks {
         ///The port # for terminate commands.
         uint16_t port_;
 
-        ///The file descriptor for the server
-        int server_fd_ = -1;
+        ///The number of acceptor threads to use.
+        uint32_t num_acceptors_;
+
+        ///Accepts connections on the port. @note Declared after the pool, since it runs tasks in it.
+        std::unique_ptr<listener::ListenerGroup> listeners_;
+
+        ///How often to check that the acceptors are still running.
+        static constexpr auto kMonitorInterval_ = std::chrono::seconds(1);
 
-        /// Maximum queue size to use for listening on the server socket.
-        uint8_t static constexpr kMaxQueueSize_= 5;
+        ///Signalled when the task is cancelled, so we don't wait out the monitor interval.
+        thread_pool::WakeupEvent cancelled_;
 
         ///The list containing the active command IDs
         std::shared_ptr<CommandIDs> active_ids_;
@@ -0,0 +1,152 @@
+#include "striped_uploads.h"
+
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <iterator>
+#include <loguru.hpp>
+#include <utility>
+
+namespace server_tasks {
+namespace {
+
+/**
+ * @brief Checks that a stripe lies within a file.
+ * @param offset Where the stripe starts.
+ * @param length How many bytes are in the stripe.
+ * @param file_size The size of the file.
+ * @return True if it does.
+ */
+bool FitsInFile(uint64_t offset, uint64_t length, uint64_t file_size) {
+  // Written so that it can't overflow.
+  return offset <= file_size && length <= file_size - offset;
+}
+
+}  // namespace
+
+StripedUploads::Upload::~Upload() {
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (!committed) {
+    std::remove(temp_path.c_str());
+  }
+}
+
+std::shared_ptr<StripedUploads::Upload> StripedUploads::Start(
+    std::string path, std::string temp_path, int fd, uint64_t file_size,
+    uint32_t num_stripes, uint64_t offset, uint64_t length) {
+  auto upload = std::make_shared<Upload>();
+  upload->path = std::move(path);
+  upload->temp_path = std::move(temp_path);
+  upload->fd = fd;
+  upload->file_size = file_size;
+  if (!FitsInFile(offset, length, file_size)) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  RemoveAbandoned();
+
+  upload->id = MakeId();
+  uploads_[upload->id] = {upload, num_stripes, 1, 0, {{offset, length}}, 0,
+                          std::chrono::steady_clock::now()};
+  LOG_F(INFO, "Starting striped upload #%" PRIx64 " with %u stripes.",
+        upload->id, num_stripes);
+  return upload;
+}
+
+std::shared_ptr<StripedUploads::Upload> StripedUploads::Join(
+    uint64_t upload_id, const std::string& path, uint64_t file_size,
+    uint64_t offset, uint64_t length) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  const auto kEntry = uploads_.find(upload_id);
+  if (kEntry == uploads_.end()) {
+    return nullptr;
+  }
+  Entry& entry = kEntry->second;
+  if (entry.num_joined >= entry.num_stripes || path != entry.upload->path ||
+      file_size != entry.upload->file_size ||
+      !FitsInFile(offset, length, file_size)) {
+    return nullptr;
+  }
+
+  // Make sure it doesn't overlap the stripes before or after it.
+  const auto kNext = entry.stripes.lower_bound(offset);
+  if (kNext != entry.stripes.end() && kNext->first - offset < length) {
+    return nullptr;
+  }
+  if (kNext != entry.stripes.begin()) {
+    const auto kPrevious = std::prev(kNext);
+    if (offset - kPrevious->first < kPrevious->second) {
+      return nullptr;
+    }
+  }
+
+  entry.stripes.emplace(offset, length);
+  ++entry.num_joined;
+  entry.last_active = std::chrono::steady_clock::now();
+  return entry.upload;
+}
+
+StripedUploads::Result StripedUploads::Finish(uint64_t upload_id,
+                                              uint64_t offset, bool success) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  const auto kEntry = uploads_.find(upload_id);
+  if (kEntry == uploads_.end()) {
+    // Another stripe already failed.
+    return Result::FAILED;
+  }
+  Entry& entry = kEntry->second;
+
+  const auto kStripe = entry.stripes.find(offset);
+  if (!success || kStripe == entry.stripes.end()) {
+    // The staging file is deleted once the other stripes let go of it.
+    LOG_F(WARNING, "Cancelling striped upload #%" PRIx64 ".", upload_id);
+    uploads_.erase(kEntry);
+    return Result::FAILED;
+  }
+
+  entry.finished_bytes += kStripe->second;
+  entry.last_active = std::chrono::steady_clock::now();
+  if (++entry.num_finished < entry.num_stripes) {
+    return Result::PENDING;
+  }
+
+  // The stripes don't overlap, so they cover the file if the sizes add up.
+  const bool kCovered = entry.finished_bytes == entry.upload->file_size;
+  if (!kCovered) {
+    LOG_F(WARNING, "Striped upload #%" PRIx64 " has gaps, cancelling it.",
+          upload_id);
+  }
+  uploads_.erase(kEntry);
+  return kCovered ? Result::COMPLETE : Result::FAILED;
+}
+
+void StripedUploads::RemoveAbandoned() {
+  const auto kNow = std::chrono::steady_clock::now();
+  for (auto entry = uploads_.begin(); entry != uploads_.end();) {
+    // If every stripe that started has finished, nobody is going to touch
+    // the upload until the missing stripes show up.
+    const bool kIdle = entry->second.num_joined == entry->second.num_finished;
+    if (kIdle && kNow - entry->second.last_active > kAbandonTimeout) {
+      LOG_F(WARNING,
+            "Striped upload #%" PRIx64 " is missing stripes, removing it.",
+            entry->first);
+      entry = uploads_.erase(entry);
+    } else {
+      ++entry;
+    }
+  }
+}
+
+uint64_t StripedUploads::MakeId() {
+  uint64_t id = 0;
+  while (id == 0 || uploads_.count(id) != 0) {
+    id = static_cast<uint64_t>(random_()) << 32 | random_();
+  }
+  return id;
+}
+
+}  // namespace server_tasks
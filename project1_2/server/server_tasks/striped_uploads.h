@@ -0,0 +1,148 @@
+/**
+ * @file Keeps track of files that are being uploaded over several connections
+ */
+
+#ifndef PROJECT1_STRIPED_UPLOADS_H
+#define PROJECT1_STRIPED_UPLOADS_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+namespace server_tasks {
+
+/**
+ * @class A thread-safe table of uploads that are being sent in stripes. Each
+ *    stripe comes over its own connection, and is written at its offset in a
+ *    staging file that all of them share. The file is only committed once
+ *    every stripe is in.
+ */
+class StripedUploads {
+ public:
+  /// How long an upload can wait for stripes that never arrive before it is
+  /// thrown away.
+  static constexpr std::chrono::seconds kAbandonTimeout{60};
+
+  /// A file that is being uploaded in stripes.
+  struct Upload {
+    /// Closes the staging file, and deletes it unless it was committed.
+    ~Upload();
+
+    /// The ID of the upload. It is random, so that only the client that
+    /// started the upload knows it.
+    uint64_t id = 0;
+    /// The absolute path that the file will be committed to.
+    std::string path;
+    /// The staging file.
+    std::string temp_path;
+    /// FD of the staging file. Stripes write to it with `pwrite()`, so they
+    /// can share it.
+    int fd = -1;
+    /// The total size of the file.
+    uint64_t file_size = 0;
+    /// Set once the staging file has been renamed to `path`.
+    bool committed = false;
+  };
+
+  /// What happened to an upload once a stripe finished.
+  enum class Result {
+    /// Still waiting on other stripes.
+    PENDING,
+    /// Every stripe is in, and the caller should commit the file.
+    COMPLETE,
+    /// A stripe failed, so the upload is cancelled.
+    FAILED,
+  };
+
+  /**
+   * @brief Starts a new upload, with its first stripe.
+   * @param path The absolute path that the file will be committed to.
+   * @param temp_path The staging file.
+   * @param fd FD of the staging file. The upload takes ownership of it.
+   * @param file_size The total size of the file.
+   * @param num_stripes How many stripes the file is sent in.
+   * @param offset Where in the file the first stripe starts.
+   * @param length How many bytes are in the first stripe.
+   * @return The upload, or nullptr if the stripe doesn't fit in the file.
+   */
+  std::shared_ptr<Upload> Start(std::string path, std::string temp_path,
+                                int fd, uint64_t file_size,
+                                uint32_t num_stripes, uint64_t offset,
+                                uint64_t length);
+
+  /**
+   * @brief Adds another stripe to an upload.
+   * @param upload_id The ID of the upload.
+   * @param path The absolute path that the stripe is for.
+   * @param file_size The total size of the file, according to the stripe.
+   * @param offset Where in the file the stripe starts.
+   * @param length How many bytes are in the stripe.
+   * @return The upload, or nullptr if there is no such upload, it already
+   *    has all its stripes, the path or size doesn't match, or the stripe
+   *    doesn't fit in the file or overlaps another one.
+   */
+  std::shared_ptr<Upload> Join(uint64_t upload_id, const std::string& path,
+                               uint64_t file_size, uint64_t offset,
+                               uint64_t length);
+
+  /**
+   * @brief Records that a stripe has finished.
+   * @param upload_id The ID of the upload.
+   * @param offset Where in the file the stripe starts.
+   * @param success Whether the whole stripe was received.
+   * @return What the caller should do with the upload. It is only
+   *    `COMPLETE` once the stripes cover the whole file.
+   */
+  Result Finish(uint64_t upload_id, uint64_t offset, bool success);
+
+ private:
+  /// Progress of an upload.
+  struct Entry {
+    /// The upload itself.
+    std::shared_ptr<Upload> upload;
+    /// How many stripes there are.
+    uint32_t num_stripes;
+    /// How many stripes have started.
+    uint32_t num_joined = 1;
+    /// How many stripes have finished successfully.
+    uint32_t num_finished = 0;
+    /// The length of every stripe that has started, by offset.
+    std::map<uint64_t, uint64_t> stripes{};
+    /// How many bytes the finished stripes cover.
+    uint64_t finished_bytes = 0;
+    /// When a stripe last started or finished.
+    std::chrono::steady_clock::time_point last_active;
+  };
+
+  /**
+   * @brief Throws away uploads that are idle, but still missing stripes.
+   * @note The mutex must be held.
+   */
+  void RemoveAbandoned();
+
+  /**
+   * @brief Picks an ID for a new upload.
+   * @note The mutex must be held.
+   * @return An ID that isn't 0, and isn't in use.
+   */
+  uint64_t MakeId();
+
+  /// Uploads that are in progress, by ID.
+  std::unordered_map<uint64_t, Entry> uploads_{};
+
+  /// Mutex for implementing thread safety.
+  std::mutex mutex_{};
+
+  /// Source of upload IDs. They have to be unpredictable, so this isn't a
+  /// seeded generator.
+  std::random_device random_{};
+};
+
+}  // namespace server_tasks
+
+#endif  // PROJECT1_STRIPED_UPLOADS_H
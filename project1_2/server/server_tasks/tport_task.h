@@ -26,10 +26,10 @@ class TPortTask : public ServerTask {
   TPortTask(std::shared_ptr<CommandIDs> active_ids, uint16_t port);
 
   /**
-   * Listens for Terminate Commands
-   * @return The client status.
+   * Starts an agent to listen for Terminate Commands from a client.
+   * @param client_fd The socket for the client.
    */
-  thread_pool::Task::Status Listen() final;
+  void HandleClient(int client_fd) final;
 };
 }  // namespace server_tasks
 #endif  // PROJECT1_TPORT_TASK_H
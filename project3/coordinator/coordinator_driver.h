@@ -9,6 +9,7 @@
 #include "coordinator_resources/participant_manager.h"
 #include "coordinator_resources/registrar.h"
 #include "coordinator_task.h"
+#include "listener/listener_group.h"
 #include "queue/queue.h"
 #include "thread_pool/task.h"
 #include "thread_pool/thread_pool.h"
@@ -31,9 +32,20 @@ class CoordinatorDriver {
    * @brief Listens for participant connections.
    * @param port The port to listen on.
    * @param threshold The missed messages time threshold.
+   * @param num_acceptors The number of threads accepting connections.
+   * @param backlog The length of the accept queue for each acceptor.
    */
-  [[noreturn]] void Start(uint16_t port, Duration threshold);
+  [[noreturn]] void Start(uint16_t port, Duration threshold,
+                          uint32_t num_acceptors = listener::kDefaultNumAcceptors,
+                          int backlog = SOMAXCONN);
  private:
+  /**
+   * @brief Deploys a coordinator task for a newly connected participant.
+   * @param client_fd The socket for the participant.
+   * @param address The address of the participant.
+   */
+  void HandleParticipant(int client_fd, const struct sockaddr_storage &address);
+
   /// The data structures shared by coordinators.
   std::shared_ptr<ParticipantManager> participants_;
   std::shared_ptr<MessageLog> message_log_;
@@ -41,20 +53,9 @@ class CoordinatorDriver {
   std::shared_ptr<Registrar> registrar_;
   std::shared_ptr<queue::Queue<MessageLog::Message>> message_queue_;
 
-  /// Maximum queue size to use for listening on the server socket.
-  uint8_t static constexpr kMaxQueueSize_ = 5;
-
   /// The thread pool.
   thread_pool::ThreadPool pool_;
 
-  /**
-   * Helper functions for creating sockets.
-   *
-   */
-  static struct sockaddr_in MakeAddress(int port);
-  static int SetUpSocket(const struct sockaddr_in &address);
-  int CreateSocket(int port);
-
 };
 }
 #endif  // CSCI6780_COORDINATOR_DRIVER_H
@@ -76,9 +76,7 @@ void Bootstrap::HandleRequest(
   } else {
     // send entrance info message to be filled out
     entrance_info.set_id(request.id());
-    message_passing::Client client =
-        message_passing::Client(threadpool_, successor_);
-    client.Send(entrance_info);
+    connections_->Get(successor_)->Send(entrance_info);
   }
 }
 
@@ -125,9 +123,8 @@ void Bootstrap::LookUp(uint key) {
     consistent_hash_msgs::LookUpResult lookup;
     lookup.set_id(0);
     lookup.set_key(key);
-    message_passing::Client client =
-        message_passing::Client(threadpool_, successor_);
-    if (!client_->SendAsync(lookup)) {
+    const auto client = connections_->Get(successor_);
+    if (!client->SendAsync(lookup)) {
       // error
       LOG_F(ERROR, "Request failed to send.");
     }
@@ -148,9 +145,8 @@ void Bootstrap::Insert(uint key, const std::string& val) {
     insert.set_id(0);
     insert.set_key(key);
     insert.set_value(val);
-    message_passing::Client client =
-        message_passing::Client(threadpool_, successor_);
-    if (!client.SendAsync(insert)) {
+    const auto client = connections_->Get(successor_);
+    if (!client->SendAsync(insert)) {
       // error
       LOG_F(ERROR, "Request failed to send.");
     }
@@ -170,9 +166,8 @@ void Bootstrap::Delete(uint key) {
     consistent_hash_msgs::DeleteResult delete_r;
     delete_r.set_delete_success(false);
     delete_r.set_key(key);
-    message_passing::Client client =
-        message_passing::Client(threadpool_, successor_);
-    if (!client.SendAsync(delete_r)) {
+    const auto client = connections_->Get(successor_);
+    if (!client->SendAsync(delete_r)) {
       // error
       LOG_F(ERROR, "Request failed to send.");
     }
@@ -12,6 +12,7 @@ Nameserver::Nameserver(
   threadpool_ = pool;
   client_ = std::make_unique<message_passing::Client>(threadpool_, bootstrap_);
   server_ = std::make_unique<message_passing::Server>(threadpool_, port_);
+  connections_ = std::make_shared<message_passing::ConnectionCache>(threadpool_);
 }
 
 void Nameserver::HandleRequest(
@@ -120,11 +121,10 @@ bool Nameserver::Enter() {
       "Nameserver #%i sending UpdateSuccessorRequest message to successor #%i",
       id_, successor_id_);
   // tell this entering server's predecessor to update it's successor info
-  message_passing::Client pred_client =
-      message_passing::Client(threadpool_, predecessor_);
+  const auto pred_client = connections_->Get(predecessor_);
   update_succ_req.mutable_successor_info()->set_port(port_);
   update_succ_req.mutable_successor_info()->set_id(id_);
-  if (pred_client.Send(update_succ_req) < 0) {
+  if (pred_client->Send(update_succ_req) < 0) {
     LOG_F(ERROR, "No response received from the bootstrap.");
     return false;
   }
@@ -150,11 +150,10 @@ void Nameserver::Exit() {
   exit_info.mutable_predecessor_info()->set_ip(predecessor_.hostname);
   // send exit information to successor
   // so it can update it's key's and predecessor info
-  message_passing::Client client =
-      message_passing::Client(threadpool_, successor_);
+  const auto client = connections_->Get(successor_);
   LOG_F(INFO, "Nameserver #%i sending ExitInfo message to successor #%i", id_,
         successor_id_);
-  if (!client.SendAsync(exit_info)) {
+  if (!client->SendAsync(exit_info)) {
     // error
     LOG_F(ERROR, "Request failed to send.");
   }
@@ -168,14 +167,15 @@ void Nameserver::Exit() {
         "#%i ",
         id_, predecessor_id_);
   // tell predecessor to update it's successor info
-  message_passing::Client pred_client =
-      message_passing::Client(threadpool_, predecessor_);
-  if (!pred_client.SendAsync(update_succ_req)) {
+  const auto pred_client = connections_->Get(predecessor_);
+  if (!pred_client->SendAsync(update_succ_req)) {
     // error
     LOG_F(ERROR, "Request failed to send.");
   }
 }
 
+void Nameserver::InterruptReceive() { server_->InterruptReceive(); }
+
 void Nameserver::ReceiveAndHandle() {
   message_passing::Endpoint endpoint;
   consistent_hash_msgs::NameServerMessage ns_msg;
@@ -227,9 +227,8 @@ void Nameserver::HandleRequest(
   // entering nameserver will be the first in the ring.
 
   // forward to successor
-  message_passing::Client client =
-      message_passing::Client(threadpool_, successor_);
-  if (!client.SendAsync(req)) {
+  const auto client = connections_->Get(successor_);
+  if (!client->SendAsync(req)) {
     LOG_F(ERROR,
           "Error sending EntranceInfo message from namserver #%i to successor "
           "#%i",
@@ -279,9 +278,8 @@ void Nameserver::HandleRequest(
   LOG_F(INFO,
         "Nameserver #%i sending UpdatePredecessorResponse to name server %s",
         id_, source.hostname.c_str());
-  message_passing::Client client =
-      message_passing::Client(threadpool_, predecessor_);
-  if (!client.SendAsync(res)) {
+  const auto client = connections_->Get(predecessor_);
+  if (!client->SendAsync(res)) {
     // error
     LOG_F(ERROR, "Request failed to send.");
   }
@@ -313,9 +311,8 @@ void Nameserver::HandleRequest(
   LOG_F(INFO, "Nameserver #%i sending a LookUpResult to successor #%i", id_,
         successor_id_);
   // forward LookUpResult to successor
-  message_passing::Client client =
-      message_passing::Client(threadpool_, successor_);
-  if (!client.SendAsync(req)) {
+  const auto client = connections_->Get(successor_);
+  if (!client->SendAsync(req)) {
     // error
     LOG_F(ERROR, "Request failed to send.");
   }
@@ -337,9 +334,8 @@ void Nameserver::HandleRequest(
   LOG_F(INFO, "Nameserver #%i sending a InsertResult to successor #%i", id_,
         successor_id_);
   // forward LookUpResult to successor
-  message_passing::Client client =
-      message_passing::Client(threadpool_, successor_);
-  if (!client.SendAsync(req)) {
+  const auto client = connections_->Get(successor_);
+  if (!client->SendAsync(req)) {
     // error
     LOG_F(ERROR, "Request failed to send.");
   }
@@ -364,9 +360,8 @@ void Nameserver::HandleRequest(
   LOG_F(INFO, "Nameserver #%i sending a DeleteResult to successor #%i", id_,
         successor_id_);
   // forward LookUpResult to successor
-  message_passing::Client client =
-      message_passing::Client(threadpool_, successor_);
-  if (!client.SendAsync(req)) {
+  const auto client = connections_->Get(successor_);
+  if (!client->SendAsync(req)) {
     // error
     LOG_F(ERROR, "Request failed to send.");
   }
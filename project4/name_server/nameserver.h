@@ -11,6 +11,7 @@
 #include <string>
 
 #include "message_passing/client.h"
+#include "message_passing/connection_cache.h"
 #include "message_passing/server.h"
 #include "message_passing/types.h"
 #include "tasks/console_task.h"
@@ -52,6 +53,12 @@ class Nameserver {
    */
   virtual void ReceiveAndHandle();
 
+  /**
+   * @brief Makes a call to `ReceiveAndHandle()` that is waiting for a message
+   * return right away.
+   */
+  void InterruptReceive();
+
  protected:
   /// The threadpool used by client, server
   std::shared_ptr<thread_pool::ThreadPool> threadpool_;
@@ -62,6 +69,9 @@ class Nameserver {
   /// The client object
   std::unique_ptr<message_passing::Client> client_;
 
+  /// Long-lived connections to the other nodes in the ring
+  std::shared_ptr<message_passing::ConnectionCache> connections_;
+
   /// The key-value pairs in this nameserver
   std::unordered_map<uint, std::string> pairs_;
 
@@ -31,6 +31,8 @@ thread_pool::Task::Status ConsoleTask::RunAtomic() {
   return thread_pool::Task::Status::RUNNING;
 }
 
+void ConsoleTask::OnCancel() { console_message_queue_.Interrupt(); }
+
 void ConsoleTask::SendConsole(const std::string& message) {
   console_message_queue_.Push(message);
 }
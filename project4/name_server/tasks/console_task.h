@@ -30,6 +30,8 @@ class ConsoleTask : public thread_pool::Task {
 
   Status RunAtomic() override;
 
+  void OnCancel() override;
+
   /**
    * @param message the message to be sent to this console
    */
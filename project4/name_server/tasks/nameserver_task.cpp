@@ -13,4 +13,6 @@ thread_pool::Task::Status NameserverTask::RunAtomic() {
   return thread_pool::Task::Status::RUNNING;
 }
 
+void NameserverTask::OnCancel() { nameserver_->InterruptReceive(); }
+
 }  // namespace nameserver::tasks
@@ -26,6 +26,8 @@ class NameserverTask : public thread_pool::Task {
 
   Status RunAtomic() override;
 
+  void OnCancel() override;
+
  private:
   /// Nameserver
   std::shared_ptr<nameserver::Nameserver> nameserver_;